@@ -0,0 +1,36 @@
+/*
+  Common parts of the benchmarks. They include the converter source, so the
+  static functions can be timed directly, in the configuration of the
+  program.
+*/
+
+#define main rtcm3torinex_main
+#include "rtcm3torinex.c"
+#undef main
+
+/* monotonic time [s] */
+static double BenchTime(void)
+{
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec+t.tv_nsec*1e-9;
+}
+
+/* reads a whole file, exits on errors */
+static unsigned char *BenchRead(const char *name, size_t *size)
+{
+  FILE *f = fopen(name, "rb");
+  unsigned char *data = 0;
+  long n;
+
+  if(!f || fseek(f, 0, SEEK_END) || (n = ftell(f)) < 0
+  || fseek(f, 0, SEEK_SET) || !(data = malloc(n+1))
+  || fread(data, 1, n, f) != (size_t)n)
+  {
+    fprintf(stderr, "Could not read '%s'.\n", name);
+    exit(1);
+  }
+  fclose(f);
+  *size = n;
+  return data;
+}
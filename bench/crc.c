@@ -0,0 +1,69 @@
+/*
+  Throughput of the CRC24Q variants on frames of 8 to 1029 bytes, compared
+  with the bitwise CRC of the original converter.
+*/
+
+#include "bench.h"
+
+static uint32_t CRC24Bitwise(long size, const unsigned char *buf)
+{
+  uint32_t crc = 0;
+  int i;
+
+  while(size--)
+  {
+    crc ^= (*buf++) << 16;
+    for(i = 0; i < 8; i++)
+    {
+      crc <<= 1;
+      if(crc & 0x1000000)
+        crc ^= 0x01864cfb;
+    }
+  }
+  return crc;
+}
+
+int main(void)
+{
+  static const int sizes[] = {8, 32, 64, 128, 256, 512, 1029};
+  static unsigned char buf[1029];
+  volatile uint32_t sink = 0;
+  int i;
+
+  srand(1);
+  for(i = 0; i < (int)sizeof(buf); ++i)
+    buf[i] = rand();
+  CRC24Init();
+  printf("frame bytes  bitwise   table slice8  clmul (MB/s)\n");
+  for(i = 0; i < (int)(sizeof(sizes)/sizeof(*sizes)); ++i)
+  {
+    long reps = 50000000L/sizes[i], r;
+    double mb = (double)reps*sizes[i]/1e6, t, bitwise, table, slice8;
+    double clmul = 0.0;
+
+    t = BenchTime();
+    for(r = 0; r < reps/16; ++r)
+      sink += CRC24Bitwise(sizes[i], buf);
+    bitwise = (BenchTime()-t)*16;
+    t = BenchTime();
+    for(r = 0; r < reps; ++r)
+      sink += CRC24Table(0, sizes[i], buf);
+    table = BenchTime()-t;
+    t = BenchTime();
+    for(r = 0; r < reps; ++r)
+      sink += CRC24Slice8(0, sizes[i], buf);
+    slice8 = BenchTime()-t;
+#ifdef RTCM3_PCLMUL
+    if(crc24func == CRC24Clmul)
+    {
+      t = BenchTime();
+      for(r = 0; r < reps; ++r)
+        sink += CRC24Clmul(0, sizes[i], buf);
+      clmul = mb/(BenchTime()-t);
+    }
+#endif /* RTCM3_PCLMUL */
+    printf("%11d %8.0f %7.0f %6.0f %6.0f\n", sizes[i], mb/bitwise, mb/table,
+    mb/slice8, clmul);
+  }
+  return 0;
+}
@@ -0,0 +1,88 @@
+/*
+  Decode time per message type.
+
+  usage: decode file...
+
+  The frames of the files are sorted by message type. For each of the
+  types below, all its frames are decoded in order by RTCM3Decode() with a
+  parser of their own, including the epoch handoff. The best of some runs
+  is given per message.
+*/
+
+#include "bench.h"
+
+static const int types[] = {1004, 1012, 1019, 1020, 1045, 1077, 1087, 1097,
+1127};
+#define NUMTYPES (int)(sizeof(types)/sizeof(*types))
+
+struct TypeFrames
+{
+  const unsigned char **frame;
+  int num;
+};
+
+int main(int argc, char **argv)
+{
+  static struct TypeFrames frames[NUMTYPES];
+  static struct RTCM3ParserData parser;
+  int i, k;
+
+  if(argc < 2)
+  {
+    fprintf(stderr, "usage: %s file...\n", argv[0]);
+    return 1;
+  }
+  for(i = 1; i < argc; ++i)
+  {
+    size_t size;
+    const unsigned char *m, *e;
+    int need;
+
+    m = BenchRead(argv[i], &size);
+    e = m+size;
+    while((m = RTCM3Sync(m, e, &need)) < e && !need)
+    {
+      int len = ((m[1]&3)<<8)|m[2], type = (m[3]<<4)|(m[4]>>4);
+      for(k = 0; k < NUMTYPES && types[k] != type; ++k)
+        ;
+      if(k < NUMTYPES)
+      {
+        struct TypeFrames *t = frames+k;
+        if(!(t->num & (t->num+1))) /* 0, 1, 3, 7, ... */
+          t->frame = realloc(t->frame, 2*(t->num+1)*sizeof(*t->frame));
+        t->frame[t->num++] = m;
+      }
+      m += len+6;
+    }
+  }
+
+  printf("type  messages  ns per message\n");
+  for(k = 0; k < NUMTYPES; ++k)
+  {
+    struct TypeFrames *t = frames+k;
+    double best = 1e9;
+    int r;
+
+    if(!t->num)
+      continue;
+    for(r = 0; r < 25; ++r)
+    {
+      double s;
+
+      memset(&parser, 0, sizeof(parser));
+      parser.GPSWeek = 2440;
+      parser.rinex3 = 1;
+      s = BenchTime();
+      for(i = 0; i < t->num; ++i)
+      {
+        parser.size = ((t->frame[i][1]&3)<<8)|t->frame[i][2];
+        RTCM3Decode(&parser, t->frame[i]+3);
+      }
+      s = BenchTime()-s;
+      if(s < best)
+        best = s;
+    }
+    printf("%4d %9d %15.0f\n", types[k], t->num, best/t->num*1e9);
+  }
+  return 0;
+}
@@ -0,0 +1,127 @@
+/*
+  Data moved by the framer per RTCM3 frame.
+
+  usage: framer file
+
+  The file is fed byte by byte like HandleByte() does, once through the
+  framing of the original converter, which compacted the buffer with
+  memmove after every frame and skipped byte, and once through
+  RTCM3Parser(). The memmove calls of the converter are counted.
+*/
+
+#define _GNU_SOURCE /* as in the converter, which gets string.h from here */
+#include <string.h>
+
+static unsigned long long movedbytes;
+static long movecalls;
+
+static void *CountMemmove(void *to, const void *from, size_t n)
+{
+  movedbytes += n;
+  ++movecalls;
+  return memmove(to, from, n);
+}
+
+#define memmove CountMemmove
+#include "bench.h"
+#undef memmove
+
+struct OldFramer
+{
+  unsigned char Message[2048];
+  int MessageSize, NeedBytes, SkipBytes, size;
+};
+
+/* GetMessage() of the original converter */
+static int OldGetMessage(struct OldFramer *h)
+{
+  unsigned char *m = h->Message+h->SkipBytes, *e = h->Message+h->MessageSize;
+  int i;
+
+  h->NeedBytes = h->SkipBytes = 0;
+  while(e-m >= 3)
+  {
+    if(m[0] == 0xD3)
+    {
+      h->size = ((m[1]&3)<<8)|m[2];
+      if(e-m >= h->size+6)
+      {
+        if((uint32_t)((m[3+h->size]<<16)|(m[3+h->size+1]<<8)
+        |(m[3+h->size+2])) == crc24func(0, h->size+3, m) >> 8)
+        {
+          h->SkipBytes = h->size;
+          break;
+        }
+        else
+          ++m;
+      }
+      else
+      {
+        h->NeedBytes = h->size+6;
+        break;
+      }
+    }
+    else
+      ++m;
+  }
+  if(e-m < 3)
+    h->NeedBytes = 3;
+  i = m-h->Message;
+  if(i && m < e)
+    CountMemmove(h->Message, m, (size_t)(h->MessageSize-i));
+  h->MessageSize -= i;
+  return !h->NeedBytes;
+}
+
+int main(int argc, char **argv)
+{
+  static struct OldFramer old;
+  static struct RTCM3ParserData parser;
+  unsigned char *data;
+  size_t size, i;
+  long frames = 0;
+  double t;
+
+  if(argc != 2)
+  {
+    fprintf(stderr, "usage: %s file\n", argv[0]);
+    return 1;
+  }
+  data = BenchRead(argv[1], &size);
+  CRC24Init();
+
+  t = BenchTime();
+  for(i = 0; i < size; ++i)
+  {
+    old.Message[old.MessageSize++] = data[i];
+    if(old.MessageSize >= old.NeedBytes)
+    {
+      while(OldGetMessage(&old))
+        ++frames;
+    }
+  }
+  t = BenchTime()-t;
+  printf("%.1f MB, %ld frames\n", size/1e6, frames);
+  printf("original: %5.0f bytes moved per frame, %7ld memmove calls, "
+  "%.1f ms\n", (double)movedbytes/frames, movecalls, t*1e3);
+
+  movedbytes = 0;
+  movecalls = 0;
+  parser.GPSWeek = 2440;
+  parser.rinex3 = 1;
+  t = BenchTime();
+  for(i = 0; i < size; ++i)
+  {
+    parser.Message[parser.MessageSize++] = data[i];
+    if(parser.MessageSize >= parser.NeedBytes)
+    {
+      while(RTCM3Parser(&parser))
+        ;
+    }
+  }
+  t = BenchTime()-t;
+  printf("current:  %5.0f bytes moved per frame, %7ld memmove calls, "
+  "%.1f ms with decoding\n", (double)movedbytes/frames, movecalls, t*1e3);
+  free(data);
+  return 0;
+}
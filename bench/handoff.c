@@ -0,0 +1,106 @@
+/*
+  Bytes touched by the epoch handoff.
+
+  usage: handoff file...
+
+  The original converter copied the assembled struct gnssdata to Data and
+  cleared it with memset at each epoch. Now the buffers are swapped and
+  only the used rows of the one that becomes DataNew are cleared. Both are
+  given in bytes per epoch and in KB per second at 1, 10 and 20 Hz, with
+  the decode time per epoch.
+*/
+
+#include "bench.h"
+
+/* struct gnssdata of the original converter */
+struct OldGnssData
+{
+  int    flags;
+  int    week;
+  int    numsats;
+  double timeofweek;
+  double measdata[GNSS_MAXSATS][GNSSENTRY_NUMBER];
+  unsigned long long dataflags[GNSS_MAXSATS];
+  unsigned int dataflags2[GNSS_MAXSATS];
+  int    satellites[GNSS_MAXSATS];
+  int    snrL1[GNSS_MAXSATS];
+  int    snrL2[GNSS_MAXSATS];
+  const char * codetype[GNSS_MAXSATS][GNSSENTRY_NUMBER];
+};
+
+/* bytes ClearSat() writes for the rows of gnss and NewEpoch() for the rest */
+static long ClearBytes(const struct gnssdata *gnss)
+{
+  long bytes = sizeof(gnss->flags)+sizeof(gnss->week)+sizeof(gnss->numsats)
+  +sizeof(gnss->timeofweek);
+  int i;
+
+  for(i = 0; i < gnss->numsats; ++i)
+  {
+    bytes += sizeof(gnss->dataflags[i])+sizeof(gnss->dataflags2[i])
+    +sizeof(gnss->numcells[i])+sizeof(gnss->snrL1[i])+sizeof(gnss->snrL2[i])
+    +sizeof(gnss->satslot[0])+sizeof(gnss->satellites[i]);
+  }
+  return bytes;
+}
+
+int main(int argc, char **argv)
+{
+  static struct RTCM3ParserData parser;
+  int i;
+
+  if(argc < 2)
+  {
+    fprintf(stderr, "usage: %s file...\n", argv[0]);
+    return 1;
+  }
+  printf("%-29s %8s %8s %10s %10s %10s %8s\n", "", "epochs", "bytes",
+  "1 Hz", "10 Hz", "20 Hz", "decode");
+  for(i = 1; i < argc; ++i)
+  {
+    const unsigned char *data, *m, *e;
+    double t = 0.0, bytes;
+    long epochs = 0, touched = 0;
+    size_t size;
+    int need, k;
+
+    data = m = BenchRead(argv[i], &size);
+    e = m+size;
+    memset(&parser, 0, sizeof(parser));
+    parser.GPSWeek = 2440;
+    parser.DataNew = parser.EpochData;
+    parser.Data = parser.EpochData+1;
+    while((m = RTCM3Sync(m, e, &need)) < e && !need)
+    {
+      const struct gnssdata *last = parser.Data;
+      long clear = ClearBytes(last);
+      double s;
+
+      parser.size = ((m[1]&3)<<8)|m[2];
+      s = BenchTime();
+      RTCM3Decode(&parser, m+3);
+      t += BenchTime()-s;
+      if(parser.Data != last) /* last became DataNew and was cleared */
+      {
+        ++epochs;
+        touched += clear;
+      }
+      m += parser.size+6;
+    }
+    if(!epochs)
+      continue;
+    bytes = 3.0*sizeof(struct OldGnssData); /* copy read and write, memset */
+    for(k = 0; k < 2; ++k)
+    {
+      printf("%-20.20s %-8s %8ld %8.0f %7.1f KB %7.1f KB %7.1f KB", k ? ""
+      : argv[i], k ? "current" : "original", epochs, bytes, bytes/1e3,
+      bytes*10/1e3, bytes*20/1e3);
+      if(k)
+        printf(" %5.2f us", t/epochs*1e6);
+      printf("\n");
+      bytes = (double)touched/epochs;
+    }
+    free((void *)data);
+  }
+  return 0;
+}
@@ -0,0 +1,189 @@
+/*
+  Cache lines of struct gnssdata used per epoch and epoch throughput.
+
+  usage: layout file...
+
+  For each complete epoch the 64 byte lines holding its observations are
+  counted, for the compact layout and for the dense measdata and codetype
+  arrays of the original struct gnssdata. Hardware counters are not needed
+  for this. The throughput is that of decoding and writing RINEX 3 to
+  /dev/null, best of some runs.
+*/
+
+#include "bench.h"
+
+/* struct gnssdata of the original converter */
+struct OldGnssData
+{
+  int    flags;
+  int    week;
+  int    numsats;
+  double timeofweek;
+  double measdata[GNSS_MAXSATS][GNSSENTRY_NUMBER];
+  unsigned long long dataflags[GNSS_MAXSATS];
+  unsigned int dataflags2[GNSS_MAXSATS];
+  int    satellites[GNSS_MAXSATS];
+  int    snrL1[GNSS_MAXSATS];
+  int    snrL2[GNSS_MAXSATS];
+  const char * codetype[GNSS_MAXSATS][GNSSENTRY_NUMBER];
+};
+
+#define LINES 2048 /* covers both structures */
+
+static unsigned char line[LINES];
+static int lines;
+
+static void Touch(size_t offset, size_t size)
+{
+  size_t i;
+
+  for(i = offset/64; i <= (offset+size-1)/64; ++i)
+  {
+    if(!line[i])
+    {
+      line[i] = 1;
+      ++lines;
+    }
+  }
+}
+
+#define TOUCH(type, field) Touch(offsetof(type, field), sizeof(((type *)0)->field))
+
+static void TouchCommon(int old)
+{
+  if(old)
+  {
+    TOUCH(struct OldGnssData, flags);
+    TOUCH(struct OldGnssData, week);
+    TOUCH(struct OldGnssData, numsats);
+    TOUCH(struct OldGnssData, timeofweek);
+  }
+  else
+  {
+    TOUCH(struct gnssdata, flags);
+    TOUCH(struct gnssdata, week);
+    TOUCH(struct gnssdata, numsats);
+    TOUCH(struct gnssdata, timeofweek);
+  }
+}
+
+/* lines of an epoch in the compact and in the original layout */
+static void EpochLines(const struct gnssdata *g, int *compact, int *dense)
+{
+  int i, e;
+
+  memset(line, 0, sizeof(line));
+  lines = 0;
+  TouchCommon(0);
+  for(i = 0; i < g->numsats; ++i)
+  {
+    TOUCH(struct gnssdata, satellites[i]);
+    TOUCH(struct gnssdata, satslot[g->satellites[i]]);
+    TOUCH(struct gnssdata, dataflags[i]);
+    TOUCH(struct gnssdata, dataflags2[i]);
+    TOUCH(struct gnssdata, snrL1[i]);
+    TOUCH(struct gnssdata, snrL2[i]);
+    TOUCH(struct gnssdata, numcells[i]);
+    for(e = 0; e < GNSSENTRY_NUMBER; ++e)
+    {
+      if(g->dataflags[i] & (UINT64(1)<<e))
+        TOUCH(struct gnssdata, cellindex[i][e]);
+    }
+    if(g->numcells[i])
+    {
+      Touch(offsetof(struct gnssdata, cellvalue[i]),
+      g->numcells[i]*sizeof(g->cellvalue[i][0]));
+      Touch(offsetof(struct gnssdata, cellcode[i]),
+      g->numcells[i]*sizeof(g->cellcode[i][0]));
+    }
+  }
+  *compact = lines;
+
+  memset(line, 0, sizeof(line));
+  lines = 0;
+  TouchCommon(1);
+  for(i = 0; i < g->numsats; ++i)
+  {
+    TOUCH(struct OldGnssData, satellites[i]);
+    TOUCH(struct OldGnssData, dataflags[i]);
+    TOUCH(struct OldGnssData, dataflags2[i]);
+    TOUCH(struct OldGnssData, snrL1[i]);
+    TOUCH(struct OldGnssData, snrL2[i]);
+    for(e = 0; e < GNSSENTRY_NUMBER; ++e)
+    {
+      if(g->dataflags[i] & (UINT64(1)<<e))
+      {
+        TOUCH(struct OldGnssData, measdata[i][e]);
+        TOUCH(struct OldGnssData, codetype[i][e]);
+      }
+    }
+  }
+  *dense = lines;
+}
+
+int main(int argc, char **argv)
+{
+  static struct RTCM3ParserData parser;
+  int i;
+
+  if(sizeof(struct OldGnssData) > LINES*64 || sizeof(struct gnssdata) > LINES*64)
+    return 1;
+  if(!(textfile = fopen("/dev/null", "w")))
+    return 1;
+  printf("%-20s %7s %15s %15s %10s\n", "", "epochs", "lines compact",
+  "lines original", "epochs/s");
+  for(i = 1; i < argc; ++i)
+  {
+    const unsigned char *data, *m, *e;
+    double best = 1e9;
+    long epochs = 0, compact = 0, dense = 0;
+    size_t size;
+    int need, r, run;
+
+    data = BenchRead(argv[i], &size);
+    e = data+size;
+    for(run = 0; run < 5; ++run)
+    {
+      double t;
+
+      memset(&parser, 0, sizeof(parser));
+      parser.GPSWeek = 2440;
+      parser.rinex3 = 1;
+      epochs = compact = dense = 0;
+      m = data;
+      t = BenchTime();
+      while((m = RTCM3Sync(m, e, &need)) < e && !need)
+      {
+        parser.size = ((m[1]&3)<<8)|m[2];
+        if((r = RTCM3Decode(&parser, m+3)))
+        {
+          HandleResult(&parser, r);
+          if(r == 1 || r == 2)
+          {
+            ++epochs;
+            if(!run)
+            {
+              int c, d;
+              EpochLines(parser.Data, &c, &d);
+              compact += c;
+              dense += d;
+            }
+          }
+        }
+        m += parser.size+6;
+      }
+      t = BenchTime()-t;
+      if(run && t < best) /* the first run counts the lines */
+        best = t;
+      if(!epochs)
+        break;
+      if(!run)
+        printf("%-20.20s %7ld %15.1f %15.1f", argv[i], epochs,
+        (double)compact/epochs, (double)dense/epochs);
+    }
+    if(epochs)
+      printf(" %10.0f\n", epochs/best);
+    free((void *)data);
+  }
+  return 0;
+}
@@ -0,0 +1,161 @@
+/*
+  MSM cells decoded per second by the specialised decoders and by the
+  generic DecodeMSM() with the MSM number and the system as variables.
+
+  usage: msm file...
+*/
+
+#include "bench.h"
+
+struct TypeFrames
+{
+  const unsigned char **frame;
+  int num;
+  long cells;
+};
+
+static int __attribute__((noinline)) Generic(struct RTCM3ParserData *handle,
+struct BitReader *br, int msm, int sys)
+{
+  return DecodeMSM(handle, br, msm, sys);
+}
+
+static int Bits(const unsigned char *d, int pos, int n)
+{
+  int v = 0;
+
+  while(n--)
+  {
+    v = (v<<1)|((d[pos>>3]>>(7-(pos&7)))&1);
+    ++pos;
+  }
+  return v;
+}
+
+/* cells of a MSM payload */
+static int Cells(const unsigned char *d)
+{
+  int nsat = 0, nsig = 0, n = 0, i;
+
+  for(i = 0; i < 64; ++i)
+    nsat += Bits(d, 73+i, 1);
+  for(i = 0; i < 32; ++i)
+    nsig += Bits(d, 137+i, 1);
+  for(i = 0; i < nsat*nsig; ++i)
+    n += Bits(d, 169+i, 1);
+  return n;
+}
+
+/* best time of some runs [s] */
+static double Time(struct TypeFrames *t, int generic, int type)
+{
+  static struct RTCM3ParserData parser;
+  double best = 1e9;
+  int r, i;
+
+  for(r = 0; r < 25; ++r)
+  {
+    double s;
+
+    memset(&parser, 0, sizeof(parser));
+    parser.GPSWeek = 2440;
+    parser.DataNew = parser.EpochData;
+    parser.Data = parser.EpochData+1;
+    s = BenchTime();
+    for(i = 0; i < t->num; ++i)
+    {
+      struct BitReader br;
+
+      br.data = t->frame[i]+3;
+      br.pos = 12;
+      br.end = (((t->frame[i][1]&3)<<8)|t->frame[i][2])+3;
+      if(generic)
+        Generic(&parser, &br, type%10, (type-1071)/10);
+      else
+        msmdecoders[(type-1071)/10][type%10-1](&parser, &br);
+    }
+    s = BenchTime()-s;
+    if(s < best)
+      best = s;
+  }
+  return best;
+}
+
+int main(int argc, char **argv)
+{
+  static const char *sys[RTCM3_MSM_NUMSYS] = {"GPS", "GLONASS", "Galileo",
+  "SBAS", "QZSS", "BDS"};
+  static struct TypeFrames frames[RTCM3_MSM_NUMSYS*10];
+  double tg[7+RTCM3_MSM_NUMSYS], ts[7+RTCM3_MSM_NUMSYS];
+  long cells[7+RTCM3_MSM_NUMSYS], num[7+RTCM3_MSM_NUMSYS];
+  int i, k;
+
+  if(argc < 2)
+  {
+    fprintf(stderr, "usage: %s file...\n", argv[0]);
+    return 1;
+  }
+  for(i = 1; i < argc; ++i)
+  {
+    size_t size;
+    const unsigned char *m, *e;
+    int need;
+
+    m = BenchRead(argv[i], &size);
+    e = m+size;
+    while((m = RTCM3Sync(m, e, &need)) < e && !need)
+    {
+      int len = ((m[1]&3)<<8)|m[2], type = (m[3]<<4)|(m[4]>>4);
+      if(type >= 1071 && type < 1071+RTCM3_MSM_NUMSYS*10 && type%10 >= 1
+      && type%10 <= 7)
+      {
+        struct TypeFrames *t = frames+type-1071;
+        if(!(t->num & (t->num+1)))
+          t->frame = realloc(t->frame, 2*(t->num+1)*sizeof(*t->frame));
+        t->frame[t->num++] = m;
+        t->cells += Cells(m+3);
+      }
+      m += len+6;
+    }
+  }
+
+  /* totals by MSM number and by system */
+  memset(tg, 0, sizeof(tg));
+  memset(ts, 0, sizeof(ts));
+  memset(cells, 0, sizeof(cells));
+  memset(num, 0, sizeof(num));
+  for(k = 0; k < RTCM3_MSM_NUMSYS*10; ++k)
+  {
+    struct TypeFrames *t = frames+k;
+    double g, s;
+    int group[2];
+
+    if(!t->num)
+      continue;
+    group[0] = k%10;  /* MSM number - 1 */
+    group[1] = 7+k/10; /* system */
+    g = Time(t, 1, 1071+k);
+    s = Time(t, 0, 1071+k);
+    for(i = 0; i < 2; ++i)
+    {
+      tg[group[i]] += g;
+      ts[group[i]] += s;
+      cells[group[i]] += t->cells;
+      num[group[i]] += t->num;
+    }
+  }
+  printf("            messages  cells  generic / specialised\n");
+  for(i = 0; i < 7+RTCM3_MSM_NUMSYS; ++i)
+  {
+    if(!num[i])
+      continue;
+    if(i < 7)
+      printf("MSM%d    ", i+1);
+    else
+      printf("%-8s", sys[i-7]);
+    printf("%12ld %6.1f %5.0f / %4.0f ns %6.1f / %5.1f Mcells/s\n",
+    num[i], (double)cells[i]/num[i], tg[i]/num[i]*1e9, ts[i]/num[i]*1e9,
+    cells[i]/tg[i]/1e6, cells[i]/ts[i]/1e6);
+  }
+  return 0;
+}
@@ -0,0 +1,117 @@
+/*
+  Formatting of RINEX navigation records.
+
+  usage: navformat file
+
+  First a "%19.12e" value with 'D' exponent is formatted with snprintf and
+  a scan for the 'e' as in the original ConvLine() and with FormatExp().
+  Then the file, which should be heavy in ephemerides, is converted with
+  the navigation output of RINEX 3 and RINEX 2 going to /dev/null.
+*/
+
+#include "bench.h"
+
+static int OldFormat(char *buf, double x)
+{
+  int n = snprintf(buf, 32, "%19.12e", x), i;
+
+  for(i = 0; i < n; ++i)
+  {
+    if(buf[i] == 'e')
+      buf[i] = 'D';
+  }
+  return n;
+}
+
+/* the conversion time, best of some runs */
+static double Convert(const unsigned char *data, size_t size, int rinex3,
+long *records)
+{
+  static struct RTCM3ParserData parser;
+  double best = 1e9;
+  int run, i;
+
+  for(run = 0; run < 7; ++run)
+  {
+    const unsigned char *m = data, *e = data+size;
+    FILE **files[NAVFILES];
+    const char **names[NAVFILES];
+    double t;
+    int need, r;
+
+    memset(&parser, 0, sizeof(parser));
+    parser.GPSWeek = 2440;
+    parser.rinex3 = rinex3;
+    NavFields(&parser, files, names);
+    for(i = 0; i < NAVFILES; ++i)
+    {
+      if(rinex3 ? i == NAVFILES-1 : i < NAVFILES-1)
+        *names[i] = "/dev/null";
+    }
+    t = BenchTime();
+    while((m = RTCM3Sync(m, e, &need)) < e && !need)
+    {
+      parser.size = ((m[1]&3)<<8)|m[2];
+      if((r = RTCM3Decode(&parser, m+3)))
+        HandleResult(&parser, r);
+      m += parser.size+6;
+    }
+    for(i = 0; i < NAVFILES; ++i)
+    {
+      if(*files[i])
+        fflush(*files[i]);
+    }
+    t = BenchTime()-t;
+    for(i = 0; i < NAVFILES; ++i)
+    {
+      if(*files[i])
+        fclose(*files[i]);
+    }
+    if(t < best)
+      best = t;
+  }
+  *records = parser.ephemerisWritten;
+  return best;
+}
+
+int main(int argc, char **argv)
+{
+  static double values[100000];
+  const unsigned char *data;
+  volatile int sink = 0;
+  char buf[40];
+  double t, told, tnew;
+  size_t size;
+  long records;
+  int i;
+
+  if(argc != 2)
+  {
+    fprintf(stderr, "usage: %s file\n", argv[0]);
+    return 1;
+  }
+  srand(1);
+  for(i = 0; i < 100000; ++i) /* values as in ephemerides */
+  {
+    values[i] = (rand()/(double)RAND_MAX-0.5)*pow(10.0, rand() % 30-20);
+  }
+  t = BenchTime();
+  for(i = 0; i < 100000; ++i)
+    sink += OldFormat(buf, values[i]);
+  told = BenchTime()-t;
+  t = BenchTime();
+  for(i = 0; i < 100000; ++i)
+    sink += FormatExp(buf, values[i]);
+  tnew = BenchTime()-t;
+  printf("per value: snprintf and scan %.0f ns, FormatExp %.0f ns\n",
+  told*1e4, tnew*1e4);
+
+  data = BenchRead(argv[1], &size);
+  if(!(textfile = fopen("/dev/null", "w")))
+    return 1;
+  t = Convert(data, size, 1, &records);
+  printf("RINEX 3: %ld records in %.3f s\n", records, t);
+  t = Convert(data, size, 0, &records);
+  printf("RINEX 2: %ld records in %.3f s\n", records, t);
+  return 0;
+}
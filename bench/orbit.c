@@ -0,0 +1,88 @@
+/*
+  Satellite positions from broadcast ephemerides.
+
+  usage: orbit file
+
+  The ephemerides of the file are decoded and the positions of all their
+  satellites computed for an hour of 1 Hz epochs, once with all satellites
+  of an epoch in one call of SatellitePositions() and once with a call for
+  each satellite, which leaves the other lanes unused. The Kepler and the
+  GLONASS satellites are timed separately.
+*/
+
+#include "bench.h"
+
+#define EPOCHS 3600
+
+/* satellites per second */
+static double Rate(const struct ephemerisentry **eph, int num, int week,
+int tow, int single)
+{
+  double pos[3*RTCM3_MSM_NUMSYS*RTCM3_MSM_NUMSAT];
+  double clock[RTCM3_MSM_NUMSYS*RTCM3_MSM_NUMSAT];
+  double t;
+  int n, i;
+
+  t = BenchTime();
+  for(n = 0; n < EPOCHS; ++n)
+  {
+    if(single)
+    {
+      for(i = 0; i < num; ++i)
+        SatellitePositions(eph+i, 1, week, tow+n, pos+3*i, clock+i);
+    }
+    else
+      SatellitePositions(eph, num, week, tow+n, pos, clock);
+  }
+  t = BenchTime()-t;
+  return t > 0.0 ? num*(double)EPOCHS/t : 0.0;
+}
+
+int main(int argc, char **argv)
+{
+  static struct RTCM3ParserData parser;
+  static const struct ephemerisentry *kepler[RTCM3_MSM_NUMSYS*RTCM3_MSM_NUMSAT];
+  static const struct ephemerisentry *glonass[RTCM3_MSM_NUMSAT];
+  const unsigned char *data, *m, *e;
+  int need, nk = 0, ng = 0, week = 0, tow = 0, sys, prn;
+  size_t size;
+
+  if(argc != 2)
+  {
+    fprintf(stderr, "usage: %s file\n", argv[0]);
+    return 1;
+  }
+  data = BenchRead(argv[1], &size);
+  m = data;
+  e = data+size;
+  parser.GPSWeek = 2440;
+  while((m = RTCM3Sync(m, e, &need)) < e && !need)
+  {
+    parser.size = ((m[1]&3)<<8)|m[2];
+    RTCM3Decode(&parser, m+3);
+    m += parser.size+6;
+  }
+  for(sys = 0; sys < RTCM3_MSM_NUMSYS; ++sys)
+  {
+    for(prn = 1; prn <= RTCM3_MSM_NUMSAT; ++prn)
+    {
+      const struct ephemerisentry *c = GetEphemeris(&parser, sys, prn);
+      if(!c || c->type == 1043)
+        continue;
+      if(c->type == 1020)
+        glonass[ng++] = c;
+      else
+        kepler[nk++] = c;
+      week = c->week; /* compute near the last toe */
+      tow = c->toe-EPOCHS/2;
+    }
+  }
+  printf("%-8s %6s %14s %14s\n", "", "sats", "per epoch", "per satellite");
+  if(nk)
+    printf("%-8s %6d %12.0f/s %12.0f/s\n", "Kepler", nk,
+    Rate(kepler, nk, week, tow, 0), Rate(kepler, nk, week, tow, 1));
+  if(ng)
+    printf("%-8s %6d %12.0f/s %12.0f/s\n", "GLONASS", ng,
+    Rate(glonass, ng, week, tow, 0), Rate(glonass, ng, week, tow, 1));
+  return 0;
+}
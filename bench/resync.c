@@ -0,0 +1,156 @@
+/*
+  Cost of the resynchronisation on corrupted RTCM3 streams.
+
+  usage: resync file
+
+  Bit errors, noise and dense false preambles are put into the recording,
+  which is then searched for frames with the byte loop of the original
+  converter (a full CRC at every preamble) and with RTCM3Sync(). Both use
+  the fastest CRC of the CPU. The extra time compared with the clean data
+  is given per kB of frames lost by the corruption.
+*/
+
+#include "bench.h"
+
+/* the search of the original GetMessage(), returns the bytes in frames */
+static long OldSearch(const unsigned char *d, long n)
+{
+  long p = 0, bytes = 0;
+
+  while(p+6 <= n)
+  {
+    if(d[p] == 0xD3)
+    {
+      int size = ((d[p+1]&3)<<8)|d[p+2];
+      if(p+size+6 <= n && crc24func(0, size+3, d+p) >> 8
+      == (uint32_t)((d[p+size+3]<<16)|(d[p+size+4]<<8)|d[p+size+5]))
+      {
+        p += size+6;
+        bytes += size+6;
+        continue;
+      }
+    }
+    ++p;
+  }
+  return bytes;
+}
+
+static long SyncSearch(const unsigned char *d, long n)
+{
+  const unsigned char *m = d, *e = d+n;
+  long bytes = 0;
+  int need;
+
+  while(m < e)
+  {
+    m = RTCM3Sync(m, e, &need);
+    if(!need)
+    {
+      int size = ((m[1]&3)<<8)|m[2];
+      m += size+6;
+      bytes += size+6;
+    }
+    else if(m < e)
+      ++m;
+  }
+  return bytes;
+}
+
+/* as in test/resync.c */
+static void Corrupt(unsigned char *d, long n, int mode)
+{
+  long i;
+
+  srand(mode);
+  for(i = 0; i < n; ++i)
+  {
+    if((mode == 1 && rand() % 80000 == 0) || (mode == 2 && rand() % 8000 == 0))
+      d[i] ^= 1 << (rand() % 8);
+    else if(mode == 3 && rand() % 20000 == 0)
+    {
+      long k;
+      for(k = 0; k < 500 && i < n; ++k, ++i)
+        d[i] = rand();
+    }
+    else if(mode == 4 && rand() % 2000 == 0)
+    {
+      long k;
+      for(k = 0; k < 300 && i+3 <= n; k += 3, i += 3)
+      {
+        d[i] = 0xD3;
+        d[i+1] = rand() & 3;
+        d[i+2] = rand();
+      }
+    }
+  }
+}
+
+/* best of some runs [s] */
+static double Time(long (*search)(const unsigned char *, long),
+const unsigned char *d, long n, long *bytes)
+{
+  double best = 1e9;
+  int r;
+
+  for(r = 0; r < 5; ++r)
+  {
+    double t = BenchTime();
+    *bytes = search(d, n);
+    t = BenchTime()-t;
+    if(t < best)
+      best = t;
+  }
+  return best;
+}
+
+int main(int argc, char **argv)
+{
+  static const char *modes[] = {"clean", "BER 1e-4", "BER 1e-3", "noise",
+  "dense preambles"};
+  unsigned char *data, *d;
+  double told0 = 0.0, tnew0 = 0.0;
+  long clean = 0;
+  size_t n;
+  int mode;
+
+  if(argc != 2)
+  {
+    fprintf(stderr, "usage: %s file\n", argv[0]);
+    return 1;
+  }
+  data = BenchRead(argv[1], &n);
+  d = malloc(n);
+  CRC24Init();
+  printf("%s CRC, time per kB of input, original / RTCM3Sync\n",
+  crc24func == CRC24Slice8 ? "slice-by-8" : "carry-less multiplication");
+  for(mode = 0; mode < 5; ++mode)
+  {
+    double told, tnew;
+    long bytes, b;
+
+    memcpy(d, data, n);
+    Corrupt(d, n, mode);
+    told = Time(OldSearch, d, n, &bytes);
+    tnew = Time(SyncSearch, d, n, &b);
+    printf("%-15s %7.2f / %5.2f us", modes[mode], told/n*1024e6,
+    tnew/n*1024e6);
+    if(!mode)
+    {
+      told0 = told;
+      tnew0 = tnew;
+      clean = bytes;
+      printf("\n");
+    }
+    else if(clean > bytes)
+    {
+      double lost = (clean-bytes)/1024.0;
+      printf(", extra per lost kB %7.2f / %5.2f us\n", (told-told0)/lost*1e6,
+      (tnew-tnew0)/lost*1e6);
+    }
+    else
+      printf("\n");
+  }
+  free(d);
+  free(data);
+  return 0;
+}
@@ -0,0 +1,125 @@
+/*
+  Writing many output files with and without io_uring.
+
+  usage: uring file [files [epochs [directory]]]
+
+  The first epochs (default 100) of the RINEX observation file are written
+  round robin to files (default 1000) in directory (default bench/out),
+  removed afterwards, as by a stream
+  list converter: with stdio, with stdio and a fdatasync of each file every
+  10 epochs, and with the io_uring files, whose queue is submitted after
+  each epoch. Given are the time spent in the writing calls, the longest
+  call and the time until all data is written.
+*/
+
+#include "bench.h"
+
+static void Run(const char *data, const size_t *start, int epochs,
+int nfiles, const char *dir, int mode)
+{
+  static const char *names[] = {"stdio", "stdio fdatasync", "io_uring"};
+  FILE **f;
+  char name[256];
+  double t, t0, write = 0.0, longest = 0.0, slow = 0;
+  long calls = 0;
+  int e, i;
+
+  if(!(f = calloc(nfiles, sizeof(*f))))
+    exit(1);
+  for(i = 0; i < nfiles; ++i)
+  {
+    snprintf(name, sizeof(name), "%s/%d.obs", dir, i);
+    if(!(f[i] = mode == 2 ? UringOpen(name) : fopen(name, "w")))
+    {
+      fprintf(stderr, "Could not open '%s'.\n", name);
+      exit(1);
+    }
+    setbuf(f[i], 0);
+  }
+  t0 = BenchTime();
+  for(e = 0; e < epochs; ++e)
+  {
+    for(i = 0; i < nfiles; ++i)
+    {
+      t = BenchTime();
+      fwrite(data+start[e], 1, start[e+1]-start[e], f[i]);
+      if(mode == 1 && e % 10 == 9)
+        fdatasync(fileno(f[i]));
+      t = BenchTime()-t;
+      write += t;
+      if(t > longest)
+        longest = t;
+      if(t > 0.001)
+        ++slow;
+      ++calls;
+    }
+    if(mode == 2)
+    {
+      t = BenchTime();
+      UringFlush();
+      write += BenchTime()-t;
+    }
+  }
+  for(i = 0; i < nfiles; ++i)
+    fclose(f[i]);
+  if(mode == 2)
+    UringFinish();
+  t = BenchTime()-t0;
+  for(i = 0; i < nfiles; ++i)
+  {
+    snprintf(name, sizeof(name), "%s/%d.obs", dir, i);
+    remove(name);
+  }
+  printf("%-16s %8.3f s %8.1f us %8.2f ms %8.0f %8.3f s\n", names[mode],
+  write, write/calls*1e6, longest*1e3, slow, t);
+  free(f);
+}
+
+int main(int argc, char **argv)
+{
+  const char *dir = argc > 4 ? argv[4] : "bench/out";
+  int nfiles = argc > 2 ? atoi(argv[2]) : 1000, epochs = 0, mode;
+  int maxepochs = argc > 3 ? atoi(argv[3]) : 100;
+  const char *data;
+  size_t size, i, *start;
+
+  if(argc < 2 || nfiles <= 0)
+  {
+    fprintf(stderr, "usage: %s file [files [epochs [directory]]]\n",
+    argv[0]);
+    return 1;
+  }
+  data = (const char *)BenchRead(argv[1], &size);
+  if(!(start = malloc((size/2+2)*sizeof(*start))))
+    return 1;
+  for(i = 0; i < size; ++i) /* epochs begin with '>' */
+  {
+    if(data[i] == '>' && (!i || data[i-1] == '\n'))
+    {
+      if(epochs == maxepochs)
+        break;
+      start[epochs++] = i;
+    }
+  }
+  start[epochs] = i;
+  if(!epochs)
+  {
+    fprintf(stderr, "No RINEX 3 epochs in '%s'.\n", argv[1]);
+    return 1;
+  }
+  if(mkdir(dir, 0777) && errno != EEXIST)
+  {
+    fprintf(stderr, "Could not create '%s'.\n", dir);
+    return 1;
+  }
+  printf("%d epochs of %.1f KB to %d files\n", epochs,
+  (start[epochs]-start[0])/1e3/epochs, nfiles);
+  printf("%-16s %10s %11s %11s %8s %10s\n", "", "write", "per call",
+  "longest", "> 1 ms", "complete");
+  for(mode = 0; mode < 3; ++mode)
+    Run(data, start, epochs, nfiles, dir, mode);
+  rmdir(dir);
+  printf("io_uring: %ld writes (%ld registered), %ld syncs, %ld errors\n",
+  uringwrites, uringfixed, uringsyncs, uringerrors);
+  return 0;
+}
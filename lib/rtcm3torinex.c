@@ -24,23 +24,42 @@
   or read http://www.gnu.org/licenses/gpl.txt
 */
 
+#if !defined(NO_RTCM3_MAIN) && defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE /* CPU affinity of the stream workers, fopencookie */
+#endif
+
 #include <ctype.h>
 #include <errno.h>
+#include <float.h>
 #include <math.h>
 #include <signal.h>
 #include <stdarg.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
 #include <sys/types.h>
 #include <time.h>
 #include <unistd.h>
 
 #ifndef NO_RTCM3_MAIN
+#include <fcntl.h>
 #include <getopt.h>
 #include <netdb.h>
 #include <netinet/in.h>
+#include <semaphore.h>
+#include <sys/mman.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#ifdef __linux__
+#include <linux/io_uring.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include <sys/timerfd.h>
+#endif
 #endif
 
 #ifndef sparc
@@ -60,162 +79,368 @@ static char revisionstr[] = "$Revision$";
 #define COMPILEDATE " built " __DATE__
 #endif
 
-static uint32_t CRC24(long size, const unsigned char *buf)
+/* CRC24Q as used by RTCM3 (polynomial 0x1864CFB, no reflection).
+   The table driven versions keep the 24 bit CRC in the upper bits of a 32 bit
+   register, so the usual non-reflected CRC32 slicing technique applies. */
+#define CRC24POLY 0x864CFB00 /* 0x1864CFB << 8 without the x^32 term */
+#define CRC24XINV 0xC3267D00 /* x^-1 = (0x1864CFB ^ 1) >> 1 */
+
+static uint32_t crc24table[8][256];
+static uint32_t crc24shift[1027]; /* x^(8*n) for n bytes up to a full frame */
+static uint32_t crc24unshift[1027]; /* x^(-8*n) */
+static uint32_t (*crc24func)(uint32_t crc, long size, const unsigned char *buf);
+static int crc24reuse; /* bytes a reused CRC must save, see CRC24Check() */
+
+/* process single bytes using the first table */
+static uint32_t CRC24Table(uint32_t crc, long size, const unsigned char *buf)
+{
+  while(size--)
+    crc = (crc << 8) ^ crc24table[0][(crc >> 24) ^ *(buf++)];
+  return crc;
+}
+
+/* slice-by-8, table k handles a byte followed by k zero bytes */
+static uint32_t CRC24Slice8(uint32_t crc, long size, const unsigned char *buf)
+{
+  while(size >= 8)
+  {
+    uint32_t a = crc ^ (((uint32_t)buf[0]<<24)|((uint32_t)buf[1]<<16)
+    |((uint32_t)buf[2]<<8)|buf[3]);
+    crc = crc24table[7][a>>24] ^ crc24table[6][(a>>16)&0xFF]
+    ^ crc24table[5][(a>>8)&0xFF] ^ crc24table[4][a&0xFF]
+    ^ crc24table[3][buf[4]] ^ crc24table[2][buf[5]]
+    ^ crc24table[1][buf[6]] ^ crc24table[0][buf[7]];
+    buf += 8;
+    size -= 8;
+  }
+  return CRC24Table(crc, size, buf);
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) \
+&& !defined(NO_RTCM3_PCLMUL)
+#define RTCM3_PCLMUL
+#include <immintrin.h>
+
+#define CRC24CLMULMIN 64 /* shorter data is faster with slice-by-8 */
+
+static uint64_t crc24fold[2]; /* x^192 and x^128 modulo CRC24POLY*x^8 */
+
+/* Folds 16 byte blocks with carry-less multiplication. The folded 128 bit
+   remainder is congruent to the processed data, so its CRC is the CRC of the
+   data. This and the tail are finished using the tables. */
+__attribute__((target("pclmul,ssse3")))
+static uint32_t CRC24Clmul(uint32_t crc, long size, const unsigned char *buf)
+{
+  const __m128i swap = _mm_set_epi8(0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15);
+  const __m128i k = _mm_set_epi64x((long long)crc24fold[0],
+  (long long)crc24fold[1]);
+  unsigned char rem[16];
+  __m128i f;
+
+  if(size < CRC24CLMULMIN)
+    return CRC24Slice8(crc, size, buf);
+
+  f = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)buf), swap);
+  f = _mm_xor_si128(f, _mm_set_epi32((int)crc, 0, 0, 0));
+  buf += 16;
+  size -= 16;
+  while(size >= 16)
+  {
+    f = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(f, k, 0x11),
+    _mm_clmulepi64_si128(f, k, 0x00)),
+    _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)buf), swap));
+    buf += 16;
+    size -= 16;
+  }
+  _mm_storeu_si128((__m128i *)rem, _mm_shuffle_epi8(f, swap));
+  return CRC24Slice8(CRC24Slice8(0, 16, rem), size, buf);
+}
+
+/* x^n modulo CRC24POLY*x^8 */
+static uint64_t CRC24XPow(int n)
+{
+  uint64_t r = 1;
+  while(n--)
+  {
+    r <<= 1;
+    if(r & (UINT64(1)<<32))
+      r ^= (UINT64(1)<<32)|CRC24POLY;
+  }
+  return r;
+}
+#endif /* RTCM3_PCLMUL */
+
+/* product of two CRC registers modulo CRC24POLY */
+static uint32_t CRC24Mul(uint32_t a, uint32_t b)
 {
-  uint32_t crc = 0;
+  uint32_t r = 0;
   int i;
 
-  while(size--)
+  for(i = 31; i >= 8; --i)
+    r = (r << 1) ^ (CRC24POLY & -(r >> 31)) ^ (a & -((b >> i) & 1));
+  return r;
+}
+
+static void CRC24Tables(void)
+{
+  uint32_t xinv8 = 1 << 8;
+  int i, j;
+
+  for(i = 0; i < 256; ++i)
+  {
+    uint32_t crc = i << 24;
+    for(j = 0; j < 8; ++j)
+      crc = (crc & 0x80000000) ? (crc << 1) ^ CRC24POLY : crc << 1;
+    crc24table[0][i] = crc;
+  }
+  for(i = 0; i < 256; ++i)
   {
-    crc ^= (*buf++) << (16);
-    for(i = 0; i < 8; i++)
+    for(j = 1; j < 8; ++j)
     {
-      crc <<= 1;
-      if(crc & 0x1000000)
-        crc ^= 0x01864cfb;
+      uint32_t crc = crc24table[j-1][i];
+      crc24table[j][i] = (crc << 8) ^ crc24table[0][crc >> 24];
     }
   }
-  return crc;
+  crc24shift[0] = 1 << 8;
+  for(i = 1; i < 1027; ++i)
+    crc24shift[i] = (crc24shift[i-1] << 8)
+    ^ crc24table[0][crc24shift[i-1] >> 24];
+  for(i = 0; i < 8; ++i)
+    xinv8 = CRC24Mul(xinv8, CRC24XINV);
+  crc24unshift[0] = 1 << 8;
+  for(i = 1; i < 1027; ++i)
+    crc24unshift[i] = CRC24Mul(crc24unshift[i-1], xinv8);
+  crc24func = CRC24Slice8;
+  crc24reuse = 64;
+#ifdef RTCM3_PCLMUL
+  __builtin_cpu_init();
+  if(__builtin_cpu_supports("pclmul") && __builtin_cpu_supports("ssse3"))
+  {
+    crc24fold[0] = CRC24XPow(192);
+    crc24fold[1] = CRC24XPow(128);
+    crc24func = CRC24Clmul;
+    crc24reuse = 1027; /* never, CRC24Mul() is slower than folding */
+  }
+#endif /* RTCM3_PCLMUL */
 }
 
-static int GetMessage(struct RTCM3ParserData *handle)
+/* sets up the CRC tables and crc24func, called before any CRC is computed;
+   the first call of any thread does the work, the others wait for it */
+static void CRC24Init(void)
 {
-  unsigned char *m, *e;
-  int i;
+  static pthread_once_t once = PTHREAD_ONCE_INIT;
+  pthread_once(&once, CRC24Tables);
+}
 
-  m = handle->Message+handle->SkipBytes;
-  e = handle->Message+handle->MessageSize;
-  handle->NeedBytes = handle->SkipBytes = 0;
-  while(e-m >= 3)
+/* While resynchronising, a candidate frame often overlaps the previous one.
+   The CRC register is linear, so with c(a..b) being the CRC of bytes a to b
+     c(a..e) = c(a..b) * x^(8*(e-b)) ^ c(b..e)
+   and the CRC of the new candidate follows from the previous CRC and the
+   bytes that are not shared. This is used when these are fewer than the
+   bytes of the candidate by crc24reuse, which covers the multiplications. */
+struct CRC24Span
+{
+  const unsigned char *start;
+  int len;
+  uint32_t crc;
+};
+
+static int CRC24Check(struct CRC24Span *s, const unsigned char *m, int n)
+{
+  uint32_t crc;
+  int a = m-s->start, b = s->len-a;
+
+  if(m < s->start+s->len && a+abs(n-b)+crc24reuse < n)
   {
-    if(m[0] == 0xD3)
+    /* c(m..end of previous) */
+    crc = s->crc ^ CRC24Mul(crc24func(0, a, s->start), crc24shift[b]);
+    if(n >= b)
+      crc = crc24func(crc, n-b, m+b);
+    else
+      crc = CRC24Mul(crc ^ crc24func(0, b-n, m+n), crc24unshift[b-n]);
+  }
+  else
+    crc = crc24func(0, n, m);
+  s->start = m;
+  s->len = n;
+  s->crc = crc;
+  return (uint32_t)((m[n]<<16)|(m[n+1]<<8)|m[n+2]) == crc >> 8;
+}
+
+/* Searches [m,e) for the next frame and returns its start. need is set to 0
+   for a frame with valid CRC, otherwise to the number of bytes still required
+   to check the returned candidate. Candidates with the reserved bits set are
+   dropped before any CRC work. */
+static const unsigned char *RTCM3Sync(const unsigned char *m,
+const unsigned char *e, int *need)
+{
+  struct CRC24Span span;
+
+  CRC24Init();
+  span.start = m;
+  span.len = 0;
+  span.crc = 0;
+  while(m < e && (m = memchr(m, 0xD3, e-m)))
+  {
+    int size;
+
+    if(e-m < 3)
+    {
+      *need = 3;
+      return m;
+    }
+    if(!(m[1] & 0xFC)) /* reserved bits */
     {
-      handle->size = ((m[1]&3)<<8)|m[2];
-      if(e-m >= handle->size+6)
+      size = ((m[1]&3)<<8)|m[2];
+      if(e-m < size+6)
       {
-        if((uint32_t)((m[3+handle->size]<<16)|(m[3+handle->size+1]<<8)
-        |(m[3+handle->size+2])) == CRC24(handle->size+3, m))
-        {
-          handle->SkipBytes = handle->size;
-          break;
-        }
-        else
-          ++m;
+        *need = size+6;
+        return m;
       }
-      else
+      if(CRC24Check(&span, m, size+3))
       {
-        handle->NeedBytes = handle->size+6;
-        break;
+        *need = 0;
+        return m;
       }
     }
-    else
-      ++m;
+    ++m;
   }
-  if(e-m < 3)
-    handle->NeedBytes = 3;
+  *need = 3;
+  return e;
+}
+
+/* The input buffer uses two cursors: MessageStart is the first unprocessed
+   byte and MessageSize the end of the data. Messages are decoded where they
+   are, partial data is only moved to the front when the next message would
+   not fit into the buffer. */
+static int GetMessage(struct RTCM3ParserData *handle)
+{
+  const unsigned char *m, *e;
+  int need;
 
-  /* copy buffer to front */
-  i = m - handle->Message;
-  if(i && m < e)
-    memmove(handle->Message, m, (size_t)(handle->MessageSize-i));
-  handle->MessageSize -= i;
+  m = handle->Message+handle->MessageStart+handle->SkipBytes;
+  e = handle->Message+handle->MessageSize;
+  handle->NeedBytes = handle->SkipBytes = 0;
+  m = RTCM3Sync(m, e, &need);
+  handle->MessageStart = m - handle->Message;
+  if(!need)
+  {
+    handle->size = ((m[1]&3)<<8)|m[2];
+    handle->SkipBytes = handle->size+6;
+  }
+  else
+  {
+    handle->NeedBytes = need;
+    if(m == e) /* buffer is empty */
+      handle->MessageStart = handle->MessageSize = 0;
+    else if(handle->MessageStart+handle->NeedBytes
+    > (int)sizeof(handle->Message))
+    {
+      /* copy partial message to front */
+      memmove(handle->Message, m, (size_t)(e-m));
+      handle->MessageSize = e-m;
+      handle->MessageStart = 0;
+    }
+    /* NeedBytes is compared to MessageSize */
+    handle->NeedBytes += handle->MessageStart;
+  }
 
   return !handle->NeedBytes;
 }
 
-#define LOADBITS(a) \
-{ \
-  while((a) > numbits) \
-  { \
-    if(!size--) break; \
-    bitfield = (bitfield<<8)|*(data++); \
-    numbits += 8; \
-  } \
-}
+/* Bit reader for message payloads. Fields are taken from a 64 bit big endian
+   word loaded at the byte of the current bit position, so every field of up
+   to 57 bits needs one load and two shifts. The payload is followed by the
+   3 CRC bytes, only at the very end the word is assembled bytewise. */
+struct BitReader
+{
+  const unsigned char *data;
+  unsigned long pos; /* bit position */
+  unsigned long end; /* number of bytes which may be read */
+};
 
-/* extract bits from data stream
-   b = variable to store result, a = number of bits */
-#define GETBITS64(b, a) \
-{ \
-  if(((a) > 56) && ((a)-56) > numbits) \
-  { \
-    uint64_t x; \
-    GETBITS(x, 56) \
-    LOADBITS((a)-56) \
-    b = ((x<<((a)-56)) | (bitfield<<(sizeof(bitfield)*8-numbits)) \
-    >>(sizeof(bitfield)*8-((a)-56))); \
-    numbits -= ((a)-56); \
-  } \
-  else \
-  { \
-    GETBITS(b, a) \
-  } \
-}
-
-/* extract bits from data stream
-   b = variable to store result, a = number of bits */
-#define GETBITS(b, a) \
-{ \
-  LOADBITS(a) \
-  b = (bitfield<<(64-numbits))>>(64-(a)); \
-  numbits -= (a); \
-}
+static uint64_t BitsPeek(const struct BitReader *br)
+{
+  const unsigned char *p = br->data+(br->pos>>3);
+  uint64_t w;
 
-/* extract bits from data stream
-   b = variable to store result, a = number of bits */
-#define GETBITSFACTOR(b, a, c) \
-{ \
-  LOADBITS(a) \
-  b = ((bitfield<<(sizeof(bitfield)*8-numbits))>>(sizeof(bitfield)*8-(a)))*(c); \
-  numbits -= (a); \
+  if((br->pos>>3)+8 <= br->end)
+  {
+#if defined(__GNUC__) && defined(__BYTE_ORDER__) \
+&& __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    memcpy(&w, p, 8);
+    w = __builtin_bswap64(w);
+#else
+    w = ((uint64_t)p[0]<<56)|((uint64_t)p[1]<<48)|((uint64_t)p[2]<<40)
+    |((uint64_t)p[3]<<32)|((uint64_t)p[4]<<24)|((uint64_t)p[5]<<16)
+    |((uint64_t)p[6]<<8)|p[7];
+#endif
+  }
+  else /* bytes behind the frame are read as zero */
+  {
+    unsigned long i;
+
+    w = 0;
+    for(i = br->pos>>3; i < (br->pos>>3)+8; ++i)
+      w = (w<<8)|(i < br->end ? br->data[i] : 0);
+  }
+  return w<<(br->pos&7);
 }
 
-/* extract floating value from data stream
-   b = variable to store result, a = number of bits */
-#define GETFLOAT(b, a, c) \
-{ \
-  LOADBITS(a) \
-  b = ((double)((bitfield<<(64-numbits))>>(64-(a))))*(c); \
-  numbits -= (a); \
+/* unsigned field of 1 to 57 bits */
+static uint64_t BitsGet(struct BitReader *br, int n)
+{
+  uint64_t w = BitsPeek(br);
+  br->pos += n;
+  return w>>(64-n);
 }
 
-/* extract signed floating value from data stream
-   b = variable to store result, a = number of bits */
-#define GETFLOATSIGN(b, a, c) \
-{ \
-  LOADBITS(a) \
-  b = ((double)(((int64_t)(bitfield<<(64-numbits)))>>(64-(a))))*(c); \
-  numbits -= (a); \
+/* two's complement field of 1 to 57 bits */
+static int64_t BitsGetSigned(struct BitReader *br, int n)
+{
+  int64_t w = (int64_t)BitsPeek(br);
+  br->pos += n;
+  return w>>(64-n);
 }
 
-/* extract bits from data stream
-   b = variable to store result, a = number of bits */
-#define GETBITSSIGN(b, a) \
-{ \
-  LOADBITS(a) \
-  b = ((int64_t)(bitfield<<(64-numbits)))>>(64-(a)); \
-  numbits -= (a); \
+/* unsigned field of 0 to 64 bits */
+static uint64_t BitsGet64(struct BitReader *br, int n)
+{
+  if(n > 57)
+  {
+    uint64_t w = BitsGet(br, n-32);
+    return (w<<32)|BitsGet(br, 32);
+  }
+  return n ? BitsGet(br, n) : 0;
 }
 
+/* The following macros read from the BitReader pointer br of the decoder.
+   The widths are mostly constants, so the inlined shifts are too.
+   b = variable to store result, a = number of bits, c = scale factor */
+#define GETBITS(b, a) { b = BitsGet(br, a); }
+#define GETBITS64(b, a) { b = BitsGet64(br, a); }
+#define GETBITSSIGN(b, a) { b = BitsGetSigned(br, a); }
+#define GETBITSFACTOR(b, a, c) { b = BitsGet(br, a)*(c); }
+#define GETFLOAT(b, a, c) { b = ((double)BitsGet(br, a))*(c); }
+#define GETFLOATSIGN(b, a, c) { b = ((double)BitsGetSigned(br, a))*(c); }
+
+/* sign-magnitude value */
 #define GETFLOATSIGNM(b, a, c) \
-{ int l; \
-  LOADBITS(a) \
-  l = (bitfield<<(64-numbits))>>(64-1); \
-  b = ((double)(((bitfield<<(64-(numbits-1))))>>(64-(a-1))))*(c); \
-  numbits -= (a); \
-  if(l) b *= -1.0; \
+{ uint64_t x; \
+  x = BitsGet(br, a); \
+  b = ((double)(x&((UINT64(1)<<((a)-1))-1)))*(c); \
+  if(x>>((a)-1)) b *= -1.0; \
 }
 
-#define SKIPBITS(b) { LOADBITS(b) numbits -= (b); }
+#define SKIPBITS(b) { br->pos += (b); }
 
 /* extract byte-aligned byte from data stream,
    b = variable to store size, s = variable to store string pointer */
 #define GETSTRING(b, s) \
 { \
-  b = *(data++); \
-  s = (char *) data; \
-  data += b; \
-  size -= b+1; \
+  b = br->data[br->pos>>3]; \
+  s = (char *) br->data+(br->pos>>3)+1; \
+  br->pos += (b+1)*8; \
 }
 
 struct leapseconds { /* specify the day of leap second */
@@ -322,3561 +547,7352 @@ void updatetime(int *week, int *secOfWeek, int mSecOfWeek, int fixnumleap)
   if(*secOfWeek >= 24*60*60*7) {*secOfWeek -= 24*60*60*7; ++*week; }
 }
 
-int RTCM3Parser(struct RTCM3ParserData *handle)
+struct CodeData {
+  int typeR;
+  int typeP;
+  int typeD;
+  int typeS;
+  int lock;
+  double wl;
+  const char *code; /* RINEX code type */
+};
+
+static const struct CodeData msmgps[RTCM3_MSM_NUMSIG] =
 {
-  int ret=0;
+  {0,0,0,0,0,0,0},
+  {GNSSENTRY_C1DATA,GNSSENTRY_L1CDATA,GNSSENTRY_D1CDATA,
+  GNSSENTRY_S1CDATA,GNSSDF2_LOCKLOSSL1,GPS_WAVELENGTH_L1,"1C"},
+  {GNSSENTRY_P1DATA,GNSSENTRY_L1PDATA,GNSSENTRY_D1PDATA,
+  GNSSENTRY_S1PDATA,GNSSDF2_LOCKLOSSL1,GPS_WAVELENGTH_L1,"1P"},
+  {GNSSENTRY_P1DATA,GNSSENTRY_L1PDATA,GNSSENTRY_D1PDATA,
+  GNSSENTRY_S1PDATA,GNSSDF2_LOCKLOSSL1,GPS_WAVELENGTH_L1,"1W"},
+  {0,0,0,0,0,0,0}/*{GNSSENTRY_P1DATA,GNSSENTRY_L1PDATA,GNSSENTRY_D1PDATA,
+  GNSSENTRY_S1PDATA,GNSSDF2_LOCKLOSSL1,GPS_WAVELENGTH_L1,"1Y"}*/,
+  {0,0,0,0,0,0,0},
+  {0,0,0,0,0,0,0},
+  {GNSSENTRY_C2DATA,GNSSENTRY_L2CDATA,GNSSENTRY_D2CDATA,
+  GNSSENTRY_S2CDATA,GNSSDF2_LOCKLOSSL2,GPS_WAVELENGTH_L2,"2C"},
+  {GNSSENTRY_P2DATA,GNSSENTRY_L2PDATA,GNSSENTRY_D2PDATA,
+  GNSSENTRY_S2PDATA,GNSSDF2_LOCKLOSSL2,GPS_WAVELENGTH_L2,"2P"},
+  {GNSSENTRY_P2DATA,GNSSENTRY_L2PDATA,GNSSENTRY_D2PDATA,
+  GNSSENTRY_S2PDATA,GNSSDF2_LOCKLOSSL2,GPS_WAVELENGTH_L2,"2W"},
+  {0,0,0,0,0,0,0}/*{GNSSENTRY_P2DATA,GNSSENTRY_L2PDATA,GNSSENTRY_D2PDATA,
+  GNSSENTRY_S2PDATA,GNSSDF2_LOCKLOSSL2,GPS_WAVELENGTH_L2,"2Y"}*/,
+  {0,0,0,0,0,0,0},
+  {0,0,0,0,0,0,0},
+  {0,0,0,0,0,0,0},
+  {GNSSENTRY_C2DATA,GNSSENTRY_L2CDATA,GNSSENTRY_D2CDATA,
+  GNSSENTRY_S2CDATA,GNSSDF2_LOCKLOSSL2,GPS_WAVELENGTH_L2,"2S"},
+  {GNSSENTRY_C2DATA,GNSSENTRY_L2CDATA,GNSSENTRY_D2CDATA,
+  GNSSENTRY_S2CDATA,GNSSDF2_LOCKLOSSL2,GPS_WAVELENGTH_L2,"2L"},
+  {GNSSENTRY_C2DATA,GNSSENTRY_L2CDATA,GNSSENTRY_D2CDATA,
+  GNSSENTRY_S2CDATA,GNSSDF2_LOCKLOSSL2,GPS_WAVELENGTH_L2,"2X"},
+  {0,0,0,0,0,0,0},
+  {0,0,0,0,0,0,0},
+  {0,0,0,0,0,0,0},
+  {0,0,0,0,0,0,0},
+  {GNSSENTRY_C5DATA,GNSSENTRY_L5DATA,GNSSENTRY_D5DATA,
+  GNSSENTRY_S5DATA,GNSSDF2_LOCKLOSSL5,GPS_WAVELENGTH_L5,"5I"},
+  {GNSSENTRY_C5DATA,GNSSENTRY_L5DATA,GNSSENTRY_D5DATA,
+  GNSSENTRY_S5DATA,GNSSDF2_LOCKLOSSL5,GPS_WAVELENGTH_L5,"5Q"},
+  {GNSSENTRY_C5DATA,GNSSENTRY_L5DATA,GNSSENTRY_D5DATA,
+  GNSSENTRY_S5DATA,GNSSDF2_LOCKLOSSL5,GPS_WAVELENGTH_L5,"5X"},
+  {0,0,0,0,0,0,0},
+  {0,0,0,0,0,0,0},
+  {0,0,0,0,0,0,0},
+  {0,0,0,0,0,0,0},
+  {0,0,0,0,0,0,0},
+  {GNSSENTRY_C1NDATA,GNSSENTRY_L1NDATA,GNSSENTRY_D1NDATA,
+  GNSSENTRY_S1NDATA,GNSSDF2_LOCKLOSSL1,GPS_WAVELENGTH_L1,"1S"},
+  {GNSSENTRY_C1NDATA,GNSSENTRY_L1NDATA,GNSSENTRY_D1NDATA,
+  GNSSENTRY_S1NDATA,GNSSDF2_LOCKLOSSL1,GPS_WAVELENGTH_L1,"1L"},
+  {GNSSENTRY_C1NDATA,GNSSENTRY_L1NDATA,GNSSENTRY_D1NDATA,
+  GNSSENTRY_S1NDATA,GNSSDF2_LOCKLOSSL1,GPS_WAVELENGTH_L1,"1X"}
+};
+
+/* NOTE: Uses 0.0, 1.0 for wavelength as sat index dependence is done later! */
+static const struct CodeData msmglo[RTCM3_MSM_NUMSIG] =
+{
+  {0,0,0,0,0,0,0},
+  {GNSSENTRY_C1DATA,GNSSENTRY_L1CDATA,GNSSENTRY_D1CDATA,
+  GNSSENTRY_S1CDATA,GNSSDF2_LOCKLOSSL1,0.0,"1C"},
+  {GNSSENTRY_P1DATA,GNSSENTRY_L1PDATA,GNSSENTRY_D1PDATA,
+  GNSSENTRY_S1PDATA,GNSSDF2_LOCKLOSSL1,0.0,"1P"},
+  {0,0,0,0,0,0,0},
+  {0,0,0,0,0,0,0},
+  {0,0,0,0,0,0,0},
+  {0,0,0,0,0,0,0},
+  {GNSSENTRY_C2DATA,GNSSENTRY_L2CDATA,GNSSENTRY_D2CDATA,
+  GNSSENTRY_S2CDATA,GNSSDF2_LOCKLOSSL2,1.0,"2C"},
+  {GNSSENTRY_P2DATA,GNSSENTRY_L2PDATA,GNSSENTRY_D2PDATA,
+  GNSSENTRY_S2PDATA,GNSSDF2_LOCKLOSSL2,1.0,"2P"},
+  {0,0,0,0,0,0,0},
+  {0,0,0,0,0,0,0},
+  {0,0,0,0,0,0,0},
+  {0,0,0,0,0,0,0},
+  {0,0,0,0,0,0,0},
+  {0,0,0,0,0,0,0},
+  {0,0,0,0,0,0,0},
+  {0,0,0,0,0,0,0},
+  {0,0,0,0,0,0,0},
+  {0,0,0,0,0,0,0},
+  {0,0,0,0,0,0,0},
+  {0,0,0,0,0,0,0},
+  {0,0,0,0,0,0,0},
+  {0,0,0,0,0,0,0},
+  {0,0,0,0,0,0,0},
+  {0,0,0,0,0,0,0},
+  {0,0,0,0,0,0,0},
+  {0,0,0,0,0,0,0},
+  {0,0,0,0,0,0,0},
+  {0,0,0,0,0,0,0},
+  {0,0,0,0,0,0,0},
+  {0,0,0,0,0,0,0},
+  {0,0,0,0,0,0,0}
+};
+
+static const struct CodeData msmgal[RTCM3_MSM_NUMSIG] =
+{
+  {0,0,0,0,0,0,0},
+  {GNSSENTRY_C1DATA,GNSSENTRY_L1CDATA,GNSSENTRY_D1CDATA,
+  GNSSENTRY_S1CDATA,GNSSDF2_LOCKLOSSL1,GAL_WAVELENGTH_E1,"1C"},
+  {GNSSENTRY_C1DATA,GNSSENTRY_L1CDATA,GNSSENTRY_D1CDATA,
+  GNSSENTRY_S1CDATA,GNSSDF2_LOCKLOSSL1,GAL_WAVELENGTH_E1,"1A"},
+  {GNSSENTRY_C1DATA,GNSSENTRY_L1CDATA,GNSSENTRY_D1CDATA,
+  GNSSENTRY_S1CDATA,GNSSDF2_LOCKLOSSL1,GAL_WAVELENGTH_E1,"1B"},
+  {GNSSENTRY_C1DATA,GNSSENTRY_L1CDATA,GNSSENTRY_D1CDATA,
+  GNSSENTRY_S1CDATA,GNSSDF2_LOCKLOSSL1,GAL_WAVELENGTH_E1,"1X"},
+  {GNSSENTRY_C1DATA,GNSSENTRY_L1CDATA,GNSSENTRY_D1CDATA,
+  GNSSENTRY_S1CDATA,GNSSDF2_LOCKLOSSL1,GAL_WAVELENGTH_E1,"1Z"},
+  {0,0,0,0,0,0,0},
+  {GNSSENTRY_C6DATA,GNSSENTRY_L6DATA,GNSSENTRY_D6DATA,
+  GNSSENTRY_S6DATA,GNSSDF2_LOCKLOSSE6,GAL_WAVELENGTH_E6,"6C"},
+  {GNSSENTRY_C6DATA,GNSSENTRY_L6DATA,GNSSENTRY_D6DATA,
+  GNSSENTRY_S6DATA,GNSSDF2_LOCKLOSSE6,GAL_WAVELENGTH_E6,"6A"},
+  {GNSSENTRY_C6DATA,GNSSENTRY_L6DATA,GNSSENTRY_D6DATA,
+  GNSSENTRY_S6DATA,GNSSDF2_LOCKLOSSE6,GAL_WAVELENGTH_E6,"6B"},
+  {GNSSENTRY_C6DATA,GNSSENTRY_L6DATA,GNSSENTRY_D6DATA,
+  GNSSENTRY_S6DATA,GNSSDF2_LOCKLOSSE6,GAL_WAVELENGTH_E6,"6X"},
+  {GNSSENTRY_C6DATA,GNSSENTRY_L6DATA,GNSSENTRY_D6DATA,
+  GNSSENTRY_S6DATA,GNSSDF2_LOCKLOSSE6,GAL_WAVELENGTH_E6,"6Z"},
+  {0,0,0,0,0,0,0},
+  {GNSSENTRY_C5BDATA,GNSSENTRY_L5BDATA,GNSSENTRY_D5BDATA,
+  GNSSENTRY_S5BDATA,GNSSDF2_LOCKLOSSE5B,GAL_WAVELENGTH_E5B,"7I"},
+  {GNSSENTRY_C5BDATA,GNSSENTRY_L5BDATA,GNSSENTRY_D5BDATA,
+  GNSSENTRY_S5BDATA,GNSSDF2_LOCKLOSSE5B,GAL_WAVELENGTH_E5B,"7Q"},
+  {GNSSENTRY_C5BDATA,GNSSENTRY_L5BDATA,GNSSENTRY_D5BDATA,
+  GNSSENTRY_S5BDATA,GNSSDF2_LOCKLOSSE5B,GAL_WAVELENGTH_E5B,"7X"},
+  {0,0,0,0,0,0,0},
+  {GNSSENTRY_C5ABDATA,GNSSENTRY_L5ABDATA,GNSSENTRY_D5ABDATA,
+  GNSSENTRY_S5ABDATA,GNSSDF2_LOCKLOSSE5AB,GAL_WAVELENGTH_E5AB,"8I"},
+  {GNSSENTRY_C5ABDATA,GNSSENTRY_L5ABDATA,GNSSENTRY_D5ABDATA,
+  GNSSENTRY_S5ABDATA,GNSSDF2_LOCKLOSSE5AB,GAL_WAVELENGTH_E5AB,"8Q"},
+  {GNSSENTRY_C5ABDATA,GNSSENTRY_L5ABDATA,GNSSENTRY_D5ABDATA,
+  GNSSENTRY_S5ABDATA,GNSSDF2_LOCKLOSSE5AB,GAL_WAVELENGTH_E5AB,"8X"},
+  {0,0,0,0,0,0,0},
+  {GNSSENTRY_C5DATA,GNSSENTRY_L5DATA,GNSSENTRY_D5DATA,
+  GNSSENTRY_S5DATA,GNSSDF2_LOCKLOSSL5,GAL_WAVELENGTH_E5A,"5I"},
+  {GNSSENTRY_C5DATA,GNSSENTRY_L5DATA,GNSSENTRY_D5DATA,
+  GNSSENTRY_S5DATA,GNSSDF2_LOCKLOSSL5,GAL_WAVELENGTH_E5A,"5Q"},
+  {GNSSENTRY_C5DATA,GNSSENTRY_L5DATA,GNSSENTRY_D5DATA,
+  GNSSENTRY_S5DATA,GNSSDF2_LOCKLOSSL5,GAL_WAVELENGTH_E5A,"5X"},
+  {0,0,0,0,0,0,0},
+  {0,0,0,0,0,0,0},
+  {0,0,0,0,0,0,0},
+  {0,0,0,0,0,0,0},
+  {0,0,0,0,0,0,0},
+  {0,0,0,0,0,0,0},
+  {0,0,0,0,0,0,0},
+  {0,0,0,0,0,0,0},
+};
+
+static const struct CodeData msmqzss[RTCM3_MSM_NUMSIG] =
+{
+  {0,0,0,0,0,0,0},
+  {GNSSENTRY_C1DATA,GNSSENTRY_L1CDATA,GNSSENTRY_D1CDATA,
+  GNSSENTRY_S1CDATA,GNSSDF2_LOCKLOSSL1,GPS_WAVELENGTH_L1,"1C"},
+  {0,0,0,0,0,0,0},
+  {0,0,0,0,0,0,0},
+  {0,0,0,0,0,0,0},
+  {GNSSENTRY_CSAIFDATA,GNSSENTRY_LSAIFDATA,GNSSENTRY_DSAIFDATA,
+  GNSSENTRY_SSAIFDATA,GNSSDF2_LOCKLOSSSAIF,GPS_WAVELENGTH_L1,"1Z"},
+  {0,0,0,0,0,0,0},
+  {0,0,0,0,0,0,0},
+  {GNSSENTRY_CLEXDATA,GNSSENTRY_LLEXDATA,GNSSENTRY_DLEXDATA,
+  GNSSENTRY_SLEXDATA,GNSSDF2_LOCKLOSSLEX,QZSS_WAVELENGTH_LEX,"6S"},
+  {GNSSENTRY_CLEXDATA,GNSSENTRY_LLEXDATA,GNSSENTRY_DLEXDATA,
+  GNSSENTRY_SLEXDATA,GNSSDF2_LOCKLOSSLEX,QZSS_WAVELENGTH_LEX,"6L"},
+  {GNSSENTRY_CLEXDATA,GNSSENTRY_LLEXDATA,GNSSENTRY_DLEXDATA,
+  GNSSENTRY_SLEXDATA,GNSSDF2_LOCKLOSSLEX,QZSS_WAVELENGTH_LEX,"6X"},
+  {0,0,0,0,0,0,0},
+  {0,0,0,0,0,0,0},
+  {0,0,0,0,0,0,0},
+  {GNSSENTRY_C2DATA,GNSSENTRY_L2CDATA,GNSSENTRY_D2CDATA,
+  GNSSENTRY_S2CDATA,GNSSDF2_LOCKLOSSL2,GPS_WAVELENGTH_L2,"2S"},
+  {GNSSENTRY_C2DATA,GNSSENTRY_L2CDATA,GNSSENTRY_D2CDATA,
+  GNSSENTRY_S2CDATA,GNSSDF2_LOCKLOSSL2,GPS_WAVELENGTH_L2,"2L"},
+  {GNSSENTRY_C2DATA,GNSSENTRY_L2CDATA,GNSSENTRY_D2CDATA,
+  GNSSENTRY_S2CDATA,GNSSDF2_LOCKLOSSL2,GPS_WAVELENGTH_L2,"2X"},
+  {0,0,0,0,0,0,0},
+  {0,0,0,0,0,0,0},
+  {0,0,0,0,0,0,0},
+  {0,0,0,0,0,0,0},
+  {GNSSENTRY_C5DATA,GNSSENTRY_L5DATA,GNSSENTRY_D5DATA,
+  GNSSENTRY_S5DATA,GNSSDF2_LOCKLOSSL5,GPS_WAVELENGTH_L5,"5I"},
+  {GNSSENTRY_C5DATA,GNSSENTRY_L5DATA,GNSSENTRY_D5DATA,
+  GNSSENTRY_S5DATA,GNSSDF2_LOCKLOSSL5,GPS_WAVELENGTH_L5,"5Q"},
+  {GNSSENTRY_C5DATA,GNSSENTRY_L5DATA,GNSSENTRY_D5DATA,
+  GNSSENTRY_S5DATA,GNSSDF2_LOCKLOSSL5,GPS_WAVELENGTH_L5,"5X"},
+  {0,0,0,0,0,0,0},
+  {0,0,0,0,0,0,0},
+  {0,0,0,0,0,0,0},
+  {0,0,0,0,0,0,0},
+  {0,0,0,0,0,0,0},
+  {GNSSENTRY_C1NDATA,GNSSENTRY_L1NDATA,GNSSENTRY_D1NDATA,
+  GNSSENTRY_S1NDATA,GNSSDF2_LOCKLOSSL1,GPS_WAVELENGTH_L1,"1D"},
+  {GNSSENTRY_C1NDATA,GNSSENTRY_L1NDATA,GNSSENTRY_D1NDATA,
+  GNSSENTRY_S1NDATA,GNSSDF2_LOCKLOSSL1,GPS_WAVELENGTH_L1,"1P"},
+  {GNSSENTRY_C1NDATA,GNSSENTRY_L1NDATA,GNSSENTRY_D1NDATA,
+  GNSSENTRY_S1NDATA,GNSSDF2_LOCKLOSSL1,GPS_WAVELENGTH_L1,"1X"}
+};
+
+static const struct CodeData msmbds[RTCM3_MSM_NUMSIG] =
+{
+  {0,0,0,0,0,0,0},
+  {GNSSENTRY_CB1DATA,GNSSENTRY_LB1DATA,GNSSENTRY_DB1DATA,
+  GNSSENTRY_SB1DATA,GNSSDF2_LOCKLOSSB1,BDS_WAVELENGTH_B1,"1I"},
+  {0,0,0,0,0,0,0},
+  {0,0,0,0,0,0,0},
+  {0,0,0,0,0,0,0},
+  {0,0,0,0,0,0,0},
+  {0,0,0,0,0,0,0},
+  {GNSSENTRY_CB3DATA,GNSSENTRY_LB3DATA,GNSSENTRY_DB3DATA,
+  GNSSENTRY_SB3DATA,GNSSDF2_LOCKLOSSB3,BDS_WAVELENGTH_B3,"6I"},
+  {0,0,0,0,0,0,0},
+  {0,0,0,0,0,0,0},
+  {0,0,0,0,0,0,0},
+  {0,0,0,0,0,0,0},
+  {0,0,0,0,0,0,0},
+  {GNSSENTRY_CB2DATA,GNSSENTRY_LB2DATA,GNSSENTRY_DB2DATA,
+  GNSSENTRY_SB2DATA,GNSSDF2_LOCKLOSSB2,BDS_WAVELENGTH_B2,"7I"},
+  {0,0,0,0,0,0,0},
+  {0,0,0,0,0,0,0},
+  {0,0,0,0,0,0,0},
+  {0,0,0,0,0,0,0},
+  {0,0,0,0,0,0,0},
+  {0,0,0,0,0,0,0},
+  {0,0,0,0,0,0,0},
+  {0,0,0,0,0,0,0},
+  {0,0,0,0,0,0,0},
+  {0,0,0,0,0,0,0},
+  {0,0,0,0,0,0,0},
+  {0,0,0,0,0,0,0},
+  {0,0,0,0,0,0,0},
+  {0,0,0,0,0,0,0},
+  {0,0,0,0,0,0,0},
+  {0,0,0,0,0,0,0},
+  {0,0,0,0,0,0,0},
+  {0,0,0,0,0,0,0},
+};
+
+/* GLONASS wavelengths for the frequency numbers -7 to 6 */
+#define GLOWL(b) {GLO_WAVELENGTH_##b(-7), GLO_WAVELENGTH_##b(-6), \
+  GLO_WAVELENGTH_##b(-5), GLO_WAVELENGTH_##b(-4), \
+  GLO_WAVELENGTH_##b(-3), GLO_WAVELENGTH_##b(-2), \
+  GLO_WAVELENGTH_##b(-1), GLO_WAVELENGTH_##b(0), \
+  GLO_WAVELENGTH_##b(1), GLO_WAVELENGTH_##b(2), \
+  GLO_WAVELENGTH_##b(3), GLO_WAVELENGTH_##b(4), \
+  GLO_WAVELENGTH_##b(5), GLO_WAVELENGTH_##b(6)}
+static const double msmglowl[2][14] = {GLOWL(L1), GLOWL(L2)};
+
+/* signal tables indexed by RTCM3_MSM_xxx, SBAS uses the GPS signals */
+static const struct CodeData * const msmcodes[RTCM3_MSM_NUMSYS] =
+{msmgps, msmglo, msmgal, msmgps, msmqzss, msmbds};
+
+/* Returns the row of fullsat in the epoch, a new satellite is added.
+   -1 is returned if the epoch is full. */
+static int GetSatIndex(struct gnssdata *gnss, int fullsat)
+{
+  int num = gnss->satslot[fullsat]-1;
+
+  if(num < 0)
+  {
+    if(gnss->numsats >= GNSS_MAXSATS)
+      return -1;
+    num = gnss->numsats++;
+    gnss->satellites[num] = fullsat;
+    gnss->satslot[fullsat] = num+1;
+  }
+  return num;
+}
 
+/* Code types of the observations. The index of a code "ba" is
+   band*27 + attribute letter, where a blank attribute is 26. */
+#define CODEROW(b) {#b "A"}, {#b "B"}, {#b "C"}, {#b "D"}, {#b "E"}, \
+  {#b "F"}, {#b "G"}, {#b "H"}, {#b "I"}, {#b "J"}, {#b "K"}, {#b "L"}, \
+  {#b "M"}, {#b "N"}, {#b "O"}, {#b "P"}, {#b "Q"}, {#b "R"}, {#b "S"}, \
+  {#b "T"}, {#b "U"}, {#b "V"}, {#b "W"}, {#b "X"}, {#b "Y"}, {#b "Z"}, \
+  {#b " "}
+static const char gnsscodes[9*27][3] = {
+  CODEROW(0), CODEROW(1), CODEROW(2), CODEROW(3), CODEROW(4), CODEROW(5),
+  CODEROW(6), CODEROW(7), CODEROW(8)};
+#define CODEINDEX(c) (((c)[0]-'0')*27 + ((c)[1] == ' ' ? 26 : (c)[1]-'A'))
+
+/* value of entry e in row num, which must be flagged in dataflags */
 #ifdef NO_RTCM3_MAIN
-  if(GetMessage(handle)) /* don't repeat */
+#define GNSSVALUE(g, num, e) ((g)->measdata[num][e])
 #else
-  while(!ret && GetMessage(handle))
+#define GNSSVALUE(g, num, e) ((g)->cellvalue[num][(g)->cellindex[num][e]])
 #endif /* NO_RTCM3_MAIN */
-  {
-    /* using 64 bit integer types, as it is much easier than handling
-    the long datatypes in 32 bit */
-    uint64_t numbits = 0, bitfield = 0;
-    int size = handle->size, type;
-    int syncf, old = 0;
-    unsigned char *data = handle->Message+3;
 
-    GETBITS(type,12)
+/* code type of entry e in row num as GNSSVALUE(), 0 if none */
+static const char *GNSSCode(const struct gnssdata *g, int num, int e)
+{
 #ifdef NO_RTCM3_MAIN
-    handle->blocktype = type;
+  return g->codetype[num][e];
+#else
+  int c = g->cellcode[num][g->cellindex[num][e]];
+  return c ? gnsscodes[c] : 0;
 #endif /* NO_RTCM3_MAIN */
-    switch(type)
-    {
+}
+
+/* Sets entry e of row num. In the program a new entry gets the next free
+   cell, the library writes measdata and codetype directly. */
+static void SetObs(struct gnssdata *gnss, int num, int e, int code,
+double value)
+{
 #ifdef NO_RTCM3_MAIN
-    default:
-      ret = type;
-      break;
-    case 1005: case 1006:
-      {
-        SKIPBITS(22)
-        GETBITSSIGN(handle->antX, 38)
-        SKIPBITS(2)
-        GETBITSSIGN(handle->antY, 38)
-        SKIPBITS(2)
-        GETBITSSIGN(handle->antZ, 38)
-        if(type == 1006)
-          GETBITS(handle->antH, 16)
-        ret = type;
-      }
-      break;
-    case 1007: case 1008: case 1033:
-      {
-        char *antenna;
-        int antnum;
+  gnss->measdata[num][e] = value;
+  gnss->codetype[num][e] = code ? gnsscodes[code] : 0;
+#else
+  int c;
 
-        SKIPBITS(12)
-        GETSTRING(antnum,antenna)
-        memcpy(handle->antenna, antenna, antnum);
-        handle->antenna[antnum] = 0;
-        ret = type;
-      }
-      break;
-    case 1013:
-      {
-        SKIPBITS(12);
-        GETBITS(handle->modjulday, 16);
-        GETBITS(handle->secofday, 17);
-        SKIPBITS(5);
-        GETBITS(handle->leapsec, 8);
-        ret = 1013;
-      }
-      break;
+  if(gnss->dataflags[num] & (1ULL<<e))
+    c = gnss->cellindex[num][e];
+  else
+    c = gnss->cellindex[num][e] = gnss->numcells[num]++;
+  gnss->cellvalue[num][c] = value;
+  gnss->cellcode[num][c] = code;
 #endif /* NO_RTCM3_MAIN */
-    case 1019:
-      if(size == 59)
-      {
-        struct gpsephemeris *ge;
-        int sv, i;
+  gnss->dataflags[num] |= 1ULL<<e;
+}
 
-        ge = &handle->ephemerisGPS;
-        memset(ge, 0, sizeof(*ge));
+/* Clears row num of the epoch. In the program only the flags and the number
+   of cells are reset, unused cells are never read. */
+static void ClearSat(struct gnssdata *gnss, int num)
+{
+#ifdef NO_RTCM3_MAIN
+  unsigned long long df = gnss->dataflags[num];
+  int k;
 
-        GETBITS(sv, 6)
-        ge->satellite = (sv < 40 ? sv : sv+80);
-        GETBITS(ge->GPSweek, 10)
-        ge->GPSweek += 1024;
-        GETBITS(ge->URAindex, 4)
-        GETBITS(sv, 2)
-        if(sv & 1)
-          ge->flags |= GPSEPHF_L2PCODE;
-        if(sv & 2)
-          ge->flags |= GPSEPHF_L2CACODE;
-        GETFLOATSIGN(ge->IDOT, 14, R2R_PI/(double)(1<<30)/(double)(1<<13))
-        GETBITS(ge->IODE, 8)
-        GETBITS(ge->TOC, 16)
-        ge->TOC <<= 4;
-        GETFLOATSIGN(ge->clock_driftrate, 8, 1.0/(double)(1<<30)/(double)(1<<25))
-        GETFLOATSIGN(ge->clock_drift, 16, 1.0/(double)(1<<30)/(double)(1<<13))
-        GETFLOATSIGN(ge->clock_bias, 22, 1.0/(double)(1<<30)/(double)(1<<1))
-        GETBITS(ge->IODC, 10)
-        GETFLOATSIGN(ge->Crs, 16, 1.0/(double)(1<<5))
-        GETFLOATSIGN(ge->Delta_n, 16, R2R_PI/(double)(1<<30)/(double)(1<<13))
-        GETFLOATSIGN(ge->M0, 32, R2R_PI/(double)(1<<30)/(double)(1<<1))
-        GETFLOATSIGN(ge->Cuc, 16, 1.0/(double)(1<<29))
-        GETFLOAT(ge->e, 32, 1.0/(double)(1<<30)/(double)(1<<3))
-        GETFLOATSIGN(ge->Cus, 16, 1.0/(double)(1<<29))
-        GETFLOAT(ge->sqrt_A, 32, 1.0/(double)(1<<19))
-        GETBITS(ge->TOE, 16)
-        ge->TOE <<= 4;
-
-        GETFLOATSIGN(ge->Cic, 16, 1.0/(double)(1<<29))
-        GETFLOATSIGN(ge->OMEGA0, 32, R2R_PI/(double)(1<<30)/(double)(1<<1))
-        GETFLOATSIGN(ge->Cis, 16, 1.0/(double)(1<<29))
-        GETFLOATSIGN(ge->i0, 32, R2R_PI/(double)(1<<30)/(double)(1<<1))
-        GETFLOATSIGN(ge->Crc, 16, 1.0/(double)(1<<5))
-        GETFLOATSIGN(ge->omega, 32, R2R_PI/(double)(1<<30)/(double)(1<<1))
-        GETFLOATSIGN(ge->OMEGADOT, 24, R2R_PI/(double)(1<<30)/(double)(1<<13))
-        GETFLOATSIGN(ge->TGD, 8, 1.0/(double)(1<<30)/(double)(1<<1))
-        GETBITS(ge->SVhealth, 6)
-        GETBITS(sv, 1)
-        if(sv)
-          ge->flags |= GPSEPHF_L2PCODEDATA;
-        GETBITS(sv, 1)
-        if(sv)
-          ge->flags |= GPSEPHF_6HOURSFIT;
+  for(k = 0; df; ++k, df >>= 1)
+  {
+    if(df & 1)
+    {
+      gnss->measdata[num][k] = 0.0;
+      gnss->codetype[num][k] = 0;
+    }
+  }
+#endif /* NO_RTCM3_MAIN */
+  gnss->dataflags[num] = 0;
+  gnss->dataflags2[num] = 0;
+#ifndef NO_RTCM3_MAIN
+  gnss->numcells[num] = 0;
+#endif /* NO_RTCM3_MAIN */
+  gnss->snrL1[num] = gnss->snrL2[num] = 0;
+  gnss->satslot[gnss->satellites[num]] = 0;
+  gnss->satellites[num] = 0;
+}
 
-        i = ((int)ge->GPSweek - (int)handle->GPSWeek)*7*24*60*60
-        + ((int)ge->TOE - (int)handle->GPSTOW) - 2*60*60;
-        if(i > 5*60*60 && i < 8*60*60)
-        {
-          handle->GPSTOW = ge->TOE;
-          handle->GPSWeek = ge->GPSweek;
-        }
-        ge->TOW = 0.9999E9;
-        ret = 1019;
-      }
-      break;
-    case RTCM3ID_BDS:
-      if(size == 62)
+/* Hands the assembled epoch over to Data and continues in the other buffer,
+   which holds the epoch returned before. The caller is done with it, so
+   only the rows it used are cleared. Returns the new DataNew. */
+static struct gnssdata *NewEpoch(struct RTCM3ParserData *handle)
+{
+  struct gnssdata *gnss = handle->Data;
+  int i;
+
+  handle->Data = handle->DataNew;
+  handle->DataNew = gnss;
+  for(i = 0; i < gnss->numsats; ++i)
+    ClearSat(gnss, i);
+  gnss->flags = gnss->week = gnss->numsats = 0;
+  gnss->timeofweek = 0.0;
+  return gnss;
+}
+
+/* x reduced to -modulus/2 .. modulus/2 */
+static double ReduceRange(double x, double modulus)
+{
+  return x - floor(x/modulus+0.5)*modulus;
+}
+
+/* Restores the ambiguity of num ranges [m], which are only known modulo
+   modulus. The ranges to the satellites sys[k]/prn[k] (as for GetEphemeris)
+   are predicted from the stored ephemerides and the station position. The
+   receiver clock is the offset most satellites share, it is kept in
+   ambclock so the next epochs continue with the same choice. amb[k] gets
+   the number of moduli to add to range[k] or -1 if this is not possible.
+   Returns -1 if the station position is unknown, else the number of
+   restored ranges. */
+static int ResolveAmbiguity(struct RTCM3ParserData *handle, int week,
+double tow, int num, const int *sys, const int *prn, const double *range,
+double modulus, int *amb)
+{
+  const struct ephemerisentry *eph[RTCM3_MSM_NUMSAT] = {0};
+  double pos[3*RTCM3_MSM_NUMSAT], clock[RTCM3_MSM_NUMSAT];
+  double pred[RTCM3_MSM_NUMSAT], d[RTCM3_MSM_NUMSAT], clk = 0.0;
+  const double *sta = handle->refpos;
+  int k, l, n, best = -1, nbest = 0, res = 0;
+
+  if(!sta[0] && !sta[1] && !sta[2])
+    return -1;
+  if(num > RTCM3_MSM_NUMSAT)
+    num = RTCM3_MSM_NUMSAT;
+  for(k = 0; k < num; ++k)
+    eph[k] = GetEphemerisAt(handle, sys[k], prn[k], week, (int)tow);
+  /* a fixed travel time of 75 ms moves the satellites less than 100 m */
+  SatellitePositions(eph, num, week, tow-0.075, pos, clock);
+  for(k = 0; k < num; ++k)
+  {
+    amb[k] = -1;
+    if(eph[k])
+    {
+      double dx = pos[3*k]-sta[0], dy = pos[3*k+1]-sta[1];
+      double dz = pos[3*k+2]-sta[2];
+      /* geometric range with earth rotation, minus satellite clock */
+      pred[k] = sqrt(dx*dx+dy*dy+dz*dz) - clock[k]*LIGHTSPEED
+      + 7.2921151467e-5*(pos[3*k]*sta[1]-pos[3*k+1]*sta[0])/LIGHTSPEED;
+      d[k] = ReduceRange(range[k]-pred[k]-handle->ambclock, modulus);
+    }
+  }
+  /* the clock offset is taken from the largest group of agreeing
+     satellites, so one bad ephemeris cannot move it */
+  for(k = 0; k < num; ++k)
+  {
+    if(!eph[k])
+      continue;
+    for(l = n = 0; l < num; ++l)
+    {
+      if(eph[l] && fabs(ReduceRange(d[l]-d[k], modulus)) < modulus/16)
+        ++n;
+    }
+    if(n > nbest)
+    {
+      nbest = n;
+      best = k;
+    }
+  }
+  if(best >= 0)
+  {
+    for(l = 0; l < num; ++l)
+    {
+      double x;
+      if(eph[l] && fabs(x = ReduceRange(d[l]-d[best], modulus)) < modulus/16)
+        clk += x;
+    }
+    clk = handle->ambclock + d[best] + clk/nbest;
+    handle->ambclock = clk;
+    for(k = 0; k < num; ++k)
+    {
+      double x, a;
+      if(!eph[k])
+        continue;
+      x = pred[k]+clk-range[k];
+      a = floor(x/modulus+0.5);
+      if(a >= 0.0 && a < 256.0 && fabs(x-a*modulus) < modulus/16)
       {
-        struct bdsephemeris *be;
-        int sv, i, week, tow;
-        be = &handle->ephemerisBDS;
-        memset(be, 0, sizeof(*be));
+        amb[k] = (int)a;
+        ++res;
+      }
+    }
+  }
+  return res;
+}
 
-        GETBITS(sv, 6)
-        be->satellite = sv+PRN_BDS_START-1;
-        GETBITS(be->BDSweek, 13)
-        GETBITS(be->URAI, 4)
-        GETFLOATSIGN(be->IDOT, 14, R2R_PI/(double)(1<<30)/(double)(1<<13))
-        GETBITS(be->AODE, 5)
-        GETBITS(be->TOC, 17)
-        be->TOC <<= 3;
-        GETFLOATSIGN(be->clock_driftrate, 11, 1.0/(double)(1<<30)/(double)(1<<30)/(double)(1<<6))
-        GETFLOATSIGN(be->clock_drift, 22, 1.0/(double)(1<<30)/(double)(1<<20))
-        GETFLOATSIGN(be->clock_bias, 24, 1.0/(double)(1<<30)/(double)(1<<3))
-        GETBITS(be->AODC, 5)
-        GETFLOATSIGN(be->Crs, 18, 1.0/(double)(1<<6))
-        GETFLOATSIGN(be->Delta_n, 16, R2R_PI/(double)(1<<30)/(double)(1<<13))
-        GETFLOATSIGN(be->M0, 32, R2R_PI/(double)(1<<30)/(double)(1<<1))
-        GETFLOATSIGN(be->Cuc, 18, 1.0/(double)(1<<30)/(double)(1<<1))
-        GETFLOAT(be->e, 32, 1.0/(double)(1<<30)/(double)(1<<3))
-        GETFLOATSIGN(be->Cus, 18, 1.0/(double)(1<<30)/(double)(1<<1))
-        GETFLOAT(be->sqrt_A, 32, 1.0/(double)(1<<19))
-        GETBITS(be->TOE, 17)
-        be->TOE <<= 3;
-        GETFLOATSIGN(be->Cic, 18, 1.0/(double)(1<<30)/(double)(1<<1))
-        GETFLOATSIGN(be->OMEGA0, 32, R2R_PI/(double)(1<<30)/(double)(1<<1))
-        GETFLOATSIGN(be->Cis, 18, 1.0/(double)(1<<30)/(double)(1<<1))
-        GETFLOATSIGN(be->i0, 32, R2R_PI/(double)(1<<30)/(double)(1<<1))
-        GETFLOATSIGN(be->Crc, 18, 1.0/(double)(1<<6))
-        GETFLOATSIGN(be->omega, 32, R2R_PI/(double)(1<<30)/(double)(1<<1))
-        GETFLOATSIGN(be->OMEGADOT, 24, R2R_PI/(double)(1<<30)/(double)(1<<13))
-        GETFLOATSIGN(be->TGD_B1_B3, 10, 0.0000000001)
-        GETFLOATSIGN(be->TGD_B2_B3, 10, 0.0000000001)
-        GETBITS(sv, 1)
-        if(sv)
-          be->flags |= BDSEPHF_SATH1;
-        week = 1356+be->BDSweek;
-        tow = 14+be->TOE;
-        if(tow > 7*24*60*60) /* overflow due to leap */
-        {
-          ++week;
-          tow -=  7*24*60*60;
-        }
-        i = (week - (int)handle->GPSWeek)*7*24*60*60
-        + (tow - (int)handle->GPSTOW) - 2*60*60;
-        if(i > 5*60*60 && i < 8*60*60)
+/* start of the PRN range, indexed by RTCM3_MSM_xxx */
+static const int msmstart[RTCM3_MSM_NUMSYS] =
+{PRN_GPS_START, PRN_GLONASS_START, PRN_GALILEO_START, PRN_SBAS_START,
+PRN_QZSS_START, PRN_BDS_START};
+
+#if defined(__GNUC__)
+#define RTCM3_INLINE __attribute__((always_inline)) inline
+#elif defined(_MSC_VER)
+#define RTCM3_INLINE __forceinline
+#else
+#define RTCM3_INLINE
+#endif
+
+/* The observables of a MSM cell, rough is the rough range of the
+   satellite [ms]. */
+static RTCM3_INLINE void MSMRange(struct gnssdata *gnss, int num,
+const struct CodeData *cd, int code, double psr, double rough)
+{
+  if(psr > -1.0/(1<<10))
+  {
+    SetObs(gnss, num, cd->typeR, code, psr*LIGHTSPEED/1000.0
+    +rough*LIGHTSPEED/1000.0);
+  }
+}
+
+static RTCM3_INLINE void MSMPhase(struct gnssdata *gnss, int num,
+const struct CodeData *cd, int code, double wl, double cp, double rough,
+int ll, int *lastlock)
+{
+  if(wl && cp > -1.0/(1<<8))
+  {
+    SetObs(gnss, num, cd->typeP, code, cp*LIGHTSPEED/1000.0/wl
+    +rough*LIGHTSPEED/1000.0/wl);
+    if(*lastlock > ll)
+      gnss->dataflags2[num] |= cd->lock;
+    *lastlock = ll > 255 ? 255 : ll;
+  }
+}
+
+static RTCM3_INLINE void MSMDoppler(struct gnssdata *gnss, int num,
+const struct CodeData *cd, int code, double wl, double dop, double rdop)
+{
+  if(dop > -1.6384)
+    SetObs(gnss, num, cd->typeD, code, -(dop+rdop)/wl);
+}
+
+/* Generic MSM decoder. It is only used through the specialised versions
+   below, where msm (1 to 7) and sys are constants, so the compiler removes
+   the switches over them and the tests in the cell loop. */
+static RTCM3_INLINE int DecodeMSM(struct RTCM3ParserData *handle,
+struct BitReader *br, const int msm, const int sys)
+{
+  int i=0, count, j, old = 0, wasnoamb = 0, ret = 0;
+  int start = msmstart[sys];
+  const struct CodeData *codes = msmcodes[sys];
+  int syncf, sigmask, numsat = 0, numsig = 0, numcells;
+  uint64_t satmask, cellmask, ui;
+  double rrmod[RTCM3_MSM_NUMSAT];
+  int rrint[RTCM3_MSM_NUMSAT], rdop[RTCM3_MSM_NUMSAT],
+  extsat[RTCM3_MSM_NUMSAT];
+  int ll[RTCM3_MSM_NUMCELLS]/*, hc[RTCM3_MSM_NUMCELLS]*/;
+  double cnr[RTCM3_MSM_NUMCELLS];
+  double cp[RTCM3_MSM_NUMCELLS], psr[RTCM3_MSM_NUMCELLS],
+  dop[RTCM3_MSM_NUMCELLS];
+  struct gnssdata *gnss = handle->DataNew;
+
+  SKIPBITS(12)
+  for(i = 0; i < RTCM3_MSM_NUMSAT; ++i)
+    extsat[i] = 15;
+
+  switch(sys)
+  {
+  case RTCM3_MSM_BDS:
+    GETBITS(i,30)
+    i += 14000;
+    if(i >= 7*24*60*60*1000)
+      i -= 7*24*60*60*1000;
+    if(i/1000 < (int)handle->GPSTOW - 86400)
+      ++handle->GPSWeek;
+    handle->GPSTOW = i/1000;
+    break;
+  case RTCM3_MSM_GALILEO: /* use DF004 instead of DF248 */
+  case RTCM3_MSM_QZSS:
+  case RTCM3_MSM_SBAS:
+  case RTCM3_MSM_GPS:
+    GETBITS(i,30)
+    if(i/1000 < (int)handle->GPSTOW - 86400)
+      ++handle->GPSWeek;
+    handle->GPSTOW = i/1000;
+    break;
+  case RTCM3_MSM_GLONASS:
+    SKIPBITS(3)
+    GETBITS(i,27) /* tk */
+
+    updatetime(&handle->GPSWeek, &handle->GPSTOW, i, 0); /* Moscow -> GPS */
+    i = handle->GPSTOW*1000;
+    break;
+  }
+
+  if(gnss->week && (gnss->timeofweek != i || gnss->week
+  != handle->GPSWeek))
+  {
+    gnss = NewEpoch(handle);
+    old = 1;
+  }
+  gnss->timeofweek = i;
+  gnss->week = handle->GPSWeek;
+
+  GETBITS(syncf, 1)
+  SKIPBITS(3+7+2+2+1+3)
+  GETBITS64(satmask, RTCM3_MSM_NUMSAT)
+
+  /* http://gurmeetsingh.wordpress.com/2008/08/05/fast-bit-counting-routines/ */
+  for(ui = satmask; ui; ui &= (ui - 1) /* remove rightmost bit */)
+    ++numsat;
+  GETBITS(sigmask, RTCM3_MSM_NUMSIG)
+  for(i = sigmask; i; i &= (i - 1) /* remove rightmost bit */)
+    ++numsig;
+  i = numsat*numsig;
+  GETBITS64(cellmask, (unsigned)i)
+
+  switch(msm)
+  {
+  case 1: case 2: case 3:
+    {
+      int prn[RTCM3_MSM_NUMSAT] = {0}, sats[RTCM3_MSM_NUMSAT] = {0};
+      double range[RTCM3_MSM_NUMSAT] = {0};
+
+      for(j = numsat; j--;)
+        GETFLOAT(rrmod[j], 10, 1.0/1024.0)
+      /* rrint is not transmitted, restore it from the predicted range,
+         -1 marks satellites which must be skipped */
+      for(i = j = 0; j < numsat; ++i)
+      {
+        if(satmask & (UINT64(1)<<i))
         {
-          handle->GPSTOW = tow;
-          handle->GPSWeek = week;
+          sats[j] = sys;
+          prn[j] = RTCM3_MSM_NUMSAT-i + (sys == RTCM3_MSM_SBAS ? 19 : 0);
+          range[j] = rrmod[j]*LIGHTSPEED/1000.0;
+          ++j;
         }
-        ret = RTCM3ID_BDS;
-        be->TOW = 0.9999E9;
       }
-      break;
-    case 1043:
-      if(size == 27 && handle->GPSWeek)
+      if(ResolveAmbiguity(handle, gnss->week, gnss->timeofweek/1000.0,
+      numsat, sats, prn, range, LIGHTSPEED/1000.0, rrint) < 0)
       {
-        struct sbasephemeris *gs;
-        int sv, i, time, tod, day;
-        gs = &handle->ephemerisSBAS;
-        memset(gs, 0, sizeof(*gs));
-
-        GETBITS(sv, 6)
-        gs->satellite = PRN_SBAS_START+sv;
-        GETBITS(gs->IODN, 8)
-        GETBITS(time, 13)
-        time <<= 4;
-        gs->GPSweek_TOE = handle->GPSWeek;
-        GETBITS(gs->URA, 4)
-        GETFLOATSIGN(gs->x_pos, 30, 0.08)
-        GETFLOATSIGN(gs->y_pos, 30, 0.08)
-        GETFLOATSIGN(gs->z_pos, 25, 0.4)
-        GETFLOATSIGN(gs->x_velocity, 17, 0.000625)
-        GETFLOATSIGN(gs->y_velocity, 17, 0.000625)
-        GETFLOATSIGN(gs->z_velocity, 18, 0.004)
-        GETFLOATSIGN(gs->x_acceleration, 10, 0.0000125)
-        GETFLOATSIGN(gs->y_acceleration, 10, 0.0000125)
-        GETFLOATSIGN(gs->z_acceleration, 10, 0.0000625)
-        GETFLOATSIGN(gs->agf0, 12, 1.0/(1<<30)/(1<<1))
-        GETFLOATSIGN(gs->agf1, 8, 1.0/(1<<30)/(1<<10))
-
-        /* calculate time */
-        tod = handle->GPSTOW%(24*60*60);
-        day = handle->GPSTOW/(24*60*60);
-        if(time > 19*60*60 && tod < 5*60*60)
-          --day;
-        else if(time < 5*60*60 && tod > 19*60*60)
-          ++day;
-        time += day*24*60*60;
-        if(time > 7*24*60*60)
-          ++gs->GPSweek_TOE;
-        else if(time < 0)
-          --gs->GPSweek_TOE;
-        gs->TOE = time;
-
-        i = (gs->GPSweek_TOE - handle->GPSWeek)*7*24*60*60
-        + (gs->TOE - handle->GPSTOW) - 2*60*60;
-        if(i > 5*60*60 && i < 8*60*60)
-        {
-          handle->GPSTOW = gs->TOE;
-          handle->GPSWeek = gs->GPSweek_TOE;
-        }
-        gs->TOW = 0.9999E9;
-        ret = 1043;
+        ++wasnoamb;
+        for(j = numsat; j--;)
+          rrint[j] = 0;
       }
+    }
+    break;
+  case 4: case 6:
+    for(j = numsat; j--;)
+      GETBITS(rrint[j], 8)
+    for(j = numsat; j--;)
+      GETFLOAT(rrmod[j], 10, 1.0/1024.0)
+    break;
+  case 5: case 7:
+    for(j = numsat; j--;)
+      GETBITS(rrint[j], 8)
+    for(j = numsat; j--;)
+      GETBITS(extsat[j], 4)
+    for(j = numsat; j--;)
+      GETFLOAT(rrmod[j], 10, 1.0/1024.0)
+    for(j = numsat; j--;)
+      GETBITSSIGN(rdop[j], 14)
+    break;
+  }
+
+  numcells = numsat*numsig;
+  if(numcells <= RTCM3_MSM_NUMCELLS)
+  {
+    switch(msm)
+    {
+    case 1:
+      for(count = numcells; count--;)
+        if(cellmask & (UINT64(1)<<count))
+          GETFLOATSIGN(psr[count], 15, 1.0/(1<<24))
       break;
-    case 1044:
-      if(size == 59)
+    case 2:
+      for(count = numcells; count--;)
+        if(cellmask & (UINT64(1)<<count))
+          GETFLOATSIGN(cp[count], 22, 1.0/(1<<29))
+      for(count = numcells; count--;)
+        if(cellmask & (UINT64(1)<<count))
+          GETBITS(ll[count], 4)
+      for(count = numcells; count--;)
+        if(cellmask & (UINT64(1)<<count))
+          SKIPBITS(1)/*GETBITS(hc[count], 1)*/
+      break;
+    case 3:
+      for(count = numcells; count--;)
+        if(cellmask & (UINT64(1)<<count))
+          GETFLOATSIGN(psr[count], 15, 1.0/(1<<24))
+      for(count = numcells; count--;)
+        if(cellmask & (UINT64(1)<<count))
+          GETFLOATSIGN(cp[count], 22, 1.0/(1<<29))
+      for(count = numcells; count--;)
+        if(cellmask & (UINT64(1)<<count))
+          GETBITS(ll[count], 4)
+      for(count = numcells; count--;)
+        if(cellmask & (UINT64(1)<<count))
+          SKIPBITS(1)/*GETBITS(hc[count], 1)*/
+      break;
+    case 4:
+      for(count = numcells; count--;)
+        if(cellmask & (UINT64(1)<<count))
+          GETFLOATSIGN(psr[count], 15, 1.0/(1<<24))
+      for(count = numcells; count--;)
+        if(cellmask & (UINT64(1)<<count))
+          GETFLOATSIGN(cp[count], 22, 1.0/(1<<29))
+      for(count = numcells; count--;)
+        if(cellmask & (UINT64(1)<<count))
+          GETBITS(ll[count], 4)
+      for(count = numcells; count--;)
+        if(cellmask & (UINT64(1)<<count))
+          SKIPBITS(1)/*GETBITS(hc[count], 1)*/
+      for(count = numcells; count--;)
+        if(cellmask & (UINT64(1)<<count))
+          GETBITS(cnr[count], 6)
+      break;
+    case 5:
+      for(count = numcells; count--;)
+        if(cellmask & (UINT64(1)<<count))
+          GETFLOATSIGN(psr[count], 15, 1.0/(1<<24))
+      for(count = numcells; count--;)
+        if(cellmask & (UINT64(1)<<count))
+          GETFLOATSIGN(cp[count], 22, 1.0/(1<<29))
+      for(count = numcells; count--;)
+        if(cellmask & (UINT64(1)<<count))
+          GETBITS(ll[count], 4)
+      for(count = numcells; count--;)
+        if(cellmask & (UINT64(1)<<count))
+          SKIPBITS(1)/*GETBITS(hc[count], 1)*/
+      for(count = numcells; count--;)
+        if(cellmask & (UINT64(1)<<count))
+          GETFLOAT(cnr[count], 6, 1.0)
+      for(count = numcells; count--;)
+        if(cellmask & (UINT64(1)<<count))
+          GETFLOATSIGN(dop[count], 15, 0.0001)
+      break;
+    case 6:
+      for(count = numcells; count--;)
+        if(cellmask & (UINT64(1)<<count))
+          GETFLOATSIGN(psr[count], 20, 1.0/(1<<29))
+      for(count = numcells; count--;)
+        if(cellmask & (UINT64(1)<<count))
+          GETFLOATSIGN(cp[count], 24, 1.0/(1U<<31))
+      for(count = numcells; count--;)
+        if(cellmask & (UINT64(1)<<count))
+          GETBITS(ll[count], 10)
+      for(count = numcells; count--;)
+        if(cellmask & (UINT64(1)<<count))
+          SKIPBITS(1)/*GETBITS(hc[count], 1)*/
+      for(count = numcells; count--;)
+        if(cellmask & (UINT64(1)<<count))
+          GETFLOAT(cnr[count], 10, 1.0/(1<<4))
+      break;
+    case 7:
+      for(count = numcells; count--;)
+        if(cellmask & (UINT64(1)<<count))
+          GETFLOATSIGN(psr[count], 20, 1.0/(1<<29))
+      for(count = numcells; count--;)
+        if(cellmask & (UINT64(1)<<count))
+          GETFLOATSIGN(cp[count], 24, 1.0/(1U<<31))
+      for(count = numcells; count--;)
+        if(cellmask & (UINT64(1)<<count))
+          GETBITS(ll[count], 10)
+      for(count = numcells; count--;)
+        if(cellmask & (UINT64(1)<<count))
+          SKIPBITS(1)/*GETBITS(hc[count], 1)*/
+      for(count = numcells; count--;)
+        if(cellmask & (UINT64(1)<<count))
+          GETFLOAT(cnr[count], 10, 1.0/(1<<4))
+      for(count = numcells; count--;)
+        if(cellmask & (UINT64(1)<<count))
+          GETFLOATSIGN(dop[count], 15, 0.0001)
+      break;
+    }
+    i = RTCM3_MSM_NUMSAT;
+    j = -1;
+    for(count = numcells; count--;)
+    {
+      while(j >= 0 && !(sigmask&(1<<--j)))
+        ;
+      if(j < 0)
       {
-        struct gpsephemeris *ge;
-        int sv, i;
-
-        ge = &handle->ephemerisGPS;
-        memset(ge, 0, sizeof(*ge));
-
-        GETBITS(sv, 4)
-        ge->satellite = PRN_QZSS_START+sv-1;
-        GETBITS(ge->TOC, 16)
-        ge->TOC <<= 4;
-        GETFLOATSIGN(ge->clock_driftrate, 8, 1.0/(double)(1<<30)/(double)(1<<25))
-        GETFLOATSIGN(ge->clock_drift, 16, 1.0/(double)(1<<30)/(double)(1<<13))
-        GETFLOATSIGN(ge->clock_bias, 22, 1.0/(double)(1<<30)/(double)(1<<1))
-        GETBITS(ge->IODE, 8)
-        GETFLOATSIGN(ge->Crs, 16, 1.0/(double)(1<<5))
-        GETFLOATSIGN(ge->Delta_n, 16, R2R_PI/(double)(1<<30)/(double)(1<<13))
-        GETFLOATSIGN(ge->M0, 32, R2R_PI/(double)(1<<30)/(double)(1<<1))
-        GETFLOATSIGN(ge->Cuc, 16, 1.0/(double)(1<<29))
-        GETFLOAT(ge->e, 32, 1.0/(double)(1<<30)/(double)(1<<3))
-        GETFLOATSIGN(ge->Cus, 16, 1.0/(double)(1<<29))
-        GETFLOAT(ge->sqrt_A, 32, 1.0/(double)(1<<19))
-        GETBITS(ge->TOE, 16)
-        ge->TOE <<= 4;
-        GETFLOATSIGN(ge->Cic, 16, 1.0/(double)(1<<29))
-        GETFLOATSIGN(ge->OMEGA0, 32, R2R_PI/(double)(1<<30)/(double)(1<<1))
-        GETFLOATSIGN(ge->Cis, 16, 1.0/(double)(1<<29))
-        GETFLOATSIGN(ge->i0, 32, R2R_PI/(double)(1<<30)/(double)(1<<1))
-        GETFLOATSIGN(ge->Crc, 16, 1.0/(double)(1<<5))
-        GETFLOATSIGN(ge->omega, 32, R2R_PI/(double)(1<<30)/(double)(1<<1))
-        GETFLOATSIGN(ge->OMEGADOT, 24, R2R_PI/(double)(1<<30)/(double)(1<<13))
-        GETFLOATSIGN(ge->IDOT, 14, R2R_PI/(double)(1<<30)/(double)(1<<13))
-        GETBITS(sv, 2)
-        if(sv & 1)
-          ge->flags |= GPSEPHF_L2PCODE;
-        if(sv & 2)
-          ge->flags |= GPSEPHF_L2CACODE;
-        GETBITS(ge->GPSweek, 10)
-        ge->GPSweek += 1024;
-        GETBITS(ge->URAindex, 4)
-        GETBITS(ge->SVhealth, 6)
-        GETFLOATSIGN(ge->TGD, 8, 1.0/(double)(1<<30)/(double)(1<<1))
-        GETBITS(ge->IODC, 10)
-        GETBITS(sv, 1)
-        if(sv)
-          ge->flags |= GPSEPHF_6HOURSFIT;
-
-        i = ((int)ge->GPSweek - (int)handle->GPSWeek)*7*24*60*60
-        + ((int)ge->TOE - (int)handle->GPSTOW) - 2*60*60;
-        if(i > 5*60*60 && i < 8*60*60)
-        {
-          handle->GPSTOW = ge->TOE;
-          handle->GPSWeek = ge->GPSweek;
-        }
-        ge->TOW = 0.9999E9;
-        ret = 1044;
+        while(!(satmask&(UINT64(1)<<(--i)))) /* next satellite */
+          ;
+        j = RTCM3_MSM_NUMSIG;
+        while(!(sigmask&(1<<--j)))
+          ;
+        --numsat;
       }
-      break;
-    case 1045: case 1046:
+      if(cellmask & (UINT64(1)<<count))
       {
-        struct galileoephemeris *ge;
-        int sv;
+        const struct CodeData *cd = codes+RTCM3_MSM_NUMSIG-j-1;
+        double wl = cd->wl;
 
-        ge = &handle->ephemerisGALILEO;
-        memset(ge, 0, sizeof(*ge));
-
-        GETBITS(sv, 6)
-        ge->satellite = sv;
-        GETBITS(ge->Week, 12)
-        ge->Week += 1024;
-        GETBITS(ge->IODnav, 10)
-        GETBITS(ge->SISA, 8)
-        GETFLOATSIGN(ge->IDOT, 14, R2R_PI/(double)(1<<30)/(double)(1<<13))
-        GETBITSFACTOR(ge->TOC, 14, 60)
-        GETFLOATSIGN(ge->clock_driftrate, 6, 1.0/(double)(1<<30)/(double)(1<<29))
-        GETFLOATSIGN(ge->clock_drift, 21, 1.0/(double)(1<<30)/(double)(1<<16))
-        GETFLOATSIGN(ge->clock_bias, 31, 1.0/(double)(1<<30)/(double)(1<<4))
-        GETFLOATSIGN(ge->Crs, 16, 1.0/(double)(1<<5))
-        GETFLOATSIGN(ge->Delta_n, 16, R2R_PI/(double)(1<<30)/(double)(1<<13))
-        GETFLOATSIGN(ge->M0, 32, R2R_PI/(double)(1<<30)/(double)(1<<1))
-        GETFLOATSIGN(ge->Cuc, 16, 1.0/(double)(1<<29))
-        GETFLOAT(ge->e, 32, 1.0/(double)(1<<30)/(double)(1<<3))
-        GETFLOATSIGN(ge->Cus, 16, 1.0/(double)(1<<29))
-        GETFLOAT(ge->sqrt_A, 32, 1.0/(double)(1<<19))
-        GETBITSFACTOR(ge->TOE, 14, 60)
-        GETFLOATSIGN(ge->Cic, 16, 1.0/(double)(1<<29))
-        GETFLOATSIGN(ge->OMEGA0, 32, R2R_PI/(double)(1<<30)/(double)(1<<1))
-        GETFLOATSIGN(ge->Cis, 16, 1.0/(double)(1<<29))
-        GETFLOATSIGN(ge->i0, 32, R2R_PI/(double)(1<<30)/(double)(1<<1))
-        GETFLOATSIGN(ge->Crc, 16, 1.0/(double)(1<<5))
-        GETFLOATSIGN(ge->omega, 32, R2R_PI/(double)(1<<30)/(double)(1<<1))
-        GETFLOATSIGN(ge->OMEGADOT, 24, R2R_PI/(double)(1<<30)/(double)(1<<13))
-        GETFLOATSIGN(ge->BGD_1_5A, 10, 1.0/(double)(1<<30)/(double)(1<<2))
-        if(type == 1046)
+        if(sys == RTCM3_MSM_GLONASS)
         {
-          GETFLOATSIGN(ge->BGD_1_5B, 10, 1.0/(double)(1<<30)/(double)(1<<2))
-          GETBITS(ge->E5bHS, 2)
-          GETBITS(sv, 1)
-          ge->flags |= GALEPHF_INAV;
-          if(sv)
-            ge->flags |= GALEPHF_E5BDINVALID;
-          GETBITS(ge->E1_HS, 2)
-          GETBITS(sv, 1)
-          if(sv)
-            ge->flags |= GALEPHF_E1DINVALID;
-        }
-        else
-        {
-          ge->flags |= GALEPHF_FNAV;
-          GETBITS(ge->E5aHS, 2)
-          GETBITS(sv, 1)
-          if(sv)
-            ge->flags |= GALEPHF_E5ADINVALID;
-        }
-        ret = type;
-      }
-      break;
-    case 1020:
-      if(size == 43)
-      {
-        struct glonassephemeris *ge;
-        int i;
-
-        ge = &handle->ephemerisGLONASS;
-        memset(ge, 0, sizeof(*ge));
-
-        ge->flags |= GLOEPHF_PAVAILABLE;
-        GETBITS(ge->almanac_number, 6)
-        GETBITS(i, 5)
-        ge->frequency_number = i-7;
-        if(ge->almanac_number >= 1 && ge->almanac_number <= PRN_GLONASS_NUM)
-          handle->GLOFreq[ge->almanac_number-1] = 100+ge->frequency_number;
-        GETBITS(i, 1)
-        if(i)
-          ge->flags |= GLOEPHF_ALMANACHEALTHY;
-        GETBITS(i, 1)
-        if(i)
-          ge->flags |= GLOEPHF_ALMANACHEALTHOK;
-        GETBITS(i, 2)
-        if(i & 1)
-          ge->flags |= GLOEPHF_P10TRUE;
-        if(i & 2)
-          ge->flags |= GLOEPHF_P11TRUE;
-        GETBITS(i, 5)
-        ge->tk = i*60*60;
-        GETBITS(i, 6)
-        ge->tk += i*60;
-        GETBITS(i, 1)
-        ge->tk += i*30;
-        GETBITS(i, 1)
-        if(i)
-          ge->flags |= GLOEPHF_UNHEALTHY;
-        GETBITS(i, 1)
-        if(i)
-          ge->flags |= GLOEPHF_P2TRUE;
-        GETBITS(i, 7)
-        ge->tb = i*15*60;
-        GETFLOATSIGNM(ge->x_velocity, 24, 1.0/(double)(1<<20))
-        GETFLOATSIGNM(ge->x_pos, 27, 1.0/(double)(1<<11))
-        GETFLOATSIGNM(ge->x_acceleration, 5, 1.0/(double)(1<<30))
-        GETFLOATSIGNM(ge->y_velocity, 24, 1.0/(double)(1<<20))
-        GETFLOATSIGNM(ge->y_pos, 27, 1.0/(double)(1<<11))
-        GETFLOATSIGNM(ge->y_acceleration, 5, 1.0/(double)(1<<30))
-        GETFLOATSIGNM(ge->z_velocity, 24, 1.0/(double)(1<<20))
-        GETFLOATSIGNM(ge->z_pos, 27, 1.0/(double)(1<<11))
-        GETFLOATSIGNM(ge->z_acceleration, 5, 1.0/(double)(1<<30))
-        GETBITS(i, 1)
-        if(i)
-          ge->flags |= GLOEPHF_P3TRUE;
-        GETFLOATSIGNM(ge->gamma, 11, 1.0/(double)(1<<30)/(double)(1<<10))
-        SKIPBITS(3) /* GLONASS-M P, GLONASS-M ln (third string) */
-        GETFLOATSIGNM(ge->tau, 22, 1.0/(double)(1<<30)) /* GLONASS tau n(tb) */
-        SKIPBITS(5) /* GLONASS-M delta tau n(tb) */
-        GETBITS(ge->E, 5)
-        /* GETBITS(b, 1) / * GLONASS-M P4 */
-        /* GETBITS(b, 4) / * GLONASS-M Ft */
-        /* GETBITS(b, 11) / * GLONASS-M Nt */
-        /* GETBITS(b, 2) / * GLONASS-M M */
-        /* GETBITS(b, 1) / * GLONASS-M The Availability of Additional Data */
-        /* GETBITS(b, 11) / * GLONASS-M Na */
-        /* GETFLOATSIGNM(b, 32, 1.0/(double)(1<<30)/(double)(1<<1)) / * GLONASS tau c */
-        /* GETBITS(b, 5) / * GLONASS-M N4 */
-        /* GETFLOATSIGNM(b, 22, 1.0/(double)(1<<30)) / * GLONASS-M tau GPS */
-        /* GETBITS(b, 1) / * GLONASS-M ln (fifth string) */
-        ge->GPSWeek = handle->GPSWeek;
-        ge->GPSTOW = handle->GPSTOW;
-        ret = 1020;
-      }
-      break;
-    case 1001: case 1002: case 1003: case 1004:
-      if(handle->GPSWeek)
-      {
-        int lastlockl1[64];
-        int lastlockl2[64];
-        struct gnssdata *gnss;
-        int i, numsats, wasamb=0;
-
-        for(i = 0; i < 64; ++i)
-          lastlockl1[i] = lastlockl2[i] = 0;
-
-        gnss = &handle->DataNew;
-
-        SKIPBITS(12) /* id */
-        GETBITS(i,30)
-        if(i/1000 < (int)handle->GPSTOW - 86400)
-          ++handle->GPSWeek;
-        handle->GPSTOW = i/1000;
-        if(gnss->week && (gnss->timeofweek != i || gnss->week
-        != handle->GPSWeek))
-        {
-          handle->Data = *gnss;
-          memset(gnss, 0, sizeof(*gnss));
-          old = 1;
+          int k = handle->GLOFreq[RTCM3_MSM_NUMSAT-i-1];
+          if(!k && extsat[numsat] < 14)
+          {
+            k = handle->GLOFreq[RTCM3_MSM_NUMSAT-i-1]
+            = 100+extsat[numsat]-7;
+          }
+          if(!k)
+            wl = 0.0;
+          else if(k-100 >= -7 && k-100 <= 6)
+            wl = msmglowl[cd->wl != 0.0][k-100+7];
+          else if(cd->wl == 0.0)
+            wl = GLO_WAVELENGTH_L1(k-100);
+          else
+            wl = GLO_WAVELENGTH_L2(k-100);
         }
-        gnss->timeofweek = i;
-        gnss->week = handle->GPSWeek;
-
-        GETBITS(syncf,1) /* sync */
-        GETBITS(numsats,5)
-        SKIPBITS(4) /* smind, smint */
-
-        while(numsats-- && gnss->numsats < GNSS_MAXSATS)
+        if(cd->lock && wl) /* lock cannot have a valid zero value */
         {
-          int sv, code, l1range, c,l,s,ce,le,se,amb=0;
-          int fullsat, num;
+          int fullsat = RTCM3_MSM_NUMSAT-i-1, num, code;
 
-          GETBITS(sv, 6)
-          fullsat = sv < 40 ? sv : sv+80;
-          for(num = 0; num < gnss->numsats
-          && fullsat != gnss->satellites[num]; ++num)
-            ;
+          if(sys == RTCM3_MSM_GALILEO && fullsat >= 50 && fullsat <= 51)
+            fullsat += PRN_GIOVE_START-50;
+          else
+            fullsat += start;
 
-          if(num == gnss->numsats)
-            gnss->satellites[gnss->numsats++] = fullsat;
+          if((msm <= 3 && rrint[numsat] < 0) /* ambiguity not restored */
+          || (num = GetSatIndex(gnss, fullsat)) < 0)
+            continue;
 
-          /* L1 */
-          GETBITS(code, 1);
-          if(code)
-          {
-            c = GNSSDF_P1DATA;  ce = GNSSENTRY_P1DATA;
-            l = GNSSDF_L1PDATA; le = GNSSENTRY_L1PDATA;
-            s = GNSSDF_S1PDATA; se = GNSSENTRY_S1PDATA;
-            gnss->codetype[num][se] = 
-            gnss->codetype[num][ce] = gnss->codetype[num][le] = "1W";
-          }
-          else
-          {
-            c = GNSSDF_C1DATA;  ce = GNSSENTRY_C1DATA;
-            l = GNSSDF_L1CDATA; le = GNSSENTRY_L1CDATA;
-            s = GNSSDF_S1CDATA; se = GNSSENTRY_S1CDATA;
-            gnss->codetype[num][se] = 
-            gnss->codetype[num][ce] = gnss->codetype[num][le] = "1C";
-          }
-          if(!handle->info[RTCM3_MSM_GPS].type[ce])
-          {
-            handle->info[RTCM3_MSM_GPS].type[ce] = 
-            handle->info[RTCM3_MSM_GPS].type[le] = 
-            handle->info[RTCM3_MSM_GPS].type[se] = gnss->codetype[num][ce][1];
-          }
-          GETBITS(l1range, 24);
-          GETBITSSIGN(i, 20);
-          if((i&((1<<20)-1)) != 0x80000)
+          code = CODEINDEX(cd->code);
+          if(!handle->info[sys].type[cd->typeR])
           {
-            gnss->dataflags[num] |= (c|l);
-            gnss->measdata[num][ce] = l1range*0.02;
-            gnss->measdata[num][le] = l1range*0.02+i*0.0005;
+            handle->info[sys].type[cd->typeR] = 
+            handle->info[sys].type[cd->typeP] = 
+            handle->info[sys].type[cd->typeD] = 
+            handle->info[sys].type[cd->typeS] = cd->code[1];
           }
-          GETBITS(i, 7);
-          lastlockl1[sv] = i;
-          if(handle->lastlockGPSl1[sv] > i || i == 0)
-            gnss->dataflags2[num] |= GNSSDF2_LOCKLOSSL1;
-          if(type == 1002 || type == 1004)
+
+          if(msm != 2)
           {
-            GETBITS(amb,8);
-            if(amb && (gnss->dataflags[num] & c))
-            {
-              gnss->measdata[num][ce] += amb*299792.458;
-              gnss->measdata[num][le] += amb*299792.458;
-              ++wasamb;
-            }
-            GETBITS(i, 8);
-            if(i)
-            {
-              gnss->dataflags[num] |= s;
-              gnss->measdata[num][se] = i*0.25;
-              i /= 4*4;
-              if(i > 9) i = 9;
-              else if(i < 1) i = 1;
-              gnss->snrL1[num] = i;
-            }
+            MSMRange(gnss, num, cd, code, psr[count],
+            rrmod[numsat]+rrint[numsat]);
           }
-          gnss->measdata[num][le] /= GPS_WAVELENGTH_L1;
-          if(type == 1003 || type == 1004)
+          if(msm >= 2)
           {
-            /* L2 */
-            GETBITS(code,2);
-            if(code)
-            {
-              c = GNSSDF_P2DATA;  ce = GNSSENTRY_P2DATA;
-              l = GNSSDF_L2PDATA; le = GNSSENTRY_L2PDATA;
-              s = GNSSDF_S2PDATA; se = GNSSENTRY_S2PDATA;
-              if(code >= 2)
-              {
-                gnss->codetype[num][se] = 
-                gnss->codetype[num][ce] = gnss->codetype[num][le] = "2W";
-                gnss->dataflags2[num] |= GNSSDF2_XCORRL2;
-              }
-              else
-              {
-                gnss->codetype[num][se] = 
-                gnss->codetype[num][ce] = gnss->codetype[num][le] = "2P";
-              }
-            }
-            else
-            {
-              c = GNSSDF_C2DATA;  ce = GNSSENTRY_C2DATA;
-              l = GNSSDF_L2CDATA; le = GNSSENTRY_L2CDATA;
-              s = GNSSDF_S2CDATA; se = GNSSENTRY_S2CDATA;
-              gnss->codetype[num][se] = 
-              gnss->codetype[num][ce] = gnss->codetype[num][le] = "2 ";
-            }
-            if(!handle->info[RTCM3_MSM_GPS].type[ce])
-            {
-              handle->info[RTCM3_MSM_GPS].type[ce] = 
-              handle->info[RTCM3_MSM_GPS].type[le] = 
-              handle->info[RTCM3_MSM_GPS].type[se] = gnss->codetype[num][ce][1];
-            }
-            GETBITSSIGN(i,14);
-            if((i&((1<<14)-1)) != 0x2000)
-            {
-              gnss->dataflags[num] |= c;
-              gnss->measdata[num][ce] = l1range*0.02+i*0.02
-              +amb*299792.458;
-            }
-            GETBITSSIGN(i,20);
-            if((i&((1<<20)-1)) != 0x80000)
-            {
-              gnss->dataflags[num] |= l;
-              gnss->measdata[num][le] = l1range*0.02+i*0.0005
-              +amb*299792.458;
-            }
-            GETBITS(i,7);
-            lastlockl2[sv] = i;
-            if(handle->lastlockGPSl2[sv] > i || i == 0)
-              gnss->dataflags2[num] |= GNSSDF2_LOCKLOSSL2;
-            if(type == 1004)
-            {
-              GETBITS(i, 8);
-              if(i)
-              {
-                gnss->dataflags[num] |= s;
-                gnss->measdata[num][se] = i*0.25;
-                i /= 4*4;
-                if(i > 9) i = 9;
-                else if(i < 1) i = 1;
-                gnss->snrL2[num] = i;
-              }
-            }
-            gnss->measdata[num][le] /= GPS_WAVELENGTH_L2;
+            MSMPhase(gnss, num, cd, code, wl, cp[count],
+            rrmod[numsat]+rrint[numsat], ll[count], &handle->lastlockmsm[j][i]);
           }
+          if(msm >= 4)
+            SetObs(gnss, num, cd->typeS, code, cnr[count]);
+          if(msm == 5 || msm == 7)
+            MSMDoppler(gnss, num, cd, code, wl, dop[count], rdop[numsat]);
         }
-        for(i = 0; i < 64; ++i)
-        {
-          handle->lastlockGPSl1[i] = lastlockl1[i];
-          handle->lastlockGPSl2[i] = lastlockl2[i];
-        }
-        if(!syncf && !old)
-        {
-          handle->Data = *gnss;
-          memset(gnss, 0, sizeof(*gnss));
-        }
-        if(!syncf || old)
-        {
-          if(wasamb) /* not RINEX compatible without */
-            ret = 1;
-          else
-            ret = 2;
-        }
+      }
+    }
+  }
+  if(!syncf && !old)
+  {
+    NewEpoch(handle);
+  }
+  if(!syncf || old)
+  {
+    if(!wasnoamb) /* not RINEX compatible without */
+      ret = 1;
+    else
+      ret = 2;
+  }
 #ifdef NO_RTCM3_MAIN
-        else
-          ret = type;
+  else
+    ret = 1070+10*sys+msm; /* message type */
 #endif /* NO_RTCM3_MAIN */
+  return ret;
+}
+
+#define MSMDECODER(s, n) \
+static int DecodeMSM##n##s(struct RTCM3ParserData *handle, \
+struct BitReader *br) \
+{ return DecodeMSM(handle, br, n, RTCM3_MSM_##s); }
+#define MSMDECODERS(s) MSMDECODER(s, 1) MSMDECODER(s, 2) MSMDECODER(s, 3) \
+  MSMDECODER(s, 4) MSMDECODER(s, 5) MSMDECODER(s, 6) MSMDECODER(s, 7)
+MSMDECODERS(GPS) MSMDECODERS(GLONASS) MSMDECODERS(GALILEO)
+MSMDECODERS(SBAS) MSMDECODERS(QZSS) MSMDECODERS(BDS)
+
+#define MSMDECODERTAB(s) {DecodeMSM1##s, DecodeMSM2##s, DecodeMSM3##s, \
+  DecodeMSM4##s, DecodeMSM5##s, DecodeMSM6##s, DecodeMSM7##s}
+/* indexed by RTCM3_MSM_xxx and MSM number - 1 */
+static int (* const msmdecoders[RTCM3_MSM_NUMSYS][7])(
+struct RTCM3ParserData *handle, struct BitReader *br) =
+{MSMDECODERTAB(GPS), MSMDECODERTAB(GLONASS), MSMDECODERTAB(GALILEO),
+MSMDECODERTAB(SBAS), MSMDECODERTAB(QZSS), MSMDECODERTAB(BDS)};
+
+/* time around toe in which an ephemeris is used [s], by RTCM3_MSM_xxx */
+static const int ephemerisvalidity[RTCM3_MSM_NUMSYS] =
+{2*60*60, 15*60, 2*60*60, 10*60, 60*60, 60*60};
+
+/* returns the store index of a satellite or -1 */
+static int EphemerisIndex(int sys, int prn)
+{
+  if(sys == RTCM3_MSM_SBAS)
+    prn -= 20; /* S20 is PRN 120 */
+  if(sys < 0 || sys >= RTCM3_MSM_NUMSYS || prn < 0 || prn >= RTCM3_MSM_NUMSAT)
+    return -1;
+  return prn;
+}
+
+/* the ephemeris store of the parser, allocated when it is first needed */
+static struct ephemerisstore *EphemerisStore(struct RTCM3ParserData *handle)
+{
+  if(!handle->ephemerides
+  && !(handle->ephemerides = calloc(1, sizeof(*handle->ephemerides))))
+    RTCM3Error("Could not allocate the ephemeris store.\n");
+  return handle->ephemerides;
+}
+
+/* Puts the ephemeris decoded from message r into the store of its
+   satellite. A new one replaces the older entry, one with the same issue
+   of data and toe but changed content is updated. Returns 0 if an equal
+   ephemeris, apart from the GLONASS frame time, was stored already, 1
+   otherwise. */
+static int StoreEphemeris(struct RTCM3ParserData *handle, int r)
+{
+  union ephemerisrecord e;
+  struct ephemerisentry *c;
+  int sys, prn, iod, week, toe, i;
+
+  memset(&e, 0, sizeof(e));
+  switch(r)
+  {
+  case 1020:
+    {
+      struct glonassephemeris *g = &handle->ephemerisGLONASS;
+      week = g->GPSWeek;
+      toe = g->GPSTOW;
+      updatetime(&week, &toe, g->tb*1000, 0); /* Moscow -> GPS */
+      memcpy(&e.glonass, g, sizeof(*g));
+      e.glonass.GPSWeek = week; /* instead of the time of decoding */
+      e.glonass.GPSTOW = toe;
+      sys = RTCM3_MSM_GLONASS;
+      prn = g->almanac_number;
+      iod = g->tb;
+    }
+    break;
+  case 1043:
+    {
+      struct sbasephemeris *g = &handle->ephemerisSBAS;
+      memcpy(&e.sbas, g, sizeof(*g));
+      sys = RTCM3_MSM_SBAS;
+      prn = g->satellite-100;
+      iod = g->IODN;
+      week = g->GPSweek_TOE;
+      toe = g->TOE;
+      if(toe >= 7*24*60*60)
+        toe -= 7*24*60*60;
+      else if(toe < 0)
+        toe += 7*24*60*60;
+    }
+    break;
+  case RTCM3ID_BDS:
+    {
+      struct bdsephemeris *g = &handle->ephemerisBDS;
+      memcpy(&e.bds, g, sizeof(*g));
+      sys = RTCM3_MSM_BDS;
+      prn = g->satellite-PRN_BDS_START+1;
+      iod = g->AODE;
+      week = 1356+g->BDSweek;
+      toe = 14+g->TOE;
+      if(toe >= 7*24*60*60)
+      {
+        ++week;
+        toe -= 7*24*60*60;
       }
-      break;
-    case 1009: case 1010: case 1011: case 1012:
+    }
+    break;
+  case 1045: case 1046:
+    {
+      struct galileoephemeris *g = &handle->ephemerisGALILEO;
+      memcpy(&e.galileo, g, sizeof(*g));
+      sys = RTCM3_MSM_GALILEO;
+      prn = g->satellite;
+      iod = g->IODnav;
+      week = g->Week;
+      toe = g->TOE;
+    }
+    break;
+  default: /* 1019, 1044 */
+    {
+      struct gpsephemeris *g = &handle->ephemerisGPS;
+      memcpy(&e.gps, g, sizeof(*g));
+      if(g->satellite >= PRN_QZSS_START)
       {
-        int lastlockl1[64];
-        int lastlockl2[64];
-        struct gnssdata *gnss;
-        int i, numsats;
-        int wasamb=0;
+        sys = RTCM3_MSM_QZSS;
+        prn = g->satellite-PRN_QZSS_START+1;
+      }
+      else
+      {
+        sys = RTCM3_MSM_GPS;
+        prn = g->satellite < 40 ? g->satellite : g->satellite-80;
+      }
+      iod = g->IODE;
+      week = g->GPSweek;
+      if(handle->GPSWeek) /* the message has 10 bits, take the near cycle */
+        week += (handle->GPSWeek-week+512)/1024*1024;
+      toe = g->TOE;
+    }
+    break;
+  }
+  if((prn = EphemerisIndex(sys, prn)) < 0 || !EphemerisStore(handle))
+    return 1;
+
+  c = handle->ephemerides->entry[sys][prn];
+  for(i = 0; i < 2; ++i)
+  {
+    if(c[i].type == r && c[i].iod == iod && c[i].week == week
+    && c[i].toe == toe)
+    {
+      union ephemerisrecord d;
+      memcpy(&d, &c[i].data, sizeof(d));
+      if(r == 1020) /* the frame time tk advances with each rebroadcast */
+        d.glonass.tk = e.glonass.tk;
+      if(!memcmp(&d, &e, sizeof(e)))
+        return 0;
+      break; /* changed content */
+    }
+  }
+  if(i) /* new or previous entry, keep the current one as previous */
+    memcpy(c+1, c, sizeof(*c));
+  c[0].type = r;
+  c[0].iod = iod;
+  c[0].week = week;
+  c[0].toe = toe;
+  memcpy(&c[0].data, &e, sizeof(e));
+  return 1;
+}
 
-        for(i = 0; i < 64; ++i)
-          lastlockl1[i] = lastlockl2[i] = 0;
+const struct ephemerisentry *GetEphemeris(
+const struct RTCM3ParserData *Parser, int sys, int prn)
+{
+  const struct ephemerisentry *c;
+  if((prn = EphemerisIndex(sys, prn)) < 0 || !Parser->ephemerides)
+    return 0;
+  c = Parser->ephemerides->entry[sys][prn];
+  return c->type ? c : 0;
+}
 
-        gnss = &handle->DataNew;
+const struct ephemerisentry *GetEphemerisAt(
+const struct RTCM3ParserData *Parser, int sys, int prn, int week, int tow)
+{
+  const struct ephemerisentry *c, *best = 0;
+  int i, d, dbest = 0, valid;
 
-        SKIPBITS(12) /* id */;
-        GETBITS(i,27) /* tk */
+  if((prn = EphemerisIndex(sys, prn)) < 0 || !Parser->ephemerides)
+    return 0;
+  c = Parser->ephemerides->entry[sys][prn];
+  for(i = 0; i < 2; ++i)
+  {
+    if(!c[i].type || c[i].week < week-1 || c[i].week > week+1)
+      continue;
+    valid = ephemerisvalidity[sys];
+    if((sys == RTCM3_MSM_GPS || sys == RTCM3_MSM_QZSS)
+    && (c[i].data.gps.flags & GPSEPHF_6HOURSFIT))
+      valid = 3*60*60;
+    d = (week-c[i].week)*7*24*60*60 + tow-c[i].toe;
+    if(d < 0)
+      d = -d;
+    if(d <= valid && (!best || d < dbest))
+    {
+      best = c+i;
+      dbest = d;
+    }
+  }
+  return best;
+}
 
-        updatetime(&handle->GPSWeek, &handle->GPSTOW, i, 0); /* Moscow -> GPS */
-        i = handle->GPSTOW*1000;
-        if(gnss->week && (gnss->timeofweek != i || gnss->week
-        != handle->GPSWeek))
-        {
-          handle->Data = *gnss;
-          memset(gnss, 0, sizeof(*gnss));
-          old = 1;
-        }
+void RTCM3ParserFree(struct RTCM3ParserData *Parser)
+{
+  free(Parser->ephemerides);
+  Parser->ephemerides = 0;
+#ifndef NO_RTCM3_MAIN
+  free(Parser->qc);
+  Parser->qc = 0;
+#endif /* NO_RTCM3_MAIN */
+}
 
-        gnss->timeofweek = i;
-        gnss->week = handle->GPSWeek;
+/* Satellite orbits from broadcast ephemerides. The satellites of an epoch
+   are computed in blocks of ORBITLANES, with the parameters in arrays of
+   one element per lane. Each step is a loop over the lanes without
+   branches or library calls, which the compiler vectorises. */
+#define ORBITLANES    8
+#define KEPLERITER    6  /* Newton steps, enough for e < 0.3 */
+#define GLOSTEP       60 /* longest GLONASS integration step [s] */
+
+#define GPS_GM        3.986005e14      /* [m^3/s^2] */
+#define GPS_OMEGAE    7.2921151467e-5  /* [rad/s] */
+#define GAL_GM        3.986004418e14
+#define BDS_GM        3.986004418e14
+#define BDS_OMEGAE    7.292115e-5
+#define GLO_GM        3.986004418e14   /* PZ-90.02 */
+#define GLO_OMEGAE    7.292115e-5
+#define GLO_AE        6378136.0        /* [m] */
+#define GLO_J2        1.08262575e-3
+
+/* Kepler lanes, inputs and results */
+struct keplerlanes {
+  double tk[ORBITLANES];      /* time from toe [s] */
+  double tc[ORBITLANES];      /* time from toc [s] */
+  double toe[ORBITLANES];     /* toe in system time of week [s] */
+  double sqrtgm[ORBITLANES];   /* sqrt(GM) */
+  double sqrte[ORBITLANES];    /* sqrt(1-e^2) */
+  double omegae[ORBITLANES];
+  double omegaetk[ORBITLANES]; /* omegae, 0 for BDS GEO satellites */
+  double sqrt_A[ORBITLANES];
+  double Delta_n[ORBITLANES];
+  double M0[ORBITLANES];
+  double e[ORBITLANES];
+  double omega[ORBITLANES];
+  double Cuc[ORBITLANES], Cus[ORBITLANES];
+  double Crc[ORBITLANES], Crs[ORBITLANES];
+  double Cic[ORBITLANES], Cis[ORBITLANES];
+  double i0[ORBITLANES];
+  double IDOT[ORBITLANES];
+  double OMEGA0[ORBITLANES];
+  double OMEGADOT[ORBITLANES];
+  double af0[ORBITLANES], af1[ORBITLANES], af2[ORBITLANES];
+  double M[ORBITLANES], E[ORBITLANES];
+  double x[ORBITLANES], y[ORBITLANES], z[ORBITLANES], clk[ORBITLANES];
+};
 
-        GETBITS(syncf,1) /* sync */
-        GETBITS(numsats,5)
+/* GLONASS lanes, the state is x, y, z [m], vx, vy, vz [m/s] */
+struct glonasslanes {
+  double h[ORBITLANES];       /* step [s] */
+  double rinv[ORBITLANES];    /* 1/r of the last evaluated state */
+  double p[6][ORBITLANES];
+  double acc[3][ORBITLANES];  /* luni-solar acceleration [m/s^2] */
+  double k[6][ORBITLANES], s[6][ORBITLANES], t[6][ORBITLANES];
+};
 
-        SKIPBITS(4) /* smind, smint */
+/* sin and cos of x with |x| < 2^20. x is reduced by a multiple n of pi/2
+   in three parts, for |r| <= pi/4 the Taylor series up to r^17 and r^16
+   are exact to double precision. */
+static RTCM3_INLINE void SinCos(double x, double *sinx, double *cosx)
+{
+  const double round = 6755399441055744.0; /* 1.5*2^52 */
+  double n = (x*0.63661977236758134 + round) - round;
+  double q = n - 4.0*((n*0.25 - 0.375 + round) - round); /* n mod 4 */
+  double r = ((x - n*1.57079632673412561417) - n*6.07710050630396597660e-11)
+  - n*2.02226624871116645580e-21;
+  double r2 = r*r, s, c;
+
+  s = r + r*r2*(-1.0/6 + r2*(1.0/120 + r2*(-1.0/5040 + r2*(1.0/362880
+  + r2*(-1.0/39916800 + r2*(1.0/6227020800.0 + r2*(-1.0/1307674368000.0
+  + r2*(1.0/355687428096000.0))))))));
+  c = 1.0 + r2*(-0.5 + r2*(1.0/24 + r2*(-1.0/720 + r2*(1.0/40320
+  + r2*(-1.0/3628800 + r2*(1.0/479001600 + r2*(-1.0/87178291200.0
+  + r2*(1.0/20922789888000.0))))))));
+  *sinx = q == 0.0 ? s : q == 1.0 ? c : q == 2.0 ? -s : -c;
+  *cosx = q == 0.0 ? c : q == 1.0 ? -s : q == 2.0 ? -c : s;
+}
 
-        while(numsats-- && gnss->numsats < GNSS_MAXSATS)
-        {
-          int sv, code, l1range, c,l,s,ce,le,se,amb=0;
-          int freq;
-          int fullsat, num;
-
-          GETBITS(sv, 6)
-          fullsat = sv-1 + PRN_GLONASS_START;
-          for(num = 0; num < gnss->numsats
-          && fullsat != gnss->satellites[num]; ++num)
-            ;
+/* sin and cos of a correction angle |x| < 1e-3 */
+static RTCM3_INLINE void SinCosSmall(double x, double *sinx, double *cosx)
+{
+  double x2 = x*x;
+  *sinx = x*(1.0 - x2*(1.0/6 - x2*(1.0/120)));
+  *cosx = 1.0 - x2*(0.5 - x2*(1.0/24));
+}
 
-          if(num == gnss->numsats)
-            gnss->satellites[gnss->numsats++] = fullsat;
+/* IS-GPS-200 user algorithm, the true anomaly and the corrected angles are
+   handled as sin/cos pairs so no atan2 is needed. Square roots depend on
+   the lane only and are prepared by KeplerLane(). */
+static RTCM3_INLINE void KeplerLanesBody(struct keplerlanes *k)
+{
+  int i, j;
 
-          /* L1 */
-          GETBITS(code, 1)
-          GETBITS(freq, 5)
+  for(j = 0; j < ORBITLANES; ++j)
+  {
+    double A3 = k->sqrt_A[j]*k->sqrt_A[j]*k->sqrt_A[j];
+    k->M[j] = k->M0[j] + (k->sqrtgm[j]/A3 + k->Delta_n[j])*k->tk[j];
+    k->E[j] = k->M[j];
+  }
+  for(i = 0; i < KEPLERITER; ++i)
+  {
+    for(j = 0; j < ORBITLANES; ++j)
+    {
+      double s, c;
+      SinCos(k->E[j], &s, &c);
+      k->E[j] -= (k->E[j] - k->e[j]*s - k->M[j])/(1.0 - k->e[j]*c);
+    }
+  }
+  for(j = 0; j < ORBITLANES; ++j)
+  {
+    double sE, cE, sw, cw, sO, cO, sd, cd, si, ci, sp, cp, su, cu;
+    double den, snu, cnu, s2, c2, r;
+
+    SinCos(k->E[j], &sE, &cE);
+    den = 1.0 - k->e[j]*cE;
+    cnu = (cE - k->e[j])/den;
+    snu = k->sqrte[j]*sE/den;
+    SinCos(k->omega[j], &sw, &cw);
+    sp = snu*cw + cnu*sw; /* argument of latitude */
+    cp = cnu*cw - snu*sw;
+    s2 = 2.0*sp*cp;
+    c2 = cp*cp - sp*sp;
+    SinCosSmall(k->Cus[j]*s2 + k->Cuc[j]*c2, &sd, &cd);
+    su = sp*cd + cp*sd;
+    cu = cp*cd - sp*sd;
+    r = k->sqrt_A[j]*k->sqrt_A[j]*den + k->Crs[j]*s2 + k->Crc[j]*c2;
+    SinCos(k->i0[j], &si, &ci);
+    SinCosSmall(k->Cis[j]*s2 + k->Cic[j]*c2 + k->IDOT[j]*k->tk[j], &sd, &cd);
+    s2 = si*cd + ci*sd; /* inclination */
+    c2 = ci*cd - si*sd;
+    SinCos(k->OMEGA0[j] + (k->OMEGADOT[j] - k->omegaetk[j])*k->tk[j]
+    - k->omegae[j]*k->toe[j], &sO, &cO);
+    k->x[j] = r*(cu*cO - su*c2*sO);
+    k->y[j] = r*(cu*sO + su*c2*cO);
+    k->z[j] = r*su*s2;
+    k->clk[j] = k->af0[j] + (k->af1[j] + k->af2[j]*k->tc[j])*k->tc[j]
+    - 2.0*k->sqrtgm[j]/(LIGHTSPEED*LIGHTSPEED)*k->e[j]*k->sqrt_A[j]*sE;
+  }
+}
 
-          if(sv >= 1 && sv <= PRN_GLONASS_NUM)
-            handle->GLOFreq[sv-1] = 100+freq-7;
+/* GLONASS ICD equations of motion: derivative d of state s. 1/r is found
+   with Newton steps from that of the previous state, which differs by less
+   than 2 percent. A libm sqrt() would prevent the vectorisation. */
+static RTCM3_INLINE void GlonassDerivative(struct glonasslanes *g,
+double s[6][ORBITLANES], double d[6][ORBITLANES])
+{
+  int j;
 
-          if(code)
-          {
-            c = GNSSDF_P1DATA;  ce = GNSSENTRY_P1DATA;
-            l = GNSSDF_L1PDATA; le = GNSSENTRY_L1PDATA;
-            s = GNSSDF_S1PDATA; se = GNSSENTRY_S1PDATA;
-            gnss->codetype[num][se] = 
-            gnss->codetype[num][ce] = gnss->codetype[num][le] = "1P";
-          }
-          else
-          {
-            c = GNSSDF_C1DATA;  ce = GNSSENTRY_C1DATA;
-            l = GNSSDF_L1CDATA; le = GNSSENTRY_L1CDATA;
-            s = GNSSDF_S1CDATA; se = GNSSENTRY_S1CDATA;
-            gnss->codetype[num][se] = 
-            gnss->codetype[num][ce] = gnss->codetype[num][le] = "1C";
-          }
-          if(!handle->info[RTCM3_MSM_GLONASS].type[ce])
-          {
-            handle->info[RTCM3_MSM_GLONASS].type[ce] = 
-            handle->info[RTCM3_MSM_GLONASS].type[le] = 
-            handle->info[RTCM3_MSM_GLONASS].type[se] = gnss->codetype[num][ce][1];
-          }
-          GETBITS(l1range, 25)
-          GETBITSSIGN(i, 20)
-          if((i&((1<<20)-1)) != 0x80000)
-          {
-            /* Handle this like GPS. Actually for GLONASS L1 range is always
-               valid. To be on the save side, we handle it as invalid like we
-               do for GPS and also remove range in case of 0x80000. */
-            gnss->dataflags[num] |= (c|l);
-            gnss->measdata[num][ce] = l1range*0.02;
-            gnss->measdata[num][le] = l1range*0.02+i*0.0005;
-          }
-          GETBITS(i, 7)
-          lastlockl1[sv] = i;
-          if(handle->lastlockGLOl1[sv] > i || i == 0)
-            gnss->dataflags2[num] |= GNSSDF2_LOCKLOSSL1;
-          if(type == 1010 || type == 1012)
-          {
-            GETBITS(amb,7)
-            if(amb && (gnss->dataflags[num] & c))
-            {
-              gnss->measdata[num][ce] += amb*599584.916;
-              gnss->measdata[num][le] += amb*599584.916;
-              ++wasamb;
-            }
-            GETBITS(i, 8)
-            if(i)
-            {
-              gnss->dataflags[num] |= s;
-              gnss->measdata[num][se] = i*0.25;
-              i /= 4*4;
-              if(i > 9) i = 9;
-              else if(i < 1) i = 1;
-              gnss->snrL1[num] = i;
-            }
-          }
-          gnss->measdata[num][le] /= GLO_WAVELENGTH_L1(freq-7);
-          if(type == 1011 || type == 1012)
-          {
-            /* L2 */
-            GETBITS(code,2)
-            if(code)
-            {
-              c = GNSSDF_P2DATA;  ce = GNSSENTRY_P2DATA;
-              l = GNSSDF_L2PDATA; le = GNSSENTRY_L2PDATA;
-              s = GNSSDF_S2PDATA; se = GNSSENTRY_S2PDATA;
-              gnss->codetype[num][se] = 
-              gnss->codetype[num][ce] = gnss->codetype[num][le] = "2P";
-            }
-            else
-            {
-              c = GNSSDF_C2DATA;  ce = GNSSENTRY_C2DATA;
-              l = GNSSDF_L2CDATA; le = GNSSENTRY_L2CDATA;
-              s = GNSSDF_S2CDATA; se = GNSSENTRY_S2CDATA;
-              gnss->codetype[num][se] = 
-              gnss->codetype[num][ce] = gnss->codetype[num][le] = "2C";
-            }
-            if(!handle->info[RTCM3_MSM_GLONASS].type[ce])
-            {
-              handle->info[RTCM3_MSM_GLONASS].type[ce] = 
-              handle->info[RTCM3_MSM_GLONASS].type[le] = 
-              handle->info[RTCM3_MSM_GLONASS].type[se] = gnss->codetype[num][ce][1];
-            }
-            GETBITSSIGN(i,14)
-            if((i&((1<<14)-1)) != 0x2000)
-            {
-              gnss->dataflags[num] |= c;
-              gnss->measdata[num][ce] = l1range*0.02+i*0.02
-              +amb*599584.916;
-            }
-            GETBITSSIGN(i,20)
-            if((i&((1<<20)-1)) != 0x80000)
-            {
-              gnss->dataflags[num] |= l;
-              gnss->measdata[num][le] = l1range*0.02+i*0.0005
-              +amb*599584.916;
-            }
-            GETBITS(i,7)
-            lastlockl2[sv] = i;
-            if(handle->lastlockGLOl2[sv] > i || i == 0)
-              gnss->dataflags2[num] |= GNSSDF2_LOCKLOSSL2;
-            if(type == 1012)
-            {
-              GETBITS(i, 8)
-              if(i)
-              {
-                gnss->dataflags[num] |= s;
-                gnss->measdata[num][se] = i*0.25;
-                i /= 4*4;
-                if(i > 9) i = 9;
-                else if(i < 1) i = 1;
-                gnss->snrL2[num] = i;
-              }
-            }
-            gnss->measdata[num][le] /= GLO_WAVELENGTH_L2(freq-7);
-          }
-          if(!sv || sv > 24) /* illegal, remove it again */
-            --gnss->numsats;
-        }
-        for(i = 0; i < 64; ++i)
-        {
-          handle->lastlockGLOl1[i] = lastlockl1[i];
-          handle->lastlockGLOl2[i] = lastlockl2[i];
-        }
-        if(!syncf && !old)
-        {
-          handle->Data = *gnss;
-          memset(gnss, 0, sizeof(*gnss));
-        }
-        if(!syncf || old)
-        {
-          if(wasamb) /* not RINEX compatible without */
-            ret = 1;
-          else
-            ret = 2;
-        }
-#ifdef NO_RTCM3_MAIN
-        else
-          ret = type;
-#endif /* NO_RTCM3_MAIN */
+  for(j = 0; j < ORBITLANES; ++j)
+  {
+    double r2 = s[0][j]*s[0][j] + s[1][j]*s[1][j] + s[2][j]*s[2][j];
+    double r = g->rinv[j], gm, j2, z5;
+
+    r *= 1.5 - 0.5*r2*r*r;
+    r *= 1.5 - 0.5*r2*r*r;
+    r *= 1.5 - 0.5*r2*r*r;
+    g->rinv[j] = r;
+    gm = GLO_GM*r*r*r;
+    j2 = 1.5*GLO_J2*GLO_GM*GLO_AE*GLO_AE*r*r*r*r*r;
+    z5 = 5.0*s[2][j]*s[2][j]*r*r;
+
+    d[0][j] = s[3][j];
+    d[1][j] = s[4][j];
+    d[2][j] = s[5][j];
+    d[3][j] = (GLO_OMEGAE*GLO_OMEGAE - gm - j2*(1.0-z5))*s[0][j]
+    + 2.0*GLO_OMEGAE*s[4][j] + g->acc[0][j];
+    d[4][j] = (GLO_OMEGAE*GLO_OMEGAE - gm - j2*(1.0-z5))*s[1][j]
+    - 2.0*GLO_OMEGAE*s[3][j] + g->acc[1][j];
+    d[5][j] = (-gm - j2*(3.0-z5))*s[2][j] + g->acc[2][j];
+  }
+}
+
+/* Runge-Kutta 4th order, steps times h for all lanes */
+static RTCM3_INLINE void GlonassLanesBody(struct glonasslanes *g, int steps)
+{
+  int n, i, j;
+
+  for(n = 0; n < steps; ++n)
+  {
+    GlonassDerivative(g, g->p, g->k);
+    for(i = 0; i < 6; ++i)
+    {
+      for(j = 0; j < ORBITLANES; ++j)
+      {
+        g->s[i][j] = g->k[i][j];
+        g->t[i][j] = g->p[i][j] + 0.5*g->h[j]*g->k[i][j];
       }
-      break;
-    case 1071: case 1081: case 1091: case 1101: case 1111: case 1121:
-    case 1072: case 1082: case 1092: case 1102: case 1112: case 1122:
-    case 1073: case 1083: case 1093: case 1103: case 1113: case 1123:
-    case 1074: case 1084: case 1094: case 1104: case 1114: case 1124:
-    case 1075: case 1085: case 1095: case 1105: case 1115: case 1125:
-    case 1076: case 1086: case 1096: case 1106: case 1116: case 1126:
-    case 1077: case 1087: case 1097: case 1107: case 1117: case 1127:
-      if(handle->GPSWeek)
+    }
+    GlonassDerivative(g, g->t, g->k);
+    for(i = 0; i < 6; ++i)
+    {
+      for(j = 0; j < ORBITLANES; ++j)
       {
-        struct CodeData {
-          int typeR;
-          int typeP;
-          int typeD;
-          int typeS;
-          int lock;
-          double wl;
-          const char *code; /* currently unused */
-        };
-        struct CodeData gps[RTCM3_MSM_NUMSIG] =
-        {
-          {0,0,0,0,0,0,0},
-          {GNSSENTRY_C1DATA,GNSSENTRY_L1CDATA,GNSSENTRY_D1CDATA,
-          GNSSENTRY_S1CDATA,GNSSDF2_LOCKLOSSL1,GPS_WAVELENGTH_L1,"1C"},
-          {GNSSENTRY_P1DATA,GNSSENTRY_L1PDATA,GNSSENTRY_D1PDATA,
-          GNSSENTRY_S1PDATA,GNSSDF2_LOCKLOSSL1,GPS_WAVELENGTH_L1,"1P"},
-          {GNSSENTRY_P1DATA,GNSSENTRY_L1PDATA,GNSSENTRY_D1PDATA,
-          GNSSENTRY_S1PDATA,GNSSDF2_LOCKLOSSL1,GPS_WAVELENGTH_L1,"1W"},
-          {0,0,0,0,0,0,0}/*{GNSSENTRY_P1DATA,GNSSENTRY_L1PDATA,GNSSENTRY_D1PDATA,
-          GNSSENTRY_S1PDATA,GNSSDF2_LOCKLOSSL1,GPS_WAVELENGTH_L1,"1Y"}*/,
-          {0,0,0,0,0,0,0},
-          {0,0,0,0,0,0,0},
-          {GNSSENTRY_C2DATA,GNSSENTRY_L2CDATA,GNSSENTRY_D2CDATA,
-          GNSSENTRY_S2CDATA,GNSSDF2_LOCKLOSSL2,GPS_WAVELENGTH_L2,"2C"},
-          {GNSSENTRY_P2DATA,GNSSENTRY_L2PDATA,GNSSENTRY_D2PDATA,
-          GNSSENTRY_S2PDATA,GNSSDF2_LOCKLOSSL2,GPS_WAVELENGTH_L2,"2P"},
-          {GNSSENTRY_P2DATA,GNSSENTRY_L2PDATA,GNSSENTRY_D2PDATA,
-          GNSSENTRY_S2PDATA,GNSSDF2_LOCKLOSSL2,GPS_WAVELENGTH_L2,"2W"},
-          {0,0,0,0,0,0,0}/*{GNSSENTRY_P2DATA,GNSSENTRY_L2PDATA,GNSSENTRY_D2PDATA,
-          GNSSENTRY_S2PDATA,GNSSDF2_LOCKLOSSL2,GPS_WAVELENGTH_L2,"2Y"}*/,
-          {0,0,0,0,0,0,0},
-          {0,0,0,0,0,0,0},
-          {0,0,0,0,0,0,0},
-          {GNSSENTRY_C2DATA,GNSSENTRY_L2CDATA,GNSSENTRY_D2CDATA,
-          GNSSENTRY_S2CDATA,GNSSDF2_LOCKLOSSL2,GPS_WAVELENGTH_L2,"2S"},
-          {GNSSENTRY_C2DATA,GNSSENTRY_L2CDATA,GNSSENTRY_D2CDATA,
-          GNSSENTRY_S2CDATA,GNSSDF2_LOCKLOSSL2,GPS_WAVELENGTH_L2,"2L"},
-          {GNSSENTRY_C2DATA,GNSSENTRY_L2CDATA,GNSSENTRY_D2CDATA,
-          GNSSENTRY_S2CDATA,GNSSDF2_LOCKLOSSL2,GPS_WAVELENGTH_L2,"2X"},
-          {0,0,0,0,0,0,0},
-          {0,0,0,0,0,0,0},
-          {0,0,0,0,0,0,0},
-          {0,0,0,0,0,0,0},
-          {GNSSENTRY_C5DATA,GNSSENTRY_L5DATA,GNSSENTRY_D5DATA,
-          GNSSENTRY_S5DATA,GNSSDF2_LOCKLOSSL5,GPS_WAVELENGTH_L5,"5I"},
-          {GNSSENTRY_C5DATA,GNSSENTRY_L5DATA,GNSSENTRY_D5DATA,
-          GNSSENTRY_S5DATA,GNSSDF2_LOCKLOSSL5,GPS_WAVELENGTH_L5,"5Q"},
-          {GNSSENTRY_C5DATA,GNSSENTRY_L5DATA,GNSSENTRY_D5DATA,
-          GNSSENTRY_S5DATA,GNSSDF2_LOCKLOSSL5,GPS_WAVELENGTH_L5,"5X"},
-          {0,0,0,0,0,0,0},
-          {0,0,0,0,0,0,0},
-          {0,0,0,0,0,0,0},
-          {0,0,0,0,0,0,0},
-          {0,0,0,0,0,0,0},
-          {GNSSENTRY_C1NDATA,GNSSENTRY_L1NDATA,GNSSENTRY_D1NDATA,
-          GNSSENTRY_S1NDATA,GNSSDF2_LOCKLOSSL1,GPS_WAVELENGTH_L1,"1S"},
-          {GNSSENTRY_C1NDATA,GNSSENTRY_L1NDATA,GNSSENTRY_D1NDATA,
-          GNSSENTRY_S1NDATA,GNSSDF2_LOCKLOSSL1,GPS_WAVELENGTH_L1,"1L"},
-          {GNSSENTRY_C1NDATA,GNSSENTRY_L1NDATA,GNSSENTRY_D1NDATA,
-          GNSSENTRY_S1NDATA,GNSSDF2_LOCKLOSSL1,GPS_WAVELENGTH_L1,"1X"}
-        };
-        /* NOTE: Uses 0.0, 1.0 for wavelength as sat index dependence is done later! */
-        struct CodeData glo[RTCM3_MSM_NUMSIG] =
-        {
-          {0,0,0,0,0,0,0},
-          {GNSSENTRY_C1DATA,GNSSENTRY_L1CDATA,GNSSENTRY_D1CDATA,
-          GNSSENTRY_S1CDATA,GNSSDF2_LOCKLOSSL1,0.0,"1C"},
-          {GNSSENTRY_P1DATA,GNSSENTRY_L1PDATA,GNSSENTRY_D1PDATA,
-          GNSSENTRY_S1PDATA,GNSSDF2_LOCKLOSSL1,0.0,"1P"},
-          {0,0,0,0,0,0,0},
-          {0,0,0,0,0,0,0},
-          {0,0,0,0,0,0,0},
-          {0,0,0,0,0,0,0},
-          {GNSSENTRY_C2DATA,GNSSENTRY_L2CDATA,GNSSENTRY_D2CDATA,
-          GNSSENTRY_S2CDATA,GNSSDF2_LOCKLOSSL2,1.0,"2C"},
-          {GNSSENTRY_P2DATA,GNSSENTRY_L2PDATA,GNSSENTRY_D2PDATA,
-          GNSSENTRY_S2PDATA,GNSSDF2_LOCKLOSSL2,1.0,"2P"},
-          {0,0,0,0,0,0,0},
-          {0,0,0,0,0,0,0},
-          {0,0,0,0,0,0,0},
-          {0,0,0,0,0,0,0},
-          {0,0,0,0,0,0,0},
-          {0,0,0,0,0,0,0},
-          {0,0,0,0,0,0,0},
-          {0,0,0,0,0,0,0},
-          {0,0,0,0,0,0,0},
-          {0,0,0,0,0,0,0},
-          {0,0,0,0,0,0,0},
-          {0,0,0,0,0,0,0},
-          {0,0,0,0,0,0,0},
-          {0,0,0,0,0,0,0},
-          {0,0,0,0,0,0,0},
-          {0,0,0,0,0,0,0},
-          {0,0,0,0,0,0,0},
-          {0,0,0,0,0,0,0},
-          {0,0,0,0,0,0,0},
-          {0,0,0,0,0,0,0},
-          {0,0,0,0,0,0,0},
-          {0,0,0,0,0,0,0},
-          {0,0,0,0,0,0,0}
-        };
-        struct CodeData gal[RTCM3_MSM_NUMSIG] =
-        {
-          {0,0,0,0,0,0,0},
-          {GNSSENTRY_C1DATA,GNSSENTRY_L1CDATA,GNSSENTRY_D1CDATA,
-          GNSSENTRY_S1CDATA,GNSSDF2_LOCKLOSSL1,GAL_WAVELENGTH_E1,"1C"},
-          {GNSSENTRY_C1DATA,GNSSENTRY_L1CDATA,GNSSENTRY_D1CDATA,
-          GNSSENTRY_S1CDATA,GNSSDF2_LOCKLOSSL1,GAL_WAVELENGTH_E1,"1A"},
-          {GNSSENTRY_C1DATA,GNSSENTRY_L1CDATA,GNSSENTRY_D1CDATA,
-          GNSSENTRY_S1CDATA,GNSSDF2_LOCKLOSSL1,GAL_WAVELENGTH_E1,"1B"},
-          {GNSSENTRY_C1DATA,GNSSENTRY_L1CDATA,GNSSENTRY_D1CDATA,
-          GNSSENTRY_S1CDATA,GNSSDF2_LOCKLOSSL1,GAL_WAVELENGTH_E1,"1X"},
-          {GNSSENTRY_C1DATA,GNSSENTRY_L1CDATA,GNSSENTRY_D1CDATA,
-          GNSSENTRY_S1CDATA,GNSSDF2_LOCKLOSSL1,GAL_WAVELENGTH_E1,"1Z"},
-          {0,0,0,0,0,0,0},
-          {GNSSENTRY_C6DATA,GNSSENTRY_L6DATA,GNSSENTRY_D6DATA,
-          GNSSENTRY_S6DATA,GNSSDF2_LOCKLOSSE6,GAL_WAVELENGTH_E6,"6C"},
-          {GNSSENTRY_C6DATA,GNSSENTRY_L6DATA,GNSSENTRY_D6DATA,
-          GNSSENTRY_S6DATA,GNSSDF2_LOCKLOSSE6,GAL_WAVELENGTH_E6,"6A"},
-          {GNSSENTRY_C6DATA,GNSSENTRY_L6DATA,GNSSENTRY_D6DATA,
-          GNSSENTRY_S6DATA,GNSSDF2_LOCKLOSSE6,GAL_WAVELENGTH_E6,"6B"},
-          {GNSSENTRY_C6DATA,GNSSENTRY_L6DATA,GNSSENTRY_D6DATA,
-          GNSSENTRY_S6DATA,GNSSDF2_LOCKLOSSE6,GAL_WAVELENGTH_E6,"6X"},
-          {GNSSENTRY_C6DATA,GNSSENTRY_L6DATA,GNSSENTRY_D6DATA,
-          GNSSENTRY_S6DATA,GNSSDF2_LOCKLOSSE6,GAL_WAVELENGTH_E6,"6Z"},
-          {0,0,0,0,0,0,0},
-          {GNSSENTRY_C5BDATA,GNSSENTRY_L5BDATA,GNSSENTRY_D5BDATA,
-          GNSSENTRY_S5BDATA,GNSSDF2_LOCKLOSSE5B,GAL_WAVELENGTH_E5B,"7I"},
-          {GNSSENTRY_C5BDATA,GNSSENTRY_L5BDATA,GNSSENTRY_D5BDATA,
-          GNSSENTRY_S5BDATA,GNSSDF2_LOCKLOSSE5B,GAL_WAVELENGTH_E5B,"7Q"},
-          {GNSSENTRY_C5BDATA,GNSSENTRY_L5BDATA,GNSSENTRY_D5BDATA,
-          GNSSENTRY_S5BDATA,GNSSDF2_LOCKLOSSE5B,GAL_WAVELENGTH_E5B,"7X"},
-          {0,0,0,0,0,0,0},
-          {GNSSENTRY_C5ABDATA,GNSSENTRY_L5ABDATA,GNSSENTRY_D5ABDATA,
-          GNSSENTRY_S5ABDATA,GNSSDF2_LOCKLOSSE5AB,GAL_WAVELENGTH_E5AB,"8I"},
-          {GNSSENTRY_C5ABDATA,GNSSENTRY_L5ABDATA,GNSSENTRY_D5ABDATA,
-          GNSSENTRY_S5ABDATA,GNSSDF2_LOCKLOSSE5AB,GAL_WAVELENGTH_E5AB,"8Q"},
-          {GNSSENTRY_C5ABDATA,GNSSENTRY_L5ABDATA,GNSSENTRY_D5ABDATA,
-          GNSSENTRY_S5ABDATA,GNSSDF2_LOCKLOSSE5AB,GAL_WAVELENGTH_E5AB,"8X"},
-          {0,0,0,0,0,0,0},
-          {GNSSENTRY_C5DATA,GNSSENTRY_L5DATA,GNSSENTRY_D5DATA,
-          GNSSENTRY_S5DATA,GNSSDF2_LOCKLOSSL5,GAL_WAVELENGTH_E5A,"5I"},
-          {GNSSENTRY_C5DATA,GNSSENTRY_L5DATA,GNSSENTRY_D5DATA,
-          GNSSENTRY_S5DATA,GNSSDF2_LOCKLOSSL5,GAL_WAVELENGTH_E5A,"5Q"},
-          {GNSSENTRY_C5DATA,GNSSENTRY_L5DATA,GNSSENTRY_D5DATA,
-          GNSSENTRY_S5DATA,GNSSDF2_LOCKLOSSL5,GAL_WAVELENGTH_E5A,"5X"},
-          {0,0,0,0,0,0,0},
-          {0,0,0,0,0,0,0},
-          {0,0,0,0,0,0,0},
-          {0,0,0,0,0,0,0},
-          {0,0,0,0,0,0,0},
-          {0,0,0,0,0,0,0},
-          {0,0,0,0,0,0,0},
-          {0,0,0,0,0,0,0},
-        };
-        struct CodeData qzss[RTCM3_MSM_NUMSIG] =
-        {
-          {0,0,0,0,0,0,0},
-          {GNSSENTRY_C1DATA,GNSSENTRY_L1CDATA,GNSSENTRY_D1CDATA,
-          GNSSENTRY_S1CDATA,GNSSDF2_LOCKLOSSL1,GPS_WAVELENGTH_L1,"1C"},
-          {0,0,0,0,0,0,0},
-          {0,0,0,0,0,0,0},
-          {0,0,0,0,0,0,0},
-          {GNSSENTRY_CSAIFDATA,GNSSENTRY_LSAIFDATA,GNSSENTRY_DSAIFDATA,
-          GNSSENTRY_SSAIFDATA,GNSSDF2_LOCKLOSSSAIF,GPS_WAVELENGTH_L1,"1Z"},
-          {0,0,0,0,0,0,0},
-          {0,0,0,0,0,0,0},
-          {GNSSENTRY_CLEXDATA,GNSSENTRY_LLEXDATA,GNSSENTRY_DLEXDATA,
-          GNSSENTRY_SLEXDATA,GNSSDF2_LOCKLOSSLEX,QZSS_WAVELENGTH_LEX,"6S"},
-          {GNSSENTRY_CLEXDATA,GNSSENTRY_LLEXDATA,GNSSENTRY_DLEXDATA,
-          GNSSENTRY_SLEXDATA,GNSSDF2_LOCKLOSSLEX,QZSS_WAVELENGTH_LEX,"6L"},
-          {GNSSENTRY_CLEXDATA,GNSSENTRY_LLEXDATA,GNSSENTRY_DLEXDATA,
-          GNSSENTRY_SLEXDATA,GNSSDF2_LOCKLOSSLEX,QZSS_WAVELENGTH_LEX,"6X"},
-          {0,0,0,0,0,0,0},
-          {0,0,0,0,0,0,0},
-          {0,0,0,0,0,0,0},
-          {GNSSENTRY_C2DATA,GNSSENTRY_L2CDATA,GNSSENTRY_D2CDATA,
-          GNSSENTRY_S2CDATA,GNSSDF2_LOCKLOSSL2,GPS_WAVELENGTH_L2,"2S"},
-          {GNSSENTRY_C2DATA,GNSSENTRY_L2CDATA,GNSSENTRY_D2CDATA,
-          GNSSENTRY_S2CDATA,GNSSDF2_LOCKLOSSL2,GPS_WAVELENGTH_L2,"2L"},
-          {GNSSENTRY_C2DATA,GNSSENTRY_L2CDATA,GNSSENTRY_D2CDATA,
-          GNSSENTRY_S2CDATA,GNSSDF2_LOCKLOSSL2,GPS_WAVELENGTH_L2,"2X"},
-          {0,0,0,0,0,0,0},
-          {0,0,0,0,0,0,0},
-          {0,0,0,0,0,0,0},
-          {0,0,0,0,0,0,0},
-          {GNSSENTRY_C5DATA,GNSSENTRY_L5DATA,GNSSENTRY_D5DATA,
-          GNSSENTRY_S5DATA,GNSSDF2_LOCKLOSSL5,GPS_WAVELENGTH_L5,"5I"},
-          {GNSSENTRY_C5DATA,GNSSENTRY_L5DATA,GNSSENTRY_D5DATA,
-          GNSSENTRY_S5DATA,GNSSDF2_LOCKLOSSL5,GPS_WAVELENGTH_L5,"5Q"},
-          {GNSSENTRY_C5DATA,GNSSENTRY_L5DATA,GNSSENTRY_D5DATA,
-          GNSSENTRY_S5DATA,GNSSDF2_LOCKLOSSL5,GPS_WAVELENGTH_L5,"5X"},
-          {0,0,0,0,0,0,0},
-          {0,0,0,0,0,0,0},
-          {0,0,0,0,0,0,0},
-          {0,0,0,0,0,0,0},
-          {0,0,0,0,0,0,0},
-          {GNSSENTRY_C1NDATA,GNSSENTRY_L1NDATA,GNSSENTRY_D1NDATA,
-          GNSSENTRY_S1NDATA,GNSSDF2_LOCKLOSSL1,GPS_WAVELENGTH_L1,"1D"},
-          {GNSSENTRY_C1NDATA,GNSSENTRY_L1NDATA,GNSSENTRY_D1NDATA,
-          GNSSENTRY_S1NDATA,GNSSDF2_LOCKLOSSL1,GPS_WAVELENGTH_L1,"1P"},
-          {GNSSENTRY_C1NDATA,GNSSENTRY_L1NDATA,GNSSENTRY_D1NDATA,
-          GNSSENTRY_S1NDATA,GNSSDF2_LOCKLOSSL1,GPS_WAVELENGTH_L1,"1X"}
-        };
-        struct CodeData bds[RTCM3_MSM_NUMSIG] =
-        {
-          {0,0,0,0,0,0,0},
-          {GNSSENTRY_CB1DATA,GNSSENTRY_LB1DATA,GNSSENTRY_DB1DATA,
-          GNSSENTRY_SB1DATA,GNSSDF2_LOCKLOSSB1,BDS_WAVELENGTH_B1,"1I"},
-          {0,0,0,0,0,0,0},
-          {0,0,0,0,0,0,0},
-          {0,0,0,0,0,0,0},
-          {0,0,0,0,0,0,0},
-          {0,0,0,0,0,0,0},
-          {GNSSENTRY_CB3DATA,GNSSENTRY_LB3DATA,GNSSENTRY_DB3DATA,
-          GNSSENTRY_SB3DATA,GNSSDF2_LOCKLOSSB3,BDS_WAVELENGTH_B3,"6I"},
-          {0,0,0,0,0,0,0},
-          {0,0,0,0,0,0,0},
-          {0,0,0,0,0,0,0},
-          {0,0,0,0,0,0,0},
-          {0,0,0,0,0,0,0},
-          {GNSSENTRY_CB2DATA,GNSSENTRY_LB2DATA,GNSSENTRY_DB2DATA,
-          GNSSENTRY_SB2DATA,GNSSDF2_LOCKLOSSB2,BDS_WAVELENGTH_B2,"7I"},
-          {0,0,0,0,0,0,0},
-          {0,0,0,0,0,0,0},
-          {0,0,0,0,0,0,0},
-          {0,0,0,0,0,0,0},
-          {0,0,0,0,0,0,0},
-          {0,0,0,0,0,0,0},
-          {0,0,0,0,0,0,0},
-          {0,0,0,0,0,0,0},
-          {0,0,0,0,0,0,0},
-          {0,0,0,0,0,0,0},
-          {0,0,0,0,0,0,0},
-          {0,0,0,0,0,0,0},
-          {0,0,0,0,0,0,0},
-          {0,0,0,0,0,0,0},
-          {0,0,0,0,0,0,0},
-          {0,0,0,0,0,0,0},
-          {0,0,0,0,0,0,0},
-          {0,0,0,0,0,0,0},
-        };
-
-        int sys = RTCM3_MSM_GPS, i=0, count, j, old = 0, wasnoamb = 0,
-        start=PRN_GPS_START;
-        int syncf, sigmask, numsat = 0, numsig = 0, numcells;
-        uint64_t satmask, cellmask, ui;
-        double rrmod[RTCM3_MSM_NUMSAT];
-        int rrint[RTCM3_MSM_NUMSAT], rdop[RTCM3_MSM_NUMSAT],
-        extsat[RTCM3_MSM_NUMSAT];
-        int ll[RTCM3_MSM_NUMCELLS]/*, hc[RTCM3_MSM_NUMCELLS]*/;
-        double cnr[RTCM3_MSM_NUMCELLS];
-        double cp[RTCM3_MSM_NUMCELLS], psr[RTCM3_MSM_NUMCELLS],
-        dop[RTCM3_MSM_NUMCELLS];
-        struct gnssdata *gnss = &handle->DataNew;
-
-        SKIPBITS(12)
-        if(type >= 1121)
-        {
-          sys = RTCM3_MSM_BDS;
-          start = PRN_BDS_START;
-        }
-        else if(type >= 1111)
-        {
-          sys = RTCM3_MSM_QZSS;
-          start = PRN_QZSS_START;
-        }
-        else if(type >= 1101)
-        {
-          sys = RTCM3_MSM_SBAS;
-          start = PRN_SBAS_START;
-        }
-        else if(type >= 1091)
-        {
-          sys = RTCM3_MSM_GALILEO;
-          start = PRN_GALILEO_START;
-        }
-        else if(type >= 1081)
-        {
-          sys = RTCM3_MSM_GLONASS;
-          start = PRN_GLONASS_START;
-        }
+        g->s[i][j] += 2.0*g->k[i][j];
+        g->t[i][j] = g->p[i][j] + 0.5*g->h[j]*g->k[i][j];
+      }
+    }
+    GlonassDerivative(g, g->t, g->k);
+    for(i = 0; i < 6; ++i)
+    {
+      for(j = 0; j < ORBITLANES; ++j)
+      {
+        g->s[i][j] += 2.0*g->k[i][j];
+        g->t[i][j] = g->p[i][j] + g->h[j]*g->k[i][j];
+      }
+    }
+    GlonassDerivative(g, g->t, g->k);
+    for(i = 0; i < 6; ++i)
+    {
+      for(j = 0; j < ORBITLANES; ++j)
+        g->p[i][j] += g->h[j]/6.0*(g->s[i][j] + g->k[i][j]);
+    }
+  }
+}
 
-        for(i = 0; i < RTCM3_MSM_NUMSAT; ++i)
-          extsat[i] = 15;
+static void KeplerLanes(struct keplerlanes *k)
+{
+  KeplerLanesBody(k);
+}
 
-        switch(sys)
-        {
-        case RTCM3_MSM_BDS:
-          GETBITS(i,30)
-          i += 14000;
-          if(i >= 7*24*60*60*1000)
-            i -= 7*24*60*60*1000;
-          if(i/1000 < (int)handle->GPSTOW - 86400)
-            ++handle->GPSWeek;
-          handle->GPSTOW = i/1000;
-          break;
-        case RTCM3_MSM_GALILEO: /* use DF004 instead of DF248 */
-        case RTCM3_MSM_QZSS:
-        case RTCM3_MSM_SBAS:
-        case RTCM3_MSM_GPS:
-          GETBITS(i,30)
-          if(i/1000 < (int)handle->GPSTOW - 86400)
-            ++handle->GPSWeek;
-          handle->GPSTOW = i/1000;
-          break;
-        case RTCM3_MSM_GLONASS:
-          SKIPBITS(3)
-          GETBITS(i,27) /* tk */
-
-          updatetime(&handle->GPSWeek, &handle->GPSTOW, i, 0); /* Moscow -> GPS */
-          i = handle->GPSTOW*1000;
-          break;
-        }
+static void GlonassLanes(struct glonasslanes *g, int steps)
+{
+  GlonassLanesBody(g, steps);
+}
 
-        if(gnss->week && (gnss->timeofweek != i || gnss->week
-        != handle->GPSWeek))
-        {
-          handle->Data = *gnss;
-          memset(gnss, 0, sizeof(*gnss));
-          old = 1;
-        }
-        gnss->timeofweek = i;
-        gnss->week = handle->GPSWeek;
-
-        GETBITS(syncf, 1)
-        SKIPBITS(3+7+2+2+1+3)
-        GETBITS64(satmask, RTCM3_MSM_NUMSAT)
-
-        /* http://gurmeetsingh.wordpress.com/2008/08/05/fast-bit-counting-routines/ */
-        for(ui = satmask; ui; ui &= (ui - 1) /* remove rightmost bit */)
-          ++numsat;
-        GETBITS(sigmask, RTCM3_MSM_NUMSIG)
-        for(i = sigmask; i; i &= (i - 1) /* remove rightmost bit */)
-          ++numsig;
-        i = numsat*numsig;
-        GETBITS64(cellmask, (unsigned)i)
-
-        switch(type % 10)
-        {
-        case 1: case 2: case 3:
-          ++wasnoamb;
-          for(j = numsat; j--;)
-            GETFLOAT(rrmod[j], 10, 1.0/1024.0)
-          break;
-        case 4: case 6:
-          for(j = numsat; j--;)
-            GETBITS(rrint[j], 8)
-          for(j = numsat; j--;)
-            GETFLOAT(rrmod[j], 10, 1.0/1024.0)
-          break;
-        case 5: case 7:
-          for(j = numsat; j--;)
-            GETBITS(rrint[j], 8)
-          for(j = numsat; j--;)
-            GETBITS(extsat[j], 4)
-          for(j = numsat; j--;)
-            GETFLOAT(rrmod[j], 10, 1.0/1024.0)
-          for(j = numsat; j--;)
-            GETBITSSIGN(rdop[j], 14)
-          break;
-        }
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) \
+&& !defined(NO_RTCM3_AVX2)
+#define RTCM3_AVX2
+__attribute__((target("avx2,fma")))
+static void KeplerLanesAVX2(struct keplerlanes *k)
+{
+  KeplerLanesBody(k);
+}
 
-        numcells = numsat*numsig;
-        if(numcells <= RTCM3_MSM_NUMCELLS)
-        {
-          switch(type % 10)
-          {
-          case 1:
-            for(count = numcells; count--;)
-              if(cellmask & (UINT64(1)<<count))
-                GETFLOATSIGN(psr[count], 15, 1.0/(1<<24))
-            break;
-          case 2:
-            for(count = numcells; count--;)
-              if(cellmask & (UINT64(1)<<count))
-                GETFLOATSIGN(cp[count], 22, 1.0/(1<<29))
-            for(count = numcells; count--;)
-              if(cellmask & (UINT64(1)<<count))
-                GETBITS(ll[count], 4)
-            for(count = numcells; count--;)
-              if(cellmask & (UINT64(1)<<count))
-                SKIPBITS(1)/*GETBITS(hc[count], 1)*/
-            break;
-          case 3:
-            for(count = numcells; count--;)
-              if(cellmask & (UINT64(1)<<count))
-                GETFLOATSIGN(psr[count], 15, 1.0/(1<<24))
-            for(count = numcells; count--;)
-              if(cellmask & (UINT64(1)<<count))
-                GETFLOATSIGN(cp[count], 22, 1.0/(1<<29))
-            for(count = numcells; count--;)
-              if(cellmask & (UINT64(1)<<count))
-                GETBITS(ll[count], 4)
-            for(count = numcells; count--;)
-              if(cellmask & (UINT64(1)<<count))
-                SKIPBITS(1)/*GETBITS(hc[count], 1)*/
-            break;
-          case 4:
-            for(count = numcells; count--;)
-              if(cellmask & (UINT64(1)<<count))
-                GETFLOATSIGN(psr[count], 15, 1.0/(1<<24))
-            for(count = numcells; count--;)
-              if(cellmask & (UINT64(1)<<count))
-                GETFLOATSIGN(cp[count], 22, 1.0/(1<<29))
-            for(count = numcells; count--;)
-              if(cellmask & (UINT64(1)<<count))
-                GETBITS(ll[count], 4)
-            for(count = numcells; count--;)
-              if(cellmask & (UINT64(1)<<count))
-                SKIPBITS(1)/*GETBITS(hc[count], 1)*/
-            for(count = numcells; count--;)
-              if(cellmask & (UINT64(1)<<count))
-                GETBITS(cnr[count], 6)
-            break;
-          case 5:
-            for(count = numcells; count--;)
-              if(cellmask & (UINT64(1)<<count))
-                GETFLOATSIGN(psr[count], 15, 1.0/(1<<24))
-            for(count = numcells; count--;)
-              if(cellmask & (UINT64(1)<<count))
-                GETFLOATSIGN(cp[count], 22, 1.0/(1<<29))
-            for(count = numcells; count--;)
-              if(cellmask & (UINT64(1)<<count))
-                GETBITS(ll[count], 4)
-            for(count = numcells; count--;)
-              if(cellmask & (UINT64(1)<<count))
-                SKIPBITS(1)/*GETBITS(hc[count], 1)*/
-            for(count = numcells; count--;)
-              if(cellmask & (UINT64(1)<<count))
-                GETFLOAT(cnr[count], 6, 1.0)
-            for(count = numcells; count--;)
-              if(cellmask & (UINT64(1)<<count))
-                GETFLOATSIGN(dop[count], 15, 0.0001)
-            break;
-          case 6:
-            for(count = numcells; count--;)
-              if(cellmask & (UINT64(1)<<count))
-                GETFLOATSIGN(psr[count], 20, 1.0/(1<<29))
-            for(count = numcells; count--;)
-              if(cellmask & (UINT64(1)<<count))
-                GETFLOATSIGN(cp[count], 24, 1.0/(1U<<31))
-            for(count = numcells; count--;)
-              if(cellmask & (UINT64(1)<<count))
-                GETBITS(ll[count], 10)
-            for(count = numcells; count--;)
-              if(cellmask & (UINT64(1)<<count))
-                SKIPBITS(1)/*GETBITS(hc[count], 1)*/
-            for(count = numcells; count--;)
-              if(cellmask & (UINT64(1)<<count))
-                GETFLOAT(cnr[count], 10, 1.0/(1<<4))
-            break;
-          case 7:
-            for(count = numcells; count--;)
-              if(cellmask & (UINT64(1)<<count))
-                GETFLOATSIGN(psr[count], 20, 1.0/(1<<29))
-            for(count = numcells; count--;)
-              if(cellmask & (UINT64(1)<<count))
-                GETFLOATSIGN(cp[count], 24, 1.0/(1U<<31))
-            for(count = numcells; count--;)
-              if(cellmask & (UINT64(1)<<count))
-                GETBITS(ll[count], 10)
-            for(count = numcells; count--;)
-              if(cellmask & (UINT64(1)<<count))
-                SKIPBITS(1)/*GETBITS(hc[count], 1)*/
-            for(count = numcells; count--;)
-              if(cellmask & (UINT64(1)<<count))
-                GETFLOAT(cnr[count], 10, 1.0/(1<<4))
-            for(count = numcells; count--;)
-              if(cellmask & (UINT64(1)<<count))
-                GETFLOATSIGN(dop[count], 15, 0.0001)
-            break;
-          }
-          i = RTCM3_MSM_NUMSAT;
-          j = -1;
-          for(count = numcells; count--;)
-          {
-            while(j >= 0 && !(sigmask&(1<<--j)))
-              ;
-            if(j < 0)
-            {
-              while(!(satmask&(UINT64(1)<<(--i)))) /* next satellite */
-                ;
-              j = RTCM3_MSM_NUMSIG;
-              while(!(sigmask&(1<<--j)))
-                ;
-              --numsat;
-            }
-            if(cellmask & (UINT64(1)<<count))
-            {
-              struct CodeData cd = {0,0,0,0,0,0,0};
-              double wl = 0.0;
-              switch(sys)
-              {
-              case RTCM3_MSM_QZSS:
-                cd = qzss[RTCM3_MSM_NUMSIG-j-1];
-                wl = cd.wl;
-                break;
-              case RTCM3_MSM_BDS:
-                cd = bds[RTCM3_MSM_NUMSIG-j-1];
-                wl = cd.wl;
-                break;
-              case RTCM3_MSM_GPS:  case RTCM3_MSM_SBAS:
-                cd = gps[RTCM3_MSM_NUMSIG-j-1];
-                wl = cd.wl;
-                break;
-              case RTCM3_MSM_GLONASS: cd = glo[RTCM3_MSM_NUMSIG-j-1];
-                {
-                  int k = handle->GLOFreq[RTCM3_MSM_NUMSAT-i-1];
-                  if(!k && extsat[numsat] < 14)
-                  {
-                    k = handle->GLOFreq[RTCM3_MSM_NUMSAT-i-1]
-                    = 100+extsat[numsat]-7;
-                  }
-                  if(k)
-                  {
-                    if(cd.wl == 0.0)
-                      wl = GLO_WAVELENGTH_L1(k-100);
-                    else if(cd.wl == 1.0)
-                      wl = GLO_WAVELENGTH_L2(k-100);
-                  }
-                }
-                break;
-              case RTCM3_MSM_GALILEO: cd = gal[RTCM3_MSM_NUMSIG-j-1];
-                wl = cd.wl;
-                break;
-              }
-              if(cd.lock && wl) /* lock cannot have a valid zero value */
-              {
-                int fullsat = RTCM3_MSM_NUMSAT-i-1, num;
-
-                if(sys == RTCM3_MSM_GALILEO && fullsat >= 50 && fullsat <= 51)
-                  fullsat += PRN_GIOVE_START-50;
-                else
-                  fullsat += start;
-
-                for(num = 0; num < gnss->numsats
-                && fullsat != gnss->satellites[num]; ++num)
-                  ;
-
-                if(num == gnss->numsats)
-                  gnss->satellites[gnss->numsats++] = fullsat;
-
-                gnss->codetype[num][cd.typeR] = 
-                gnss->codetype[num][cd.typeP] = 
-                gnss->codetype[num][cd.typeD] = 
-                gnss->codetype[num][cd.typeS] = cd.code;
-                if(!handle->info[sys].type[cd.typeR])
-                {
-                  handle->info[sys].type[cd.typeR] = 
-                  handle->info[sys].type[cd.typeP] = 
-                  handle->info[sys].type[cd.typeD] = 
-                  handle->info[sys].type[cd.typeS] = cd.code[1];
-                }
-
-                switch(type % 10)
-                {
-                case 1:
-                  if(psr[count] > -1.0/(1<<10))
-                  {
-                    gnss->measdata[num][cd.typeR] = psr[count]*LIGHTSPEED/1000.0
-                    +(rrmod[numsat])*LIGHTSPEED/1000.0;
-                    gnss->dataflags[num] |= (1LL<<cd.typeR);
-                  }
-                  break;
-                case 2:
-                  if(wl && cp[count] > -1.0/(1<<8))
-                  {
-                    gnss->measdata[num][cd.typeP] = cp[count]*LIGHTSPEED/1000.0/wl
-                    +(rrmod[numsat])*LIGHTSPEED/1000.0/wl;
-                    if(handle->lastlockmsm[j][i] > ll[count])
-                      gnss->dataflags2[num] |= cd.lock;
-                    handle->lastlockmsm[j][i] = ll[count] > 255 ? 255 : ll[count];
-                    gnss->dataflags[num] |= (1LL<<cd.typeP);
-                  }
-                  break;
-                case 3:
-                  if(psr[count] > -1.0/(1<<10))
-                  {
-                    gnss->measdata[num][cd.typeR] = psr[count]*LIGHTSPEED/1000.0
-                    +(rrmod[numsat])*LIGHTSPEED/1000.0;
-                    gnss->dataflags[num] |= (1LL<<cd.typeR);
-                  }
-
-                  if(wl && cp[count] > -1.0/(1<<8))
-                  {
-                    gnss->measdata[num][cd.typeP] = cp[count]*LIGHTSPEED/1000.0/wl
-                    +(rrmod[numsat]+rrint[numsat])*LIGHTSPEED/1000.0/wl;
-                    if(handle->lastlockmsm[j][i] > ll[count])
-                      gnss->dataflags2[num] |= cd.lock;
-                    handle->lastlockmsm[j][i] = ll[count] > 255 ? 255 : ll[count];
-                    gnss->dataflags[num] |= (1LL<<cd.typeP);
-                  }
-                  break;
-                case 4:
-                  if(psr[count] > -1.0/(1<<10))
-                  {
-                    gnss->measdata[num][cd.typeR] = psr[count]*LIGHTSPEED/1000.0
-                    +(rrmod[numsat]+rrint[numsat])*LIGHTSPEED/1000.0;
-                    gnss->dataflags[num] |= (1LL<<cd.typeR);
-                  }
-
-                  if(wl && cp[count] > -1.0/(1<<8))
-                  {
-                    gnss->measdata[num][cd.typeP] = cp[count]*LIGHTSPEED/1000.0/wl
-                    +(rrmod[numsat]+rrint[numsat])*LIGHTSPEED/1000.0/wl;
-                    if(handle->lastlockmsm[j][i] > ll[count])
-                      gnss->dataflags2[num] |= cd.lock;
-                    handle->lastlockmsm[j][i] = ll[count] > 255 ? 255 : ll[count];
-                    gnss->dataflags[num] |= (1LL<<cd.typeP);
-                  }
-
-                  gnss->measdata[num][cd.typeS] = cnr[count];
-                    gnss->dataflags[num] |= (1LL<<cd.typeS);
-                  break;
-                case 5:
-                  if(psr[count] > -1.0/(1<<10))
-                  {
-                    gnss->measdata[num][cd.typeR] = psr[count]*LIGHTSPEED/1000.0
-                    +(rrmod[numsat]+rrint[numsat])*LIGHTSPEED/1000.0;
-                    gnss->dataflags[num] |= (1LL<<cd.typeR);
-                  }
-
-                  if(wl && cp[count] > -1.0/(1<<8))
-                  {
-                    gnss->measdata[num][cd.typeP] = cp[count]*LIGHTSPEED/1000.0/wl
-                    +(rrmod[numsat]+rrint[numsat])*LIGHTSPEED/1000.0/wl;
-                    if(handle->lastlockmsm[j][i] > ll[count])
-                      gnss->dataflags2[num] |= cd.lock;
-                    handle->lastlockmsm[j][i] = ll[count] > 255 ? 255 : ll[count];
-                    gnss->dataflags[num] |= (1LL<<cd.typeP);
-                  }
-
-                  gnss->measdata[num][cd.typeS] = cnr[count];
-                    gnss->dataflags[num] |= (1<<cd.typeS);
-
-                  if(dop[count] > -1.6384)
-                  {
-                    gnss->measdata[num][cd.typeD] = -(dop[count]
-                    +rdop[numsat])/wl;
-                    gnss->dataflags[num] |= (1LL<<cd.typeD);
-                  }
-                  break;
-                case 6:
-                  if(psr[count] > -1.0/(1<<10))
-                  {
-                    gnss->measdata[num][cd.typeR] = psr[count]*LIGHTSPEED/1000.0
-                    +(rrmod[numsat]+rrint[numsat])*LIGHTSPEED/1000.0;
-                    gnss->dataflags[num] |= (1LL<<cd.typeR);
-                  }
+__attribute__((target("avx2,fma")))
+static void GlonassLanesAVX2(struct glonasslanes *g, int steps)
+{
+  GlonassLanesBody(g, steps);
+}
+#endif /* RTCM3_AVX2 */
 
-                  if(wl && cp[count] > -1.0/(1<<8))
-                  {
-                    gnss->measdata[num][cd.typeP] = cp[count]*LIGHTSPEED/1000.0/wl
-                    +(rrmod[numsat]+rrint[numsat])*LIGHTSPEED/1000.0/wl;
-                    if(handle->lastlockmsm[j][i] > ll[count])
-                      gnss->dataflags2[num] |= cd.lock;
-                    handle->lastlockmsm[j][i] = ll[count] > 255 ? 255 : ll[count];
-                    gnss->dataflags[num] |= (1LL<<cd.typeP);
-                  }
+static void (*keplerfunc)(struct keplerlanes *k);
+static void (*glonassfunc)(struct glonasslanes *g, int steps);
 
-                  gnss->measdata[num][cd.typeS] = cnr[count];
-                    gnss->dataflags[num] |= (1LL<<cd.typeS);
-                  break;
-                case 7:
-                  if(psr[count] > -1.0/(1<<10))
-                  {
-                    gnss->measdata[num][cd.typeR] = psr[count]*LIGHTSPEED/1000.0
-                    +(rrmod[numsat]+rrint[numsat])*LIGHTSPEED/1000.0;
-                    gnss->dataflags[num] |= (1LL<<cd.typeR);
-                  }
+static void OrbitInit(void)
+{
+  glonassfunc = GlonassLanes;
+  keplerfunc = KeplerLanes;
+#ifdef RTCM3_AVX2
+  __builtin_cpu_init();
+  if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+  {
+    glonassfunc = GlonassLanesAVX2;
+    keplerfunc = KeplerLanesAVX2;
+  }
+#endif /* RTCM3_AVX2 */
+}
 
-                  if(wl && cp[count] > -1.0/(1<<8))
-                  {
-                    gnss->measdata[num][cd.typeP] = cp[count]*LIGHTSPEED/1000.0/wl
-                    +(rrmod[numsat]+rrint[numsat])*LIGHTSPEED/1000.0/wl;
-                    if(handle->lastlockmsm[j][i] > ll[count])
-                      gnss->dataflags2[num] |= cd.lock;
-                    handle->lastlockmsm[j][i] = ll[count] > 255 ? 255 : ll[count];
-                    gnss->dataflags[num] |= (1LL<<cd.typeP);
-                  }
+/* the Keplerian elements have the same names in all ephemeris structs */
+#define KEPLERLANE(k, j, g) \
+{ \
+  int d = (g)->TOE - (g)->TOC; \
+  if(d > 7*24*60*60/2) d -= 7*24*60*60; \
+  else if(d < -7*24*60*60/2) d += 7*24*60*60; \
+  k->tc[j] = k->tk[j] + d; \
+  k->toe[j] = (g)->TOE; \
+  k->sqrt_A[j] = (g)->sqrt_A; k->Delta_n[j] = (g)->Delta_n; \
+  k->M0[j] = (g)->M0; k->e[j] = (g)->e; k->omega[j] = (g)->omega; \
+  k->Cuc[j] = (g)->Cuc; k->Cus[j] = (g)->Cus; \
+  k->Crc[j] = (g)->Crc; k->Crs[j] = (g)->Crs; \
+  k->Cic[j] = (g)->Cic; k->Cis[j] = (g)->Cis; \
+  k->i0[j] = (g)->i0; k->IDOT[j] = (g)->IDOT; \
+  k->OMEGA0[j] = (g)->OMEGA0; k->OMEGADOT[j] = (g)->OMEGADOT; \
+  k->af0[j] = (g)->clock_bias; k->af1[j] = (g)->clock_drift; \
+  k->af2[j] = (g)->clock_driftrate; \
+}
 
-                  gnss->measdata[num][cd.typeS] = cnr[count];
-                    gnss->dataflags[num] |= (1LL<<cd.typeS);
+/* fills Kepler lane j from ephemeris e, dt is the time from toe */
+static void KeplerLane(struct keplerlanes *k, int j,
+const struct ephemerisentry *e, double dt)
+{
+  double gm = GPS_GM;
 
-                  if(dop[count] > -1.6384)
-                  {
-                    gnss->measdata[num][cd.typeD] = -(dop[count]
-                    +rdop[numsat])/wl;
-                    gnss->dataflags[num] |= (1LL<<cd.typeD);
-                  }
-                  break;
-                }
-              }
-            }
-          }
-        }
-        if(!syncf && !old)
-        {
-          handle->Data = *gnss;
-          memset(gnss, 0, sizeof(*gnss));
-        }
-        if(!syncf || old)
-        {
-          if(!wasnoamb) /* not RINEX compatible without */
-            ret = 1;
-          else
-            ret = 2;
-        }
-#ifdef NO_RTCM3_MAIN
-        else
-          ret = type;
-#endif /* NO_RTCM3_MAIN */
-      }
-      break;
-    }
+  k->tk[j] = dt;
+  k->omegae[j] = k->omegaetk[j] = GPS_OMEGAE;
+  if(e->type == RTCM3ID_BDS)
+  {
+    int prn = e->data.bds.satellite-PRN_BDS_START+1;
+    gm = BDS_GM;
+    k->omegae[j] = BDS_OMEGAE;
+    k->omegaetk[j] = prn <= 5 || prn >= 59 ? 0.0 : BDS_OMEGAE;
+    KEPLERLANE(k, j, &e->data.bds)
   }
-  return ret;
+  else if(e->type == 1045 || e->type == 1046)
+  {
+    gm = GAL_GM;
+    KEPLERLANE(k, j, &e->data.galileo)
+  }
+  else
+    KEPLERLANE(k, j, &e->data.gps)
+  k->sqrtgm[j] = sqrt(gm);
+  k->sqrte[j] = sqrt(1.0 - k->e[j]*k->e[j]);
 }
 
-struct Header
+/* computes the used Kepler lanes and stores the results */
+static void KeplerFlush(struct keplerlanes *k, int num,
+const struct ephemerisentry **eph, const int *sat, double *pos, double *clock)
 {
-  const char *version;
-  const char *pgm;
-  const char *marker;
-  const char *markertype;
-  const char *observer;
-  const char *receiver;
-  const char *antenna;
-  const char *position;
-  const char *antennaposition;
-  const char *wavelength;
-  const char *typesofobs; /* should not be modified outside */
-  const char *typesofobsG; /* should not be modified outside */
-  const char *typesofobsR; /* should not be modified outside */
-  const char *typesofobsS; /* should not be modified outside */
-  const char *typesofobsE; /* should not be modified outside */
-  const char *typesofobsC; /* should not be modified outside */
-  const char *typesofobsJ; /* should not be modified outside */
-  const char *timeoffirstobs; /* should not be modified outside */
-};
+  int j;
 
-#define MAXHEADERLINES 50
-#define MAXHEADERBUFFERSIZE 4096
-struct HeaderData
-{
-  union
+  for(j = num; j < ORBITLANES; ++j) /* unused lanes repeat the first */
+    KeplerLane(k, j, eph[0], k->tk[0]);
+  keplerfunc(k);
+  for(j = 0; j < num; ++j)
   {
-    struct Header named;
-    const char *unnamed[MAXHEADERLINES];
-  } data;
-  int  numheaders;
-};
-
-void converttime(struct converttimeinfo *c, int week, int tow)
-{
-  int i, k, doy, j; /* temporary variables */
-  j = week*(7*24*60*60) + tow + 5*24*60*60;
-  for(i = 1980; j >= (k = (365+longyear(i,0))*24*60*60); ++i)
-    j -= k;
-  c->year = i;
-  doy = 1+ (j / (24*60*60));
-  j %= (24*60*60);
-  c->hour = j / (60*60);
-  j %= (60*60);
-  c->minute = j / 60;
-  c->second = j % 60;
-  j = 0;
-  for(i = 1; j + (k = months[i] + longyear(c->year,i)) < doy; ++i)
-    j += k;
-  c->month = i;
-  c->day = doy - j;
+    double *p = pos+3*sat[j];
+    p[0] = k->x[j];
+    p[1] = k->y[j];
+    p[2] = k->z[j];
+    clock[sat[j]] = k->clk[j];
+    if(k->omegaetk[j] == 0.0) /* BDS GEO, rotate by -5 deg and omegae*tk */
+    {
+      const double s5 = -0.087155742747658174, c5 = 0.99619469809174553;
+      double s = sin(BDS_OMEGAE*k->tk[j]), c = cos(BDS_OMEGAE*k->tk[j]);
+      double y = k->y[j]*c5 + k->z[j]*s5;
+      p[0] = k->x[j]*c + y*s;
+      p[1] = -k->x[j]*s + y*c;
+      p[2] = -k->y[j]*s5 + k->z[j]*c5;
+    }
+  }
 }
 
-void converttimebds(struct converttimeinfo *c, int week, int tow)
+/* fills GLONASS lane j from ephemeris e, dt is the time from tb */
+static void GlonassLane(struct glonasslanes *g, int j,
+const struct ephemerisentry *e, double dt)
 {
-  int i, k, doy, j; /* temporary variables */
-  j = week*(7*24*60*60) + tow;
-  for(i = 2006; j >= (k = (365+longyear(i,0))*24*60*60); ++i)
-    j -= k;
-  c->year = i;
-  doy = 1+ (j / (24*60*60));
-  j %= (24*60*60);
-  c->hour = j / (60*60);
-  j %= (60*60);
-  c->minute = j / 60;
-  c->second = j % 60;
-  j = 0;
-  for(i = 1; j + (k = months[i] + longyear(c->year,i)) < doy; ++i)
-    j += k;
-  c->month = i;
-  c->day = doy - j;
+  const struct glonassephemeris *o = &e->data.glonass;
+  g->h[j] = dt; /* divided by the number of steps later */
+  g->p[0][j] = o->x_pos*1000.0;
+  g->p[1][j] = o->y_pos*1000.0;
+  g->p[2][j] = o->z_pos*1000.0;
+  g->p[3][j] = o->x_velocity*1000.0;
+  g->p[4][j] = o->y_velocity*1000.0;
+  g->p[5][j] = o->z_velocity*1000.0;
+  g->acc[0][j] = o->x_acceleration*1000.0;
+  g->acc[1][j] = o->y_acceleration*1000.0;
+  g->acc[2][j] = o->z_acceleration*1000.0;
+  g->rinv[j] = 1.0/sqrt(g->p[0][j]*g->p[0][j] + g->p[1][j]*g->p[1][j]
+  + g->p[2][j]*g->p[2][j]);
 }
 
-#ifndef NO_RTCM3_MAIN
-void RTCM3Error(const char *fmt, ...)
+/* integrates the used GLONASS lanes and stores the positions */
+static void GlonassFlush(struct glonasslanes *g, int num,
+const struct ephemerisentry **eph, const int *sat, double *pos)
 {
-  va_list v;
-  va_start(v, fmt);
-  vfprintf(stderr, fmt, v);
-  va_end(v);
-}
-#endif
+  double m = 0.0;
+  int j, steps;
 
-void RTCM3Text(const char *fmt, ...)
-{
-  va_list v;
-  va_start(v, fmt);
-  vprintf(fmt, v);
-  va_end(v);
+  for(j = num; j < ORBITLANES; ++j)
+    GlonassLane(g, j, eph[0], g->h[0]);
+  for(j = 0; j < ORBITLANES; ++j)
+  {
+    if(fabs(g->h[j]) > m)
+      m = fabs(g->h[j]);
+  }
+  steps = (int)ceil(m/GLOSTEP);
+  if(steps < 1)
+    steps = 1;
+  for(j = 0; j < ORBITLANES; ++j)
+    g->h[j] /= steps;
+  glonassfunc(g, steps);
+  for(j = 0; j < num; ++j)
+  {
+    pos[3*sat[j]] = g->p[0][j];
+    pos[3*sat[j]+1] = g->p[1][j];
+    pos[3*sat[j]+2] = g->p[2][j];
+  }
 }
 
-static void fixrevision(void)
+int SatellitePositions(const struct ephemerisentry * const *eph, int num,
+int week, double tow, double *pos, double *clock)
 {
-  if(revisionstr[0] == '$')
+  struct keplerlanes k;
+  struct glonasslanes g;
+  const struct ephemerisentry *ke[ORBITLANES], *ge[ORBITLANES];
+  int ks[ORBITLANES], gs[ORBITLANES], nk = 0, ng = 0, res = 0, i;
+
+  if(!keplerfunc)
+    OrbitInit();
+  for(i = 0; i < num; ++i)
   {
-    char *a;
-    int i=sizeof(RTCM3TORINEX_VERSION); /* set version to 1.<revision> */
-    strcpy(revisionstr, RTCM3TORINEX_VERSION ".");
-    for(a = revisionstr+11; *a && *a != ' '; ++a)
-      revisionstr[i++] = *a;
-    revisionstr[i] = 0;
+    const struct ephemerisentry *e = eph[i];
+    double dt;
+
+    pos[3*i] = pos[3*i+1] = pos[3*i+2] = clock[i] = 0.0;
+    if(!e || !e->type)
+      continue;
+    ++res;
+    dt = (week-e->week)*(7.0*24*60*60) + tow - e->toe;
+    if(e->type == 1020)
+    {
+      clock[i] = -e->data.glonass.tau + e->data.glonass.gamma*dt;
+      GlonassLane(&g, ng, e, dt);
+      ge[ng] = e;
+      gs[ng] = i;
+      if(++ng == ORBITLANES)
+      {
+        GlonassFlush(&g, ng, ge, gs, pos);
+        ng = 0;
+      }
+    }
+    else if(e->type == 1043) /* position, velocity and acceleration */
+    {
+      const struct sbasephemeris *s = &e->data.sbas;
+      pos[3*i] = s->x_pos + (s->x_velocity + 0.5*s->x_acceleration*dt)*dt;
+      pos[3*i+1] = s->y_pos + (s->y_velocity + 0.5*s->y_acceleration*dt)*dt;
+      pos[3*i+2] = s->z_pos + (s->z_velocity + 0.5*s->z_acceleration*dt)*dt;
+      clock[i] = s->agf0 + s->agf1*dt;
+    }
+    else
+    {
+      KeplerLane(&k, nk, e, dt);
+      ke[nk] = e;
+      ks[nk] = i;
+      if(++nk == ORBITLANES)
+      {
+        KeplerFlush(&k, nk, ke, ks, pos, clock);
+        nk = 0;
+      }
+    }
   }
+  if(nk)
+    KeplerFlush(&k, nk, ke, ks, pos, clock);
+  if(ng)
+    GlonassFlush(&g, ng, ge, gs, pos);
+  return res;
 }
 
-static int HandleRunBy(char *buffer, int buffersize, const char **u,
-int rinex3)
+void SatelliteAzEl(const double *station, int num, const double *pos,
+double *azimuth, double *elevation)
 {
-  const char *user;
-  time_t t;
-  struct tm * t2;
-
-#ifdef NO_RTCM3_MAIN
-  fixrevision();
-#endif
+  const double a = 6378137.0, f = 1.0/298.257223563, e2 = f*(2.0-f);
+  double p = sqrt(station[0]*station[0] + station[1]*station[1]);
+  double lat = atan2(station[2], p*(1.0-e2)), lon, sb, cb, sl, cl;
+  int i;
 
-  user= getenv("USER");
-  if(!user) user = "";
-  t = time(&t);
-  t2 = gmtime(&t);
-  if(u) *u = user;
-  if(rinex3)
+  for(i = 0; i < 5; ++i) /* geodetic latitude */
   {
-    return 1+snprintf(buffer, buffersize,
-    "RTCM3TORINEX %-7.7s%-20.20s%04d%02d%02d %02d%02d%02d UTC "
-    "PGM / RUN BY / DATE", revisionstr, user, 1900+t2->tm_year,
-    t2->tm_mon+1, t2->tm_mday, t2->tm_hour, t2->tm_min, t2->tm_sec);
+    double n = a/sqrt(1.0-e2*sin(lat)*sin(lat));
+    lat = atan2(station[2] + e2*n*sin(lat), p);
   }
-  else
+  lon = atan2(station[1], station[0]);
+  sb = sin(lat); cb = cos(lat);
+  sl = sin(lon); cl = cos(lon);
+  for(i = 0; i < num; ++i)
   {
-    return 1+snprintf(buffer, buffersize,
-    "RTCM3TORINEX %-7.7s%-20.20s%04d-%02d-%02d %02d:%02d    "
-    "PGM / RUN BY / DATE", revisionstr, user, 1900+t2->tm_year,
-    t2->tm_mon+1, t2->tm_mday, t2->tm_hour, t2->tm_min);
+    double dx = pos[3*i]-station[0], dy = pos[3*i+1]-station[1];
+    double dz = pos[3*i+2]-station[2];
+    double e = -sl*dx + cl*dy;
+    double n = -sb*cl*dx - sb*sl*dy + cb*dz;
+    double u = cb*cl*dx + cb*sl*dy + sb*dz;
+    azimuth[i] = atan2(e, n);
+    if(azimuth[i] < 0.0)
+      azimuth[i] += 6.283185307179586;
+    elevation[i] = atan2(u, sqrt(e*e + n*n));
   }
 }
 
-#ifdef NO_RTCM3_MAIN
-#define NUMSTARTSKIP 1
-#else
-#define NUMSTARTSKIP 3
-#endif
-
-int HandleObsHeader(struct RTCM3ParserData *Parser, char *buffer,
-size_t buffersize, struct HeaderData *hdata)
+/* decode the message at data, handle->size contains its length */
+static int RTCM3Decode(struct RTCM3ParserData *handle,
+const unsigned char *data)
 {
-  int buffersizeold = buffersize;
-  int i, modified = 0;
+  struct BitReader bits, *br = &bits;
+  int size = handle->size, type;
+  int syncf, old = 0, ret = 0;
 
-  if(Parser->rinex3)
+  if(!handle->DataNew) /* parser data is zero-initialised by the caller */
   {
-    int flags;
-#define CHECKFLAGSNEW(a, b, c) \
-    if(flags & GNSSDF_##b##DATA) \
-    { \
-      int new = hdata ? 1 : 0; \
-      if(!hdata) /* check if already known */ \
-      { \
-        int ic; \
-        for(ic = 0; ic < Parser->info[RTCM3_MSM_##a].numtypes \
-        && Parser->info[RTCM3_MSM_##a].flags[ic] != GNSSDF_##b##DATA; ++ic) \
-          ; \
-        if(ic == Parser->info[RTCM3_MSM_##a].numtypes) \
-          new = 1; \
-      } \
-      if(new) \
-      { \
-        Parser->info[RTCM3_MSM_##a].flags[Parser->info[RTCM3_MSM_##a].numtypes] \
-        = GNSSDF_##b##DATA; \
-        Parser->info[RTCM3_MSM_##a].pos[Parser->info[RTCM3_MSM_##a].numtypes] \
-        = GNSSENTRY_##b##DATA; \
-        if(Parser->info[RTCM3_MSM_##a].type[GNSSENTRY_##b##DATA]) \
-        { \
-          snprintf(Parser->fieldbuffer##a+4*Parser->info[RTCM3_MSM_##a].numtypes, \
-          sizeof(Parser->fieldbuffer##a)-4*Parser->info[RTCM3_MSM_##a].numtypes, \
-          " %-2.2s%c", #c, Parser->info[RTCM3_MSM_##a].type[GNSSENTRY_##b##DATA]); \
-        } \
-        else \
-        { \
-          snprintf(Parser->fieldbuffer##a+4*Parser->info[RTCM3_MSM_##a].numtypes, \
-          sizeof(Parser->fieldbuffer##a)-4*Parser->info[RTCM3_MSM_##a].numtypes, \
-          " %-3s", #c); \
-        } \
-        ++Parser->info[RTCM3_MSM_##a].numtypes; \
-        ++modified; \
-      } \
+    handle->DataNew = handle->EpochData;
+    handle->Data = handle->EpochData+1;
+  }
+  br->data = data;
+  br->pos = 0;
+  br->end = size+3;
+  GETBITS(type,12)
+#ifdef NO_RTCM3_MAIN
+  handle->blocktype = type;
+#endif /* NO_RTCM3_MAIN */
+  switch(type)
+  {
+  case 1005: case 1006: /* position for the ambiguity of 1001 and MSM1 */
+    {
+      int64_t x, y, z;
+
+      SKIPBITS(22)
+      GETBITSSIGN(x, 38)
+      SKIPBITS(2)
+      GETBITSSIGN(y, 38)
+      SKIPBITS(2)
+      GETBITSSIGN(z, 38)
+      handle->refpos[0] = x*0.0001;
+      handle->refpos[1] = y*0.0001;
+      handle->refpos[2] = z*0.0001;
+#ifdef NO_RTCM3_MAIN
+      handle->antX = x;
+      handle->antY = y;
+      handle->antZ = z;
+      if(type == 1006)
+        GETBITS(handle->antH, 16)
+      ret = type;
+#endif /* NO_RTCM3_MAIN */
     }
+    break;
+#ifdef NO_RTCM3_MAIN
+  default:
+    ret = type;
+    break;
+  case 1007: case 1008: case 1033:
+    {
+      char *antenna;
+      int antnum;
 
-#define INITFLAGS(a) \
-    flags = Parser->startflags; \
-    modified = 0; \
-    for(i = 0; i < Parser->Data.numsats; ++i) \
-    { \
-      if(Parser->Data.satellites[i] >= PRN_##a##_START \
-      && Parser->Data.satellites[i] <= PRN_##a##_END) \
-        flags |= Parser->Data.dataflags[i]; \
+      SKIPBITS(12)
+      GETSTRING(antnum,antenna)
+      memcpy(handle->antenna, antenna, antnum);
+      handle->antenna[antnum] = 0;
+      ret = type;
     }
-
-    INITFLAGS(SBAS)
-    CHECKFLAGSNEW(SBAS, C1,  C1C)
-    CHECKFLAGSNEW(SBAS, L1C, L1C)
-    CHECKFLAGSNEW(SBAS, D1C, D1C)
-    CHECKFLAGSNEW(SBAS, S1C, S1C)
-    CHECKFLAGSNEW(SBAS, C5,  C5)
-    CHECKFLAGSNEW(SBAS, L5,  L5)
-    CHECKFLAGSNEW(SBAS, D5,  D5)
-    CHECKFLAGSNEW(SBAS, S5,  S5)
-
-    if(modified)
+    break;
+  case 1013:
     {
-      if(hdata)
-        hdata->data.named.typesofobsS = buffer;
-      i = 1+snprintf(buffer, buffersize,
-      "S  %3d%-52.52s  SYS / # / OBS TYPES",
-      Parser->info[RTCM3_MSM_SBAS].numtypes, Parser->fieldbufferSBAS);
-      buffer += i; buffersize -= i;
+      SKIPBITS(12);
+      GETBITS(handle->modjulday, 16);
+      GETBITS(handle->secofday, 17);
+      SKIPBITS(5);
+      GETBITS(handle->leapsec, 8);
+      ret = 1013;
     }
-
-    INITFLAGS(GPS)
-    CHECKFLAGSNEW(GPS, C1,  C1C)
-    CHECKFLAGSNEW(GPS, L1C, L1C)
-    CHECKFLAGSNEW(GPS, D1C, D1C)
-    CHECKFLAGSNEW(GPS, S1C, S1C)
-    CHECKFLAGSNEW(GPS, P1,  C1W)
-    CHECKFLAGSNEW(GPS, L1P, L1W)
-    CHECKFLAGSNEW(GPS, D1P, D1W)
-    CHECKFLAGSNEW(GPS, S1P, S1W)
-    CHECKFLAGSNEW(GPS, C5,  C5)
-    CHECKFLAGSNEW(GPS, L5,  L5)
-    CHECKFLAGSNEW(GPS, D5,  D5)
-    CHECKFLAGSNEW(GPS, S5,  S5)
-    CHECKFLAGSNEW(GPS, P2,  C2W)
-    CHECKFLAGSNEW(GPS, L2P, L2W)
-    CHECKFLAGSNEW(GPS, D2P, D2W)
-    CHECKFLAGSNEW(GPS, S2P, S2W)
-    CHECKFLAGSNEW(GPS, C2,  C2)
-    CHECKFLAGSNEW(GPS, L2C, L2)
-    CHECKFLAGSNEW(GPS, D2C, D2)
-    CHECKFLAGSNEW(GPS, S2C, S2)
-    CHECKFLAGSNEW(GPS, C1N, C1)
-    CHECKFLAGSNEW(GPS, L1N, L1)
-    CHECKFLAGSNEW(GPS, D1N, D1)
-    CHECKFLAGSNEW(GPS, S1N, S1)
-
-    if(modified)
+    break;
+#endif /* NO_RTCM3_MAIN */
+  case 1019:
+    if(size == 61)
     {
-      if(hdata)
-        hdata->data.named.typesofobsG = buffer;
-      i = 1+snprintf(buffer, buffersize,
-      "G  %3d%-52.52s  SYS / # / OBS TYPES",
-      Parser->info[RTCM3_MSM_GPS].numtypes, Parser->fieldbufferGPS);
-      if(Parser->info[RTCM3_MSM_GPS].numtypes>13)
+      struct gpsephemeris *ge;
+      int sv, i;
+
+      ge = &handle->ephemerisGPS;
+      memset(ge, 0, sizeof(*ge));
+
+      GETBITS(sv, 6)
+      ge->satellite = (sv < 40 ? sv : sv+80);
+      GETBITS(ge->GPSweek, 10)
+      ge->GPSweek += 1024;
+      GETBITS(ge->URAindex, 4)
+      GETBITS(sv, 2)
+      if(sv & 1)
+        ge->flags |= GPSEPHF_L2PCODE;
+      if(sv & 2)
+        ge->flags |= GPSEPHF_L2CACODE;
+      GETFLOATSIGN(ge->IDOT, 14, R2R_PI/(double)(1<<30)/(double)(1<<13))
+      GETBITS(ge->IODE, 8)
+      GETBITS(ge->TOC, 16)
+      ge->TOC <<= 4;
+      GETFLOATSIGN(ge->clock_driftrate, 8, 1.0/(double)(1<<30)/(double)(1<<25))
+      GETFLOATSIGN(ge->clock_drift, 16, 1.0/(double)(1<<30)/(double)(1<<13))
+      GETFLOATSIGN(ge->clock_bias, 22, 1.0/(double)(1<<30)/(double)(1<<1))
+      GETBITS(ge->IODC, 10)
+      GETFLOATSIGN(ge->Crs, 16, 1.0/(double)(1<<5))
+      GETFLOATSIGN(ge->Delta_n, 16, R2R_PI/(double)(1<<30)/(double)(1<<13))
+      GETFLOATSIGN(ge->M0, 32, R2R_PI/(double)(1<<30)/(double)(1<<1))
+      GETFLOATSIGN(ge->Cuc, 16, 1.0/(double)(1<<29))
+      GETFLOAT(ge->e, 32, 1.0/(double)(1<<30)/(double)(1<<3))
+      GETFLOATSIGN(ge->Cus, 16, 1.0/(double)(1<<29))
+      GETFLOAT(ge->sqrt_A, 32, 1.0/(double)(1<<19))
+      GETBITS(ge->TOE, 16)
+      ge->TOE <<= 4;
+
+      GETFLOATSIGN(ge->Cic, 16, 1.0/(double)(1<<29))
+      GETFLOATSIGN(ge->OMEGA0, 32, R2R_PI/(double)(1<<30)/(double)(1<<1))
+      GETFLOATSIGN(ge->Cis, 16, 1.0/(double)(1<<29))
+      GETFLOATSIGN(ge->i0, 32, R2R_PI/(double)(1<<30)/(double)(1<<1))
+      GETFLOATSIGN(ge->Crc, 16, 1.0/(double)(1<<5))
+      GETFLOATSIGN(ge->omega, 32, R2R_PI/(double)(1<<30)/(double)(1<<1))
+      GETFLOATSIGN(ge->OMEGADOT, 24, R2R_PI/(double)(1<<30)/(double)(1<<13))
+      GETFLOATSIGN(ge->TGD, 8, 1.0/(double)(1<<30)/(double)(1<<1))
+      GETBITS(ge->SVhealth, 6)
+      GETBITS(sv, 1)
+      if(sv)
+        ge->flags |= GPSEPHF_L2PCODEDATA;
+      GETBITS(sv, 1)
+      if(sv)
+        ge->flags |= GPSEPHF_6HOURSFIT;
+
+      i = ((int)ge->GPSweek - (int)handle->GPSWeek)*7*24*60*60
+      + ((int)ge->TOE - (int)handle->GPSTOW) - 2*60*60;
+      if(i > 5*60*60 && i < 8*60*60)
       {
-        i += snprintf(buffer+i-1, buffersize,
-        "\n      %-52.52s  SYS / # / OBS TYPES", Parser->fieldbufferGPS+13*4);
+        handle->GPSTOW = ge->TOE;
+        handle->GPSWeek = ge->GPSweek;
       }
-      buffer += i; buffersize -= i;
+      ge->TOW = 0.9999E9;
+      ret = 1019;
     }
-
-    INITFLAGS(GLONASS)
-    CHECKFLAGSNEW(GLONASS, C1,  C1C)
-    CHECKFLAGSNEW(GLONASS, L1C, L1C)
-    CHECKFLAGSNEW(GLONASS, D1C, D1C)
-    CHECKFLAGSNEW(GLONASS, S1C, S1C)
-    CHECKFLAGSNEW(GLONASS, P1,  C1P)
-    CHECKFLAGSNEW(GLONASS, L1P, L1P)
-    CHECKFLAGSNEW(GLONASS, D1P, D1P)
-    CHECKFLAGSNEW(GLONASS, S1P, S1P)
-    CHECKFLAGSNEW(GLONASS, P2,  C2P)
-    CHECKFLAGSNEW(GLONASS, L2P, L2P)
-    CHECKFLAGSNEW(GLONASS, D2P, D2P)
-    CHECKFLAGSNEW(GLONASS, S2P, S2P)
-    CHECKFLAGSNEW(GLONASS, C2,  C2C)
-    CHECKFLAGSNEW(GLONASS, L2C, L2C)
-    CHECKFLAGSNEW(GLONASS, D2C, D2C)
-    CHECKFLAGSNEW(GLONASS, S2C, S2C)
-
-    if(modified)
+    break;
+  case RTCM3ID_BDS:
+    if(size == 64)
     {
-      if(hdata)
-        hdata->data.named.typesofobsR = buffer;
-      i = 1+snprintf(buffer, buffersize,
-      "R  %3d%-52.52s  SYS / # / OBS TYPES",
-      Parser->info[RTCM3_MSM_GLONASS].numtypes, Parser->fieldbufferGLONASS);
-      if(Parser->info[RTCM3_MSM_GLONASS].numtypes>13)
+      struct bdsephemeris *be;
+      int sv, i, week, tow;
+      be = &handle->ephemerisBDS;
+      memset(be, 0, sizeof(*be));
+
+      GETBITS(sv, 6)
+      be->satellite = sv+PRN_BDS_START-1;
+      GETBITS(be->BDSweek, 13)
+      GETBITS(be->URAI, 4)
+      GETFLOATSIGN(be->IDOT, 14, R2R_PI/(double)(1<<30)/(double)(1<<13))
+      GETBITS(be->AODE, 5)
+      GETBITS(be->TOC, 17)
+      be->TOC <<= 3;
+      GETFLOATSIGN(be->clock_driftrate, 11, 1.0/(double)(1<<30)/(double)(1<<30)/(double)(1<<6))
+      GETFLOATSIGN(be->clock_drift, 22, 1.0/(double)(1<<30)/(double)(1<<20))
+      GETFLOATSIGN(be->clock_bias, 24, 1.0/(double)(1<<30)/(double)(1<<3))
+      GETBITS(be->AODC, 5)
+      GETFLOATSIGN(be->Crs, 18, 1.0/(double)(1<<6))
+      GETFLOATSIGN(be->Delta_n, 16, R2R_PI/(double)(1<<30)/(double)(1<<13))
+      GETFLOATSIGN(be->M0, 32, R2R_PI/(double)(1<<30)/(double)(1<<1))
+      GETFLOATSIGN(be->Cuc, 18, 1.0/(double)(1<<30)/(double)(1<<1))
+      GETFLOAT(be->e, 32, 1.0/(double)(1<<30)/(double)(1<<3))
+      GETFLOATSIGN(be->Cus, 18, 1.0/(double)(1<<30)/(double)(1<<1))
+      GETFLOAT(be->sqrt_A, 32, 1.0/(double)(1<<19))
+      GETBITS(be->TOE, 17)
+      be->TOE <<= 3;
+      GETFLOATSIGN(be->Cic, 18, 1.0/(double)(1<<30)/(double)(1<<1))
+      GETFLOATSIGN(be->OMEGA0, 32, R2R_PI/(double)(1<<30)/(double)(1<<1))
+      GETFLOATSIGN(be->Cis, 18, 1.0/(double)(1<<30)/(double)(1<<1))
+      GETFLOATSIGN(be->i0, 32, R2R_PI/(double)(1<<30)/(double)(1<<1))
+      GETFLOATSIGN(be->Crc, 18, 1.0/(double)(1<<6))
+      GETFLOATSIGN(be->omega, 32, R2R_PI/(double)(1<<30)/(double)(1<<1))
+      GETFLOATSIGN(be->OMEGADOT, 24, R2R_PI/(double)(1<<30)/(double)(1<<13))
+      GETFLOATSIGN(be->TGD_B1_B3, 10, 0.0000000001)
+      GETFLOATSIGN(be->TGD_B2_B3, 10, 0.0000000001)
+      GETBITS(sv, 1)
+      if(sv)
+        be->flags |= BDSEPHF_SATH1;
+      week = 1356+be->BDSweek;
+      tow = 14+be->TOE;
+      if(tow > 7*24*60*60) /* overflow due to leap */
       {
-        i += snprintf(buffer+i-1, buffersize,
-        "\n      %-52.52s  SYS / # / OBS TYPES", Parser->fieldbufferGLONASS+13*4);
+        ++week;
+        tow -=  7*24*60*60;
       }
-      buffer += i; buffersize -= i;
+      i = (week - (int)handle->GPSWeek)*7*24*60*60
+      + (tow - (int)handle->GPSTOW) - 2*60*60;
+      if(i > 5*60*60 && i < 8*60*60)
+      {
+        handle->GPSTOW = tow;
+        handle->GPSWeek = week;
+      }
+      ret = RTCM3ID_BDS;
+      be->TOW = 0.9999E9;
     }
-
-    INITFLAGS(GALGIO)
-    CHECKFLAGSNEW(GALILEO, C1,   C1)
-    CHECKFLAGSNEW(GALILEO, L1C,  L1)
-    CHECKFLAGSNEW(GALILEO, D1C,  D1)
-    CHECKFLAGSNEW(GALILEO, S1C,  S1)
-    CHECKFLAGSNEW(GALILEO, C6,   C6)
-    CHECKFLAGSNEW(GALILEO, L6,   L6)
-    CHECKFLAGSNEW(GALILEO, D6,   D6)
-    CHECKFLAGSNEW(GALILEO, S6,   S6)
-    CHECKFLAGSNEW(GALILEO, C5,   C5)
-    CHECKFLAGSNEW(GALILEO, L5,   L5)
-    CHECKFLAGSNEW(GALILEO, D5,   D5)
-    CHECKFLAGSNEW(GALILEO, S5,   S5)
-    CHECKFLAGSNEW(GALILEO, C5B,  C7)
-    CHECKFLAGSNEW(GALILEO, L5B,  L7)
-    CHECKFLAGSNEW(GALILEO, D5B,  D7)
-    CHECKFLAGSNEW(GALILEO, S5B,  S7)
-    CHECKFLAGSNEW(GALILEO, C5AB, C8)
-    CHECKFLAGSNEW(GALILEO, L5AB, L8)
-    CHECKFLAGSNEW(GALILEO, D5AB, D8)
-    CHECKFLAGSNEW(GALILEO, S5AB, S8)
-
-    if(modified)
+    break;
+  case 1043:
+    if(size == 29 && handle->GPSWeek)
     {
-      if(hdata)
-        hdata->data.named.typesofobsE = buffer;
-      i = 1+snprintf(buffer, buffersize,
-      "E  %3d%-52.52s  SYS / # / OBS TYPES",
-      Parser->info[RTCM3_MSM_GALILEO].numtypes, Parser->fieldbufferGALILEO);
-      if(Parser->info[RTCM3_MSM_GALILEO].numtypes>13)
+      struct sbasephemeris *gs;
+      int sv, i, time, tod, day;
+      gs = &handle->ephemerisSBAS;
+      memset(gs, 0, sizeof(*gs));
+
+      GETBITS(sv, 6)
+      gs->satellite = PRN_SBAS_START+sv;
+      GETBITS(gs->IODN, 8)
+      GETBITS(time, 13)
+      time <<= 4;
+      gs->GPSweek_TOE = handle->GPSWeek;
+      GETBITS(gs->URA, 4)
+      GETFLOATSIGN(gs->x_pos, 30, 0.08)
+      GETFLOATSIGN(gs->y_pos, 30, 0.08)
+      GETFLOATSIGN(gs->z_pos, 25, 0.4)
+      GETFLOATSIGN(gs->x_velocity, 17, 0.000625)
+      GETFLOATSIGN(gs->y_velocity, 17, 0.000625)
+      GETFLOATSIGN(gs->z_velocity, 18, 0.004)
+      GETFLOATSIGN(gs->x_acceleration, 10, 0.0000125)
+      GETFLOATSIGN(gs->y_acceleration, 10, 0.0000125)
+      GETFLOATSIGN(gs->z_acceleration, 10, 0.0000625)
+      GETFLOATSIGN(gs->agf0, 12, 1.0/(1<<30)/(1<<1))
+      GETFLOATSIGN(gs->agf1, 8, 1.0/(1<<30)/(1<<10))
+
+      /* calculate time */
+      tod = handle->GPSTOW%(24*60*60);
+      day = handle->GPSTOW/(24*60*60);
+      if(time > 19*60*60 && tod < 5*60*60)
+        --day;
+      else if(time < 5*60*60 && tod > 19*60*60)
+        ++day;
+      time += day*24*60*60;
+      if(time > 7*24*60*60)
+        ++gs->GPSweek_TOE;
+      else if(time < 0)
+        --gs->GPSweek_TOE;
+      gs->TOE = time;
+
+      i = (gs->GPSweek_TOE - handle->GPSWeek)*7*24*60*60
+      + (gs->TOE - handle->GPSTOW) - 2*60*60;
+      if(i > 5*60*60 && i < 8*60*60)
       {
-        i += snprintf(buffer+i-1, buffersize,
-        "\n      %-52.52s  SYS / # / OBS TYPES", Parser->fieldbufferGALILEO+13*4);
+        handle->GPSTOW = gs->TOE;
+        handle->GPSWeek = gs->GPSweek_TOE;
       }
-      buffer += i; buffersize -= i;
+      gs->TOW = 0.9999E9;
+      ret = 1043;
     }
-
-    INITFLAGS(BDS)
-    CHECKFLAGSNEW(BDS, CB1,  C2I)
-    CHECKFLAGSNEW(BDS, LB1,  L2I)
-    CHECKFLAGSNEW(BDS, DB1,  D2I)
-    CHECKFLAGSNEW(BDS, SB1,  S2I)
-    CHECKFLAGSNEW(BDS, CB2,  C7I)
-    CHECKFLAGSNEW(BDS, LB2,  L7I)
-    CHECKFLAGSNEW(BDS, DB2,  D7I)
-    CHECKFLAGSNEW(BDS, SB2,  S7I)
-    CHECKFLAGSNEW(BDS, CB3,  C6I)
-    CHECKFLAGSNEW(BDS, LB3,  L6I)
-    CHECKFLAGSNEW(BDS, DB3,  D6I)
-    CHECKFLAGSNEW(BDS, SB3,  S6I)
-
-    if(modified)
+    break;
+  case 1044:
+    if(size == 61)
     {
-      if(hdata)
-        hdata->data.named.typesofobsC = buffer;
-      i = 1+snprintf(buffer, buffersize,
-      "C  %3d%-52.52s  SYS / # / OBS TYPES",
-      Parser->info[RTCM3_MSM_BDS].numtypes, Parser->fieldbufferBDS);
-      if(Parser->info[RTCM3_MSM_BDS].numtypes>13)
+      struct gpsephemeris *ge;
+      int sv, i;
+
+      ge = &handle->ephemerisGPS;
+      memset(ge, 0, sizeof(*ge));
+
+      GETBITS(sv, 4)
+      ge->satellite = PRN_QZSS_START+sv-1;
+      GETBITS(ge->TOC, 16)
+      ge->TOC <<= 4;
+      GETFLOATSIGN(ge->clock_driftrate, 8, 1.0/(double)(1<<30)/(double)(1<<25))
+      GETFLOATSIGN(ge->clock_drift, 16, 1.0/(double)(1<<30)/(double)(1<<13))
+      GETFLOATSIGN(ge->clock_bias, 22, 1.0/(double)(1<<30)/(double)(1<<1))
+      GETBITS(ge->IODE, 8)
+      GETFLOATSIGN(ge->Crs, 16, 1.0/(double)(1<<5))
+      GETFLOATSIGN(ge->Delta_n, 16, R2R_PI/(double)(1<<30)/(double)(1<<13))
+      GETFLOATSIGN(ge->M0, 32, R2R_PI/(double)(1<<30)/(double)(1<<1))
+      GETFLOATSIGN(ge->Cuc, 16, 1.0/(double)(1<<29))
+      GETFLOAT(ge->e, 32, 1.0/(double)(1<<30)/(double)(1<<3))
+      GETFLOATSIGN(ge->Cus, 16, 1.0/(double)(1<<29))
+      GETFLOAT(ge->sqrt_A, 32, 1.0/(double)(1<<19))
+      GETBITS(ge->TOE, 16)
+      ge->TOE <<= 4;
+      GETFLOATSIGN(ge->Cic, 16, 1.0/(double)(1<<29))
+      GETFLOATSIGN(ge->OMEGA0, 32, R2R_PI/(double)(1<<30)/(double)(1<<1))
+      GETFLOATSIGN(ge->Cis, 16, 1.0/(double)(1<<29))
+      GETFLOATSIGN(ge->i0, 32, R2R_PI/(double)(1<<30)/(double)(1<<1))
+      GETFLOATSIGN(ge->Crc, 16, 1.0/(double)(1<<5))
+      GETFLOATSIGN(ge->omega, 32, R2R_PI/(double)(1<<30)/(double)(1<<1))
+      GETFLOATSIGN(ge->OMEGADOT, 24, R2R_PI/(double)(1<<30)/(double)(1<<13))
+      GETFLOATSIGN(ge->IDOT, 14, R2R_PI/(double)(1<<30)/(double)(1<<13))
+      GETBITS(sv, 2)
+      if(sv & 1)
+        ge->flags |= GPSEPHF_L2PCODE;
+      if(sv & 2)
+        ge->flags |= GPSEPHF_L2CACODE;
+      GETBITS(ge->GPSweek, 10)
+      ge->GPSweek += 1024;
+      GETBITS(ge->URAindex, 4)
+      GETBITS(ge->SVhealth, 6)
+      GETFLOATSIGN(ge->TGD, 8, 1.0/(double)(1<<30)/(double)(1<<1))
+      GETBITS(ge->IODC, 10)
+      GETBITS(sv, 1)
+      if(sv)
+        ge->flags |= GPSEPHF_6HOURSFIT;
+
+      i = ((int)ge->GPSweek - (int)handle->GPSWeek)*7*24*60*60
+      + ((int)ge->TOE - (int)handle->GPSTOW) - 2*60*60;
+      if(i > 5*60*60 && i < 8*60*60)
       {
-        i += snprintf(buffer+i-1, buffersize,
-        "\n      %-52.52s  SYS / # / OBS TYPES", Parser->fieldbufferBDS+13*4);
+        handle->GPSTOW = ge->TOE;
+        handle->GPSWeek = ge->GPSweek;
       }
-      buffer += i; buffersize -= i;
+      ge->TOW = 0.9999E9;
+      ret = 1044;
     }
-
-    INITFLAGS(QZSS)
-
-    CHECKFLAGSNEW(QZSS, C1,  C1C)
-    CHECKFLAGSNEW(QZSS, L1C, L1C)
-    CHECKFLAGSNEW(QZSS, D1C, D1C)
-    CHECKFLAGSNEW(QZSS, S1C, S1C)
-
-    CHECKFLAGSNEW(QZSS, CSAIF, C1Z)
-    CHECKFLAGSNEW(QZSS, LSAIF, L1Z)
-    CHECKFLAGSNEW(QZSS, DSAIF, D1Z)
-    CHECKFLAGSNEW(QZSS, SSAIF, S1Z)
-
-    CHECKFLAGSNEW(QZSS, C1N, C1)
-    CHECKFLAGSNEW(QZSS, L1N, L1)
-    CHECKFLAGSNEW(QZSS, D1N, D1)
-    CHECKFLAGSNEW(QZSS, S1N, S1)
-
-    CHECKFLAGSNEW(QZSS, C6, C6)
-    CHECKFLAGSNEW(QZSS, L6, L6)
-    CHECKFLAGSNEW(QZSS, D6, D6)
-    CHECKFLAGSNEW(QZSS, S6, S6)
-
-    CHECKFLAGSNEW(QZSS, C2,  C2)
-    CHECKFLAGSNEW(QZSS, L2C, L2)
-    CHECKFLAGSNEW(QZSS, D2C, D2)
-    CHECKFLAGSNEW(QZSS, S2C, S2)
-
-    CHECKFLAGSNEW(QZSS, C5,  C5)
-    CHECKFLAGSNEW(QZSS, L5,  L5)
-    CHECKFLAGSNEW(QZSS, D5,  D5)
-    CHECKFLAGSNEW(QZSS, S5,  S5)
-
-    if(modified)
+    break;
+  case 1045: case 1046:
     {
-      if(hdata)
-        hdata->data.named.typesofobsJ = buffer;
-      i = 1+snprintf(buffer, buffersize,
-      "J  %3d%-52.52s  SYS / # / OBS TYPES",
-      Parser->info[RTCM3_MSM_QZSS].numtypes, Parser->fieldbufferQZSS);
-      if(Parser->info[RTCM3_MSM_QZSS].numtypes>13)
+      struct galileoephemeris *ge;
+      int sv;
+
+      ge = &handle->ephemerisGALILEO;
+      memset(ge, 0, sizeof(*ge));
+
+      GETBITS(sv, 6)
+      ge->satellite = sv;
+      GETBITS(ge->Week, 12)
+      ge->Week += 1024;
+      GETBITS(ge->IODnav, 10)
+      GETBITS(ge->SISA, 8)
+      GETFLOATSIGN(ge->IDOT, 14, R2R_PI/(double)(1<<30)/(double)(1<<13))
+      GETBITSFACTOR(ge->TOC, 14, 60)
+      GETFLOATSIGN(ge->clock_driftrate, 6, 1.0/(double)(1<<30)/(double)(1<<29))
+      GETFLOATSIGN(ge->clock_drift, 21, 1.0/(double)(1<<30)/(double)(1<<16))
+      GETFLOATSIGN(ge->clock_bias, 31, 1.0/(double)(1<<30)/(double)(1<<4))
+      GETFLOATSIGN(ge->Crs, 16, 1.0/(double)(1<<5))
+      GETFLOATSIGN(ge->Delta_n, 16, R2R_PI/(double)(1<<30)/(double)(1<<13))
+      GETFLOATSIGN(ge->M0, 32, R2R_PI/(double)(1<<30)/(double)(1<<1))
+      GETFLOATSIGN(ge->Cuc, 16, 1.0/(double)(1<<29))
+      GETFLOAT(ge->e, 32, 1.0/(double)(1<<30)/(double)(1<<3))
+      GETFLOATSIGN(ge->Cus, 16, 1.0/(double)(1<<29))
+      GETFLOAT(ge->sqrt_A, 32, 1.0/(double)(1<<19))
+      GETBITSFACTOR(ge->TOE, 14, 60)
+      GETFLOATSIGN(ge->Cic, 16, 1.0/(double)(1<<29))
+      GETFLOATSIGN(ge->OMEGA0, 32, R2R_PI/(double)(1<<30)/(double)(1<<1))
+      GETFLOATSIGN(ge->Cis, 16, 1.0/(double)(1<<29))
+      GETFLOATSIGN(ge->i0, 32, R2R_PI/(double)(1<<30)/(double)(1<<1))
+      GETFLOATSIGN(ge->Crc, 16, 1.0/(double)(1<<5))
+      GETFLOATSIGN(ge->omega, 32, R2R_PI/(double)(1<<30)/(double)(1<<1))
+      GETFLOATSIGN(ge->OMEGADOT, 24, R2R_PI/(double)(1<<30)/(double)(1<<13))
+      GETFLOATSIGN(ge->BGD_1_5A, 10, 1.0/(double)(1<<30)/(double)(1<<2))
+      if(type == 1046)
       {
-        i += snprintf(buffer+i-1, buffersize,
-        "\n      %-52.52s  SYS / # / OBS TYPES", Parser->fieldbufferQZSS+13*4);
+        GETFLOATSIGN(ge->BGD_1_5B, 10, 1.0/(double)(1<<30)/(double)(1<<2))
+        GETBITS(ge->E5bHS, 2)
+        GETBITS(sv, 1)
+        ge->flags |= GALEPHF_INAV;
+        if(sv)
+          ge->flags |= GALEPHF_E5BDINVALID;
+        GETBITS(ge->E1_HS, 2)
+        GETBITS(sv, 1)
+        if(sv)
+          ge->flags |= GALEPHF_E1DINVALID;
       }
-      buffer += i; buffersize -= i;
+      else
+      {
+        ge->flags |= GALEPHF_FNAV;
+        GETBITS(ge->E5aHS, 2)
+        GETBITS(sv, 1)
+        if(sv)
+          ge->flags |= GALEPHF_E5ADINVALID;
+      }
+      ret = type;
     }
-  }
-  else
-  {
-#define CHECKFLAGS(a, b) \
-    if(flags & GNSSDF_##a##DATA) \
-    { \
-      if(Parser->datafields[RINEXENTRY_##b##DATA]) \
-      { \
-        Parser->info[RTCM3_MSM_GPS].flags[Parser->datafields[\
-        RINEXENTRY_##b##DATA]-1] = GNSSDF_##a##DATA; \
-        Parser->info[RTCM3_MSM_GPS].pos[Parser->datafields[\
-        RINEXENTRY_##b##DATA]-1] = GNSSENTRY_##a##DATA; \
-      } \
-      else \
-      { \
-        Parser->flags[Parser->info[RTCM3_MSM_GPS].numtypes] = GNSSDF_##a##DATA; \
-        Parser->pos[Parser->info[RTCM3_MSM_GPS].numtypes] = GNSSENTRY_##a##DATA; \
-        Parser->datafields[RINEXENTRY_##b##DATA] = \
-        ++Parser->info[RTCM3_MSM_GPS].numtypes; \
-        snprintf(Parser->fieldbuffer+6*Parser->numdatafields, \
-        sizeof(Parser->fieldbuffer)-6*Parser->numdatafields, "    "#b); \
-        ++Parser->numdatafields; \
-        ++modified; \
-      } \
+    break;
+  case 1020:
+    if(size == 45)
+    {
+      struct glonassephemeris *ge;
+      int i;
+
+      ge = &handle->ephemerisGLONASS;
+      memset(ge, 0, sizeof(*ge));
+
+      ge->flags |= GLOEPHF_PAVAILABLE;
+      GETBITS(ge->almanac_number, 6)
+      GETBITS(i, 5)
+      ge->frequency_number = i-7;
+      if(ge->almanac_number >= 1 && ge->almanac_number <= PRN_GLONASS_NUM)
+        handle->GLOFreq[ge->almanac_number-1] = 100+ge->frequency_number;
+      GETBITS(i, 1)
+      if(i)
+        ge->flags |= GLOEPHF_ALMANACHEALTHY;
+      GETBITS(i, 1)
+      if(i)
+        ge->flags |= GLOEPHF_ALMANACHEALTHOK;
+      GETBITS(i, 2)
+      if(i & 1)
+        ge->flags |= GLOEPHF_P10TRUE;
+      if(i & 2)
+        ge->flags |= GLOEPHF_P11TRUE;
+      GETBITS(i, 5)
+      ge->tk = i*60*60;
+      GETBITS(i, 6)
+      ge->tk += i*60;
+      GETBITS(i, 1)
+      ge->tk += i*30;
+      GETBITS(i, 1)
+      if(i)
+        ge->flags |= GLOEPHF_UNHEALTHY;
+      GETBITS(i, 1)
+      if(i)
+        ge->flags |= GLOEPHF_P2TRUE;
+      GETBITS(i, 7)
+      ge->tb = i*15*60;
+      GETFLOATSIGNM(ge->x_velocity, 24, 1.0/(double)(1<<20))
+      GETFLOATSIGNM(ge->x_pos, 27, 1.0/(double)(1<<11))
+      GETFLOATSIGNM(ge->x_acceleration, 5, 1.0/(double)(1<<30))
+      GETFLOATSIGNM(ge->y_velocity, 24, 1.0/(double)(1<<20))
+      GETFLOATSIGNM(ge->y_pos, 27, 1.0/(double)(1<<11))
+      GETFLOATSIGNM(ge->y_acceleration, 5, 1.0/(double)(1<<30))
+      GETFLOATSIGNM(ge->z_velocity, 24, 1.0/(double)(1<<20))
+      GETFLOATSIGNM(ge->z_pos, 27, 1.0/(double)(1<<11))
+      GETFLOATSIGNM(ge->z_acceleration, 5, 1.0/(double)(1<<30))
+      GETBITS(i, 1)
+      if(i)
+        ge->flags |= GLOEPHF_P3TRUE;
+      GETFLOATSIGNM(ge->gamma, 11, 1.0/(double)(1<<30)/(double)(1<<10))
+      SKIPBITS(3) /* GLONASS-M P, GLONASS-M ln (third string) */
+      GETFLOATSIGNM(ge->tau, 22, 1.0/(double)(1<<30)) /* GLONASS tau n(tb) */
+      SKIPBITS(5) /* GLONASS-M delta tau n(tb) */
+      GETBITS(ge->E, 5)
+      /* GETBITS(b, 1) / * GLONASS-M P4 */
+      /* GETBITS(b, 4) / * GLONASS-M Ft */
+      /* GETBITS(b, 11) / * GLONASS-M Nt */
+      /* GETBITS(b, 2) / * GLONASS-M M */
+      /* GETBITS(b, 1) / * GLONASS-M The Availability of Additional Data */
+      /* GETBITS(b, 11) / * GLONASS-M Na */
+      /* GETFLOATSIGNM(b, 32, 1.0/(double)(1<<30)/(double)(1<<1)) / * GLONASS tau c */
+      /* GETBITS(b, 5) / * GLONASS-M N4 */
+      /* GETFLOATSIGNM(b, 22, 1.0/(double)(1<<30)) / * GLONASS-M tau GPS */
+      /* GETBITS(b, 1) / * GLONASS-M ln (fifth string) */
+      ge->GPSWeek = handle->GPSWeek;
+      ge->GPSTOW = handle->GPSTOW;
+      ret = 1020;
     }
+    break;
+  case 1001: case 1002: case 1003: case 1004:
+    if(handle->GPSWeek)
+    {
+      int lastlockl1[64];
+      int lastlockl2[64];
+      struct gnssdata *gnss;
+      int i, numsats, wasamb=0, resolved = -1, satbits, k = 0;
+      int ambs[32];
+
+      for(i = 0; i < 64; ++i)
+        lastlockl1[i] = lastlockl2[i] = 0;
+
+      gnss = handle->DataNew;
+
+      SKIPBITS(12) /* id */
+      GETBITS(i,30)
+      if(i/1000 < (int)handle->GPSTOW - 86400)
+        ++handle->GPSWeek;
+      handle->GPSTOW = i/1000;
+      if(gnss->week && (gnss->timeofweek != i || gnss->week
+      != handle->GPSWeek))
+      {
+        gnss = NewEpoch(handle);
+        old = 1;
+      }
+      gnss->timeofweek = i;
+      gnss->week = handle->GPSWeek;
 
-    int flags = Parser->startflags;
-    for(i = 0; i < Parser->Data.numsats; ++i)
-      flags |= Parser->Data.dataflags[i];
+      GETBITS(syncf,1) /* sync */
+      GETBITS(numsats,5)
+      SKIPBITS(4) /* smind, smint */
 
-    CHECKFLAGS(C1,C1)
-    CHECKFLAGS(C2,C2)
-    CHECKFLAGS(P1,P1)
-    CHECKFLAGS(P2,P2)
-    CHECKFLAGS(L1C,L1)
-    CHECKFLAGS(L1P,L1)
-    CHECKFLAGS(L2C,L2)
-    CHECKFLAGS(L2P,L2)
-    CHECKFLAGS(D1C,D1)
-    CHECKFLAGS(D1P,D1)
-    CHECKFLAGS(D2C,D2)
-    CHECKFLAGS(D2P,D2)
-    CHECKFLAGS(S1C,S1)
-    CHECKFLAGS(S1P,S1)
-    CHECKFLAGS(S2C,S2)
-    CHECKFLAGS(S2P,S2)
-    CHECKFLAGS(C5,C5)
-    CHECKFLAGS(L5,L5)
-    CHECKFLAGS(D5,D5)
-    CHECKFLAGS(S5,S5)
-    CHECKFLAGS(C5AB,C8)
-    CHECKFLAGS(L5AB,L8)
-    CHECKFLAGS(D5AB,D8)
-    CHECKFLAGS(S5AB,S8)
-    CHECKFLAGS(C5B,C7)
-    CHECKFLAGS(L5B,L7)
-    CHECKFLAGS(D5B,D7)
-    CHECKFLAGS(S5B,S7)
-    CHECKFLAGS(C6,C6)
-    CHECKFLAGS(L6,L6)
-    CHECKFLAGS(D6,D6)
-    CHECKFLAGS(S6,S6)
-    /* Skip C1N and SAIF for RINEX2! */
+      satbits = type == 1001 ? 58 : type == 1002 ? 74 : type == 1003 ? 101
+      : 125;
+      if(type == 1001 || type == 1003) /* no ambiguity field */
+      {
+        struct BitReader scan = *br;
+        int sats[32] = {0}, prn[32] = {0};
+        double range[32] = {0};
 
-    if(hdata)
-      hdata->data.named.typesofobs = buffer;
-    if(modified)
-    {
-      i = 1+snprintf(buffer, buffersize,
-      "%6d%-54.54s# / TYPES OF OBSERV", Parser->info[RTCM3_MSM_GPS].numtypes,
-      Parser->fieldbuffer);
-      if(Parser->info[RTCM3_MSM_GPS].numtypes>9)
+        for(i = 0; i < numsats; ++i)
+        {
+          scan.pos = br->pos+i*satbits;
+          prn[i] = BitsGet(&scan, 6);
+          sats[i] = prn[i] < 40 ? RTCM3_MSM_GPS : RTCM3_MSM_SBAS;
+          if(prn[i] >= 40)
+            prn[i] -= 20; /* S20 is PRN 120 */
+          scan.pos += 1;
+          range[i] = BitsGet(&scan, 24)*0.02;
+        }
+        resolved = ResolveAmbiguity(handle, gnss->week,
+        gnss->timeofweek/1000.0, numsats, sats, prn, range, 299792.458, ambs);
+      }
+
+      while(numsats-- && gnss->numsats < GNSS_MAXSATS)
       {
-        i += snprintf(buffer+i-1, buffersize,
-        "\n      %-54.54s# / TYPES OF OBSERV", Parser->fieldbuffer+9*6);
+        int sv, code, l1range, l1phase, ce,le,se,amb=0;
+        int fullsat, num, cx;
+        const char *ct;
+
+        GETBITS(sv, 6)
+        if(resolved >= 0 && (amb = ambs[k++]) < 0)
+        { /* ambiguity not restored, skip the satellite */
+          lastlockl1[sv] = handle->lastlockGPSl1[sv];
+          lastlockl2[sv] = handle->lastlockGPSl2[sv];
+          SKIPBITS(satbits-6)
+          continue;
+        }
+        fullsat = sv < 40 ? sv : sv+80;
+        num = GetSatIndex(gnss, fullsat);
+
+        /* L1 */
+        GETBITS(code, 1);
+        if(code)
+        {
+          ce = GNSSENTRY_P1DATA;
+          le = GNSSENTRY_L1PDATA;
+          se = GNSSENTRY_S1PDATA;
+          ct = "1W";
+        }
+        else
+        {
+          ce = GNSSENTRY_C1DATA;
+          le = GNSSENTRY_L1CDATA;
+          se = GNSSENTRY_S1CDATA;
+          ct = "1C";
+        }
+        if(!handle->info[RTCM3_MSM_GPS].type[ce])
+        {
+          handle->info[RTCM3_MSM_GPS].type[ce] = 
+          handle->info[RTCM3_MSM_GPS].type[le] = 
+          handle->info[RTCM3_MSM_GPS].type[se] = ct[1];
+        }
+        cx = CODEINDEX(ct);
+        GETBITS(l1range, 24);
+        GETBITSSIGN(l1phase, 20);
+        GETBITS(i, 7);
+        lastlockl1[sv] = i;
+        if(handle->lastlockGPSl1[sv] > i || i == 0)
+          gnss->dataflags2[num] |= GNSSDF2_LOCKLOSSL1;
+        if(type == 1002 || type == 1004)
+        {
+          GETBITS(amb,8);
+          GETBITS(i, 8);
+          if(i)
+          {
+            SetObs(gnss, num, se, cx, i*0.25);
+            i /= 4*4;
+            if(i > 9) i = 9;
+            else if(i < 1) i = 1;
+            gnss->snrL1[num] = i;
+          }
+        }
+        if((l1phase&((1<<20)-1)) != 0x80000)
+        {
+          SetObs(gnss, num, ce, cx, l1range*0.02
+          +amb*299792.458);
+          SetObs(gnss, num, le, cx, (l1range*0.02+l1phase*0.0005
+          +amb*299792.458)/GPS_WAVELENGTH_L1);
+          if(amb)
+            ++wasamb;
+        }
+        if(type == 1003 || type == 1004)
+        {
+          /* L2 */
+          GETBITS(code,2);
+          if(code)
+          {
+            ce = GNSSENTRY_P2DATA;
+            le = GNSSENTRY_L2PDATA;
+            se = GNSSENTRY_S2PDATA;
+            if(code >= 2)
+            {
+              ct = "2W";
+              gnss->dataflags2[num] |= GNSSDF2_XCORRL2;
+            }
+            else
+              ct = "2P";
+          }
+          else
+          {
+            ce = GNSSENTRY_C2DATA;
+            le = GNSSENTRY_L2CDATA;
+            se = GNSSENTRY_S2CDATA;
+            ct = "2 ";
+          }
+          if(!handle->info[RTCM3_MSM_GPS].type[ce])
+          {
+            handle->info[RTCM3_MSM_GPS].type[ce] = 
+            handle->info[RTCM3_MSM_GPS].type[le] = 
+            handle->info[RTCM3_MSM_GPS].type[se] = ct[1];
+          }
+          cx = CODEINDEX(ct);
+          GETBITSSIGN(i,14);
+          if((i&((1<<14)-1)) != 0x2000)
+          {
+            SetObs(gnss, num, ce, cx, l1range*0.02+i*0.02
+            +amb*299792.458);
+          }
+          GETBITSSIGN(i,20);
+          if((i&((1<<20)-1)) != 0x80000)
+          {
+            SetObs(gnss, num, le, cx, (l1range*0.02+i*0.0005
+            +amb*299792.458)/GPS_WAVELENGTH_L2);
+          }
+          GETBITS(i,7);
+          lastlockl2[sv] = i;
+          if(handle->lastlockGPSl2[sv] > i || i == 0)
+            gnss->dataflags2[num] |= GNSSDF2_LOCKLOSSL2;
+          if(type == 1004)
+          {
+            GETBITS(i, 8);
+            if(i)
+            {
+              SetObs(gnss, num, se, cx, i*0.25);
+              i /= 4*4;
+              if(i > 9) i = 9;
+              else if(i < 1) i = 1;
+              gnss->snrL2[num] = i;
+            }
+          }
+        }
       }
-      if(Parser->info[RTCM3_MSM_GPS].numtypes>18)
+      for(i = 0; i < 64; ++i)
       {
-        i += snprintf(buffer+i-1, buffersize,
-        "\n      %-54.54s# / TYPES OF OBSERV", Parser->fieldbuffer+18*6);
+        handle->lastlockGPSl1[i] = lastlockl1[i];
+        handle->lastlockGPSl2[i] = lastlockl2[i];
+      }
+      if(!syncf && !old)
+      {
+        NewEpoch(handle);
+      }
+      if(!syncf || old)
+      {
+        if(wasamb || resolved >= 0) /* not RINEX compatible without */
+          ret = 1;
+        else
+          ret = 2;
       }
-      buffer += i; buffersize -= i;
-    }
-  }
-  return buffersizeold - buffersize;
-}
-
-void HandleHeader(struct RTCM3ParserData *Parser)
-{
 #ifdef NO_RTCM3_MAIN
-  int flags, modified = 0;
-  if(Parser->allflags == 0)
-    Parser->allflags = ~0;
-  flags = Parser->allflags;
-  if(Parser->rinex3)
-  {
-    struct HeaderData *hdata = 0;
-    CHECKFLAGSNEW(GPS, C1,  C1C)
-    CHECKFLAGSNEW(GPS, L1C, L1C)
-    CHECKFLAGSNEW(GPS, D1C, D1C)
-    CHECKFLAGSNEW(GPS, S1C, S1C)
-    CHECKFLAGSNEW(GPS, P1,  C1P)
-    CHECKFLAGSNEW(GPS, L1P, L1P)
-    CHECKFLAGSNEW(GPS, D1P, D1P)
-    CHECKFLAGSNEW(GPS, S1P, S1P)
-    CHECKFLAGSNEW(GPS, P2,  C2P)
-    CHECKFLAGSNEW(GPS, L2P, L2P)
-    CHECKFLAGSNEW(GPS, D2P, D2P)
-    CHECKFLAGSNEW(GPS, S2P, S2P)
-    CHECKFLAGSNEW(GPS, C2,  C2X)
-    CHECKFLAGSNEW(GPS, L2C, L2X)
-    CHECKFLAGSNEW(GPS, D2C, D2X)
-    CHECKFLAGSNEW(GPS, S2C, S2X)
-    CHECKFLAGSNEW(GLONASS, C1,  C1C)
-    CHECKFLAGSNEW(GLONASS, L1C, L1C)
-    CHECKFLAGSNEW(GLONASS, D1C, D1C)
-    CHECKFLAGSNEW(GLONASS, S1C, S1C)
-    CHECKFLAGSNEW(GLONASS, P1,  C1P)
-    CHECKFLAGSNEW(GLONASS, L1P, L1P)
-    CHECKFLAGSNEW(GLONASS, D1P, D1P)
-    CHECKFLAGSNEW(GLONASS, S1P, S1P)
-    CHECKFLAGSNEW(GLONASS, P2,  C2P)
-    CHECKFLAGSNEW(GLONASS, L2P, L2P)
-    CHECKFLAGSNEW(GLONASS, D2P, D2P)
-    CHECKFLAGSNEW(GLONASS, S2P, S2P)
-    CHECKFLAGSNEW(GLONASS, C2,  C2C)
-    CHECKFLAGSNEW(GLONASS, L2C, L2C)
-    CHECKFLAGSNEW(GLONASS, D2C, D2C)
-    CHECKFLAGSNEW(GLONASS, S2C, S2C)
-  }
-  else
-  {
-    CHECKFLAGS(C1,C1)
-    CHECKFLAGS(C2,C2)
-    CHECKFLAGS(P1,P1)
-    CHECKFLAGS(P2,P2)
-    CHECKFLAGS(L1C,L1)
-    CHECKFLAGS(L1P,L1)
-    CHECKFLAGS(L2C,L2)
-    CHECKFLAGS(L2P,L2)
-    CHECKFLAGS(D1C,D1)
-    CHECKFLAGS(D1P,D1)
-    CHECKFLAGS(D2C,D2)
-    CHECKFLAGS(D2P,D2)
-    CHECKFLAGS(S1C,S1)
-    CHECKFLAGS(S1P,S1)
-    CHECKFLAGS(S2C,S2)
-    CHECKFLAGS(S2P,S2)
-    CHECKFLAGS(C5,C5)
-    CHECKFLAGS(L5,L5)
-    CHECKFLAGS(D5,D5)
-    CHECKFLAGS(S5,S5)
-    CHECKFLAGS(C5AB,C8)
-    CHECKFLAGS(L5AB,L8)
-    CHECKFLAGS(D5AB,D8)
-    CHECKFLAGS(S5AB,S8)
-    CHECKFLAGS(C5B,C7)
-    CHECKFLAGS(L5B,L7)
-    CHECKFLAGS(D5B,D7)
-    CHECKFLAGS(S5B,S7)
-    CHECKFLAGS(C6,C6)
-    CHECKFLAGS(L6,L6)
-    CHECKFLAGS(D6,D6)
-    CHECKFLAGS(S6,S6)
-  }
-#else /* NO_RTCM3_MAIN */
-  struct HeaderData hdata;
-  char thebuffer[MAXHEADERBUFFERSIZE];
-  char *buffer = thebuffer;
-  size_t buffersize = sizeof(thebuffer);
-  int i;
-
-  memset(&hdata, 0, sizeof(hdata));
+      else
+        ret = type;
+#endif /* NO_RTCM3_MAIN */
+    }
+    break;
+  case 1009: case 1010: case 1011: case 1012:
+    {
+      int lastlockl1[64];
+      int lastlockl2[64];
+      struct gnssdata *gnss;
+      int i, numsats;
+      int wasamb=0, resolved = -1, satbits, k = 0;
+      int ambs[32];
 
-  hdata.data.named.version = buffer;
-  i = 1+snprintf(buffer, buffersize,
-  "%9.2f           OBSERVATION DATA    M (Mixed)"
-  "           RINEX VERSION / TYPE", Parser->rinex3 ? 3.0 : 2.11);
-  buffer += i; buffersize -= i;
+      for(i = 0; i < 64; ++i)
+        lastlockl1[i] = lastlockl2[i] = 0;
 
-  {
-    const char *str;
-    hdata.data.named.pgm = buffer;
-    i = HandleRunBy(buffer, buffersize, &str, Parser->rinex3);
-    buffer += i; buffersize -= i;
-    hdata.data.named.observer = buffer;
-    i = 1+snprintf(buffer, buffersize,
-    "%-20.20s                                        "
-    "OBSERVER / AGENCY", str);
-    buffer += i; buffersize -= i;
-  }
+      gnss = handle->DataNew;
 
-  hdata.data.named.marker =
-  "RTCM3TORINEX                                                "
-  "MARKER NAME";
+      SKIPBITS(12) /* id */;
+      GETBITS(i,27) /* tk */
 
-  hdata.data.named.markertype =  !Parser->rinex3 ? 0 :
-  "GEODETIC                                                    "
-  "MARKER TYPE";
+      updatetime(&handle->GPSWeek, &handle->GPSTOW, i, 0); /* Moscow -> GPS */
+      i = handle->GPSTOW*1000;
+      if(gnss->week && (gnss->timeofweek != i || gnss->week
+      != handle->GPSWeek))
+      {
+        gnss = NewEpoch(handle);
+        old = 1;
+      }
 
-  hdata.data.named.receiver =
-  "                                                            "
-  "REC # / TYPE / VERS";
+      gnss->timeofweek = i;
+      gnss->week = handle->GPSWeek;
 
-  hdata.data.named.antenna =
-  "                                                            "
-  "ANT # / TYPE";
+      GETBITS(syncf,1) /* sync */
+      GETBITS(numsats,5)
 
-  hdata.data.named.position =
-  "         .0000         .0000         .0000                  "
-  "APPROX POSITION XYZ";
+      SKIPBITS(4) /* smind, smint */
 
-  hdata.data.named.antennaposition =
-  "         .0000         .0000         .0000                  "
-  "ANTENNA: DELTA H/E/N";
+      satbits = type == 1009 ? 64 : type == 1010 ? 79 : type == 1011 ? 107
+      : 130;
+      if(type == 1009 || type == 1011) /* no ambiguity field */
+      {
+        struct BitReader scan = *br;
+        int sats[32] = {0}, prn[32] = {0};
+        double range[32] = {0};
 
-  hdata.data.named.wavelength = Parser->rinex3 ? 0 :
-  "     1     1                                                "
-  "WAVELENGTH FACT L1/2";
+        for(i = 0; i < numsats; ++i)
+        {
+          scan.pos = br->pos+i*satbits;
+          prn[i] = BitsGet(&scan, 6);
+          sats[i] = RTCM3_MSM_GLONASS;
+          scan.pos += 1+5;
+          range[i] = BitsGet(&scan, 25)*0.02;
+        }
+        resolved = ResolveAmbiguity(handle, gnss->week,
+        gnss->timeofweek/1000.0, numsats, sats, prn, range, 599584.916, ambs);
+      }
 
-  hdata.numheaders = 18;
+      while(numsats-- && gnss->numsats < GNSS_MAXSATS)
+      {
+        int sv, code, l1range, l1phase, ce,le,se,amb=0;
+        int freq;
+        int fullsat, num, cx;
+        const char *ct;
 
-  i = HandleObsHeader(Parser, buffer, buffersize, &hdata);
-  buffer += i; buffersize -= i;
+        GETBITS(sv, 6)
+        if(resolved >= 0 && (amb = ambs[k++]) < 0)
+        { /* ambiguity not restored, skip the satellite */
+          lastlockl1[sv] = handle->lastlockGLOl1[sv];
+          lastlockl2[sv] = handle->lastlockGLOl2[sv];
+          SKIPBITS(satbits-6)
+          continue;
+        }
+        fullsat = sv-1 + PRN_GLONASS_START;
+        num = GetSatIndex(gnss, fullsat);
 
-  {
-    struct converttimeinfo cti;
-    converttime(&cti, Parser->Data.week,
-    (int)floor(Parser->Data.timeofweek/1000.0));
-    hdata.data.named.timeoffirstobs = buffer;
-    i = 1+snprintf(buffer, buffersize,
-    "  %4d    %2d    %2d    %2d    %2d   %10.7f     GPS         "
-    "TIME OF FIRST OBS", cti.year, cti.month, cti.day, cti.hour,
-    cti.minute, cti.second + fmod(Parser->Data.timeofweek/1000.0,1.0));
+        /* L1 */
+        GETBITS(code, 1)
+        GETBITS(freq, 5)
 
-    buffer += i; buffersize -= i;
-  }
+        if(sv >= 1 && sv <= PRN_GLONASS_NUM)
+          handle->GLOFreq[sv-1] = 100+freq-7;
 
-  if(Parser->headerfile)
-  {
-    FILE *fh;
-    if((fh = fopen(Parser->headerfile, "r")))
-    {
-      size_t siz;
-      char *lastblockstart;
-      if((siz = fread(buffer, 1, buffersize-1, fh)) > 0)
-      {
-        buffer[siz] = '\n';
-        if(siz == buffersize)
+        if(code)
         {
-          RTCM3Error("Header file is too large. Only %d bytes read.",
-          (int)siz);
+          ce = GNSSENTRY_P1DATA;
+          le = GNSSENTRY_L1PDATA;
+          se = GNSSENTRY_S1PDATA;
+          ct = "1P";
         }
-        /* scan the file line by line and enter the entries in the list */
-        /* warn for "# / TYPES OF OBSERV" and "TIME OF FIRST OBS" */
-        /* overwrites entries, except for comments */
-        lastblockstart = buffer;
-        for(i = 0; i < (int)siz; ++i)
+        else
         {
-          if(buffer[i] == '\n')
-          { /* we found a line */
-            char *end;
-            while(buffer[i+1] == '\r')
-              ++i; /* skip \r in case there are any */
-            end = buffer+i;
-            while(*end == '\t' || *end == ' ' || *end == '\r' || *end == '\n')
-              *(end--) = 0;
-            if(end-lastblockstart < 60+5) /* short line */
-              RTCM3Error("Short Header line '%s' ignored.\n", lastblockstart);
-            else
-            {
-              int pos;
-              if(!strcmp("COMMENT", lastblockstart+60))
-                pos = hdata.numheaders;
-              else
-              {
-                for(pos = 0; pos < hdata.numheaders; ++pos)
-                {
-                  if(hdata.data.unnamed[pos] &&
-                  !strcmp(hdata.data.unnamed[pos]+60, lastblockstart+60))
-                    break;
-                }
-                if(!strcmp("# / TYPES OF OBSERV", lastblockstart+60)
-                || !strcmp("SYS / # / OBS TYPES", lastblockstart+60)
-                || !strcmp("TIME OF FIRST OBS", lastblockstart+60))
-                {
-                  RTCM3Error("Overwriting header '%s' is dangerous.\n",
-                  lastblockstart+60);
-                }
-              }
-              if(pos >= MAXHEADERLINES)
-              {
-                RTCM3Error("Maximum number of header lines of %d reached.\n",
-                MAXHEADERLINES);
-              }
-              else if(!strcmp("END OF HEADER", lastblockstart+60))
-              {
-                RTCM3Error("End of header ignored.\n");
-              }
-              else
-              {
-                hdata.data.unnamed[pos] = lastblockstart;
-                if(pos == hdata.numheaders)
-                  ++hdata.numheaders;
-              }
-            }
-            lastblockstart = buffer+i+1;
-          }
+          ce = GNSSENTRY_C1DATA;
+          le = GNSSENTRY_L1CDATA;
+          se = GNSSENTRY_S1CDATA;
+          ct = "1C";
         }
-      }
-      else
-      {
-        RTCM3Error("Could not read data from headerfile '%s'.\n",
-        Parser->headerfile);
-      }
-      fclose(fh);
-    }
-    else
-    {
-      RTCM3Error("Could not open header datafile '%s'.\n",
-      Parser->headerfile);
-    }
-  }
-
-  for(i = 0; i < hdata.numheaders; ++i)
-  {
-    if(hdata.data.unnamed[i] && hdata.data.unnamed[i][0])
-      RTCM3Text("%s\n", hdata.data.unnamed[i]);
-  }
-  RTCM3Text("                                                            "
-  "END OF HEADER\n");
-#endif
-}
-
-static void ConvLine(FILE *file, const char *fmt, ...)
-{
-  char buffer[100], *b;
-  va_list v;
-  va_start(v, fmt);
-  vsnprintf(buffer, sizeof(buffer), fmt, v);
-  for(b = buffer; *b; ++b)
-  {
-    if(*b == 'e') *b = 'D';
-  }
-  fprintf(file, "%s", buffer);
-  va_end(v);
-}
-
-void HandleByte(struct RTCM3ParserData *Parser, unsigned int byte)
-{
-  Parser->Message[Parser->MessageSize++] = byte;
-  if(Parser->MessageSize >= Parser->NeedBytes)
-  {
-    int r;
-    while((r = RTCM3Parser(Parser)))
-    {
-      double ver = Parser->rinex3 ? 3.02 : 2.11;
-      if(r == 1020 || r == RTCM3ID_BDS || r == 1019 || r == 1044 || r == 1043)
-      {
-        FILE *file = 0;
-
-        if(Parser->mixedephemeris)
+        if(!handle->info[RTCM3_MSM_GLONASS].type[ce])
         {
-          if(Parser->mixedephemeris != (const char *)1)
-          {
-            if(!(Parser->mixedfile = fopen(Parser->mixedephemeris, "w")))
-            {
-              RTCM3Error("Could not open ephemeris output file.\n");
-            }
-            else
-            {
-              char buffer[100];
-              fprintf(Parser->mixedfile,
-              "%9.2f%11sN: GNSS NAV DATA    M: Mixed%12sRINEX VERSION / TYPE\n", ver, "", "");
-              HandleRunBy(buffer, sizeof(buffer), 0, Parser->rinex3);
-              fprintf(Parser->mixedfile, "%s\n%60sEND OF HEADER\n", buffer, "");
-            }
-            Parser->mixedephemeris = (const char *)1;
-          }
-          file = Parser->mixedfile;
+          handle->info[RTCM3_MSM_GLONASS].type[ce] = 
+          handle->info[RTCM3_MSM_GLONASS].type[le] = 
+          handle->info[RTCM3_MSM_GLONASS].type[se] = ct[1];
         }
-        else
+        cx = CODEINDEX(ct);
+        GETBITS(l1range, 25)
+        GETBITSSIGN(l1phase, 20)
+        GETBITS(i, 7)
+        lastlockl1[sv] = i;
+        if(handle->lastlockGLOl1[sv] > i || i == 0)
+          gnss->dataflags2[num] |= GNSSDF2_LOCKLOSSL1;
+        if(type == 1010 || type == 1012)
         {
-          if(r == 1020)
-          {
-            if(Parser->glonassephemeris)
-            {
-              if(!(Parser->glonassfile = fopen(Parser->glonassephemeris, "w")))
-              {
-                RTCM3Error("Could not open GLONASS ephemeris output file.\n");
-              }
-              else
-              {
-                char buffer[100];
-                fprintf(Parser->glonassfile,
-                "%9.2f%11sG: GLONASS NAV DATA%21sRINEX VERSION / TYPE\n", ver, "", "");
-                HandleRunBy(buffer, sizeof(buffer), 0, Parser->rinex3);
-                fprintf(Parser->glonassfile, "%s\n%60sEND OF HEADER\n", buffer, "");
-              }
-              Parser->glonassephemeris = 0;
-            }
-            file = Parser->glonassfile;
-          }
-          else if(r == 1019)
-          {
-            if(Parser->gpsephemeris)
-            {
-              if(!(Parser->gpsfile = fopen(Parser->gpsephemeris, "w")))
-              {
-                RTCM3Error("Could not open GPS ephemeris output file.\n");
-              }
-              else
-              {
-                char buffer[100];
-                fprintf(Parser->gpsfile,
-                "%9.2f%11sN: GPS NAV DATA%25sRINEX VERSION / TYPE\n", ver, "", "");
-                HandleRunBy(buffer, sizeof(buffer), 0, Parser->rinex3);
-                fprintf(Parser->gpsfile, "%s\n%60sEND OF HEADER\n", buffer, "");
-              }
-              Parser->gpsephemeris = 0;
-            }
-            file = Parser->gpsfile;
-          }
-          else if(r == 1043)
+          GETBITS(amb,7)
+          GETBITS(i, 8)
+          if(i)
           {
-            if(Parser->sbasephemeris)
-            {
-              if(!(Parser->sbasfile = fopen(Parser->sbasephemeris, "w")))
-              {
-                RTCM3Error("Could not open SBAS ephemeris output file.\n");
-              }
-              else
-              {
-                char buffer[100];
-                fprintf(Parser->sbasfile,
-                "%9.2f%11sN: SBAS NAV DATA%24sRINEX VERSION / TYPE\n", ver, "", "");
-                HandleRunBy(buffer, sizeof(buffer), 0, Parser->rinex3);
-                fprintf(Parser->sbasfile, "%s\n%60sEND OF HEADER\n", buffer, "");
-              }
-              Parser->sbasephemeris = 0;
-            }
-            file = Parser->sbasfile;
+            SetObs(gnss, num, se, cx, i*0.25);
+            i /= 4*4;
+            if(i > 9) i = 9;
+            else if(i < 1) i = 1;
+            gnss->snrL1[num] = i;
           }
-          else if(r == 1044)
+        }
+        if((l1phase&((1<<20)-1)) != 0x80000)
+        {
+          /* Handle this like GPS. Actually for GLONASS L1 range is always
+             valid. To be on the save side, we handle it as invalid like we
+             do for GPS and also remove range in case of 0x80000. */
+          SetObs(gnss, num, ce, cx, l1range*0.02
+          +amb*599584.916);
+          SetObs(gnss, num, le, cx, (l1range*0.02+l1phase*0.0005
+          +amb*599584.916)/GLO_WAVELENGTH_L1(freq-7));
+          if(amb)
+            ++wasamb;
+        }
+        if(type == 1011 || type == 1012)
+        {
+          /* L2 */
+          GETBITS(code,2)
+          if(code)
           {
-            if(Parser->qzssephemeris)
-            {
-              if(!(Parser->qzssfile = fopen(Parser->qzssephemeris, "w")))
-              {
-                RTCM3Error("Could not open QZSS ephemeris output file.\n");
-              }
-              else
-              {
-                char buffer[100];
-                fprintf(Parser->qzssfile,
-                "%9.2f%11sN: QZSS NAV DATA%24sRINEX VERSION / TYPE\n", ver, "", "");
-                HandleRunBy(buffer, sizeof(buffer), 0, Parser->rinex3);
-                fprintf(Parser->qzssfile, "%s\n%60sEND OF HEADER\n", buffer, "");
-              }
-              Parser->qzssephemeris = 0;
-            }
-            file = Parser->qzssfile;
+            ce = GNSSENTRY_P2DATA;
+            le = GNSSENTRY_L2PDATA;
+            se = GNSSENTRY_S2PDATA;
+            ct = "2P";
           }
-          else if(r == RTCM3ID_BDS)
+          else
           {
-            if(Parser->bdsephemeris)
-            {
-              if(!(Parser->bdsfile = fopen(Parser->bdsephemeris, "w")))
-              {
-                RTCM3Error("Could not open BDS ephemeris output file.\n");
-              }
-              else
-              {
-                char buffer[100];
-                fprintf(Parser->bdsfile,
-                "%9.2f%11sN: BDS NAV DATA%25sRINEX VERSION / TYPE\n", ver, "", "");
-                HandleRunBy(buffer, sizeof(buffer), 0, Parser->rinex3);
-                fprintf(Parser->bdsfile, "%s\n%60sEND OF HEADER\n", buffer, "");
-              }
-              Parser->bdsephemeris = 0;
-            }
-            file = Parser->bdsfile;
+            ce = GNSSENTRY_C2DATA;
+            le = GNSSENTRY_L2CDATA;
+            se = GNSSENTRY_S2CDATA;
+            ct = "2C";
           }
-        }
-        if(file)
-        {
-          const char *sep = "   ";
-          if(r == 1020)
+          if(!handle->info[RTCM3_MSM_GLONASS].type[ce])
           {
-            struct glonassephemeris *e = &Parser->ephemerisGLONASS;
-            int w = e->GPSWeek, tow = e->GPSTOW, i;
-            struct converttimeinfo cti;
-
-            updatetime(&w, &tow, e->tb*1000, 1);  /* Moscow - > UTC */
-            converttime(&cti, w, tow);
-
-            i = e->tk-3*60*60; if(i < 0) i += 86400;
-
-            if(Parser->rinex3)
-            {
-              ConvLine(file, "R%02d %04d %02d %02d %02d %02d %02d%19.12e%19.12e%19.12e\n",
-              e->almanac_number, cti.year, cti.month, cti.day, cti.hour, cti.minute,
-              cti.second, -e->tau, e->gamma, (double) i);
-              sep = "    ";
-            }
-            else
-            {
-              ConvLine(file, "%02d %02d %02d %02d %02d %02d%5.1f%19.12e%19.12e%19.12e\n",
-              e->almanac_number, cti.year%100, cti.month, cti.day, cti.hour, cti.minute,
-              (double) cti.second, -e->tau, e->gamma, (double) i);
-            }
-            ConvLine(file, "%s%19.12e%19.12e%19.12e%19.12e\n", sep, e->x_pos,
-            e->x_velocity, e->x_acceleration, (e->flags & GLOEPHF_UNHEALTHY) ? 1.0 : 0.0);
-            ConvLine(file, "%s%19.12e%19.12e%19.12e%19.12e\n", sep, e->y_pos,
-            e->y_velocity, e->y_acceleration, (double) e->frequency_number);
-            ConvLine(file, "%s%19.12e%19.12e%19.12e%19.12e\n", sep, e->z_pos,
-            e->z_velocity, e->z_acceleration, (double) e->E);
+            handle->info[RTCM3_MSM_GLONASS].type[ce] = 
+            handle->info[RTCM3_MSM_GLONASS].type[le] = 
+            handle->info[RTCM3_MSM_GLONASS].type[se] = ct[1];
           }
-          else if(r == 1043)
+          cx = CODEINDEX(ct);
+          GETBITSSIGN(i,14)
+          if((i&((1<<14)-1)) != 0x2000)
           {
-            struct sbasephemeris *e = &Parser->ephemerisSBAS;
-            struct converttimeinfo cti;
-            converttime(&cti, e->GPSweek_TOE, e->TOE);
-            if(Parser->rinex3)
-            {
-              ConvLine(file, "S%02d %04d %2d %2d %2d %2d %2d%19.12e%19.12e%19.12e\n",
-              e->satellite-100, cti.year, cti.month, cti.day, cti.hour, cti.minute,
-              cti.second, e->agf0, e->agf1, (double)e->TOW);
-              sep = "    ";
-            }
-            else
-            {
-              ConvLine(file, "%02d %02d %02d %02d %02d %02d%5.1f%19.12e%19.12e%19.12e\n",
-              e->satellite-100, cti.year%100, cti.month, cti.day, cti.hour, cti.minute,
-              (double)cti.second, e->agf0, e->agf1, (double)e->TOW);
-            }
-            /* X, health */
-            ConvLine(file, "%s%19.12e%19.12e%19.12e%19.12e\n", sep, e->x_pos,
-            e->x_velocity, e->x_acceleration, e->URA == 15 ? 1.0 : 0.0);
-            /* Y, accuracy */
-            ConvLine(file, "%s%19.12e%19.12e%19.12e%19.12e\n", sep, e->y_pos,
-            e->y_velocity, e->y_acceleration, (double)e->URA);
-            /* Z */
-            ConvLine(file, "%s%19.12e%19.12e%19.12e%19.12e\n", sep, e->z_pos,
-            e->z_velocity, e->z_acceleration, (double)e->IODN);
+            SetObs(gnss, num, ce, cx, l1range*0.02+i*0.02
+            +amb*599584.916);
           }
-          else if(r == RTCM3ID_BDS)
+          GETBITSSIGN(i,20)
+          if((i&((1<<20)-1)) != 0x80000)
           {
-            struct bdsephemeris *e = &Parser->ephemerisBDS;
-            double d;                 /* temporary variable */
-            struct converttimeinfo cti;
-            converttimebds(&cti, e->BDSweek, e->TOC);
-            int num = e->satellite-PRN_BDS_START+1;
-
-            if(Parser->rinex3)
-            {
-              ConvLine(file,
-              "C%02d %04d %02d %02d %02d %02d %02d%19.12e%19.12e%19.12e\n",
-              num, cti.year, cti.month, cti.day, cti.hour,
-              cti.minute, cti.second, e->clock_bias, e->clock_drift,
-              e->clock_driftrate);
-              sep = "    ";
-            }
-            else /* actually this is never used, as BDS is undefined for 2.x */
-            {
-              ConvLine(file,
-              "%02d %02d %02d %02d %02d %02d%05.1f%19.12e%19.12e%19.12e\n",
-              num, cti.year%100, cti.month, cti.day, cti.hour,
-              cti.minute, (double) cti.second, e->clock_bias, e->clock_drift,
-              e->clock_driftrate);
-            }
-            ConvLine(file, "%s%19.12e%19.12e%19.12e%19.12e\n", sep,
-            (double)e->AODE, e->Crs, e->Delta_n, e->M0);
-            ConvLine(file, "%s%19.12e%19.12e%19.12e%19.12e\n", sep, e->Cuc,
-            e->e, e->Cus, e->sqrt_A);
-            ConvLine(file, "%s%19.12e%19.12e%19.12e%19.12e\n", sep,
-            (double) e->TOE, e->Cic, e->OMEGA0, e->Cis);
-            ConvLine(file, "%s%19.12e%19.12e%19.12e%19.12e\n", sep, e->i0,
-            e->Crc, e->omega, e->OMEGADOT);
-            ConvLine(file, "%s%19.12e                   %19.12e\n", sep, e->IDOT,
-            (double) e->BDSweek);
-            if(e->URAI <= 6) /* URA index */
-              d = ceil(10.0*pow(2.0, 1.0+((double)e->URAI)/2.0))/10.0;
-            else
-              d = ceil(10.0*pow(2.0, ((double)e->URAI)/2.0))/10.0;
-            /* 15 indicates not to use satellite. We can't handle this special
-               case, so we create a high "non"-accuracy value. */
-            ConvLine(file, "%s%19.12e%19.12e%19.12e%19.12e\n", sep, d,
-            ((double) (e->flags & BDSEPHF_SATH1)), e->TGD_B1_B3,
-            e->TGD_B2_B3);
-
-            ConvLine(file, "%s%19.12e%19.12e\n", sep, ((double)e->TOW),
-            (double) e->AODC);
-            /* TOW, AODC */
+            SetObs(gnss, num, le, cx, (l1range*0.02+i*0.0005
+            +amb*599584.916)/GLO_WAVELENGTH_L2(freq-7));
           }
-          else /* if(r == 1019 || r == 1044) */
+          GETBITS(i,7)
+          lastlockl2[sv] = i;
+          if(handle->lastlockGLOl2[sv] > i || i == 0)
+            gnss->dataflags2[num] |= GNSSDF2_LOCKLOSSL2;
+          if(type == 1012)
           {
-            struct gpsephemeris *e = &Parser->ephemerisGPS;
-            double d;                 /* temporary variable */
-            unsigned long int i;       /* temporary variable */
-            struct converttimeinfo cti;
-            converttime(&cti, e->GPSweek, e->TOC);
-            int qzss = 0;
-            int num = e->satellite;
-
-            if(num >= PRN_QZSS_START)
-            {
-              qzss = 1;
-              num -= PRN_QZSS_START-1;
-            }
-            if(Parser->rinex3)
-            {
-              ConvLine(file,
-              "%s%02d %04d %02d %02d %02d %02d %02d%19.12e%19.12e%19.12e\n",
-              qzss ? "J" : "G", num, cti.year, cti.month, cti.day, cti.hour,
-              cti.minute, cti.second, e->clock_bias, e->clock_drift,
-              e->clock_driftrate);
-              sep = "    ";
-            }
-            else
+            GETBITS(i, 8)
+            if(i)
             {
-              ConvLine(file,
-              "%02d %02d %02d %02d %02d %02d%05.1f%19.12e%19.12e%19.12e\n",
-              num, cti.year%100, cti.month, cti.day, cti.hour,
-              cti.minute, (double) cti.second, e->clock_bias, e->clock_drift,
-              e->clock_driftrate);
+              SetObs(gnss, num, se, cx, i*0.25);
+              i /= 4*4;
+              if(i > 9) i = 9;
+              else if(i < 1) i = 1;
+              gnss->snrL2[num] = i;
             }
-            ConvLine(file, "%s%19.12e%19.12e%19.12e%19.12e\n", sep,
-            (double)e->IODE, e->Crs, e->Delta_n, e->M0);
-            ConvLine(file, "%s%19.12e%19.12e%19.12e%19.12e\n", sep, e->Cuc,
-            e->e, e->Cus, e->sqrt_A);
-            ConvLine(file, "%s%19.12e%19.12e%19.12e%19.12e\n", sep,
-            (double) e->TOE, e->Cic, e->OMEGA0, e->Cis);
-            ConvLine(file, "%s%19.12e%19.12e%19.12e%19.12e\n", sep, e->i0,
-            e->Crc, e->omega, e->OMEGADOT);
-            d = 0;
-            i = e->flags;
-            if(i & GPSEPHF_L2CACODE)
-              d += 2.0;
-            if(i & GPSEPHF_L2PCODE)
-              d += 1.0;
-            ConvLine(file, "%s%19.12e%19.12e%19.12e%19.12e\n", sep, e->IDOT, d,
-            (double) e->GPSweek, i & GPSEPHF_L2PCODEDATA ? 1.0 : 0.0);
-            if(e->URAindex <= 6) /* URA index */
-              d = ceil(10.0*pow(2.0, 1.0+((double)e->URAindex)/2.0))/10.0;
-            else
-              d = ceil(10.0*pow(2.0, ((double)e->URAindex)/2.0))/10.0;
-            /* 15 indicates not to use satellite. We can't handle this special
-               case, so we create a high "non"-accuracy value. */
-            ConvLine(file, "%s%19.12e%19.12e%19.12e%19.12e\n", sep, d,
-            ((double) e->SVhealth), e->TGD, ((double) e->IODC));
-
-            ConvLine(file, "%s%19.12e%19.12e\n", sep, ((double)e->TOW),
-            (i & GPSEPHF_6HOURSFIT) ? (Parser->rinex3 ? 1 : qzss ? 4.0 : 6.0)
-            : (Parser->rinex3 ? 0 : qzss ? 2.0 : 4.0));
-            /* TOW,Fit */
           }
         }
+        if(!sv || sv > 24) /* illegal, remove it again */
+          ClearSat(gnss, --gnss->numsats);
       }
-      else if (r == 1 || r == 2)
+      for(i = 0; i < 64; ++i)
       {
-        int i, j, o, nh=0, hl=2;
-        char newheader[512];
-        struct converttimeinfo cti;
+        handle->lastlockGLOl1[i] = lastlockl1[i];
+        handle->lastlockGLOl2[i] = lastlockl2[i];
+      }
+      if(!syncf && !old)
+      {
+        NewEpoch(handle);
+      }
+      if(!syncf || old)
+      {
+        if(wasamb || resolved >= 0) /* not RINEX compatible without */
+          ret = 1;
+        else
+          ret = 2;
+      }
+#ifdef NO_RTCM3_MAIN
+      else
+        ret = type;
+#endif /* NO_RTCM3_MAIN */
+    }
+    break;
+  case 1071: case 1081: case 1091: case 1101: case 1111: case 1121:
+  case 1072: case 1082: case 1092: case 1102: case 1112: case 1122:
+  case 1073: case 1083: case 1093: case 1103: case 1113: case 1123:
+  case 1074: case 1084: case 1094: case 1104: case 1114: case 1124:
+  case 1075: case 1085: case 1095: case 1105: case 1115: case 1125:
+  case 1076: case 1086: case 1096: case 1106: case 1116: case 1126:
+  case 1077: case 1087: case 1097: case 1107: case 1117: case 1127:
+    if(handle->GPSWeek)
+      ret = msmdecoders[(type-1071)/10][type%10-1](handle, br);
+    break;
+  }
+  if(ret == 1019 || ret == 1020 || ret == 1043 || ret == 1044
+  || ret == 1045 || ret == 1046 || ret == RTCM3ID_BDS)
+    handle->ephemerisrepeat = !StoreEphemeris(handle, ret);
+  return ret;
+}
 
-        /* skip first epochs to detect correct data types */
-        if(Parser->init < (Parser->changeobs ? 1 : NUMSTARTSKIP))
-        {
-          ++Parser->init;
+int RTCM3Parser(struct RTCM3ParserData *handle)
+{
+  int ret=0;
 
-          if(Parser->init == (Parser->changeobs ? 1 : NUMSTARTSKIP))
-            HandleHeader(Parser);
-          else
-          {
-            for(i = 0; i < Parser->Data.numsats; ++i)
-              Parser->startflags |= Parser->Data.dataflags[i];
-            continue;
-          }
-        }
-        if(r == 2 && !Parser->validwarning)
-        {
-          RTCM3Text("No valid RINEX! All values are modulo 299792.458!"
-          "           COMMENT\n");
-          Parser->validwarning = 1;
-        }
+#ifdef NO_RTCM3_MAIN
+  if(GetMessage(handle)) /* don't repeat */
+#else
+  while(!ret && GetMessage(handle))
+#endif /* NO_RTCM3_MAIN */
+    ret = RTCM3Decode(handle, handle->Message+handle->MessageStart+3);
+  return ret;
+}
 
-        converttime(&cti, Parser->Data.week,
-        (int)floor(Parser->Data.timeofweek/1000.0));
-        newheader[0] = 0;
-        if(Parser->changeobs)
-        {
-          nh = HandleObsHeader(Parser, newheader, sizeof(newheader), 0);
-          for(i = 0; i < nh; ++i)
-          {
-            if(newheader[i] == '\n')
-              ++hl;
-          }
-        }
-        if(Parser->rinex3)
-        {
-          if(nh)
-          {
-            RTCM3Text("> %04d %02d %02d %02d %02d%11.7f  4%3d\n",
-            cti.year, cti.month, cti.day, cti.hour, cti.minute, cti.second
-            + fmod(Parser->Data.timeofweek/1000.0,1.0), hl);
-            RTCM3Text("%s\n                             "
-            "                               END OF HEADER\n", newheader);
-          }
-          RTCM3Text("> %04d %02d %02d %02d %02d%11.7f  %d%3d\n",
-          cti.year, cti.month, cti.day, cti.hour, cti.minute, cti.second
-          + fmod(Parser->Data.timeofweek/1000.0,1.0), 0,
-          Parser->Data.numsats);
-          for(i = 0; i < Parser->Data.numsats; ++i)
-          {
-            int sys[RTCM3_MSM_NUMSYS] = {0,0,0,0,0,0};
-            if(Parser->Data.satellites[i] <= PRN_GPS_END)
-            {
-              RTCM3Text("G%02d", Parser->Data.satellites[i]);
-              sys[RTCM3_MSM_GPS] = 1;
-            }
-            else if(Parser->Data.satellites[i] >= PRN_GLONASS_START
-            && Parser->Data.satellites[i] <= PRN_GLONASS_END)
-            {
-              RTCM3Text("R%02d", Parser->Data.satellites[i] - (PRN_GLONASS_START-1));
-              sys[RTCM3_MSM_GLONASS] = 1;
-            }
-            else if(Parser->Data.satellites[i] >= PRN_GALILEO_START
-            && Parser->Data.satellites[i] <= PRN_GALILEO_END)
-            {
-              RTCM3Text("E%02d", Parser->Data.satellites[i] - (PRN_GALILEO_START-1));
-              sys[RTCM3_MSM_GALILEO] = 1;
-            }
-            else if(Parser->Data.satellites[i] >= PRN_GIOVE_START
-            && Parser->Data.satellites[i] <= PRN_GIOVE_END)
-            {
-              RTCM3Text("E%02d", Parser->Data.satellites[i] - (PRN_GIOVE_START-PRN_GIOVE_OFFSET));
-              sys[RTCM3_MSM_GALILEO] = 1;
-            }
-            else if(Parser->Data.satellites[i] >= PRN_QZSS_START
-            && Parser->Data.satellites[i] <= PRN_QZSS_END)
-            {
-              RTCM3Text("J%02d", Parser->Data.satellites[i] - (PRN_QZSS_START-1));
-              sys[RTCM3_MSM_QZSS] = 1;
-            }
-            else if(Parser->Data.satellites[i] >= PRN_BDS_START
-            && Parser->Data.satellites[i] <= PRN_BDS_END)
-            {
-              RTCM3Text("C%02d", Parser->Data.satellites[i] - (PRN_BDS_START-1));
-              sys[RTCM3_MSM_BDS] = 1;
-            }
-            else if(Parser->Data.satellites[i] >= PRN_SBAS_START
-            && Parser->Data.satellites[i] <= PRN_SBAS_END)
-            {
-              RTCM3Text("S%02d", Parser->Data.satellites[i] - PRN_SBAS_START+20);
-              sys[RTCM3_MSM_SBAS] = 1;
-            }
-            else
-            {
-              RTCM3Text("%3d", Parser->Data.satellites[i]);
-            }
+struct Header
+{
+  const char *version;
+  const char *pgm;
+  const char *marker;
+  const char *markertype;
+  const char *observer;
+  const char *receiver;
+  const char *antenna;
+  const char *position;
+  const char *antennaposition;
+  const char *wavelength;
+  const char *typesofobs; /* should not be modified outside */
+  const char *typesofobsG; /* should not be modified outside */
+  const char *typesofobsR; /* should not be modified outside */
+  const char *typesofobsS; /* should not be modified outside */
+  const char *typesofobsE; /* should not be modified outside */
+  const char *typesofobsC; /* should not be modified outside */
+  const char *typesofobsJ; /* should not be modified outside */
+  const char *timeoffirstobs; /* should not be modified outside */
+};
+
+#define MAXHEADERLINES 50
+#define MAXHEADERBUFFERSIZE 4096
+struct HeaderData
+{
+  union
+  {
+    struct Header named;
+    const char *unnamed[MAXHEADERLINES];
+  } data;
+  int  numheaders;
+};
+
+void converttime(struct converttimeinfo *c, int week, int tow)
+{
+  int i, k, doy, j; /* temporary variables */
+  j = week*(7*24*60*60) + tow + 5*24*60*60;
+  for(i = 1980; j >= (k = (365+longyear(i,0))*24*60*60); ++i)
+    j -= k;
+  c->year = i;
+  doy = 1+ (j / (24*60*60));
+  j %= (24*60*60);
+  c->hour = j / (60*60);
+  j %= (60*60);
+  c->minute = j / 60;
+  c->second = j % 60;
+  j = 0;
+  for(i = 1; j + (k = months[i] + longyear(c->year,i)) < doy; ++i)
+    j += k;
+  c->month = i;
+  c->day = doy - j;
+}
+
+void converttimebds(struct converttimeinfo *c, int week, int tow)
+{
+  int i, k, doy, j; /* temporary variables */
+  j = week*(7*24*60*60) + tow;
+  for(i = 2006; j >= (k = (365+longyear(i,0))*24*60*60); ++i)
+    j -= k;
+  c->year = i;
+  doy = 1+ (j / (24*60*60));
+  j %= (24*60*60);
+  c->hour = j / (60*60);
+  j %= (60*60);
+  c->minute = j / 60;
+  c->second = j % 60;
+  j = 0;
+  for(i = 1; j + (k = months[i] + longyear(c->year,i)) < doy; ++i)
+    j += k;
+  c->month = i;
+  c->day = doy - j;
+}
+
+#ifdef __GNUC__
+#define THREADLOCAL __thread
+#else
+#define THREADLOCAL
+#endif
+
+#ifndef NO_RTCM3_MAIN
+static THREADLOCAL int errorquiet = 0; /* no messages from this thread */
+
+void RTCM3Error(const char *fmt, ...)
+{
+  va_list v;
+  if(errorquiet)
+    return;
+  va_start(v, fmt);
+  vfprintf(stderr, fmt, v);
+  va_end(v);
+}
+#endif
+
+#ifndef NO_RTCM3_MAIN
+/* Rings of buffers between the stages of the pipeline (--overflow). Each
+   ring has one producer and one consumer thread. Slots are written by the
+   producer only and published with head. A buffer is owned by whoever
+   moves tail past it with compare and swap, this also lets the producer
+   drop the oldest buffer of a full ring. A thread waiting for the other
+   side sets its flag and sleeps on a semaphore. */
+#define PIPESLOTS 1024 /* buffers of a ring */
+
+enum PipePolicy { PIPE_BLOCK = 1, PIPE_DROP, PIPE_SPILL };
+
+struct PipeBuffer
+{
+  size_t size;
+  unsigned char data[1];
+};
+
+struct PipeRing
+{
+  struct PipeBuffer *slot[PIPESLOTS];
+  uint64_t head;
+  uint64_t tail;
+  enum PipePolicy policy;
+  int closed;    /* the producer has finished */
+  int consumerwaits, producerwaits;
+  sem_t consumerwake, producerwake;
+  FILE *spill;   /* buffers after a full ring in order, for PIPE_SPILL */
+  pthread_mutex_t spillmutex; /* for the offsets and truncating */
+  uint64_t spillwritten, spillread;
+  int spillpending; /* buffers in the spill file */
+  /* counters of the producer */
+  long buffers, maxdepth, blocked, dropped, spilled;
+  uint64_t bytes, droppedbytes, spilledbytes;
+};
+
+/* receive, convert (decode and format) and write stages */
+struct Pipeline
+{
+  struct PipeRing input;  /* received data */
+  struct PipeRing output; /* formatted text */
+  pthread_t converter, writer;
+  int hasconverter;
+  struct RTCM3ParserData *parser;
+  FILE *out;
+  long results, epochs, writes, writeerrors;
+  uint64_t converted, written;
+};
+
+static struct PipeBuffer *PipeBuffer(const void *data, size_t size)
+{
+  struct PipeBuffer *b = malloc(sizeof(*b)+size);
+  if(b)
+  {
+    b->size = size;
+    memcpy(b->data, data, size);
+  }
+  return b;
+}
+
+static void PipeWake(int *waits, sem_t *wake)
+{
+  if(__atomic_exchange_n(waits, 0, __ATOMIC_SEQ_CST))
+    sem_post(wake);
+}
+
+static int PipeSpillPending(struct PipeRing *r)
+{
+  return __atomic_load_n(&r->spillpending, __ATOMIC_ACQUIRE) != 0;
+}
+
+static void PipeSpill(struct PipeRing *r, struct PipeBuffer *b)
+{
+  int fd = fileno(r->spill), ok;
+
+  pthread_mutex_lock(&r->spillmutex);
+  ok = pwrite(fd, b, sizeof(*b)+b->size, (off_t)r->spillwritten)
+  == (ssize_t)(sizeof(*b)+b->size);
+  if(ok)
+  {
+    r->spillwritten += sizeof(*b)+b->size;
+    __atomic_add_fetch(&r->spillpending, 1, __ATOMIC_RELEASE);
+  }
+  pthread_mutex_unlock(&r->spillmutex);
+  if(!ok)
+  {
+    ++r->dropped;
+    r->droppedbytes += b->size;
+  }
+  else
+  {
+    ++r->spilled;
+    r->spilledbytes += b->size;
+    PipeWake(&r->consumerwaits, &r->consumerwake);
+  }
+  free(b);
+}
+
+static struct PipeBuffer *PipeUnspill(struct PipeRing *r)
+{
+  int fd = fileno(r->spill);
+  uint64_t p;
+  struct PipeBuffer h, *b;
+
+  pthread_mutex_lock(&r->spillmutex);
+  p = r->spillread;
+  if(pread(fd, &h, sizeof(h), (off_t)p) != sizeof(h)
+  || !(b = malloc(sizeof(h)+h.size))
+  || pread(fd, b, sizeof(h)+h.size, (off_t)p) != (ssize_t)(sizeof(h)+h.size))
+  {
+    RTCM3Error("Could not read spilled output.\n");
+    exit(1);
+  }
+  r->spillread = p+sizeof(h)+h.size;
+  /* drained, the producer fills the ring again until the next overflow */
+  if(!__atomic_sub_fetch(&r->spillpending, 1, __ATOMIC_ACQ_REL))
+  {
+    r->spillread = r->spillwritten = 0;
+    if(ftruncate(fd, 0))
+      RTCM3Error("Could not truncate spill file: %s\n", strerror(errno));
+  }
+  pthread_mutex_unlock(&r->spillmutex);
+  return b;
+}
+
+/* the producer gives the buffer to the ring, a full ring is handled by the
+   policy */
+static void PipePush(struct PipeRing *r, struct PipeBuffer *b)
+{
+  uint64_t h = r->head, t;
+
+  if(!b)
+  {
+    ++r->dropped;
+    return;
+  }
+  ++r->buffers;
+  r->bytes += b->size;
+  if(r->policy == PIPE_SPILL && PipeSpillPending(r))
+  {
+    PipeSpill(r, b);
+    return;
+  }
+  while(h-(t = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE)) >= PIPESLOTS)
+  {
+    /* the first buffer holds the RINEX header and is never dropped */
+    if(r->policy == PIPE_DROP && t)
+    {
+      struct PipeBuffer *o = r->slot[t%PIPESLOTS];
+      if(__atomic_compare_exchange_n(&r->tail, &t, t+1, 0, __ATOMIC_ACQ_REL,
+      __ATOMIC_ACQUIRE))
+      {
+        ++r->dropped;
+        r->droppedbytes += o->size;
+        free(o);
+      }
+    }
+    else if(r->policy == PIPE_SPILL)
+    {
+      PipeSpill(r, b);
+      return;
+    }
+    else
+    {
+      ++r->blocked;
+      __atomic_store_n(&r->producerwaits, 1, __ATOMIC_SEQ_CST);
+      if(h-__atomic_load_n(&r->tail, __ATOMIC_SEQ_CST) >= PIPESLOTS)
+        sem_wait(&r->producerwake);
+      __atomic_store_n(&r->producerwaits, 0, __ATOMIC_SEQ_CST);
+    }
+  }
+  r->slot[h%PIPESLOTS] = b;
+  __atomic_store_n(&r->head, h+1, __ATOMIC_SEQ_CST);
+  if((long)(h+1-t) > r->maxdepth)
+    r->maxdepth = h+1-t;
+  PipeWake(&r->consumerwaits, &r->consumerwake);
+}
+
+static void PipeClose(struct PipeRing *r)
+{
+  __atomic_store_n(&r->closed, 1, __ATOMIC_SEQ_CST);
+  PipeWake(&r->consumerwaits, &r->consumerwake);
+}
+
+/* The consumer takes the oldest buffer, spilled ones after the ring. Returns
+   0 when the producer has finished and everything is taken. */
+static struct PipeBuffer *PipePop(struct PipeRing *r)
+{
+  for(;;)
+  {
+    uint64_t t = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+    int closed = __atomic_load_n(&r->closed, __ATOMIC_SEQ_CST);
+
+    if(t != __atomic_load_n(&r->head, __ATOMIC_ACQUIRE))
+    {
+      struct PipeBuffer *b = r->slot[t%PIPESLOTS];
+      if(__atomic_compare_exchange_n(&r->tail, &t, t+1, 0, __ATOMIC_ACQ_REL,
+      __ATOMIC_ACQUIRE))
+      {
+        PipeWake(&r->producerwaits, &r->producerwake);
+        return b;
+      }
+    }
+    else if(r->spill && PipeSpillPending(r))
+      return PipeUnspill(r);
+    else if(closed)
+      return 0;
+    else
+    {
+      __atomic_store_n(&r->consumerwaits, 1, __ATOMIC_SEQ_CST);
+      if(t == __atomic_load_n(&r->head, __ATOMIC_SEQ_CST)
+      && !__atomic_load_n(&r->closed, __ATOMIC_SEQ_CST)
+      && !(r->spill && PipeSpillPending(r)))
+        sem_wait(&r->consumerwake);
+      __atomic_store_n(&r->consumerwaits, 0, __ATOMIC_SEQ_CST);
+    }
+  }
+}
+
+static struct Pipeline *pipeline; /* 0 without --overflow */
+static THREADLOCAL struct Pipeline *textpipe; /* for the converting thread */
+#endif /* NO_RTCM3_MAIN */
+
+/* Text output of one result is collected here and written with one call
+   to the unbuffered stdout, so an epoch is never written partially. Each
+   thread has its own buffer and may write to textfile instead. */
+static THREADLOCAL char textbuffer[1<<17];
+static THREADLOCAL size_t textsize = 0;
+static THREADLOCAL int textbuffered = 0;
+static THREADLOCAL FILE *textfile = 0;
+static THREADLOCAL int textdiscard = 0; /* nothing is formatted */
+
+static void RTCM3TextFlush(void)
+{
+#ifndef NO_RTCM3_MAIN
+  if(textsize && textpipe)
+  {
+    textpipe->converted += textsize;
+    PipePush(&textpipe->output, PipeBuffer(textbuffer, textsize));
+  }
+  else
+#endif /* NO_RTCM3_MAIN */
+  if(textsize)
+    fwrite(textbuffer, 1, textsize, textfile ? textfile : stdout);
+  textsize = 0;
+}
+
+void RTCM3Text(const char *fmt, ...)
+{
+  va_list v;
+  if(textdiscard)
+    return;
+  va_start(v, fmt);
+  if(textbuffered)
+  {
+    size_t f = sizeof(textbuffer)-textsize;
+    int n = vsnprintf(textbuffer+textsize, f, fmt, v);
+    if(n >= 0 && (size_t)n < f)
+      textsize += n;
+    else /* full, write what we have */
+    {
+      RTCM3TextFlush();
+      va_end(v);
+      va_start(v, fmt);
+      if(n >= 0 && (size_t)n < sizeof(textbuffer))
+        textsize = vsnprintf(textbuffer, sizeof(textbuffer), fmt, v);
+      else
+        vfprintf(textfile ? textfile : stdout, fmt, v);
+    }
+  }
+  else
+    vfprintf(textfile ? textfile : stdout, fmt, v);
+  va_end(v);
+}
+
+/* Writes x as printf("%*.*f", width, prec, x) does, with prec <= 7.
+   x = m*2^-s is scaled exactly by 10^prec using 64x32 bit products and
+   rounded to nearest even like glibc. Returns the length or 0 if x is not
+   finite or too large, buf needs 32 bytes. */
+static int FormatFixed(char *buf, double x, int width, int prec)
+{
+  static const uint32_t pow10[8] =
+  {1, 10, 100, 1000, 10000, 100000, 1000000, 10000000};
+  char tmp[32], *t = tmp+sizeof(tmp);
+  uint64_t u, m, lo, hi, q = 0;
+  int e, s, n, i;
+
+  memcpy(&u, &x, sizeof(u));
+  e = (int)((u >> 52) & 0x7FF);
+  m = u & ((UINT64(1)<<52)-1);
+  if(e == 0x7FF)
+    return 0;
+  if(e)
+    m |= UINT64(1)<<52;
+  else
+    e = 1;
+  s = 1075-e; /* x = m*2^-s */
+  if(s < 0)
+    return 0;
+
+  /* hi:lo = m*10^prec, at most 77 bits */
+  lo = (m & 0xFFFFFFFF)*pow10[prec];
+  hi = (m >> 32)*pow10[prec];
+  lo += hi << 32;
+  hi = (hi >> 32) + (lo < (hi << 32));
+
+  if(s == 0)
+  {
+    if(hi)
+      return 0;
+    q = lo;
+  }
+  else if(s < 128)
+  {
+    int r = s-1; /* position of the rounding bit */
+    int round, sticky;
+    if(s < 64)
+    {
+      if(hi >> s)
+        return 0;
+      q = (hi << (64-s)) | (lo >> s);
+    }
+    else
+      q = hi >> (s-64);
+    if(r < 64)
+    {
+      round = (int)((lo >> r) & 1);
+      sticky = r && (lo & ((UINT64(1)<<r)-1));
+    }
+    else
+    {
+      round = (int)((hi >> (r-64)) & 1);
+      sticky = lo || (hi & ((UINT64(1)<<(r-64))-1));
+    }
+    if(round && (sticky || (q & 1)))
+      ++q;
+  }
+
+  for(i = 0; i < prec; ++i, q /= 10)
+    *--t = '0'+(char)(q%10);
+  if(prec)
+    *--t = '.';
+  do
+    *--t = '0'+(char)(q%10);
+  while((q /= 10));
+  if(u >> 63)
+    *--t = '-';
+  n = (int)(tmp+sizeof(tmp)-t);
+  for(i = 0; i < width-n; ++i)
+    *buf++ = ' ';
+  memcpy(buf, t, n);
+  return n > width ? n : width;
+}
+
+/* Writes x as printf("%19.12e") does, but with a 'D' exponent as used in
+   RINEX navigation files. The 13 digits are taken from x scaled by a power
+   of ten in long double. If that value is too close to a rounding tie to
+   be sure of glibc's result, snprintf is used instead. Returns the length,
+   buf needs 32 bytes. */
+static int FormatExp(char *buf, double x)
+{
+  static const long double pow10[34] =
+  {1e0L, 1e1L, 1e2L, 1e3L, 1e4L, 1e5L, 1e6L, 1e7L, 1e8L, 1e9L, 1e10L,
+  1e11L, 1e12L, 1e13L, 1e14L, 1e15L, 1e16L, 1e17L, 1e18L, 1e19L, 1e20L,
+  1e21L, 1e22L, 1e23L, 1e24L, 1e25L, 1e26L, 1e27L, 1e28L, 1e29L, 1e30L,
+  1e31L, 1e32L, 1e33L};
+  long double a = fabs(x), q, f;
+  uint64_t d = 0;
+  int e = 0, i, fast = (x == 0.0);
+
+  if(a >= 1e-20 && a < 1e20)
+  {
+    frexp(x, &e);
+    e = (int)floor((e-1)*0.30102999566398120); /* e <= log10(a) < e+1 */
+    q = e <= 12 ? a*pow10[12-e] : a/pow10[e-12];
+    if(q >= 1e13L)
+    {
+      ++e;
+      q = e <= 12 ? a*pow10[12-e] : a/pow10[e-12];
+    }
+    d = (uint64_t)q;
+    f = q-d;
+    /* two roundings, each at most half an ulp */
+    fast = fabsl(f-0.5L) > q*2*LDBL_EPSILON;
+    if(f > 0.5L && ++d == UINT64(10000000000000))
+    {
+      d = UINT64(1000000000000);
+      ++e;
+    }
+  }
+  if(!fast)
+  {
+    int n = snprintf(buf, 32, "%19.12e", x);
+    for(i = 0; i < n; ++i)
+    {
+      if(buf[i] == 'e') buf[i] = 'D';
+    }
+    return n;
+  }
+
+  buf[0] = signbit(x) ? '-' : ' ';
+  for(i = 14; i > 2; --i, d /= 10)
+    buf[i] = '0'+(char)(d%10);
+  buf[2] = '.';
+  buf[1] = '0'+(char)d;
+  buf[15] = 'D';
+  buf[16] = e < 0 ? '-' : '+';
+  if(e < 0)
+    e = -e;
+  buf[17] = '0'+(char)(e/10);
+  buf[18] = '0'+(char)(e%10);
+  return 19;
+}
+
+/* appends n characters of s */
+static void RTCM3TextRaw(const char *s, int n)
+{
+  if(textdiscard)
+    return;
+  if(textbuffered && sizeof(textbuffer)-textsize > (size_t)n)
+  {
+    memcpy(textbuffer+textsize, s, n);
+    textsize += n;
+  }
+  else
+    RTCM3Text("%.*s", n, s);
+}
+
+/* appends v formatted as "%*.*f" */
+static void RTCM3TextFixed(double v, int width, int prec)
+{
+  int n;
+  if(textdiscard)
+    return;
+  if(textbuffered && sizeof(textbuffer)-textsize >= 32
+  && (n = FormatFixed(textbuffer+textsize, v, width, prec)))
+    textsize += n;
+  else
+    RTCM3Text("%*.*f", width, prec, v);
+}
+
+/* appends a RINEX observation, "%14.3f" followed by the LLI and SNR flag */
+static void RTCM3TextObs(double v, char lli, char snr)
+{
+  char f[2];
+  f[0] = lli;
+  f[1] = snr;
+  RTCM3TextFixed(v, 14, 3);
+  RTCM3TextRaw(f, 2);
+}
+
+/* appends a satellite as "%c%02d" */
+static void RTCM3TextSat(char sys, int prn)
+{
+  char f[3];
+  if(prn >= 0 && prn <= 99)
+  {
+    f[0] = sys;
+    f[1] = '0'+prn/10;
+    f[2] = '0'+prn%10;
+    RTCM3TextRaw(f, 3);
+  }
+  else
+    RTCM3Text("%c%02d", sys, prn);
+}
+
+static void fixrevision(void)
+{
+  if(revisionstr[0] == '$')
+  {
+    char *a;
+    int i=sizeof(RTCM3TORINEX_VERSION); /* set version to 1.<revision> */
+    strcpy(revisionstr, RTCM3TORINEX_VERSION ".");
+    for(a = revisionstr+11; *a && *a != ' '; ++a)
+      revisionstr[i++] = *a;
+    revisionstr[i] = 0;
+  }
+}
+
+static int HandleRunBy(char *buffer, int buffersize, const char **u,
+int rinex3)
+{
+  const char *user;
+  time_t t;
+  struct tm * t2;
+#ifndef NO_RTCM3_MAIN
+  struct tm tm;
+#endif
+
+#ifdef NO_RTCM3_MAIN
+  fixrevision();
+#endif
+
+  user= getenv("USER");
+  if(!user) user = "";
+  t = time(&t);
+#ifdef NO_RTCM3_MAIN
+  t2 = gmtime(&t);
+#else
+  t2 = gmtime_r(&t, &tm); /* headers are written by several threads */
+#endif
+  if(u) *u = user;
+  if(rinex3)
+  {
+    return 1+snprintf(buffer, buffersize,
+    "RTCM3TORINEX %-7.7s%-20.20s%04d%02d%02d %02d%02d%02d UTC "
+    "PGM / RUN BY / DATE", revisionstr, user, 1900+t2->tm_year,
+    t2->tm_mon+1, t2->tm_mday, t2->tm_hour, t2->tm_min, t2->tm_sec);
+  }
+  else
+  {
+    return 1+snprintf(buffer, buffersize,
+    "RTCM3TORINEX %-7.7s%-20.20s%04d-%02d-%02d %02d:%02d    "
+    "PGM / RUN BY / DATE", revisionstr, user, 1900+t2->tm_year,
+    t2->tm_mon+1, t2->tm_mday, t2->tm_hour, t2->tm_min);
+  }
+}
+
+#ifdef NO_RTCM3_MAIN
+#define NUMSTARTSKIP 1
+#else
+#define NUMSTARTSKIP 3
+#endif
+
+int HandleObsHeader(struct RTCM3ParserData *Parser, char *buffer,
+size_t buffersize, struct HeaderData *hdata)
+{
+  int buffersizeold = buffersize;
+  int i, modified = 0;
+
+  if(Parser->rinex3)
+  {
+    int flags;
+#define CHECKFLAGSNEW(a, b, c) \
+    if(flags & GNSSDF_##b##DATA) \
+    { \
+      int new = hdata ? 1 : 0; \
+      if(!hdata) /* check if already known */ \
+      { \
+        int ic; \
+        for(ic = 0; ic < Parser->info[RTCM3_MSM_##a].numtypes \
+        && Parser->info[RTCM3_MSM_##a].flags[ic] != GNSSDF_##b##DATA; ++ic) \
+          ; \
+        if(ic == Parser->info[RTCM3_MSM_##a].numtypes) \
+          new = 1; \
+      } \
+      if(new) \
+      { \
+        Parser->info[RTCM3_MSM_##a].flags[Parser->info[RTCM3_MSM_##a].numtypes] \
+        = GNSSDF_##b##DATA; \
+        Parser->info[RTCM3_MSM_##a].pos[Parser->info[RTCM3_MSM_##a].numtypes] \
+        = GNSSENTRY_##b##DATA; \
+        if(Parser->info[RTCM3_MSM_##a].type[GNSSENTRY_##b##DATA]) \
+        { \
+          snprintf(Parser->fieldbuffer##a+4*Parser->info[RTCM3_MSM_##a].numtypes, \
+          sizeof(Parser->fieldbuffer##a)-4*Parser->info[RTCM3_MSM_##a].numtypes, \
+          " %-2.2s%c", #c, Parser->info[RTCM3_MSM_##a].type[GNSSENTRY_##b##DATA]); \
+        } \
+        else \
+        { \
+          snprintf(Parser->fieldbuffer##a+4*Parser->info[RTCM3_MSM_##a].numtypes, \
+          sizeof(Parser->fieldbuffer##a)-4*Parser->info[RTCM3_MSM_##a].numtypes, \
+          " %-3s", #c); \
+        } \
+        ++Parser->info[RTCM3_MSM_##a].numtypes; \
+        ++modified; \
+      } \
+    }
+
+#define INITFLAGS(a) \
+    flags = Parser->startflags; \
+    modified = 0; \
+    for(i = 0; i < Parser->Data->numsats; ++i) \
+    { \
+      if(Parser->Data->satellites[i] >= PRN_##a##_START \
+      && Parser->Data->satellites[i] <= PRN_##a##_END) \
+        flags |= Parser->Data->dataflags[i]; \
+    }
+
+    INITFLAGS(SBAS)
+    CHECKFLAGSNEW(SBAS, C1,  C1C)
+    CHECKFLAGSNEW(SBAS, L1C, L1C)
+    CHECKFLAGSNEW(SBAS, D1C, D1C)
+    CHECKFLAGSNEW(SBAS, S1C, S1C)
+    CHECKFLAGSNEW(SBAS, C5,  C5)
+    CHECKFLAGSNEW(SBAS, L5,  L5)
+    CHECKFLAGSNEW(SBAS, D5,  D5)
+    CHECKFLAGSNEW(SBAS, S5,  S5)
+
+    if(modified)
+    {
+      if(hdata)
+        hdata->data.named.typesofobsS = buffer;
+      i = 1+snprintf(buffer, buffersize,
+      "S  %3d%-52.52s  SYS / # / OBS TYPES",
+      Parser->info[RTCM3_MSM_SBAS].numtypes, Parser->fieldbufferSBAS);
+      buffer += i; buffersize -= i;
+    }
+
+    INITFLAGS(GPS)
+    CHECKFLAGSNEW(GPS, C1,  C1C)
+    CHECKFLAGSNEW(GPS, L1C, L1C)
+    CHECKFLAGSNEW(GPS, D1C, D1C)
+    CHECKFLAGSNEW(GPS, S1C, S1C)
+    CHECKFLAGSNEW(GPS, P1,  C1W)
+    CHECKFLAGSNEW(GPS, L1P, L1W)
+    CHECKFLAGSNEW(GPS, D1P, D1W)
+    CHECKFLAGSNEW(GPS, S1P, S1W)
+    CHECKFLAGSNEW(GPS, C5,  C5)
+    CHECKFLAGSNEW(GPS, L5,  L5)
+    CHECKFLAGSNEW(GPS, D5,  D5)
+    CHECKFLAGSNEW(GPS, S5,  S5)
+    CHECKFLAGSNEW(GPS, P2,  C2W)
+    CHECKFLAGSNEW(GPS, L2P, L2W)
+    CHECKFLAGSNEW(GPS, D2P, D2W)
+    CHECKFLAGSNEW(GPS, S2P, S2W)
+    CHECKFLAGSNEW(GPS, C2,  C2)
+    CHECKFLAGSNEW(GPS, L2C, L2)
+    CHECKFLAGSNEW(GPS, D2C, D2)
+    CHECKFLAGSNEW(GPS, S2C, S2)
+    CHECKFLAGSNEW(GPS, C1N, C1)
+    CHECKFLAGSNEW(GPS, L1N, L1)
+    CHECKFLAGSNEW(GPS, D1N, D1)
+    CHECKFLAGSNEW(GPS, S1N, S1)
+
+    if(modified)
+    {
+      if(hdata)
+        hdata->data.named.typesofobsG = buffer;
+      i = 1+snprintf(buffer, buffersize,
+      "G  %3d%-52.52s  SYS / # / OBS TYPES",
+      Parser->info[RTCM3_MSM_GPS].numtypes, Parser->fieldbufferGPS);
+      if(Parser->info[RTCM3_MSM_GPS].numtypes>13)
+      {
+        i += snprintf(buffer+i-1, buffersize,
+        "\n      %-52.52s  SYS / # / OBS TYPES", Parser->fieldbufferGPS+13*4);
+      }
+      buffer += i; buffersize -= i;
+    }
+
+    INITFLAGS(GLONASS)
+    CHECKFLAGSNEW(GLONASS, C1,  C1C)
+    CHECKFLAGSNEW(GLONASS, L1C, L1C)
+    CHECKFLAGSNEW(GLONASS, D1C, D1C)
+    CHECKFLAGSNEW(GLONASS, S1C, S1C)
+    CHECKFLAGSNEW(GLONASS, P1,  C1P)
+    CHECKFLAGSNEW(GLONASS, L1P, L1P)
+    CHECKFLAGSNEW(GLONASS, D1P, D1P)
+    CHECKFLAGSNEW(GLONASS, S1P, S1P)
+    CHECKFLAGSNEW(GLONASS, P2,  C2P)
+    CHECKFLAGSNEW(GLONASS, L2P, L2P)
+    CHECKFLAGSNEW(GLONASS, D2P, D2P)
+    CHECKFLAGSNEW(GLONASS, S2P, S2P)
+    CHECKFLAGSNEW(GLONASS, C2,  C2C)
+    CHECKFLAGSNEW(GLONASS, L2C, L2C)
+    CHECKFLAGSNEW(GLONASS, D2C, D2C)
+    CHECKFLAGSNEW(GLONASS, S2C, S2C)
+
+    if(modified)
+    {
+      if(hdata)
+        hdata->data.named.typesofobsR = buffer;
+      i = 1+snprintf(buffer, buffersize,
+      "R  %3d%-52.52s  SYS / # / OBS TYPES",
+      Parser->info[RTCM3_MSM_GLONASS].numtypes, Parser->fieldbufferGLONASS);
+      if(Parser->info[RTCM3_MSM_GLONASS].numtypes>13)
+      {
+        i += snprintf(buffer+i-1, buffersize,
+        "\n      %-52.52s  SYS / # / OBS TYPES", Parser->fieldbufferGLONASS+13*4);
+      }
+      buffer += i; buffersize -= i;
+    }
+
+    INITFLAGS(GALGIO)
+    CHECKFLAGSNEW(GALILEO, C1,   C1)
+    CHECKFLAGSNEW(GALILEO, L1C,  L1)
+    CHECKFLAGSNEW(GALILEO, D1C,  D1)
+    CHECKFLAGSNEW(GALILEO, S1C,  S1)
+    CHECKFLAGSNEW(GALILEO, C6,   C6)
+    CHECKFLAGSNEW(GALILEO, L6,   L6)
+    CHECKFLAGSNEW(GALILEO, D6,   D6)
+    CHECKFLAGSNEW(GALILEO, S6,   S6)
+    CHECKFLAGSNEW(GALILEO, C5,   C5)
+    CHECKFLAGSNEW(GALILEO, L5,   L5)
+    CHECKFLAGSNEW(GALILEO, D5,   D5)
+    CHECKFLAGSNEW(GALILEO, S5,   S5)
+    CHECKFLAGSNEW(GALILEO, C5B,  C7)
+    CHECKFLAGSNEW(GALILEO, L5B,  L7)
+    CHECKFLAGSNEW(GALILEO, D5B,  D7)
+    CHECKFLAGSNEW(GALILEO, S5B,  S7)
+    CHECKFLAGSNEW(GALILEO, C5AB, C8)
+    CHECKFLAGSNEW(GALILEO, L5AB, L8)
+    CHECKFLAGSNEW(GALILEO, D5AB, D8)
+    CHECKFLAGSNEW(GALILEO, S5AB, S8)
+
+    if(modified)
+    {
+      if(hdata)
+        hdata->data.named.typesofobsE = buffer;
+      i = 1+snprintf(buffer, buffersize,
+      "E  %3d%-52.52s  SYS / # / OBS TYPES",
+      Parser->info[RTCM3_MSM_GALILEO].numtypes, Parser->fieldbufferGALILEO);
+      if(Parser->info[RTCM3_MSM_GALILEO].numtypes>13)
+      {
+        i += snprintf(buffer+i-1, buffersize,
+        "\n      %-52.52s  SYS / # / OBS TYPES", Parser->fieldbufferGALILEO+13*4);
+      }
+      buffer += i; buffersize -= i;
+    }
+
+    INITFLAGS(BDS)
+    CHECKFLAGSNEW(BDS, CB1,  C2I)
+    CHECKFLAGSNEW(BDS, LB1,  L2I)
+    CHECKFLAGSNEW(BDS, DB1,  D2I)
+    CHECKFLAGSNEW(BDS, SB1,  S2I)
+    CHECKFLAGSNEW(BDS, CB2,  C7I)
+    CHECKFLAGSNEW(BDS, LB2,  L7I)
+    CHECKFLAGSNEW(BDS, DB2,  D7I)
+    CHECKFLAGSNEW(BDS, SB2,  S7I)
+    CHECKFLAGSNEW(BDS, CB3,  C6I)
+    CHECKFLAGSNEW(BDS, LB3,  L6I)
+    CHECKFLAGSNEW(BDS, DB3,  D6I)
+    CHECKFLAGSNEW(BDS, SB3,  S6I)
+
+    if(modified)
+    {
+      if(hdata)
+        hdata->data.named.typesofobsC = buffer;
+      i = 1+snprintf(buffer, buffersize,
+      "C  %3d%-52.52s  SYS / # / OBS TYPES",
+      Parser->info[RTCM3_MSM_BDS].numtypes, Parser->fieldbufferBDS);
+      if(Parser->info[RTCM3_MSM_BDS].numtypes>13)
+      {
+        i += snprintf(buffer+i-1, buffersize,
+        "\n      %-52.52s  SYS / # / OBS TYPES", Parser->fieldbufferBDS+13*4);
+      }
+      buffer += i; buffersize -= i;
+    }
+
+    INITFLAGS(QZSS)
+
+    CHECKFLAGSNEW(QZSS, C1,  C1C)
+    CHECKFLAGSNEW(QZSS, L1C, L1C)
+    CHECKFLAGSNEW(QZSS, D1C, D1C)
+    CHECKFLAGSNEW(QZSS, S1C, S1C)
+
+    CHECKFLAGSNEW(QZSS, CSAIF, C1Z)
+    CHECKFLAGSNEW(QZSS, LSAIF, L1Z)
+    CHECKFLAGSNEW(QZSS, DSAIF, D1Z)
+    CHECKFLAGSNEW(QZSS, SSAIF, S1Z)
+
+    CHECKFLAGSNEW(QZSS, C1N, C1)
+    CHECKFLAGSNEW(QZSS, L1N, L1)
+    CHECKFLAGSNEW(QZSS, D1N, D1)
+    CHECKFLAGSNEW(QZSS, S1N, S1)
+
+    CHECKFLAGSNEW(QZSS, C6, C6)
+    CHECKFLAGSNEW(QZSS, L6, L6)
+    CHECKFLAGSNEW(QZSS, D6, D6)
+    CHECKFLAGSNEW(QZSS, S6, S6)
+
+    CHECKFLAGSNEW(QZSS, C2,  C2)
+    CHECKFLAGSNEW(QZSS, L2C, L2)
+    CHECKFLAGSNEW(QZSS, D2C, D2)
+    CHECKFLAGSNEW(QZSS, S2C, S2)
+
+    CHECKFLAGSNEW(QZSS, C5,  C5)
+    CHECKFLAGSNEW(QZSS, L5,  L5)
+    CHECKFLAGSNEW(QZSS, D5,  D5)
+    CHECKFLAGSNEW(QZSS, S5,  S5)
+
+    if(modified)
+    {
+      if(hdata)
+        hdata->data.named.typesofobsJ = buffer;
+      i = 1+snprintf(buffer, buffersize,
+      "J  %3d%-52.52s  SYS / # / OBS TYPES",
+      Parser->info[RTCM3_MSM_QZSS].numtypes, Parser->fieldbufferQZSS);
+      if(Parser->info[RTCM3_MSM_QZSS].numtypes>13)
+      {
+        i += snprintf(buffer+i-1, buffersize,
+        "\n      %-52.52s  SYS / # / OBS TYPES", Parser->fieldbufferQZSS+13*4);
+      }
+      buffer += i; buffersize -= i;
+    }
+  }
+  else
+  {
+#define CHECKFLAGS(a, b) \
+    if(flags & GNSSDF_##a##DATA) \
+    { \
+      if(Parser->datafields[RINEXENTRY_##b##DATA]) \
+      { \
+        Parser->info[RTCM3_MSM_GPS].flags[Parser->datafields[\
+        RINEXENTRY_##b##DATA]-1] = GNSSDF_##a##DATA; \
+        Parser->info[RTCM3_MSM_GPS].pos[Parser->datafields[\
+        RINEXENTRY_##b##DATA]-1] = GNSSENTRY_##a##DATA; \
+      } \
+      else \
+      { \
+        Parser->flags[Parser->info[RTCM3_MSM_GPS].numtypes] = GNSSDF_##a##DATA; \
+        Parser->pos[Parser->info[RTCM3_MSM_GPS].numtypes] = GNSSENTRY_##a##DATA; \
+        Parser->datafields[RINEXENTRY_##b##DATA] = \
+        ++Parser->info[RTCM3_MSM_GPS].numtypes; \
+        snprintf(Parser->fieldbuffer+6*Parser->numdatafields, \
+        sizeof(Parser->fieldbuffer)-6*Parser->numdatafields, "    "#b); \
+        ++Parser->numdatafields; \
+        ++modified; \
+      } \
+    }
+
+    int flags = Parser->startflags;
+    for(i = 0; i < Parser->Data->numsats; ++i)
+      flags |= Parser->Data->dataflags[i];
+
+    CHECKFLAGS(C1,C1)
+    CHECKFLAGS(C2,C2)
+    CHECKFLAGS(P1,P1)
+    CHECKFLAGS(P2,P2)
+    CHECKFLAGS(L1C,L1)
+    CHECKFLAGS(L1P,L1)
+    CHECKFLAGS(L2C,L2)
+    CHECKFLAGS(L2P,L2)
+    CHECKFLAGS(D1C,D1)
+    CHECKFLAGS(D1P,D1)
+    CHECKFLAGS(D2C,D2)
+    CHECKFLAGS(D2P,D2)
+    CHECKFLAGS(S1C,S1)
+    CHECKFLAGS(S1P,S1)
+    CHECKFLAGS(S2C,S2)
+    CHECKFLAGS(S2P,S2)
+    CHECKFLAGS(C5,C5)
+    CHECKFLAGS(L5,L5)
+    CHECKFLAGS(D5,D5)
+    CHECKFLAGS(S5,S5)
+    CHECKFLAGS(C5AB,C8)
+    CHECKFLAGS(L5AB,L8)
+    CHECKFLAGS(D5AB,D8)
+    CHECKFLAGS(S5AB,S8)
+    CHECKFLAGS(C5B,C7)
+    CHECKFLAGS(L5B,L7)
+    CHECKFLAGS(D5B,D7)
+    CHECKFLAGS(S5B,S7)
+    CHECKFLAGS(C6,C6)
+    CHECKFLAGS(L6,L6)
+    CHECKFLAGS(D6,D6)
+    CHECKFLAGS(S6,S6)
+    /* Skip C1N and SAIF for RINEX2! */
+
+    if(hdata)
+      hdata->data.named.typesofobs = buffer;
+    if(modified)
+    {
+      i = 1+snprintf(buffer, buffersize,
+      "%6d%-54.54s# / TYPES OF OBSERV", Parser->info[RTCM3_MSM_GPS].numtypes,
+      Parser->fieldbuffer);
+      if(Parser->info[RTCM3_MSM_GPS].numtypes>9)
+      {
+        i += snprintf(buffer+i-1, buffersize,
+        "\n      %-54.54s# / TYPES OF OBSERV", Parser->fieldbuffer+9*6);
+      }
+      if(Parser->info[RTCM3_MSM_GPS].numtypes>18)
+      {
+        i += snprintf(buffer+i-1, buffersize,
+        "\n      %-54.54s# / TYPES OF OBSERV", Parser->fieldbuffer+18*6);
+      }
+      buffer += i; buffersize -= i;
+    }
+  }
+  return buffersizeold - buffersize;
+}
+
+void HandleHeader(struct RTCM3ParserData *Parser)
+{
+#ifdef NO_RTCM3_MAIN
+  int flags, modified = 0;
+  if(Parser->allflags == 0)
+    Parser->allflags = ~0;
+  flags = Parser->allflags;
+  if(Parser->rinex3)
+  {
+    struct HeaderData *hdata = 0;
+    CHECKFLAGSNEW(GPS, C1,  C1C)
+    CHECKFLAGSNEW(GPS, L1C, L1C)
+    CHECKFLAGSNEW(GPS, D1C, D1C)
+    CHECKFLAGSNEW(GPS, S1C, S1C)
+    CHECKFLAGSNEW(GPS, P1,  C1P)
+    CHECKFLAGSNEW(GPS, L1P, L1P)
+    CHECKFLAGSNEW(GPS, D1P, D1P)
+    CHECKFLAGSNEW(GPS, S1P, S1P)
+    CHECKFLAGSNEW(GPS, P2,  C2P)
+    CHECKFLAGSNEW(GPS, L2P, L2P)
+    CHECKFLAGSNEW(GPS, D2P, D2P)
+    CHECKFLAGSNEW(GPS, S2P, S2P)
+    CHECKFLAGSNEW(GPS, C2,  C2X)
+    CHECKFLAGSNEW(GPS, L2C, L2X)
+    CHECKFLAGSNEW(GPS, D2C, D2X)
+    CHECKFLAGSNEW(GPS, S2C, S2X)
+    CHECKFLAGSNEW(GLONASS, C1,  C1C)
+    CHECKFLAGSNEW(GLONASS, L1C, L1C)
+    CHECKFLAGSNEW(GLONASS, D1C, D1C)
+    CHECKFLAGSNEW(GLONASS, S1C, S1C)
+    CHECKFLAGSNEW(GLONASS, P1,  C1P)
+    CHECKFLAGSNEW(GLONASS, L1P, L1P)
+    CHECKFLAGSNEW(GLONASS, D1P, D1P)
+    CHECKFLAGSNEW(GLONASS, S1P, S1P)
+    CHECKFLAGSNEW(GLONASS, P2,  C2P)
+    CHECKFLAGSNEW(GLONASS, L2P, L2P)
+    CHECKFLAGSNEW(GLONASS, D2P, D2P)
+    CHECKFLAGSNEW(GLONASS, S2P, S2P)
+    CHECKFLAGSNEW(GLONASS, C2,  C2C)
+    CHECKFLAGSNEW(GLONASS, L2C, L2C)
+    CHECKFLAGSNEW(GLONASS, D2C, D2C)
+    CHECKFLAGSNEW(GLONASS, S2C, S2C)
+  }
+  else
+  {
+    CHECKFLAGS(C1,C1)
+    CHECKFLAGS(C2,C2)
+    CHECKFLAGS(P1,P1)
+    CHECKFLAGS(P2,P2)
+    CHECKFLAGS(L1C,L1)
+    CHECKFLAGS(L1P,L1)
+    CHECKFLAGS(L2C,L2)
+    CHECKFLAGS(L2P,L2)
+    CHECKFLAGS(D1C,D1)
+    CHECKFLAGS(D1P,D1)
+    CHECKFLAGS(D2C,D2)
+    CHECKFLAGS(D2P,D2)
+    CHECKFLAGS(S1C,S1)
+    CHECKFLAGS(S1P,S1)
+    CHECKFLAGS(S2C,S2)
+    CHECKFLAGS(S2P,S2)
+    CHECKFLAGS(C5,C5)
+    CHECKFLAGS(L5,L5)
+    CHECKFLAGS(D5,D5)
+    CHECKFLAGS(S5,S5)
+    CHECKFLAGS(C5AB,C8)
+    CHECKFLAGS(L5AB,L8)
+    CHECKFLAGS(D5AB,D8)
+    CHECKFLAGS(S5AB,S8)
+    CHECKFLAGS(C5B,C7)
+    CHECKFLAGS(L5B,L7)
+    CHECKFLAGS(D5B,D7)
+    CHECKFLAGS(S5B,S7)
+    CHECKFLAGS(C6,C6)
+    CHECKFLAGS(L6,L6)
+    CHECKFLAGS(D6,D6)
+    CHECKFLAGS(S6,S6)
+  }
+#else /* NO_RTCM3_MAIN */
+  struct HeaderData hdata;
+  char thebuffer[MAXHEADERBUFFERSIZE];
+  char *buffer = thebuffer;
+  size_t buffersize = sizeof(thebuffer);
+  int i;
+
+  memset(&hdata, 0, sizeof(hdata));
+
+  hdata.data.named.version = buffer;
+  i = 1+snprintf(buffer, buffersize,
+  "%9.2f           OBSERVATION DATA    M (Mixed)"
+  "           RINEX VERSION / TYPE", Parser->rinex3 ? 3.0 : 2.11);
+  buffer += i; buffersize -= i;
+
+  {
+    const char *str;
+    hdata.data.named.pgm = buffer;
+    i = HandleRunBy(buffer, buffersize, &str, Parser->rinex3);
+    buffer += i; buffersize -= i;
+    hdata.data.named.observer = buffer;
+    i = 1+snprintf(buffer, buffersize,
+    "%-20.20s                                        "
+    "OBSERVER / AGENCY", str);
+    buffer += i; buffersize -= i;
+  }
+
+  hdata.data.named.marker =
+  "RTCM3TORINEX                                                "
+  "MARKER NAME";
+
+  hdata.data.named.markertype =  !Parser->rinex3 ? 0 :
+  "GEODETIC                                                    "
+  "MARKER TYPE";
+
+  hdata.data.named.receiver =
+  "                                                            "
+  "REC # / TYPE / VERS";
+
+  hdata.data.named.antenna =
+  "                                                            "
+  "ANT # / TYPE";
+
+  if(Parser->refpos[0] || Parser->refpos[1] || Parser->refpos[2])
+  {
+    hdata.data.named.position = buffer;
+    i = 1+snprintf(buffer, buffersize,
+    "%14.4f%14.4f%14.4f                  APPROX POSITION XYZ",
+    Parser->refpos[0], Parser->refpos[1], Parser->refpos[2]);
+    buffer += i; buffersize -= i;
+  }
+  else
+    hdata.data.named.position =
+    "         .0000         .0000         .0000                  "
+    "APPROX POSITION XYZ";
+
+  hdata.data.named.antennaposition =
+  "         .0000         .0000         .0000                  "
+  "ANTENNA: DELTA H/E/N";
+
+  hdata.data.named.wavelength = Parser->rinex3 ? 0 :
+  "     1     1                                                "
+  "WAVELENGTH FACT L1/2";
+
+  hdata.numheaders = 18;
+
+  i = HandleObsHeader(Parser, buffer, buffersize, &hdata);
+  buffer += i; buffersize -= i;
+
+  {
+    struct converttimeinfo cti;
+    converttime(&cti, Parser->Data->week,
+    (int)floor(Parser->Data->timeofweek/1000.0));
+    hdata.data.named.timeoffirstobs = buffer;
+    i = 1+snprintf(buffer, buffersize,
+    "  %4d    %2d    %2d    %2d    %2d   %10.7f     GPS         "
+    "TIME OF FIRST OBS", cti.year, cti.month, cti.day, cti.hour,
+    cti.minute, cti.second + fmod(Parser->Data->timeofweek/1000.0,1.0));
+
+    buffer += i; buffersize -= i;
+  }
+
+  if(Parser->headerfile)
+  {
+    FILE *fh;
+    if((fh = fopen(Parser->headerfile, "r")))
+    {
+      size_t siz;
+      char *lastblockstart;
+      if((siz = fread(buffer, 1, buffersize-1, fh)) > 0)
+      {
+        buffer[siz] = '\n';
+        if(siz == buffersize)
+        {
+          RTCM3Error("Header file is too large. Only %d bytes read.",
+          (int)siz);
+        }
+        /* scan the file line by line and enter the entries in the list */
+        /* warn for "# / TYPES OF OBSERV" and "TIME OF FIRST OBS" */
+        /* overwrites entries, except for comments */
+        lastblockstart = buffer;
+        for(i = 0; i < (int)siz; ++i)
+        {
+          if(buffer[i] == '\n')
+          { /* we found a line */
+            char *end;
+            while(buffer[i+1] == '\r')
+              ++i; /* skip \r in case there are any */
+            end = buffer+i;
+            while(*end == '\t' || *end == ' ' || *end == '\r' || *end == '\n')
+              *(end--) = 0;
+            if(end-lastblockstart < 60+5) /* short line */
+              RTCM3Error("Short Header line '%s' ignored.\n", lastblockstart);
+            else
+            {
+              int pos;
+              if(!strcmp("COMMENT", lastblockstart+60))
+                pos = hdata.numheaders;
+              else
+              {
+                for(pos = 0; pos < hdata.numheaders; ++pos)
+                {
+                  if(hdata.data.unnamed[pos] &&
+                  !strcmp(hdata.data.unnamed[pos]+60, lastblockstart+60))
+                    break;
+                }
+                if(!strcmp("# / TYPES OF OBSERV", lastblockstart+60)
+                || !strcmp("SYS / # / OBS TYPES", lastblockstart+60)
+                || !strcmp("TIME OF FIRST OBS", lastblockstart+60))
+                {
+                  RTCM3Error("Overwriting header '%s' is dangerous.\n",
+                  lastblockstart+60);
+                }
+              }
+              if(pos >= MAXHEADERLINES)
+              {
+                RTCM3Error("Maximum number of header lines of %d reached.\n",
+                MAXHEADERLINES);
+              }
+              else if(!strcmp("END OF HEADER", lastblockstart+60))
+              {
+                RTCM3Error("End of header ignored.\n");
+              }
+              else
+              {
+                hdata.data.unnamed[pos] = lastblockstart;
+                if(pos == hdata.numheaders)
+                  ++hdata.numheaders;
+              }
+            }
+            lastblockstart = buffer+i+1;
+          }
+        }
+      }
+      else
+      {
+        RTCM3Error("Could not read data from headerfile '%s'.\n",
+        Parser->headerfile);
+      }
+      fclose(fh);
+    }
+    else
+    {
+      RTCM3Error("Could not open header datafile '%s'.\n",
+      Parser->headerfile);
+    }
+  }
+
+  for(i = 0; i < hdata.numheaders; ++i)
+  {
+    if(hdata.data.unnamed[i] && hdata.data.unnamed[i][0])
+      RTCM3Text("%s\n", hdata.data.unnamed[i]);
+  }
+  RTCM3Text("                                                            "
+  "END OF HEADER\n");
+#endif
+}
+
+/* Writes a navigation line: prefix and then for each 'D' in fields a
+   "%19.12e" value with 'D' exponent, for each ' ' 19 blanks. */
+static void ConvLine(FILE *file, const char *prefix, const char *fields, ...)
+{
+  char buffer[256];
+  size_t n = strlen(prefix);
+  va_list v;
+  va_start(v, fields);
+  if(n > 64)
+    n = 64;
+  memcpy(buffer, prefix, n);
+  for(; *fields && n < sizeof(buffer)-33; ++fields)
+  {
+    if(*fields == 'D')
+      n += FormatExp(buffer+n, va_arg(v, double));
+    else
+    {
+      memset(buffer+n, ' ', 19);
+      n += 19;
+    }
+  }
+  buffer[n++] = '\n';
+  fwrite(buffer, 1, n, file);
+  va_end(v);
+}
+
+#ifndef NO_RTCM3_MAIN
+/* Quality control. The statistics are collected for each output epoch in
+   fixed accumulators per satellite and written by QCReport when the output
+   ends, every QC_INTERVAL seconds and when a stream connection ends. */
+#define QC_GFLIMIT 0.05 /* geometry-free phase jump of a slip [m] */
+#define QC_MWLIMIT 4.0  /* Melbourne-Wuebbena offset of a slip [cycles] */
+#define QC_INTERVAL 60  /* seconds between two reports of a conversion */
+
+/* observation types of the bands, in order of preference */
+static const int qctypes[QC_NUMBANDS][3] = {
+{GNSSENTRY_TYPEC1, GNSSENTRY_TYPEP1, GNSSENTRY_TYPEC1N},
+{GNSSENTRY_TYPEC2, GNSSENTRY_TYPEP2, -1}, {GNSSENTRY_TYPEC5, -1, -1},
+{GNSSENTRY_TYPEC6, -1, -1}, {GNSSENTRY_TYPEC5B, -1, -1},
+{GNSSENTRY_TYPEC5AB, -1, -1}, {GNSSENTRY_TYPECSAIF, -1, -1}};
+
+static const unsigned int qclockflags[QC_NUMBANDS] = {
+GNSSDF2_LOCKLOSSL1, GNSSDF2_LOCKLOSSL2, GNSSDF2_LOCKLOSSL5,
+GNSSDF2_LOCKLOSSE6, GNSSDF2_LOCKLOSSE5B, GNSSDF2_LOCKLOSSE5AB,
+GNSSDF2_LOCKLOSSSAIF};
+
+/* RINEX 3 names and frequencies [Hz] of the bands by RTCM3_MSM_xxx,
+   GLONASS frequencies depend on the channel */
+static const char qcbandnames[RTCM3_MSM_NUMSYS][QC_NUMBANDS][3] = {
+{"L1", "L2", "L5", "", "", "", ""}, {"L1", "L2", "", "", "", "", ""},
+{"L1", "", "L5", "L6", "L7", "L8", ""}, {"L1", "", "L5", "", "", "", ""},
+{"L1", "L2", "L5", "L6", "", "", "LZ"}, {"L1", "", "", "L6", "L7", "", ""}};
+static const double qcfrequencies[RTCM3_MSM_NUMSYS][QC_NUMBANDS] = {
+{GPS_FREQU_L1, GPS_FREQU_L2, GPS_FREQU_L5, 0, 0, 0, 0},
+{0, 0, 0, 0, 0, 0, 0},
+{GAL_FREQU_E1, 0, GAL_FREQU_E5A, GAL_FREQU_E6, GAL_FREQU_E5B,
+GAL_FREQU_E5AB, 0},
+{GPS_FREQU_L1, 0, GPS_FREQU_L5, 0, 0, 0, 0},
+{QZSS_FREQU_L1, QZSS_FREQU_L2, QZSS_FREQU_L5, QZSS_FREQU_LEX, 0, 0,
+QZSS_FREQU_L1},
+{BDS_FREQU_B1, 0, 0, BDS_FREQU_B3, BDS_FREQU_B2, 0, 0}};
+/* second band of the dual frequency combinations, the first is band 0 */
+static const int qcsecond[RTCM3_MSM_NUMSYS] = {1, 1, 2, 2, 1, 4};
+
+/* returns RTCM3_MSM_xxx of a satellite or -1 */
+static int QCSystem(int sat)
+{
+  if(sat >= 1 && sat <= PRN_GPS_END) return RTCM3_MSM_GPS;
+  if(sat >= PRN_GLONASS_START && sat <= PRN_GLONASS_END)
+    return RTCM3_MSM_GLONASS;
+  if(sat >= PRN_GALGIO_START && sat <= PRN_GALGIO_END)
+    return RTCM3_MSM_GALILEO;
+  if(sat >= PRN_SBAS_START && sat <= PRN_SBAS_END) return RTCM3_MSM_SBAS;
+  if(sat >= PRN_BDS_START && sat <= PRN_BDS_END) return RTCM3_MSM_BDS;
+  if(sat >= PRN_QZSS_START && sat <= PRN_QZSS_END) return RTCM3_MSM_QZSS;
+  return -1;
+}
+
+/* frequency of band b [Hz], 0 if unknown */
+static double QCFrequency(const struct RTCM3ParserData *Parser, int sys,
+int sat, int b)
+{
+  if(sys == RTCM3_MSM_GLONASS)
+  {
+    int k = Parser->GLOFreq[sat-PRN_GLONASS_START];
+    if(!k)
+      return 0.0;
+    return b == 0 ? GLO_FREQU_L1(k-100) : b == 1 ? GLO_FREQU_L2(k-100) : 0.0;
+  }
+  return qcfrequencies[sys][b];
+}
+
+/* the current multipath arc ends, its variance is added to the totals */
+static void QCArcEnd(struct qcband *b)
+{
+  if(b->arcnum > 1)
+  {
+    b->mpsum2 += b->arcsum2 - b->arcsum*b->arcsum/b->arcnum;
+    b->mpnum += b->arcnum-1;
+  }
+  b->arcnum = 0;
+}
+
+static void QCArcAdd(struct qcband *b, double mp)
+{
+  if(!b->arcnum++)
+  {
+    b->arcfirst = mp;
+    b->arcsum = b->arcsum2 = 0.0;
+  }
+  mp -= b->arcfirst;
+  b->arcsum += mp;
+  b->arcsum2 += mp*mp;
+}
+
+/* Slips and multipath from code p [m] and phase l [cycles] of bands a and
+   b. A gap in the data or loss of lock starts a new arc without a slip. */
+static void QCPair(struct qcdata *qc, struct qcsat *s, int a, int b,
+double fa, double fb, const double *p, const double *l, int lli)
+{
+  double la = l[a]*LIGHTSPEED/fa, lb = l[b]*LIGHTSPEED/fb;
+  double gf = la-lb, alpha = fa*fa/(fb*fb);
+  double mw = ((fa*la-fb*lb)/(fa-fb) - (fa*p[a]+fb*p[b])/(fa+fb))
+  *(fa-fb)/LIGHTSPEED;
+  int arc = lli || s->last != qc->epochs-2;
+
+  if(!arc)
+  {
+    if(fabs(gf-s->gf) > QC_GFLIMIT)
+    {
+      ++s->gfslips;
+      arc = 1;
+    }
+    if(s->mwnum && fabs(mw-s->mwsum/s->mwnum) > QC_MWLIMIT)
+    {
+      ++s->mwslips;
+      arc = 1;
+    }
+  }
+  if(arc)
+  {
+    QCArcEnd(s->band+a);
+    QCArcEnd(s->band+b);
+    s->mwnum = 0;
+    s->mwsum = 0.0;
+  }
+  s->gf = gf;
+  ++s->mwnum;
+  s->mwsum += mw;
+  s->last = qc->epochs-1;
+  QCArcAdd(s->band+a, p[a] - (1.0+2.0/(alpha-1.0))*la
+  + 2.0/(alpha-1.0)*lb);
+  QCArcAdd(s->band+b, p[b] - 2.0*alpha/(alpha-1.0)*la
+  + (2.0*alpha/(alpha-1.0)-1.0)*lb);
+}
+
+/* adds the epoch in Parser->Data to the statistics */
+static void QCEpoch(struct RTCM3ParserData *Parser)
+{
+  const struct gnssdata *g = Parser->Data;
+  struct qcdata *qc = Parser->qc;
+  int i, b, k;
+
+  if(!qc->epochs++)
+  {
+    qc->firstweek = g->week;
+    qc->firsttow = g->timeofweek;
+  }
+  qc->lastweek = g->week;
+  qc->lasttow = g->timeofweek;
+  for(i = 0; i < g->numsats; ++i)
+  {
+    int sat = g->satellites[i], sys = QCSystem(sat), havep = 0, havel = 0;
+    unsigned int lli = 0;
+    double p[QC_NUMBANDS], l[QC_NUMBANDS];
+    struct qcsat *s;
+
+    if(sys < 0)
+      continue;
+    s = qc->sat+sat;
+    if(!s->epochs++)
+      s->last = -2;
+    for(b = 0; b < QC_NUMBANDS; ++b)
+    {
+      int t = -1, e;
+
+      for(k = 0; k < 3 && t < 0 && qctypes[b][k] >= 0; ++k)
+      {
+        if(g->dataflags[i] & ((1ULL<<(qctypes[b][k]+GNSSENTRY_CODE))
+        | (1ULL<<(qctypes[b][k]+GNSSENTRY_PHASE))))
+          t = qctypes[b][k];
+      }
+      if(t < 0)
+        continue;
+      ++s->band[b].obs;
+      if(g->dataflags[i] & (1ULL<<(e = t+GNSSENTRY_CODE)))
+      {
+        p[b] = GNSSVALUE(g, i, e);
+        havep |= 1<<b;
+      }
+      if(g->dataflags[i] & (1ULL<<(e = t+GNSSENTRY_PHASE)))
+      {
+        l[b] = GNSSVALUE(g, i, e);
+        havel |= 1<<b;
+        if(g->dataflags2[i] & qclockflags[b])
+        {
+          ++s->band[b].lli;
+          lli = 1;
+        }
+      }
+      if(g->dataflags[i] & (1ULL<<(e = t+GNSSENTRY_SNR)))
+      {
+        double snr = GNSSVALUE(g, i, e);
+        int bin = snr < 20.0 ? 0 : snr >= 55.0 ? QC_NUMSNRBINS-1
+        : 1+(int)((snr-20.0)/5.0);
+        ++s->band[b].snrnum;
+        s->band[b].snrsum += snr;
+        ++qc->snr[sys][b][bin];
+      }
+    }
+    b = qcsecond[sys];
+    if((havep & havel & 1) && (havep & havel & (1<<b)))
+    {
+      double fa = QCFrequency(Parser, sys, sat, 0);
+      double fb = QCFrequency(Parser, sys, sat, b);
+      if(fa && fb)
+        QCPair(qc, s, 0, b, fa, fb, p, l, lli);
+    }
+  }
+}
+
+/* writes the summary of the quality control to Parser->qcfile, through a
+   temporary file, so a reader never sees a partial report. The
+   accumulators are not changed, the report may come at any epoch. */
+static void QCReport(const struct RTCM3ParserData *Parser)
+{
+  static const char sysnames[RTCM3_MSM_NUMSYS+1] = "GRESJC";
+  const struct qcdata *qc = Parser->qc;
+  struct converttimeinfo cti;
+  char *tmp;
+  FILE *f;
+  int sat, b, k, sys;
+
+  if(!(tmp = malloc(strlen(Parser->qcfile)+5)))
+    return;
+  sprintf(tmp, "%s.tmp", Parser->qcfile);
+  if(!(f = fopen(tmp, "w")))
+  {
+    RTCM3Error("Could not open quality control file '%s'.\n", tmp);
+    free(tmp);
+    return;
+  }
+  fprintf(f, "QUALITY CONTROL SUMMARY\n");
+  if(qc->epochs)
+  {
+    converttime(&cti, qc->firstweek, (int)floor(qc->firsttow/1000.0));
+    fprintf(f, "First epoch: %04d-%02d-%02d %02d:%02d:%06.3f\n", cti.year,
+    cti.month, cti.day, cti.hour, cti.minute,
+    cti.second + fmod(qc->firsttow/1000.0, 1.0));
+    converttime(&cti, qc->lastweek, (int)floor(qc->lasttow/1000.0));
+    fprintf(f, "Last epoch:  %04d-%02d-%02d %02d:%02d:%06.3f\n", cti.year,
+    cti.month, cti.day, cti.hour, cti.minute,
+    cti.second + fmod(qc->lasttow/1000.0, 1.0));
+  }
+  fprintf(f, "Epochs:      %d\n\n"
+  "Completeness relative to the epochs of the satellite, slips from\n"
+  "loss of lock (LLI), geometry-free phase (GF, > %.2f m) and\n"
+  "Melbourne-Wuebbena (MW, > %.0f cycles) of the dual frequency pair,\n"
+  "code multipath RMS of each arc without its mean.\n\n"
+  "Sat Epochs   GF   MW Band   Obs Compl%%   LLI  SNR  MP [m]\n",
+  qc->epochs, QC_GFLIMIT, QC_MWLIMIT);
+  for(sat = 0; sat <= PRN_MAX; ++sat)
+  {
+    const struct qcsat *s = qc->sat+sat;
+    int line = 0, num;
+
+    if(!s->epochs || (sys = QCSystem(sat)) < 0)
+      continue;
+    num = sat - (sys == RTCM3_MSM_GLONASS ? PRN_GLONASS_START-1
+    : sys == RTCM3_MSM_GALILEO ? (sat >= PRN_GIOVE_START
+    ? PRN_GIOVE_START-PRN_GIOVE_OFFSET : PRN_GALILEO_START-1)
+    : sys == RTCM3_MSM_SBAS ? PRN_SBAS_START-20
+    : sys == RTCM3_MSM_BDS ? PRN_BDS_START-1
+    : sys == RTCM3_MSM_QZSS ? PRN_QZSS_START-1 : 0);
+    for(b = 0; b < QC_NUMBANDS; ++b)
+    {
+      struct qcband c = s->band[b], *d = &c; /* the open arc goes on */
+
+      if(!d->obs)
+        continue;
+      QCArcEnd(d);
+      if(!line++)
+      {
+        fprintf(f, "%c%02d %6d %4d %4d ", sysnames[sys], num, s->epochs,
+        s->gfslips, s->mwslips);
+      }
+      else
+        fprintf(f, "%22s", "");
+      fprintf(f, "%-4s %5d %6.1f %5d", qcbandnames[sys][b][0]
+      ? qcbandnames[sys][b] : "?", d->obs, 100.0*d->obs/s->epochs, d->lli);
+      if(d->snrnum)
+        fprintf(f, " %4.1f", d->snrsum/d->snrnum);
+      else
+        fprintf(f, "    -");
+      if(d->mpnum)
+        fprintf(f, " %7.3f\n", sqrt(d->mpsum2/d->mpnum));
+      else
+        fprintf(f, "       -\n");
+    }
+  }
+  fprintf(f, "\nSNR distribution [dB-Hz]  <20 20-25 25-30 30-35 35-40 40-45"
+  " 45-50 50-55   >55\n");
+  for(sys = 0; sys < RTCM3_MSM_NUMSYS; ++sys)
+  {
+    for(b = 0; b < QC_NUMBANDS; ++b)
+    {
+      int sum = 0;
+      for(k = 0; k < QC_NUMSNRBINS; ++k)
+        sum += qc->snr[sys][b][k];
+      if(!sum)
+        continue;
+      fprintf(f, "%c %-4s%*s", sysnames[sys], qcbandnames[sys][b][0]
+      ? qcbandnames[sys][b] : "?", 20, "");
+      for(k = 0; k < QC_NUMSNRBINS; ++k)
+        fprintf(f, " %5d", qc->snr[sys][b][k]);
+      fprintf(f, "\n");
+    }
+  }
+  if(fclose(f) || rename(tmp, Parser->qcfile))
+  {
+    RTCM3Error("Could not write quality control file '%s'.\n",
+    Parser->qcfile);
+    remove(tmp);
+  }
+  free(tmp);
+}
+#endif /* NO_RTCM3_MAIN */
+
+#if !defined(NO_RTCM3_MAIN) && defined(__linux__)
+/* The output files of a stream list can be written with io_uring, so a
+   converting thread does not wait for the disk. Each thread has a ring
+   and an area of registered buffers. A write is copied to a free buffer
+   and queued at the offset of the file, the queue is submitted after a
+   round of conversions or when it is full. Every URINGSYNC seconds a
+   fdatasync is linked to the next write of a file without writes in
+   flight. Without a free buffer the data is copied to the heap, without
+   io_uring or its write operations the files are written directly, as
+   is a write refused for the file. */
+#define URINGENTRIES 256 /* submission queue */
+#define URINGCQ 4096     /* completion queue */
+#define URINGSLOTS 128   /* registered buffers */
+#define URINGSLOTSIZE (16*1024)
+#define URINGSYNC 10     /* seconds between syncs of a file */
+
+struct UringFile
+{
+  const char *name;
+  int fd;
+  off_t offset;  /* of the next write */
+  time_t synced; /* time of the last sync */
+  int inflight;  /* operations not completed, atomic */
+  int errors;    /* atomic */
+};
+
+/* a queued operation, slot -1 for data on the heap and -2 for a sync */
+struct UringOp
+{
+  struct UringFile *file;
+  int slot;
+  unsigned int size;
+  off_t offset;
+  char data[1];
+};
+
+struct Uring
+{
+  int fd;
+  void *sqmap, *cqmap;
+  size_t sqmapsize, cqmapsize, sqesize;
+  unsigned int *sqhead, *sqtail, *sqmask, *sqentries, *sqflags, *sqarray;
+  unsigned int *cqhead, *cqtail, *cqmask;
+  struct io_uring_sqe *sqes;
+  struct io_uring_cqe *cqes;
+  unsigned int queued;  /* not submitted */
+  unsigned int pending; /* submitted and not completed */
+  char *area;           /* the buffers */
+  int fixed;            /* area is registered */
+  struct UringOp ops[URINGSLOTS];
+  int freeslot[URINGSLOTS];
+  int numfree;
+  long writes, fixedwrites, syncs;
+  uint64_t bytes;
+};
+
+static THREADLOCAL struct Uring *uring; /* ring of this thread */
+static int uringunavailable;
+/* totals of the finished rings */
+static long uringwrites, uringfixed, uringsyncs, uringerrors;
+static uint64_t uringbytes;
+
+static void UringDestroy(struct Uring *u)
+{
+  if(u->sqes)
+    munmap(u->sqes, u->sqesize);
+  if(u->cqmap)
+    munmap(u->cqmap, u->cqmapsize);
+  if(u->sqmap)
+    munmap(u->sqmap, u->sqmapsize);
+  if(u->area)
+    munmap(u->area, URINGSLOTS*URINGSLOTSIZE);
+  close(u->fd);
+  free(u);
+}
+
+/* whether the kernel knows the used operations, IORING_OP_WRITE is newer
+   than io_uring itself */
+static int UringProbe(int fd)
+{
+  struct io_uring_probe *p;
+  const int ops[] = {IORING_OP_WRITE, IORING_OP_WRITE_FIXED, IORING_OP_FSYNC};
+  int res = 0, i;
+
+  if((p = calloc(1, sizeof(*p)+256*sizeof(p->ops[0]))))
+  {
+    if(!syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, p, 256))
+    {
+      for(res = 1, i = 0; i < (int)(sizeof(ops)/sizeof(ops[0])); ++i)
+      {
+        if(ops[i] > p->last_op
+        || !(p->ops[ops[i]].flags & IO_URING_OP_SUPPORTED))
+          res = 0;
+      }
+    }
+    free(p);
+  }
+  return res;
+}
+
+static struct Uring *UringCreate(void)
+{
+  struct io_uring_params p;
+  struct Uring *u;
+  struct iovec iov;
+  char *m;
+  int i;
+
+  if(!(u = calloc(1, sizeof(*u))))
+    return 0;
+  memset(&p, 0, sizeof(p));
+  p.flags = IORING_SETUP_CQSIZE;
+  p.cq_entries = URINGCQ;
+  if((u->fd = syscall(__NR_io_uring_setup, URINGENTRIES, &p)) == -1)
+  {
+    if(!__atomic_exchange_n(&uringunavailable, 1, __ATOMIC_SEQ_CST))
+      RTCM3Error("io_uring is not available (%s), files are written "
+      "directly.\n", strerror(errno));
+    free(u);
+    return 0;
+  }
+  if(!UringProbe(u->fd))
+  {
+    if(!__atomic_exchange_n(&uringunavailable, 1, __ATOMIC_SEQ_CST))
+      RTCM3Error("io_uring does not support writes, files are written "
+      "directly.\n");
+    close(u->fd);
+    free(u);
+    return 0;
+  }
+  u->sqmapsize = p.sq_off.array+p.sq_entries*sizeof(unsigned int);
+  u->cqmapsize = p.cq_off.cqes+p.cq_entries*sizeof(struct io_uring_cqe);
+  u->sqesize = p.sq_entries*sizeof(struct io_uring_sqe);
+  if((u->sqmap = mmap(0, u->sqmapsize, PROT_READ|PROT_WRITE,
+  MAP_SHARED|MAP_POPULATE, u->fd, IORING_OFF_SQ_RING)) == MAP_FAILED)
+    u->sqmap = 0;
+  if((u->cqmap = mmap(0, u->cqmapsize, PROT_READ|PROT_WRITE,
+  MAP_SHARED|MAP_POPULATE, u->fd, IORING_OFF_CQ_RING)) == MAP_FAILED)
+    u->cqmap = 0;
+  if((u->sqes = mmap(0, u->sqesize, PROT_READ|PROT_WRITE,
+  MAP_SHARED|MAP_POPULATE, u->fd, IORING_OFF_SQES)) == MAP_FAILED)
+    u->sqes = 0;
+  if((u->area = mmap(0, URINGSLOTS*URINGSLOTSIZE, PROT_READ|PROT_WRITE,
+  MAP_PRIVATE|MAP_ANONYMOUS, -1, 0)) == MAP_FAILED)
+    u->area = 0;
+  if(!u->sqmap || !u->cqmap || !u->sqes || !u->area)
+  {
+    if(!__atomic_exchange_n(&uringunavailable, 1, __ATOMIC_SEQ_CST))
+      RTCM3Error("Could not map io_uring, files are written directly.\n");
+    UringDestroy(u);
+    return 0;
+  }
+  m = u->sqmap;
+  u->sqhead = (unsigned int *)(m+p.sq_off.head);
+  u->sqtail = (unsigned int *)(m+p.sq_off.tail);
+  u->sqmask = (unsigned int *)(m+p.sq_off.ring_mask);
+  u->sqentries = (unsigned int *)(m+p.sq_off.ring_entries);
+  u->sqflags = (unsigned int *)(m+p.sq_off.flags);
+  u->sqarray = (unsigned int *)(m+p.sq_off.array);
+  m = u->cqmap;
+  u->cqhead = (unsigned int *)(m+p.cq_off.head);
+  u->cqtail = (unsigned int *)(m+p.cq_off.tail);
+  u->cqmask = (unsigned int *)(m+p.cq_off.ring_mask);
+  u->cqes = (struct io_uring_cqe *)(m+p.cq_off.cqes);
+
+  /* without registering (locked memory limit) the area is used as well */
+  iov.iov_base = u->area;
+  iov.iov_len = URINGSLOTS*URINGSLOTSIZE;
+  u->fixed = !syscall(__NR_io_uring_register, u->fd, IORING_REGISTER_BUFFERS,
+  &iov, 1);
+  for(i = 0; i < URINGSLOTS; ++i)
+  {
+    u->ops[i].slot = i;
+    u->freeslot[i] = URINGSLOTS-1-i;
+  }
+  u->numfree = URINGSLOTS;
+  return u;
+}
+
+static void UringReap(struct Uring *u)
+{
+  unsigned int head = *u->cqhead;
+
+  while(head != __atomic_load_n(u->cqtail, __ATOMIC_ACQUIRE))
+  {
+    struct io_uring_cqe *c = u->cqes+(head & *u->cqmask);
+    struct UringOp *op = (struct UringOp *)(uintptr_t)c->user_data;
+    struct UringFile *f = op->file;
+    int res = c->res;
+
+    if(op->slot != -2 && (res == -EINVAL || res == -EOPNOTSUPP))
+    { /* the file does not support it, a linked sync is cancelled */
+      res = pwrite(f->fd, op->slot >= 0 ? u->area+op->slot*URINGSLOTSIZE
+      : op->data, op->size, op->offset);
+    }
+    if(op->slot == -2 ? res < 0 && res != -ECANCELED
+    : res < 0 || (unsigned int)res != op->size)
+      __atomic_add_fetch(&f->errors, 1, __ATOMIC_RELAXED);
+    if(op->slot >= 0)
+      u->freeslot[u->numfree++] = op->slot;
+    else
+      free(op);
+    __atomic_sub_fetch(&f->inflight, 1, __ATOMIC_RELEASE);
+    --u->pending;
+    ++head;
+  }
+  __atomic_store_n(u->cqhead, head, __ATOMIC_RELEASE);
+}
+
+/* submits the queued operations and handles the completions, with wait
+   for at least one completion. Completions exceeding the queue are kept
+   by the kernel until they are requested. */
+static void UringSubmit(struct Uring *u, int wait)
+{
+  int n, get;
+
+  wait = wait && (u->queued || u->pending);
+  get = wait || (__atomic_load_n(u->sqflags, __ATOMIC_RELAXED)
+  & IORING_SQ_CQ_OVERFLOW);
+  if(u->queued || get)
+  {
+    n = syscall(__NR_io_uring_enter, u->fd, u->queued, wait ? 1 : 0,
+    get ? IORING_ENTER_GETEVENTS : 0, 0, 0);
+    if(n > 0)
+    {
+      u->queued -= n;
+      u->pending += n;
+    }
+  }
+  UringReap(u);
+}
+
+/* returns the next of need free submission entries */
+static struct io_uring_sqe *UringSqe(struct Uring *u, unsigned int need)
+{
+  unsigned int tail = *u->sqtail;
+  struct io_uring_sqe *e;
+
+  while(tail+need-__atomic_load_n(u->sqhead, __ATOMIC_ACQUIRE) > *u->sqentries)
+    UringSubmit(u, 0);
+  e = u->sqes+(tail & *u->sqmask);
+  memset(e, 0, sizeof(*e));
+  u->sqarray[tail & *u->sqmask] = tail & *u->sqmask;
+  return e;
+}
+
+static void UringQueue(struct Uring *u)
+{
+  __atomic_store_n(u->sqtail, *u->sqtail+1, __ATOMIC_RELEASE);
+  ++u->queued;
+}
+
+static ssize_t UringWrite(void *cookie, const char *buf, size_t size)
+{
+  struct UringFile *f = cookie;
+  struct Uring *u = uring;
+  size_t done = 0;
+
+  if(!u && !__atomic_load_n(&uringunavailable, __ATOMIC_RELAXED))
+    u = uring = UringCreate();
+  while(done < size && !u)
+  {
+    ssize_t n = pwrite(f->fd, buf+done, size-done, f->offset);
+    if(n <= 0)
+    {
+      ++f->errors;
+      return done;
+    }
+    done += n;
+    f->offset += n;
+  }
+  while(done < size)
+  {
+    unsigned int n = size-done > URINGSLOTSIZE ? URINGSLOTSIZE : size-done;
+    struct UringOp *op, *sync = 0;
+    struct io_uring_sqe *e;
+    char *data;
+
+    if(!u->numfree) /* buffered writes often complete at once */
+      UringSubmit(u, 0);
+    if(u->numfree)
+    {
+      op = u->ops+u->freeslot[--u->numfree];
+      data = u->area+op->slot*URINGSLOTSIZE;
+    }
+    else if((op = malloc(sizeof(*op)+n)))
+    {
+      op->slot = -1;
+      data = op->data;
+    }
+    else
+    {
+      ++f->errors;
+      return done;
+    }
+    memcpy(data, buf+done, n);
+    op->file = f;
+    op->size = n;
+    op->offset = f->offset;
+    if(time(0)-f->synced >= URINGSYNC
+    && !__atomic_load_n(&f->inflight, __ATOMIC_ACQUIRE)
+    && (sync = malloc(sizeof(*sync))))
+    {
+      sync->file = f;
+      sync->slot = -2;
+      f->synced = time(0);
+    }
+
+    e = UringSqe(u, sync ? 2 : 1);
+    e->opcode = op->slot >= 0 && u->fixed ? IORING_OP_WRITE_FIXED
+    : IORING_OP_WRITE;
+    e->fd = f->fd;
+    e->off = f->offset;
+    e->addr = (uintptr_t)data;
+    e->len = n;
+    e->user_data = (uintptr_t)op;
+    if(sync)
+      e->flags = IOSQE_IO_LINK;
+    __atomic_add_fetch(&f->inflight, 1, __ATOMIC_RELAXED);
+    UringQueue(u);
+    if(sync)
+    {
+      e = UringSqe(u, 1);
+      e->opcode = IORING_OP_FSYNC;
+      e->fd = f->fd;
+      e->fsync_flags = IORING_FSYNC_DATASYNC;
+      e->user_data = (uintptr_t)sync;
+      __atomic_add_fetch(&f->inflight, 1, __ATOMIC_RELAXED);
+      UringQueue(u);
+      ++u->syncs;
+    }
+    ++u->writes;
+    if(op->slot >= 0 && u->fixed)
+      ++u->fixedwrites;
+    u->bytes += n;
+    f->offset += n;
+    done += n;
+  }
+  return done;
+}
+
+/* waits for the writes of the file done by this thread */
+static int UringClose(void *cookie)
+{
+  struct UringFile *f = cookie;
+  int res = 0;
+
+  if(uring)
+  {
+    UringSubmit(uring, 0);
+    while(__atomic_load_n(&f->inflight, __ATOMIC_ACQUIRE) && uring->pending)
+      UringSubmit(uring, 1);
+  }
+  if(f->errors)
+  {
+    RTCM3Error("Could not write %s (%d errors).\n", f->name, f->errors);
+    __atomic_add_fetch(&uringerrors, f->errors, __ATOMIC_RELAXED);
+    res = -1;
+  }
+  if(close(f->fd))
+    res = -1;
+  free(f);
+  return res;
+}
+
+static FILE *UringOpen(const char *name)
+{
+  static cookie_io_functions_t io = {0, UringWrite, 0, UringClose};
+  struct UringFile *f;
+  FILE *file = 0;
+
+  if((f = calloc(1, sizeof(*f))))
+  {
+    f->name = name;
+    f->synced = time(0);
+    if((f->fd = open(name, O_WRONLY|O_CREAT|O_TRUNC, 0666)) == -1)
+      free(f);
+    else if(!(file = fopencookie(f, "w", io)))
+    {
+      close(f->fd);
+      free(f);
+    }
+  }
+  return file;
+}
+
+/* submits the writes queued by this thread */
+static void UringFlush(void)
+{
+  if(uring)
+    UringSubmit(uring, 0);
+}
+
+/* waits for all writes of this thread and removes its ring */
+static void UringFinish(void)
+{
+  struct Uring *u = uring;
+
+  if(u)
+  {
+    while(u->queued || u->pending)
+      UringSubmit(u, 1);
+    __atomic_add_fetch(&uringwrites, u->writes, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&uringfixed, u->fixedwrites, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&uringsyncs, u->syncs, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&uringbytes, u->bytes, __ATOMIC_RELAXED);
+    UringDestroy(u);
+    uring = 0;
+  }
+}
+#endif /* !NO_RTCM3_MAIN && __linux__ */
+
+/* opens a navigation output file */
+#ifdef NO_RTCM3_MAIN
+#define NavFile(Parser, name) fopen(name, "w")
+#else
+static FILE *NavFile(const struct RTCM3ParserData *Parser, const char *name)
+{
+  if(Parser->statepass)
+    return fopen("/dev/null", "w");
+  if(Parser->navtemp)
+    return tmpfile();
+#ifdef __linux__
+  if(Parser->uring)
+    return UringOpen(name);
+#endif
+  return fopen(name, "w");
+}
+#endif /* NO_RTCM3_MAIN */
+
+/* write RINEX output for a parser result */
+static void HandleResultText(struct RTCM3ParserData *Parser, int r)
+{
+  double ver = Parser->rinex3 ? 3.02 : 2.11;
+  if(r == 1020 || r == RTCM3ID_BDS || r == 1019 || r == 1044 || r == 1043)
+  {
+    FILE *file = 0;
+
+    if(Parser->mixedephemeris)
+    {
+      if(Parser->mixedephemeris != (const char *)1)
+      {
+        if(!(Parser->mixedfile = NavFile(Parser, Parser->mixedephemeris)))
+        {
+          RTCM3Error("Could not open ephemeris output file.\n");
+        }
+        else
+        {
+          char buffer[100];
+          fprintf(Parser->mixedfile,
+          "%9.2f%11sN: GNSS NAV DATA    M: Mixed%12sRINEX VERSION / TYPE\n", ver, "", "");
+          HandleRunBy(buffer, sizeof(buffer), 0, Parser->rinex3);
+          fprintf(Parser->mixedfile, "%s\n%60sEND OF HEADER\n", buffer, "");
+        }
+        Parser->mixedephemeris = (const char *)1;
+      }
+      file = Parser->mixedfile;
+    }
+    else
+    {
+      if(r == 1020)
+      {
+        if(Parser->glonassephemeris)
+        {
+          if(!(Parser->glonassfile = NavFile(Parser, Parser->glonassephemeris)))
+          {
+            RTCM3Error("Could not open GLONASS ephemeris output file.\n");
+          }
+          else
+          {
+            char buffer[100];
+            fprintf(Parser->glonassfile,
+            "%9.2f%11sG: GLONASS NAV DATA%21sRINEX VERSION / TYPE\n", ver, "", "");
+            HandleRunBy(buffer, sizeof(buffer), 0, Parser->rinex3);
+            fprintf(Parser->glonassfile, "%s\n%60sEND OF HEADER\n", buffer, "");
+          }
+          Parser->glonassephemeris = 0;
+        }
+        file = Parser->glonassfile;
+      }
+      else if(r == 1019)
+      {
+        if(Parser->gpsephemeris)
+        {
+          if(!(Parser->gpsfile = NavFile(Parser, Parser->gpsephemeris)))
+          {
+            RTCM3Error("Could not open GPS ephemeris output file.\n");
+          }
+          else
+          {
+            char buffer[100];
+            fprintf(Parser->gpsfile,
+            "%9.2f%11sN: GPS NAV DATA%25sRINEX VERSION / TYPE\n", ver, "", "");
+            HandleRunBy(buffer, sizeof(buffer), 0, Parser->rinex3);
+            fprintf(Parser->gpsfile, "%s\n%60sEND OF HEADER\n", buffer, "");
+          }
+          Parser->gpsephemeris = 0;
+        }
+        file = Parser->gpsfile;
+      }
+      else if(r == 1043)
+      {
+        if(Parser->sbasephemeris)
+        {
+          if(!(Parser->sbasfile = NavFile(Parser, Parser->sbasephemeris)))
+          {
+            RTCM3Error("Could not open SBAS ephemeris output file.\n");
+          }
+          else
+          {
+            char buffer[100];
+            fprintf(Parser->sbasfile,
+            "%9.2f%11sN: SBAS NAV DATA%24sRINEX VERSION / TYPE\n", ver, "", "");
+            HandleRunBy(buffer, sizeof(buffer), 0, Parser->rinex3);
+            fprintf(Parser->sbasfile, "%s\n%60sEND OF HEADER\n", buffer, "");
+          }
+          Parser->sbasephemeris = 0;
+        }
+        file = Parser->sbasfile;
+      }
+      else if(r == 1044)
+      {
+        if(Parser->qzssephemeris)
+        {
+          if(!(Parser->qzssfile = NavFile(Parser, Parser->qzssephemeris)))
+          {
+            RTCM3Error("Could not open QZSS ephemeris output file.\n");
+          }
+          else
+          {
+            char buffer[100];
+            fprintf(Parser->qzssfile,
+            "%9.2f%11sN: QZSS NAV DATA%24sRINEX VERSION / TYPE\n", ver, "", "");
+            HandleRunBy(buffer, sizeof(buffer), 0, Parser->rinex3);
+            fprintf(Parser->qzssfile, "%s\n%60sEND OF HEADER\n", buffer, "");
+          }
+          Parser->qzssephemeris = 0;
+        }
+        file = Parser->qzssfile;
+      }
+      else if(r == RTCM3ID_BDS)
+      {
+        if(Parser->bdsephemeris)
+        {
+          if(!(Parser->bdsfile = NavFile(Parser, Parser->bdsephemeris)))
+          {
+            RTCM3Error("Could not open BDS ephemeris output file.\n");
+          }
+          else
+          {
+            char buffer[100];
+            fprintf(Parser->bdsfile,
+            "%9.2f%11sN: BDS NAV DATA%25sRINEX VERSION / TYPE\n", ver, "", "");
+            HandleRunBy(buffer, sizeof(buffer), 0, Parser->rinex3);
+            fprintf(Parser->bdsfile, "%s\n%60sEND OF HEADER\n", buffer, "");
+          }
+          Parser->bdsephemeris = 0;
+        }
+        file = Parser->bdsfile;
+      }
+    }
+#ifndef NO_RTCM3_MAIN
+    if(file)
+    {
+      if(!Parser->ephemerisrepeat)
+        ++Parser->ephemerisWritten;
+      else
+      {
+        ++Parser->ephemerisSuppressed;
+        file = 0;
+      }
+      if(Parser->statepass)
+        file = 0;
+    }
+#endif /* NO_RTCM3_MAIN */
+    if(file)
+    {
+      const char *sep = "   ";
+      char prefix[40];
+      if(r == 1020)
+      {
+        struct glonassephemeris *e = &Parser->ephemerisGLONASS;
+        int w = e->GPSWeek, tow = e->GPSTOW, i;
+        struct converttimeinfo cti;
+
+        updatetime(&w, &tow, e->tb*1000, 1);  /* Moscow - > UTC */
+        converttime(&cti, w, tow);
+
+        i = e->tk-3*60*60; if(i < 0) i += 86400;
+
+        if(Parser->rinex3)
+        {
+          snprintf(prefix, sizeof(prefix), "R%02d %04d %02d %02d %02d %02d %02d",
+          e->almanac_number, cti.year, cti.month, cti.day, cti.hour, cti.minute,
+          cti.second);
+          sep = "    ";
+        }
+        else
+        {
+          snprintf(prefix, sizeof(prefix), "%02d %02d %02d %02d %02d %02d%5.1f",
+          e->almanac_number, cti.year%100, cti.month, cti.day, cti.hour, cti.minute,
+          (double) cti.second);
+        }
+        ConvLine(file, prefix, "DDD", -e->tau, e->gamma, (double) i);
+        ConvLine(file, sep, "DDDD", e->x_pos,
+        e->x_velocity, e->x_acceleration, (e->flags & GLOEPHF_UNHEALTHY) ? 1.0 : 0.0);
+        ConvLine(file, sep, "DDDD", e->y_pos,
+        e->y_velocity, e->y_acceleration, (double) e->frequency_number);
+        ConvLine(file, sep, "DDDD", e->z_pos,
+        e->z_velocity, e->z_acceleration, (double) e->E);
+      }
+      else if(r == 1043)
+      {
+        struct sbasephemeris *e = &Parser->ephemerisSBAS;
+        struct converttimeinfo cti;
+        converttime(&cti, e->GPSweek_TOE, e->TOE);
+        if(Parser->rinex3)
+        {
+          snprintf(prefix, sizeof(prefix), "S%02d %04d %2d %2d %2d %2d %2d",
+          e->satellite-100, cti.year, cti.month, cti.day, cti.hour, cti.minute,
+          cti.second);
+          sep = "    ";
+        }
+        else
+        {
+          snprintf(prefix, sizeof(prefix), "%02d %02d %02d %02d %02d %02d%5.1f",
+          e->satellite-100, cti.year%100, cti.month, cti.day, cti.hour, cti.minute,
+          (double)cti.second);
+        }
+        ConvLine(file, prefix, "DDD", e->agf0, e->agf1, (double)e->TOW);
+        /* X, health */
+        ConvLine(file, sep, "DDDD", e->x_pos,
+        e->x_velocity, e->x_acceleration, e->URA == 15 ? 1.0 : 0.0);
+        /* Y, accuracy */
+        ConvLine(file, sep, "DDDD", e->y_pos,
+        e->y_velocity, e->y_acceleration, (double)e->URA);
+        /* Z */
+        ConvLine(file, sep, "DDDD", e->z_pos,
+        e->z_velocity, e->z_acceleration, (double)e->IODN);
+      }
+      else if(r == RTCM3ID_BDS)
+      {
+        struct bdsephemeris *e = &Parser->ephemerisBDS;
+        double d;                 /* temporary variable */
+        struct converttimeinfo cti;
+        converttimebds(&cti, e->BDSweek, e->TOC);
+        int num = e->satellite-PRN_BDS_START+1;
+
+        if(Parser->rinex3)
+        {
+          snprintf(prefix, sizeof(prefix), "C%02d %04d %02d %02d %02d %02d %02d",
+          num, cti.year, cti.month, cti.day, cti.hour, cti.minute, cti.second);
+          sep = "    ";
+        }
+        else /* actually this is never used, as BDS is undefined for 2.x */
+        {
+          snprintf(prefix, sizeof(prefix), "%02d %02d %02d %02d %02d %02d%05.1f",
+          num, cti.year%100, cti.month, cti.day, cti.hour, cti.minute,
+          (double) cti.second);
+        }
+        ConvLine(file, prefix, "DDD", e->clock_bias, e->clock_drift,
+        e->clock_driftrate);
+        ConvLine(file, sep, "DDDD",
+        (double)e->AODE, e->Crs, e->Delta_n, e->M0);
+        ConvLine(file, sep, "DDDD", e->Cuc,
+        e->e, e->Cus, e->sqrt_A);
+        ConvLine(file, sep, "DDDD",
+        (double) e->TOE, e->Cic, e->OMEGA0, e->Cis);
+        ConvLine(file, sep, "DDDD", e->i0,
+        e->Crc, e->omega, e->OMEGADOT);
+        ConvLine(file, sep, "D D", e->IDOT,
+        (double) e->BDSweek);
+        if(e->URAI <= 6) /* URA index */
+          d = ceil(10.0*pow(2.0, 1.0+((double)e->URAI)/2.0))/10.0;
+        else
+          d = ceil(10.0*pow(2.0, ((double)e->URAI)/2.0))/10.0;
+        /* 15 indicates not to use satellite. We can't handle this special
+           case, so we create a high "non"-accuracy value. */
+        ConvLine(file, sep, "DDDD", d,
+        ((double) (e->flags & BDSEPHF_SATH1)), e->TGD_B1_B3,
+        e->TGD_B2_B3);
+
+        ConvLine(file, sep, "DD", ((double)e->TOW),
+        (double) e->AODC);
+        /* TOW, AODC */
+      }
+      else /* if(r == 1019 || r == 1044) */
+      {
+        struct gpsephemeris *e = &Parser->ephemerisGPS;
+        double d;                 /* temporary variable */
+        unsigned long int i;       /* temporary variable */
+        struct converttimeinfo cti;
+        converttime(&cti, e->GPSweek, e->TOC);
+        int qzss = 0;
+        int num = e->satellite;
+
+        if(num >= PRN_QZSS_START)
+        {
+          qzss = 1;
+          num -= PRN_QZSS_START-1;
+        }
+        if(Parser->rinex3)
+        {
+          snprintf(prefix, sizeof(prefix), "%s%02d %04d %02d %02d %02d %02d %02d",
+          qzss ? "J" : "G", num, cti.year, cti.month, cti.day, cti.hour,
+          cti.minute, cti.second);
+          sep = "    ";
+        }
+        else
+        {
+          snprintf(prefix, sizeof(prefix), "%02d %02d %02d %02d %02d %02d%05.1f",
+          num, cti.year%100, cti.month, cti.day, cti.hour, cti.minute,
+          (double) cti.second);
+        }
+        ConvLine(file, prefix, "DDD", e->clock_bias, e->clock_drift,
+        e->clock_driftrate);
+        ConvLine(file, sep, "DDDD",
+        (double)e->IODE, e->Crs, e->Delta_n, e->M0);
+        ConvLine(file, sep, "DDDD", e->Cuc,
+        e->e, e->Cus, e->sqrt_A);
+        ConvLine(file, sep, "DDDD",
+        (double) e->TOE, e->Cic, e->OMEGA0, e->Cis);
+        ConvLine(file, sep, "DDDD", e->i0,
+        e->Crc, e->omega, e->OMEGADOT);
+        d = 0;
+        i = e->flags;
+        if(i & GPSEPHF_L2CACODE)
+          d += 2.0;
+        if(i & GPSEPHF_L2PCODE)
+          d += 1.0;
+        ConvLine(file, sep, "DDDD", e->IDOT, d,
+        (double) e->GPSweek, i & GPSEPHF_L2PCODEDATA ? 1.0 : 0.0);
+        if(e->URAindex <= 6) /* URA index */
+          d = ceil(10.0*pow(2.0, 1.0+((double)e->URAindex)/2.0))/10.0;
+        else
+          d = ceil(10.0*pow(2.0, ((double)e->URAindex)/2.0))/10.0;
+        /* 15 indicates not to use satellite. We can't handle this special
+           case, so we create a high "non"-accuracy value. */
+        ConvLine(file, sep, "DDDD", d,
+        ((double) e->SVhealth), e->TGD, ((double) e->IODC));
+
+        ConvLine(file, sep, "DD", ((double)e->TOW),
+        (i & GPSEPHF_6HOURSFIT) ? (Parser->rinex3 ? 1 : qzss ? 4.0 : 6.0)
+        : (Parser->rinex3 ? 0 : qzss ? 2.0 : 4.0));
+        /* TOW,Fit */
+      }
+    }
+  }
+  else if (r == 1 || r == 2)
+  {
+    int i, j, o, nh=0, hl=2;
+    char newheader[512];
+    struct converttimeinfo cti;
+
+    /* skip first epochs to detect correct data types */
+    if(Parser->init < (Parser->changeobs ? 1 : NUMSTARTSKIP))
+    {
+      ++Parser->init;
+
+      if(Parser->init == (Parser->changeobs ? 1 : NUMSTARTSKIP))
+        HandleHeader(Parser);
+      else
+      {
+        for(i = 0; i < Parser->Data->numsats; ++i)
+          Parser->startflags |= Parser->Data->dataflags[i];
+        return;
+      }
+    }
+#ifndef NO_RTCM3_MAIN
+    if(Parser->qc)
+      QCEpoch(Parser);
+#endif /* NO_RTCM3_MAIN */
+    if(r == 2 && !Parser->validwarning)
+    {
+      RTCM3Text("No valid RINEX! All values are modulo 299792.458!"
+      "           COMMENT\n");
+      Parser->validwarning = 1;
+    }
+
+    converttime(&cti, Parser->Data->week,
+    (int)floor(Parser->Data->timeofweek/1000.0));
+    newheader[0] = 0;
+    if(Parser->changeobs)
+    {
+      nh = HandleObsHeader(Parser, newheader, sizeof(newheader), 0);
+      for(i = 0; i < nh; ++i)
+      {
+        if(newheader[i] == '\n')
+          ++hl;
+      }
+    }
+#ifndef NO_RTCM3_MAIN
+    if(Parser->statepass)
+      return;
+#endif /* NO_RTCM3_MAIN */
+    if(Parser->rinex3)
+    {
+      if(nh)
+      {
+        RTCM3Text("> %04d %02d %02d %02d %02d%11.7f  4%3d\n",
+        cti.year, cti.month, cti.day, cti.hour, cti.minute, cti.second
+        + fmod(Parser->Data->timeofweek/1000.0,1.0), hl);
+        RTCM3Text("%s\n                             "
+        "                               END OF HEADER\n", newheader);
+      }
+      RTCM3Text("> %04d %02d %02d %02d %02d",
+      cti.year, cti.month, cti.day, cti.hour, cti.minute);
+      RTCM3TextFixed(cti.second + fmod(Parser->Data->timeofweek/1000.0,1.0),
+      11, 7);
+      RTCM3Text("  %d%3d\n", 0, Parser->Data->numsats);
+      for(i = 0; i < Parser->Data->numsats; ++i)
+      {
+        int sys[RTCM3_MSM_NUMSYS] = {0,0,0,0,0,0};
+        if(Parser->Data->satellites[i] <= PRN_GPS_END)
+        {
+          RTCM3TextSat('G', Parser->Data->satellites[i]);
+          sys[RTCM3_MSM_GPS] = 1;
+        }
+        else if(Parser->Data->satellites[i] >= PRN_GLONASS_START
+        && Parser->Data->satellites[i] <= PRN_GLONASS_END)
+        {
+          RTCM3TextSat('R', Parser->Data->satellites[i] - (PRN_GLONASS_START-1));
+          sys[RTCM3_MSM_GLONASS] = 1;
+        }
+        else if(Parser->Data->satellites[i] >= PRN_GALILEO_START
+        && Parser->Data->satellites[i] <= PRN_GALILEO_END)
+        {
+          RTCM3TextSat('E', Parser->Data->satellites[i] - (PRN_GALILEO_START-1));
+          sys[RTCM3_MSM_GALILEO] = 1;
+        }
+        else if(Parser->Data->satellites[i] >= PRN_GIOVE_START
+        && Parser->Data->satellites[i] <= PRN_GIOVE_END)
+        {
+          RTCM3TextSat('E', Parser->Data->satellites[i] - (PRN_GIOVE_START-PRN_GIOVE_OFFSET));
+          sys[RTCM3_MSM_GALILEO] = 1;
+        }
+        else if(Parser->Data->satellites[i] >= PRN_QZSS_START
+        && Parser->Data->satellites[i] <= PRN_QZSS_END)
+        {
+          RTCM3TextSat('J', Parser->Data->satellites[i] - (PRN_QZSS_START-1));
+          sys[RTCM3_MSM_QZSS] = 1;
+        }
+        else if(Parser->Data->satellites[i] >= PRN_BDS_START
+        && Parser->Data->satellites[i] <= PRN_BDS_END)
+        {
+          RTCM3TextSat('C', Parser->Data->satellites[i] - (PRN_BDS_START-1));
+          sys[RTCM3_MSM_BDS] = 1;
+        }
+        else if(Parser->Data->satellites[i] >= PRN_SBAS_START
+        && Parser->Data->satellites[i] <= PRN_SBAS_END)
+        {
+          RTCM3TextSat('S', Parser->Data->satellites[i] - PRN_SBAS_START+20);
+          sys[RTCM3_MSM_SBAS] = 1;
+        }
+        else
+        {
+          RTCM3Text("%3d", Parser->Data->satellites[i]);
+        }
+
+        if(sys[RTCM3_MSM_GLONASS])
+        {
+          for(j = 0; j < Parser->info[RTCM3_MSM_GLONASS].numtypes; ++j)
+          {
+            long long df = Parser->info[RTCM3_MSM_GLONASS].flags[j];
+            int pos = Parser->info[RTCM3_MSM_GLONASS].pos[j];
+            if((Parser->Data->dataflags[i] & df)
+            && !isnan(GNSSVALUE(Parser->Data, i, pos))
+            && !isinf(GNSSVALUE(Parser->Data, i, pos))
+            && (GNSSCode(Parser->Data, i, pos)
+              && Parser->info[RTCM3_MSM_GLONASS].type[pos]
+              && Parser->info[RTCM3_MSM_GLONASS].type[pos]
+              == GNSSCode(Parser->Data, i, pos)[1]))
+            {
+              char lli = ' ';
+              char snr = ' ';
+              if(df & (GNSSDF_L1CDATA|GNSSDF_L1PDATA))
+              {
+                if(Parser->Data->dataflags2[i] & GNSSDF2_LOCKLOSSL1)
+                  lli = '1';
+                snr = '0'+Parser->Data->snrL1[i];
+              }
+              if(df & (GNSSDF_L2CDATA|GNSSDF_L2PDATA))
+              {
+                if(Parser->Data->dataflags2[i] & GNSSDF2_LOCKLOSSL2)
+                  lli = '1';
+                snr = '0'+Parser->Data->snrL2[i];
+              }
+              RTCM3TextObs(GNSSVALUE(Parser->Data, i, pos), lli, snr);
+            }
+            else
+            { /* no or illegal data */
+              RTCM3TextRaw("                ", 16);
+            }
+          }
+        }
+        else if(sys[RTCM3_MSM_GALILEO])
+        {
+          for(j = 0; j < Parser->info[RTCM3_MSM_GALILEO].numtypes; ++j)
+          {
+            long long df = Parser->info[RTCM3_MSM_GALILEO].flags[j];
+            int pos = Parser->info[RTCM3_MSM_GALILEO].pos[j];
+            if((Parser->Data->dataflags[i] & df)
+            && !isnan(GNSSVALUE(Parser->Data, i, pos))
+            && !isinf(GNSSVALUE(Parser->Data, i, pos))
+            && (GNSSCode(Parser->Data, i, pos)
+              && Parser->info[RTCM3_MSM_GALILEO].type[pos]
+              && Parser->info[RTCM3_MSM_GALILEO].type[pos]
+              == GNSSCode(Parser->Data, i, pos)[1]))
+            {
+              char lli = ' ';
+              char snr = ' ';
+              if(df & (GNSSDF_L1CDATA|GNSSDF_L1PDATA))
+              {
+                if(Parser->Data->dataflags2[i] & GNSSDF2_LOCKLOSSL1)
+                  lli = '1';
+                snr = '0'+Parser->Data->snrL1[i];
+              }
+              if(df & GNSSDF_L6DATA)
+              {
+                if(Parser->Data->dataflags2[i] & GNSSDF2_LOCKLOSSE6)
+                  lli = '1';
+                snr = ' ';
+              }
+              if(df & GNSSDF_L5DATA)
+              {
+                if(Parser->Data->dataflags2[i] & GNSSDF2_LOCKLOSSL5)
+                  lli = '1';
+                snr = ' ';
+              }
+              if(df & GNSSDF_L5BDATA)
+              {
+                if(Parser->Data->dataflags2[i] & GNSSDF2_LOCKLOSSE5B)
+                  lli = '1';
+                snr = ' ';
+              }
+              if(df & GNSSDF_L5ABDATA)
+              {
+                if(Parser->Data->dataflags2[i] & GNSSDF2_LOCKLOSSE5AB)
+                  lli = '1';
+                snr = ' ';
+              }
+              RTCM3TextObs(GNSSVALUE(Parser->Data, i, pos), lli, snr);
+            }
+            else
+            { /* no or illegal data */
+              RTCM3TextRaw("                ", 16);
+            }
+          }
+        }
+        else if(sys[RTCM3_MSM_BDS])
+        {
+          for(j = 0; j < Parser->info[RTCM3_MSM_BDS].numtypes; ++j)
+          {
+            long long df = Parser->info[RTCM3_MSM_BDS].flags[j];
+            int pos = Parser->info[RTCM3_MSM_BDS].pos[j];
+            if((Parser->Data->dataflags[i] & df)
+            && !isnan(GNSSVALUE(Parser->Data, i, pos))
+            && !isinf(GNSSVALUE(Parser->Data, i, pos))
+            && (GNSSCode(Parser->Data, i, pos)
+              && Parser->info[RTCM3_MSM_BDS].type[pos]
+              && Parser->info[RTCM3_MSM_BDS].type[pos]
+              == GNSSCode(Parser->Data, i, pos)[1]))
+            {
+              char lli = ' ';
+              char snr = ' ';
+              if(df & GNSSDF_LB1DATA)
+              {
+                if(Parser->Data->dataflags2[i] & GNSSDF2_LOCKLOSSB1)
+                  lli = '1';
+              }
+              if(df & GNSSDF_LB2DATA)
+              {
+                if(Parser->Data->dataflags2[i] & GNSSDF2_LOCKLOSSB2)
+                  lli = '1';
+              }
+              if(df & GNSSDF_LB3DATA)
+              {
+                if(Parser->Data->dataflags2[i] & GNSSDF2_LOCKLOSSB3)
+                  lli = '1';
+              }
+              RTCM3TextObs(GNSSVALUE(Parser->Data, i, pos), lli, snr);
+            }
+            else
+            { /* no or illegal data */
+              RTCM3TextRaw("                ", 16);
+            }
+          }
+        }
+        else if(sys[RTCM3_MSM_QZSS])
+        {
+          for(j = 0; j < Parser->info[RTCM3_MSM_QZSS].numtypes; ++j)
+          {
+            long long df = Parser->info[RTCM3_MSM_QZSS].flags[j];
+            int pos = Parser->info[RTCM3_MSM_QZSS].pos[j];
+            if((Parser->Data->dataflags[i] & df)
+            && !isnan(GNSSVALUE(Parser->Data, i, pos))
+            && !isinf(GNSSVALUE(Parser->Data, i, pos))
+            && (GNSSCode(Parser->Data, i, pos)
+              && Parser->info[RTCM3_MSM_QZSS].type[pos]
+              && Parser->info[RTCM3_MSM_QZSS].type[pos]
+              == GNSSCode(Parser->Data, i, pos)[1]))
+            {
+              char lli = ' ';
+              char snr = ' ';
+              if(df & GNSSDF_L1CDATA)
+              {
+                if(Parser->Data->dataflags2[i] & GNSSDF2_LOCKLOSSL1)
+                  lli = '1';
+                snr = '0'+Parser->Data->snrL1[i];
+              }
+              if(df & (GNSSDF_L2CDATA|GNSSDF_L2PDATA))
+              {
+                if(Parser->Data->dataflags2[i] & GNSSDF2_LOCKLOSSL2)
+                  lli = '1';
+                snr = '0'+Parser->Data->snrL2[i];
+              }
+              if(df & GNSSDF_L5DATA)
+              {
+                if(Parser->Data->dataflags2[i] & GNSSDF2_LOCKLOSSL5)
+                  lli = '1';
+                snr = ' ';
+              }
+              RTCM3TextObs(GNSSVALUE(Parser->Data, i, pos), lli, snr);
+            }
+            else
+            { /* no or illegal data */
+              RTCM3TextRaw("                ", 16);
+            }
+          }
+        }
+        else if(sys[RTCM3_MSM_SBAS])
+        {
+          for(j = 0; j < Parser->info[RTCM3_MSM_SBAS].numtypes; ++j)
+          {
+            long long df = Parser->info[RTCM3_MSM_SBAS].flags[j];
+            int pos = Parser->info[RTCM3_MSM_SBAS].pos[j];
+            if((Parser->Data->dataflags[i] & df)
+            && !isnan(GNSSVALUE(Parser->Data, i, pos))
+            && !isinf(GNSSVALUE(Parser->Data, i, pos))
+            && (GNSSCode(Parser->Data, i, pos)
+              && Parser->info[RTCM3_MSM_SBAS].type[pos]
+              && Parser->info[RTCM3_MSM_SBAS].type[pos]
+              == GNSSCode(Parser->Data, i, pos)[1]))
+            {
+              char lli = ' ';
+              char snr = ' ';
+              if(df & (GNSSDF_L1CDATA|GNSSDF_L1PDATA))
+              {
+                if(Parser->Data->dataflags2[i] & GNSSDF2_LOCKLOSSL1)
+                  lli = '1';
+                snr = '0'+Parser->Data->snrL1[i];
+              }
+              if(df & GNSSDF_L5DATA)
+              {
+                if(Parser->Data->dataflags2[i] & GNSSDF2_LOCKLOSSL5)
+                  lli = '1';
+                snr = ' ';
+              }
+              RTCM3TextObs(GNSSVALUE(Parser->Data, i, pos), lli, snr);
+            }
+            else
+            { /* no or illegal data */
+              RTCM3TextRaw("                ", 16);
+            }
+          }
+        }
+        else
+        {
+          for(j = 0; j < Parser->info[RTCM3_MSM_GPS].numtypes; ++j)
+          {
+            long long df = Parser->info[RTCM3_MSM_GPS].flags[j];
+            int pos = Parser->info[RTCM3_MSM_GPS].pos[j];
+            if((Parser->Data->dataflags[i] & df)
+            && !isnan(GNSSVALUE(Parser->Data, i, pos))
+            && !isinf(GNSSVALUE(Parser->Data, i, pos))
+            && (GNSSCode(Parser->Data, i, pos)
+              && Parser->info[RTCM3_MSM_GPS].type[pos]
+              && Parser->info[RTCM3_MSM_GPS].type[pos]
+              == GNSSCode(Parser->Data, i, pos)[1]))
+            {
+              char lli = ' ';
+              char snr = ' ';
+              if(df & (GNSSDF_L1CDATA|GNSSDF_L1PDATA))
+              {
+                if(Parser->Data->dataflags2[i] & GNSSDF2_LOCKLOSSL1)
+                  lli = '1';
+                snr = '0'+Parser->Data->snrL1[i];
+              }
+              if(df & (GNSSDF_L2CDATA|GNSSDF_L2PDATA))
+              {
+                if(Parser->Data->dataflags2[i] & GNSSDF2_LOCKLOSSL2)
+                  lli = '1';
+                snr = '0'+Parser->Data->snrL2[i];
+              }
+              if(df & GNSSDF_L5DATA)
+              {
+                if(Parser->Data->dataflags2[i] & GNSSDF2_LOCKLOSSL5)
+                  lli = '1';
+                snr = ' ';
+              }
+              RTCM3TextObs(GNSSVALUE(Parser->Data, i, pos), lli, snr);
+            }
+            else
+            { /* no or illegal data */
+              RTCM3TextRaw("                ", 16);
+            }
+          }
+        }
+        RTCM3TextRaw("\n", 1);
+      }
+    }
+    else
+    {
+      RTCM3Text(" %02d %2d %2d %2d %2d ",
+      cti.year%100, cti.month, cti.day, cti.hour, cti.minute);
+      RTCM3TextFixed(cti.second + fmod(Parser->Data->timeofweek/1000.0,1.0),
+      10, 7);
+      RTCM3Text("  %d%3d", nh ? 4 : 0, Parser->Data->numsats);
+      for(i = 0; i < 12 && i < Parser->Data->numsats; ++i)
+      {
+        if(Parser->Data->satellites[i] <= PRN_GPS_END)
+          RTCM3TextSat('G', Parser->Data->satellites[i]);
+        else if(Parser->Data->satellites[i] >= PRN_GLONASS_START
+        && Parser->Data->satellites[i] <= PRN_GLONASS_END)
+          RTCM3TextSat('R', Parser->Data->satellites[i]
+          - (PRN_GLONASS_START-1));
+        else if(Parser->Data->satellites[i] >= PRN_SBAS_START
+        && Parser->Data->satellites[i] <= PRN_SBAS_END)
+          RTCM3TextSat('S', Parser->Data->satellites[i]
+          - PRN_SBAS_START+20);
+        else if(Parser->Data->satellites[i] >= PRN_GALILEO_START
+        && Parser->Data->satellites[i] <= PRN_GALILEO_END)
+          RTCM3TextSat('E', Parser->Data->satellites[i]
+          - (PRN_GALILEO_START-1));
+        else if(Parser->Data->satellites[i] >= PRN_GIOVE_START
+        && Parser->Data->satellites[i] <= PRN_GIOVE_END)
+          RTCM3TextSat('E', Parser->Data->satellites[i]
+          - (PRN_GIOVE_START-PRN_GIOVE_OFFSET));
+        else if(Parser->Data->satellites[i] >= PRN_QZSS_START
+        && Parser->Data->satellites[i] <= PRN_QZSS_END)
+          RTCM3TextSat('J', Parser->Data->satellites[i]
+          - (PRN_QZSS_START-1));
+        else if(Parser->Data->satellites[i] >= PRN_BDS_START
+        && Parser->Data->satellites[i] <= PRN_BDS_END)
+          RTCM3TextSat('C', Parser->Data->satellites[i]
+          - (PRN_BDS_START-1));
+        else
+          RTCM3Text("%3d", Parser->Data->satellites[i]);
+      }
+      RTCM3TextRaw("\n", 1);
+      o = 12;
+      j = Parser->Data->numsats - 12;
+      while(j > 0)
+      {
+        RTCM3Text("                                ");
+        for(i = o; i < o+12 && i < Parser->Data->numsats; ++i)
+        {
+          if(Parser->Data->satellites[i] <= PRN_GPS_END)
+            RTCM3TextSat('G', Parser->Data->satellites[i]);
+          else if(Parser->Data->satellites[i] >= PRN_GLONASS_START
+          && Parser->Data->satellites[i] <= PRN_GLONASS_END)
+            RTCM3TextSat('R', Parser->Data->satellites[i]
+            - (PRN_GLONASS_START-1));
+          else if(Parser->Data->satellites[i] >= PRN_SBAS_START
+          && Parser->Data->satellites[i] <= PRN_SBAS_END)
+            RTCM3TextSat('S', Parser->Data->satellites[i]
+            - PRN_SBAS_START+20);
+          else if(Parser->Data->satellites[i] >= PRN_GALILEO_START
+          && Parser->Data->satellites[i] <= PRN_GALILEO_END)
+            RTCM3TextSat('E', Parser->Data->satellites[i]
+            - (PRN_GALILEO_START-1));
+          else if(Parser->Data->satellites[i] >= PRN_GIOVE_START
+          && Parser->Data->satellites[i] <= PRN_GIOVE_END)
+            RTCM3TextSat('E', Parser->Data->satellites[i]
+            - (PRN_GIOVE_START-PRN_GIOVE_OFFSET));
+          else if(Parser->Data->satellites[i] >= PRN_QZSS_START
+          && Parser->Data->satellites[i] <= PRN_QZSS_END)
+            RTCM3TextSat('J', Parser->Data->satellites[i]
+            - (PRN_QZSS_START-1));
+          else if(Parser->Data->satellites[i] >= PRN_BDS_START
+          && Parser->Data->satellites[i] <= PRN_BDS_END)
+            RTCM3TextSat('C', Parser->Data->satellites[i]
+            - (PRN_BDS_START-1));
+          else
+            RTCM3Text("%3d", Parser->Data->satellites[i]);
+        }
+        RTCM3TextRaw("\n", 1);
+        j -= 12;
+        o += 12;
+      }
+      if(nh)
+      {
+        RTCM3Text("%s\n                             "
+        "                               END OF HEADER\n", newheader);
+      }
+      for(i = 0; i < Parser->Data->numsats; ++i)
+      {
+        for(j = 0; j < Parser->info[RTCM3_MSM_GPS].numtypes; ++j)
+        {
+          int v = 0;
+          long long df = Parser->flags[j];
+          int pos = Parser->pos[j];
+          if((Parser->Data->dataflags[i] & df)
+          && !isnan(GNSSVALUE(Parser->Data, i, pos))
+          && !isinf(GNSSVALUE(Parser->Data, i, pos)))
+          {
+            v = 1;
+          }
+          else
+          {
+            df = Parser->info[RTCM3_MSM_GPS].flags[j];
+            pos = Parser->info[RTCM3_MSM_GPS].pos[j];
+
+            if((Parser->Data->dataflags[i] & df)
+            && !isnan(GNSSVALUE(Parser->Data, i, pos))
+            && !isinf(GNSSVALUE(Parser->Data, i, pos)))
+            {
+              v = 1;
+            }
+          }
+
+          if(!v)
+          { /* no or illegal data */
+            RTCM3TextRaw("                ", 16);
+          }
+          else
+          {
+            char lli = ' ';
+            char snr = ' ';
+            if(df & (GNSSDF_L1CDATA|GNSSDF_L1PDATA))
+            {
+              if(Parser->Data->dataflags2[i] & GNSSDF2_LOCKLOSSL1)
+                lli = '1';
+              snr = '0'+Parser->Data->snrL1[i];
+            }
+            if(df & (GNSSDF_L2CDATA|GNSSDF_L2PDATA))
+            {
+              if(Parser->Data->dataflags2[i]
+              & (GNSSDF2_LOCKLOSSL2|GNSSDF2_XCORRL2))
+              {
+                lli = '0';
+                if(Parser->Data->dataflags2[i] & GNSSDF2_LOCKLOSSL2)
+                  lli += 1;
+                if(Parser->Data->dataflags2[i] & GNSSDF2_XCORRL2)
+                  lli += 4;
+              }
+              snr = '0'+Parser->Data->snrL2[i];
+            }
+            if((df & GNSSDF_P2DATA) && (Parser->Data->dataflags2[i]
+            & GNSSDF2_XCORRL2))
+              lli = '4';
+            RTCM3TextObs(GNSSVALUE(Parser->Data, i, pos), lli, snr);
+          }
+          if(j%5 == 4 || j == Parser->info[RTCM3_MSM_GPS].numtypes-1)
+            RTCM3TextRaw("\n", 1);
+        }
+      }
+    }
+  }
+}
+
+#ifndef NO_RTCM3_MAIN
+/* The checkpoint holds the parser state which is needed to continue a
+   conversion after a restart. It consists of a magic, the version, records
+   of id, size and data and a CRC24 of everything before. Numbers and
+   structures are stored as the host has them. The observation types are
+   rebuilt from startflags and the signal codes at the first epoch, of the
+   ephemeris store only the used entries are written. */
+#define CHECKPOINTMAGIC "RTCM3STATE"
+#define CHECKPOINTVERSION 1
+#define CHECKPOINTINTERVAL 60 /* seconds between two checkpoints */
+#define CHECKPOINTSTARTFLAGS 9 /* id of startflags */
+#define CHECKPOINTEPH 100 /* id of an ephemeris store entry */
+
+#define STATEFIELD(id, a) {id, offsetof(struct RTCM3ParserData, a), \
+sizeof(((struct RTCM3ParserData *)0)->a)}
+
+static const struct { int id; size_t offset, size; } statefields[] = {
+STATEFIELD(1, GPSWeek),
+STATEFIELD(2, GPSTOW),
+STATEFIELD(3, GLOFreq),
+STATEFIELD(4, lastlockGPSl1),
+STATEFIELD(5, lastlockGPSl2),
+STATEFIELD(6, lastlockGLOl1),
+STATEFIELD(7, lastlockGLOl2),
+STATEFIELD(8, lastlockmsm),
+STATEFIELD(10, info[RTCM3_MSM_GPS].type),
+STATEFIELD(11, info[RTCM3_MSM_GLONASS].type),
+STATEFIELD(12, info[RTCM3_MSM_GALILEO].type),
+STATEFIELD(13, info[RTCM3_MSM_SBAS].type),
+STATEFIELD(14, info[RTCM3_MSM_QZSS].type),
+STATEFIELD(15, info[RTCM3_MSM_BDS].type),
+STATEFIELD(16, refpos),
+STATEFIELD(17, ambclock),
+};
+
+#define NUMSTATEFIELDS ((int)(sizeof(statefields)/sizeof(statefields[0])))
+
+static unsigned char *StateRecord(unsigned char *b, int id, const void *data,
+size_t size)
+{
+  uint32_t v;
+
+  v = id;
+  memcpy(b, &v, 4);
+  v = size;
+  memcpy(b+4, &v, 4);
+  memcpy(b+8, data, size);
+  return b+8+size;
+}
+
+/* written to a temporary file which replaces the checkpoint when complete */
+static void WriteCheckpoint(struct RTCM3ParserData *Parser)
+{
+  unsigned char *buf, *b, e[4+sizeof(struct ephemerisentry)];
+  char *tmp;
+  size_t size;
+  uint32_t crc;
+  int i, j, k, startflags;
+  FILE *f;
+
+  size = strlen(CHECKPOINTMAGIC)+4+8+sizeof(startflags)+4
+  + RTCM3_MSM_NUMSYS*RTCM3_MSM_NUMSAT*2*(8+sizeof(e));
+  for(i = 0; i < NUMSTATEFIELDS; ++i)
+    size += 8+statefields[i].size;
+  if(!(buf = malloc(size)) || !(tmp = malloc(strlen(Parser->checkpoint)+5)))
+  {
+    free(buf);
+    RTCM3Error("Could not allocate checkpoint.\n");
+    return;
+  }
+  b = buf;
+  memcpy(b, CHECKPOINTMAGIC, strlen(CHECKPOINTMAGIC));
+  b += strlen(CHECKPOINTMAGIC);
+  i = CHECKPOINTVERSION;
+  memcpy(b, &i, 4);
+  b += 4;
+  for(i = 0; i < NUMSTATEFIELDS; ++i)
+  {
+    b = StateRecord(b, statefields[i].id,
+    (const char *)Parser+statefields[i].offset, statefields[i].size);
+  }
+  /* types added with changeobs are part of the next header as well */
+  startflags = Parser->startflags;
+  for(i = 0; i < Parser->numdatafields; ++i)
+    startflags |= Parser->flags[i];
+  for(i = 0; i < RTCM3_MSM_NUMSYS; ++i)
+  {
+    for(j = 0; j < Parser->info[i].numtypes; ++j)
+      startflags |= Parser->info[i].flags[j];
+  }
+  b = StateRecord(b, CHECKPOINTSTARTFLAGS, &startflags, sizeof(startflags));
+  for(i = 0; i < RTCM3_MSM_NUMSYS && Parser->ephemerides; ++i)
+  {
+    for(j = 0; j < RTCM3_MSM_NUMSAT; ++j)
+    {
+      for(k = 0; k < 2; ++k)
+      {
+        const struct ephemerisentry *c = &Parser->ephemerides->entry[i][j][k];
+        if(!c->type)
+          continue;
+        e[0] = i; e[1] = j; e[2] = k; e[3] = 0;
+        memcpy(e+4, c, sizeof(*c));
+        b = StateRecord(b, CHECKPOINTEPH, e, sizeof(e));
+      }
+    }
+  }
+  CRC24Init();
+  crc = crc24func(0, b-buf, buf);
+  memcpy(b, &crc, 4);
+  b += 4;
+
+  sprintf(tmp, "%s.tmp", Parser->checkpoint);
+  if(!(f = fopen(tmp, "wb")))
+    RTCM3Error("Could not open checkpoint %s.\n", tmp);
+  else
+  {
+    i = fwrite(buf, (size_t)(b-buf), 1, f) != 1 || fflush(f)
+    || fsync(fileno(f));
+    if(fclose(f) || i || rename(tmp, Parser->checkpoint))
+    {
+      RTCM3Error("Could not write checkpoint %s.\n", Parser->checkpoint);
+      remove(tmp);
+    }
+  }
+  free(tmp);
+  free(buf);
+}
+
+/* A missing checkpoint is a first start. The records are checked before
+   anything is taken, so a damaged checkpoint leaves the parser unchanged. */
+static void ReadCheckpoint(struct RTCM3ParserData *Parser)
+{
+  unsigned char *buf = 0, *b, *e;
+  long size = -1;
+  uint32_t crc, id = 0, len = 0;
+  int i, pass, version, ok = 0;
+  FILE *f;
+
+  if(!(f = fopen(Parser->checkpoint, "rb")))
+    return;
+  if(!fseek(f, 0, SEEK_END) && (size = ftell(f)) >= 0 && !fseek(f, 0, SEEK_SET)
+  && (buf = malloc(size ? size : 1)) && fread(buf, size, 1, f) == 1
+  && size >= (long)strlen(CHECKPOINTMAGIC)+8
+  && !memcmp(buf, CHECKPOINTMAGIC, strlen(CHECKPOINTMAGIC)))
+  {
+    b = buf+strlen(CHECKPOINTMAGIC);
+    e = buf+size-4;
+    memcpy(&version, b, 4);
+    b += 4;
+    CRC24Init();
+    memcpy(&crc, e, 4);
+    ok = version == CHECKPOINTVERSION && crc == crc24func(0, e-buf, buf);
+    for(pass = 0; ok && pass < 2; ++pass)
+    {
+      unsigned char *r;
+      for(r = b; ok && r < e; r += 8+len)
+      {
+        if(e-r >= 8)
+        {
+          memcpy(&id, r, 4);
+          memcpy(&len, r+4, 4);
+        }
+        if(e-r < 8 || len > (size_t)(e-r-8))
+          ok = 0;
+        else if(id == CHECKPOINTEPH)
+        {
+          struct ephemerisentry *c;
+          if(len != 4+sizeof(*c) || r[8] >= RTCM3_MSM_NUMSYS
+          || r[9] >= RTCM3_MSM_NUMSAT || r[10] >= 2
+          || !EphemerisStore(Parser))
+            ok = 0;
+          else if(pass)
+          {
+            c = &Parser->ephemerides->entry[r[8]][r[9]][r[10]];
+            memcpy(c, r+12, sizeof(*c));
+            /* the new navigation files get the ephemeris when it is
+               received again */
+            c->iod = -1;
+          }
+        }
+        else if(id == CHECKPOINTSTARTFLAGS)
+        {
+          if(len != sizeof(Parser->startflags))
+            ok = 0;
+          else if(pass)
+            memcpy(&Parser->startflags, r+8, len);
+        }
+        else
+        {
+          for(i = 0; i < NUMSTATEFIELDS && statefields[i].id != (int)id; ++i)
+            ;
+          if(i < NUMSTATEFIELDS && len != statefields[i].size)
+            ok = 0; /* the structure has changed, unknown records are skipped */
+          else if(i < NUMSTATEFIELDS && pass)
+            memcpy((char *)Parser+statefields[i].offset, r+8, len);
+        }
+      }
+    }
+  }
+  fclose(f);
+  free(buf);
+  if(!ok)
+    RTCM3Error("Checkpoint %s is not usable, starting without it.\n",
+    Parser->checkpoint);
+  else if(Parser->startflags) /* the header is written with the first epoch */
+    Parser->init = (Parser->changeobs ? 1 : NUMSTARTSKIP)-1;
+}
+#endif /* NO_RTCM3_MAIN */
+
+/* the output of a result is written at once */
+static void HandleResult(struct RTCM3ParserData *Parser, int r)
+{
+  textbuffered = 1;
+  HandleResultText(Parser, r);
+  RTCM3TextFlush();
+  textbuffered = 0;
+#ifndef NO_RTCM3_MAIN
+  if(textpipe)
+  {
+    ++textpipe->results;
+    if(r == 1 || r == 2)
+      ++textpipe->epochs;
+  }
+  if(Parser->checkpoint && (r == 1 || r == 2))
+  {
+    long t = time(0);
+    if(t >= Parser->checkpointtime)
+    {
+      WriteCheckpoint(Parser);
+      Parser->checkpointtime = t+CHECKPOINTINTERVAL;
+    }
+  }
+  if(Parser->qc && !Parser->statepass && (r == 1 || r == 2))
+  {
+    long t = time(0);
+    if(!Parser->qctime) /* the first report after an interval */
+      Parser->qctime = t+QC_INTERVAL;
+    else if(t >= Parser->qctime)
+    {
+      QCReport(Parser);
+      Parser->qctime = t+QC_INTERVAL;
+    }
+  }
+#endif /* NO_RTCM3_MAIN */
+}
+
+void HandleByte(struct RTCM3ParserData *Parser, unsigned int byte)
+{
+  Parser->Message[Parser->MessageSize++] = byte;
+  if(Parser->MessageSize >= Parser->NeedBytes)
+  {
+    int r;
+    while((r = RTCM3Parser(Parser)))
+      HandleResult(Parser, r);
+  }
+}
+
+/* Bulk version of HandleByte(). Complete messages are decoded directly from
+   the buffer, only an incomplete message at the end is copied. */
+void HandleBytes(struct RTCM3ParserData *Parser, const unsigned char *buf,
+size_t len)
+{
+  const unsigned char *e = buf+len;
+  int r;
+
+  while(buf < e)
+  {
+    if(Parser->MessageSize) /* complete the buffered data first */
+    {
+      size_t n = Parser->NeedBytes > Parser->MessageSize
+      ? (size_t)(Parser->NeedBytes-Parser->MessageSize) : 1;
+      if(n > (size_t)(e-buf))
+        n = e-buf;
+      memcpy(Parser->Message+Parser->MessageSize, buf, n);
+      Parser->MessageSize += n;
+      buf += n;
+      if(Parser->MessageSize >= Parser->NeedBytes)
+      {
+        while((r = RTCM3Parser(Parser)))
+          HandleResult(Parser, r);
+      }
+    }
+    else
+    {
+      int need;
+
+      buf = RTCM3Sync(buf, e, &need);
+      if(need)
+      {
+        Parser->MessageSize = e-buf;
+        Parser->NeedBytes = need;
+        memcpy(Parser->Message, buf, (size_t)Parser->MessageSize);
+        break;
+      }
+      Parser->size = ((buf[1]&3)<<8)|buf[2];
+      r = RTCM3Decode(Parser, buf+3);
+      buf += Parser->size+6;
+      if(r)
+        HandleResult(Parser, r);
+    }
+  }
+}
+
+#ifndef NO_RTCM3_MAIN
+static char datestr[]     = "$Date$";
+
+/* The string, which is send as agent in HTTP request */
+#define AGENTSTRING "NTRIP NtripRTCM3ToRINEX"
+
+#define MAXDATASIZE 1000 /* max number of bytes we can get at once */
+
+static const char encodingTable [64] = {
+  'A','B','C','D','E','F','G','H','I','J','K','L','M','N','O','P',
+  'Q','R','S','T','U','V','W','X','Y','Z','a','b','c','d','e','f',
+  'g','h','i','j','k','l','m','n','o','p','q','r','s','t','u','v',
+  'w','x','y','z','0','1','2','3','4','5','6','7','8','9','+','/'
+};
+
+/* does not buffer overrun, but breaks directly after an error */
+/* returns the number of required bytes */
+static int encode(char *buf, int size, const char *user, const char *pwd)
+{
+  unsigned char inbuf[3];
+  char *out = buf;
+  int i, sep = 0, fill = 0, bytes = 0;
+
+  while(*user || *pwd)
+  {
+    i = 0;
+    while(i < 3 && *user) inbuf[i++] = *(user++);
+    if(i < 3 && !sep)    {inbuf[i++] = ':'; ++sep; }
+    while(i < 3 && *pwd)  inbuf[i++] = *(pwd++);
+    while(i < 3)         {inbuf[i++] = 0; ++fill; }
+    if(out-buf < size-1)
+      *(out++) = encodingTable[(inbuf [0] & 0xFC) >> 2];
+    if(out-buf < size-1)
+      *(out++) = encodingTable[((inbuf [0] & 0x03) << 4)
+               | ((inbuf [1] & 0xF0) >> 4)];
+    if(out-buf < size-1)
+    {
+      if(fill == 2)
+        *(out++) = '=';
+      else
+        *(out++) = encodingTable[((inbuf [1] & 0x0F) << 2)
+                 | ((inbuf [2] & 0xC0) >> 6)];
+    }
+    if(out-buf < size-1)
+    {
+      if(fill >= 1)
+        *(out++) = '=';
+      else
+        *(out++) = encodingTable[inbuf [2] & 0x3F];
+    }
+    bytes += 4;
+  }
+  if(out-buf < size)
+    *out = 0;
+  return bytes;
+}
+
+static int stop = 0;
+
+struct Args
+{
+  const char *server;
+  const char *port;
+  int         mode;
+  int         timeout;
+  int         rinex3;
+  int         changeobs;
+  const char *user;
+  const char *password;
+  const char *proxyhost;
+  const char *proxyport;
+  const char *nmea;
+  const char *data;
+  const char *headerfile;
+  const char *sbasephemeris;
+  const char *gpsephemeris;
+  const char *qzssephemeris;
+  const char *glonassephemeris;
+  const char *bdsephemeris;
+  const char *mixedephemeris;
+  const char *qcfile;
+  const char *input;
+  int         threads;
+  const char *checkpoint;
+  const char *output;
+  const char *streams;
+  int         overflow;
+  int         uring;
+};
+
+/* option parsing */
+#ifdef NO_LONG_OPTS
+#define LONG_OPT(a)
+#else
+#define LONG_OPT(a) a
+static struct option opts[] = {
+{ "data",             required_argument, 0, 'd'},
+{ "server",           required_argument, 0, 's'},
+{ "password",         required_argument, 0, 'p'},
+{ "port",             required_argument, 0, 'r'},
+{ "timeout",          required_argument, 0, 't'},
+{ "header",           required_argument, 0, 'f'},
+{ "user",             required_argument, 0, 'u'},
+{ "bdsephemeris",     required_argument, 0, 'C'},
+{ "gpsephemeris",     required_argument, 0, 'E'},
+{ "qzssephemeris",    required_argument, 0, 'Q'},
+{ "glonassephemeris", required_argument, 0, 'G'},
+{ "sbasephemeris",    required_argument, 0, 'B'},
+{ "mixedephemeris",   required_argument, 0, 'P'},
+{ "rinex3",           no_argument,       0, '3'},
+{ "changeobs",        no_argument,       0, 'O'},
+{ "proxyport",        required_argument, 0, 'R'},
+{ "proxyhost",        required_argument, 0, 'S'},
+{ "nmea",             required_argument, 0, 'n'},
+{ "qcfile",           required_argument, 0, 'q'},
+{ "input",            required_argument, 0, 'i'},
+{ "threads",          required_argument, 0, 'j'},
+{ "checkpoint",       required_argument, 0, 'k'},
+{ "output",           required_argument, 0, 'o'},
+{ "streams",          required_argument, 0, 'L'},
+{ "overflow",         required_argument, 0, 'w'},
+{ "uring",            no_argument,       0, 'U'},
+{ "mode",             required_argument, 0, 'M'},
+{ "help",             no_argument,       0, 'h'},
+{0,0,0,0}};
+#endif
+#define ARGOPT "-d:s:p:r:t:f:u:E:C:G:B:P:Q:M:S:R:n:q:i:j:k:o:L:w:h3OU"
+
+enum MODE { HTTP = 1, RTSP = 2, NTRIP1 = 3, AUTO = 4, END };
+
+static const char *geturl(const char *url, struct Args *args)
+{
+  static char buf[1000];
+  static char *Buffer = buf;
+  static char *Bufend = buf+sizeof(buf);
+
+  /* the strings are kept, a stream list needs more than one buffer */
+  if((size_t)(Bufend-Buffer) <= strlen(url))
+  {
+    char *b = malloc(sizeof(buf));
+    if(b)
+    {
+      Buffer = b;
+      Bufend = b+sizeof(buf);
+    }
+  }
+  if(strncmp("ntrip:", url, 6))
+    return "URL must start with 'ntrip:'.";
+  url += 6; /* skip ntrip: */
+
+  if(*url != '@' && *url != '/')
+  {
+    /* scan for mountpoint */
+    args->data = Buffer;
+    while(*url && *url != '@' &&  *url != ';' &&*url != '/' && Buffer != Bufend)
+      *(Buffer++) = *(url++);
+    if(Buffer == args->data)
+      return "Mountpoint required.";
+    else if(Buffer >= Bufend-1)
+      return "Parsing buffer too short.";
+    *(Buffer++) = 0;
+  }
+
+  if(*url == '/') /* username and password */
+  {
+    ++url;
+    args->user = Buffer;
+    while(*url && *url != '@' && *url != ';' && *url != ':' && Buffer != Bufend)
+      *(Buffer++) = *(url++);
+    if(Buffer == args->user)
+      return "Username cannot be empty.";
+    else if(Buffer >= Bufend-1)
+      return "Parsing buffer too short.";
+    *(Buffer++) = 0;
+
+    if(*url == ':') ++url;
+
+    args->password = Buffer;
+    while(*url && *url != '@' && *url != ';' && Buffer != Bufend)
+      *(Buffer++) = *(url++);
+    if(Buffer == args->password)
+      return "Password cannot be empty.";
+    else if(Buffer >= Bufend-1)
+      return "Parsing buffer too short.";
+    *(Buffer++) = 0;
+  }
+
+  if(*url == '@') /* server */
+  {
+    ++url;
+    if(*url != '@' && *url != ':')
+    {
+      args->server = Buffer;
+      while(*url && *url != '@' && *url != ':' && *url != ';' && Buffer != Bufend)
+        *(Buffer++) = *(url++);
+      if(Buffer == args->server)
+        return "Servername cannot be empty.";
+      else if(Buffer >= Bufend-1)
+        return "Parsing buffer too short.";
+      *(Buffer++) = 0;
+    }
+
+    if(*url == ':')
+    {
+      ++url;
+      args->port = Buffer;
+      while(*url && *url != '@' && *url != ';' && Buffer != Bufend)
+        *(Buffer++) = *(url++);
+      if(Buffer == args->port)
+        return "Port cannot be empty.";
+      else if(Buffer >= Bufend-1)
+        return "Parsing buffer too short.";
+      *(Buffer++) = 0;
+    }
+
+    if(*url == '@') /* proxy */
+    {
+      ++url;
+      args->proxyhost = Buffer;
+      while(*url && *url != ':' && *url != ';' && Buffer != Bufend)
+        *(Buffer++) = *(url++);
+      if(Buffer == args->proxyhost)
+        return "Proxy servername cannot be empty.";
+      else if(Buffer >= Bufend-1)
+        return "Parsing buffer too short.";
+      *(Buffer++) = 0;
+
+      if(*url == ':')
+      {
+        ++url;
+        args->proxyport = Buffer;
+        while(*url && *url != ';' && Buffer != Bufend)
+          *(Buffer++) = *(url++);
+        if(Buffer == args->proxyport)
+          return "Proxy port cannot be empty.";
+        else if(Buffer >= Bufend-1)
+          return "Parsing buffer too short.";
+        *(Buffer++) = 0;
+      }
+    }
+  }
+  if(*url == ';') /* NMEA */
+  {
+    args->nmea = ++url;
+    while(*url)
+      ++url;
+  }
+
+  return *url ? "Garbage at end of server string." : 0;
+}
+
+static int getargs(int argc, char **argv, struct Args *args)
+{
+  int res = 1;
+  int getoptr;
+  int help = 0;
+  char *t;
+
+  args->server = "www.euref-ip.net";
+  args->port = "2101";
+  args->timeout = 60;
+  args->user = "";
+  args->password = "";
+  args->data = 0;
+  args->headerfile = 0;
+  args->gpsephemeris = 0;
+  args->qzssephemeris = 0;
+  args->sbasephemeris = 0;
+  args->glonassephemeris = 0;
+  args->bdsephemeris = 0;
+  args->mixedephemeris = 0;
+  args->qcfile = 0;
+  args->input = 0;
+  args->threads = 1;
+  args->checkpoint = 0;
+  args->output = 0;
+  args->streams = 0;
+  args->overflow = 0;
+  args->uring = 0;
+  args->rinex3 = 0;
+  args->nmea = 0;
+  args->changeobs = 0;
+  args->proxyhost = 0;
+  args->proxyport = "2101";
+  args->mode = AUTO;
+  help = 0;
 
-            if(sys[RTCM3_MSM_GLONASS])
-            {
-              for(j = 0; j < Parser->info[RTCM3_MSM_GLONASS].numtypes; ++j)
-              {
-                long long df = Parser->info[RTCM3_MSM_GLONASS].flags[j];
-                int pos = Parser->info[RTCM3_MSM_GLONASS].pos[j];
-                if((Parser->Data.dataflags[i] & df)
-                && !isnan(Parser->Data.measdata[i][pos])
-                && !isinf(Parser->Data.measdata[i][pos])
-                && (Parser->Data.codetype[i][pos]
-                  && Parser->info[RTCM3_MSM_GLONASS].type[pos]
-                  && Parser->info[RTCM3_MSM_GLONASS].type[pos]
-                  == Parser->Data.codetype[i][pos][1]))
-                {
-                  char lli = ' ';
-                  char snr = ' ';
-                  if(df & (GNSSDF_L1CDATA|GNSSDF_L1PDATA))
-                  {
-                    if(Parser->Data.dataflags2[i] & GNSSDF2_LOCKLOSSL1)
-                      lli = '1';
-                    snr = '0'+Parser->Data.snrL1[i];
-                  }
-                  if(df & (GNSSDF_L2CDATA|GNSSDF_L2PDATA))
-                  {
-                    if(Parser->Data.dataflags2[i] & GNSSDF2_LOCKLOSSL2)
-                      lli = '1';
-                    snr = '0'+Parser->Data.snrL2[i];
-                  }
-                  RTCM3Text("%14.3f%c%c",
-                  Parser->Data.measdata[i][pos],lli,snr);
-                }
-                else
-                { /* no or illegal data */
-                  RTCM3Text("                ");
-                }
-              }
-            }
-            else if(sys[RTCM3_MSM_GALILEO])
-            {
-              for(j = 0; j < Parser->info[RTCM3_MSM_GALILEO].numtypes; ++j)
-              {
-                long long df = Parser->info[RTCM3_MSM_GALILEO].flags[j];
-                int pos = Parser->info[RTCM3_MSM_GALILEO].pos[j];
-                if((Parser->Data.dataflags[i] & df)
-                && !isnan(Parser->Data.measdata[i][pos])
-                && !isinf(Parser->Data.measdata[i][pos])
-                && (Parser->Data.codetype[i][pos]
-                  && Parser->info[RTCM3_MSM_GALILEO].type[pos]
-                  && Parser->info[RTCM3_MSM_GALILEO].type[pos]
-                  == Parser->Data.codetype[i][pos][1]))
-                {
-                  char lli = ' ';
-                  char snr = ' ';
-                  if(df & (GNSSDF_L1CDATA|GNSSDF_L1PDATA))
-                  {
-                    if(Parser->Data.dataflags2[i] & GNSSDF2_LOCKLOSSL1)
-                      lli = '1';
-                    snr = '0'+Parser->Data.snrL1[i];
-                  }
-                  if(df & GNSSDF_L6DATA)
-                  {
-                    if(Parser->Data.dataflags2[i] & GNSSDF2_LOCKLOSSE6)
-                      lli = '1';
-                    snr = ' ';
-                  }
-                  if(df & GNSSDF_L5DATA)
-                  {
-                    if(Parser->Data.dataflags2[i] & GNSSDF2_LOCKLOSSL5)
-                      lli = '1';
-                    snr = ' ';
-                  }
-                  if(df & GNSSDF_L5BDATA)
-                  {
-                    if(Parser->Data.dataflags2[i] & GNSSDF2_LOCKLOSSE5B)
-                      lli = '1';
-                    snr = ' ';
-                  }
-                  if(df & GNSSDF_L5ABDATA)
-                  {
-                    if(Parser->Data.dataflags2[i] & GNSSDF2_LOCKLOSSE5AB)
-                      lli = '1';
-                    snr = ' ';
-                  }
-                  RTCM3Text("%14.3f%c%c",
-                  Parser->Data.measdata[i][pos],lli,snr);
-                }
-                else
-                { /* no or illegal data */
-                  RTCM3Text("                ");
-                }
-              }
-            }
-            else if(sys[RTCM3_MSM_BDS])
-            {
-              for(j = 0; j < Parser->info[RTCM3_MSM_BDS].numtypes; ++j)
-              {
-                long long df = Parser->info[RTCM3_MSM_BDS].flags[j];
-                int pos = Parser->info[RTCM3_MSM_BDS].pos[j];
-                if((Parser->Data.dataflags[i] & df)
-                && !isnan(Parser->Data.measdata[i][pos])
-                && !isinf(Parser->Data.measdata[i][pos])
-                && (Parser->Data.codetype[i][pos]
-                  && Parser->info[RTCM3_MSM_BDS].type[pos]
-                  && Parser->info[RTCM3_MSM_BDS].type[pos]
-                  == Parser->Data.codetype[i][pos][1]))
-                {
-                  char lli = ' ';
-                  char snr = ' ';
-                  if(df & GNSSDF_LB1DATA)
-                  {
-                    if(Parser->Data.dataflags2[i] & GNSSDF2_LOCKLOSSB1)
-                      lli = '1';
-                  }
-                  if(df & GNSSDF_LB2DATA)
-                  {
-                    if(Parser->Data.dataflags2[i] & GNSSDF2_LOCKLOSSB2)
-                      lli = '1';
-                  }
-                  if(df & GNSSDF_LB3DATA)
-                  {
-                    if(Parser->Data.dataflags2[i] & GNSSDF2_LOCKLOSSB3)
-                      lli = '1';
-                  }
-                  RTCM3Text("%14.3f%c%c",
-                  Parser->Data.measdata[i][pos],lli,snr);
-                }
-                else
-                { /* no or illegal data */
-                  RTCM3Text("                ");
-                }
-              }
-            }
-            else if(sys[RTCM3_MSM_QZSS])
-            {
-              for(j = 0; j < Parser->info[RTCM3_MSM_QZSS].numtypes; ++j)
-              {
-                long long df = Parser->info[RTCM3_MSM_QZSS].flags[j];
-                int pos = Parser->info[RTCM3_MSM_QZSS].pos[j];
-                if((Parser->Data.dataflags[i] & df)
-                && !isnan(Parser->Data.measdata[i][pos])
-                && !isinf(Parser->Data.measdata[i][pos])
-                && (Parser->Data.codetype[i][pos]
-                  && Parser->info[RTCM3_MSM_QZSS].type[pos]
-                  && Parser->info[RTCM3_MSM_QZSS].type[pos]
-                  == Parser->Data.codetype[i][pos][1]))
-                {
-                  char lli = ' ';
-                  char snr = ' ';
-                  if(df & GNSSDF_L1CDATA)
-                  {
-                    if(Parser->Data.dataflags2[i] & GNSSDF2_LOCKLOSSL1)
-                      lli = '1';
-                    snr = '0'+Parser->Data.snrL1[i];
-                  }
-                  if(df & (GNSSDF_L2CDATA|GNSSDF_L2PDATA))
-                  {
-                    if(Parser->Data.dataflags2[i] & GNSSDF2_LOCKLOSSL2)
-                      lli = '1';
-                    snr = '0'+Parser->Data.snrL2[i];
-                  }
-                  if(df & GNSSDF_L5DATA)
-                  {
-                    if(Parser->Data.dataflags2[i] & GNSSDF2_LOCKLOSSL5)
-                      lli = '1';
-                    snr = ' ';
-                  }
-                  RTCM3Text("%14.3f%c%c",
-                  Parser->Data.measdata[i][pos],lli,snr);
-                }
-                else
-                { /* no or illegal data */
-                  RTCM3Text("                ");
-                }
-              }
-            }
-            else if(sys[RTCM3_MSM_SBAS])
-            {
-              for(j = 0; j < Parser->info[RTCM3_MSM_SBAS].numtypes; ++j)
-              {
-                long long df = Parser->info[RTCM3_MSM_SBAS].flags[j];
-                int pos = Parser->info[RTCM3_MSM_SBAS].pos[j];
-                if((Parser->Data.dataflags[i] & df)
-                && !isnan(Parser->Data.measdata[i][pos])
-                && !isinf(Parser->Data.measdata[i][pos])
-                && (Parser->Data.codetype[i][pos]
-                  && Parser->info[RTCM3_MSM_SBAS].type[pos]
-                  && Parser->info[RTCM3_MSM_SBAS].type[pos]
-                  == Parser->Data.codetype[i][pos][1]))
-                {
-                  char lli = ' ';
-                  char snr = ' ';
-                  if(df & (GNSSDF_L1CDATA|GNSSDF_L1PDATA))
-                  {
-                    if(Parser->Data.dataflags2[i] & GNSSDF2_LOCKLOSSL1)
-                      lli = '1';
-                    snr = '0'+Parser->Data.snrL1[i];
-                  }
-                  if(df & GNSSDF_L5DATA)
-                  {
-                    if(Parser->Data.dataflags2[i] & GNSSDF2_LOCKLOSSL5)
-                      lli = '1';
-                    snr = ' ';
-                  }
-                  RTCM3Text("%14.3f%c%c",
-                  Parser->Data.measdata[i][pos],lli,snr);
-                }
-                else
-                { /* no or illegal data */
-                  RTCM3Text("                ");
-                }
-              }
-            }
-            else
-            {
-              for(j = 0; j < Parser->info[RTCM3_MSM_GPS].numtypes; ++j)
-              {
-                long long df = Parser->info[RTCM3_MSM_GPS].flags[j];
-                int pos = Parser->info[RTCM3_MSM_GPS].pos[j];
-                if((Parser->Data.dataflags[i] & df)
-                && !isnan(Parser->Data.measdata[i][pos])
-                && !isinf(Parser->Data.measdata[i][pos])
-                && (Parser->Data.codetype[i][pos]
-                  && Parser->info[RTCM3_MSM_GPS].type[pos]
-                  && Parser->info[RTCM3_MSM_GPS].type[pos]
-                  == Parser->Data.codetype[i][pos][1]))
-                {
-                  char lli = ' ';
-                  char snr = ' ';
-                  if(df & (GNSSDF_L1CDATA|GNSSDF_L1PDATA))
-                  {
-                    if(Parser->Data.dataflags2[i] & GNSSDF2_LOCKLOSSL1)
-                      lli = '1';
-                    snr = '0'+Parser->Data.snrL1[i];
-                  }
-                  if(df & (GNSSDF_L2CDATA|GNSSDF_L2PDATA))
-                  {
-                    if(Parser->Data.dataflags2[i] & GNSSDF2_LOCKLOSSL2)
-                      lli = '1';
-                    snr = '0'+Parser->Data.snrL2[i];
-                  }
-                  if(df & GNSSDF_L5DATA)
-                  {
-                    if(Parser->Data.dataflags2[i] & GNSSDF2_LOCKLOSSL5)
-                      lli = '1';
-                    snr = ' ';
-                  }
-                  RTCM3Text("%14.3f%c%c",
-                  Parser->Data.measdata[i][pos],lli,snr);
-                }
-                else
-                { /* no or illegal data */
-                  RTCM3Text("                ");
-                }
-              }
-            }
-            RTCM3Text("\n");
-          }
-        }
-        else
+  do
+  {
+
+#ifdef NO_LONG_OPTS
+    switch((getoptr = getopt(argc, argv, ARGOPT)))
+#else
+    switch((getoptr = getopt_long(argc, argv, ARGOPT, opts, 0)))
+#endif
+    {
+    case 's': args->server = optarg; break;
+    case 'u': args->user = optarg; break;
+    case 'p': args->password = optarg; break;
+    case 'd': args->data = optarg; break;
+    case 'f': args->headerfile = optarg; break;
+    case 'C': args->bdsephemeris = optarg; break;
+    case 'E': args->gpsephemeris = optarg; break;
+    case 'B': args->sbasephemeris = optarg; break;
+    case 'G': args->glonassephemeris = optarg; break;
+    case 'Q': args->qzssephemeris = optarg; break;
+    case 'q': args->qcfile = optarg; break;
+    case 'i': args->input = optarg; break;
+    case 'j':
+      args->threads = strtoul(optarg, &t, 10);
+      if((t && *t) || args->threads < 1)
+        res = 0;
+      break;
+    case 'k': args->checkpoint = optarg; break;
+    case 'o': args->output = optarg; break;
+    case 'L': args->streams = optarg; break;
+    case 'w':
+      if(!strcmp(optarg, "block"))
+        args->overflow = PIPE_BLOCK;
+      else if(!strcmp(optarg, "drop"))
+        args->overflow = PIPE_DROP;
+      else if(!strcmp(optarg, "spill"))
+        args->overflow = PIPE_SPILL;
+      else
+        res = 0;
+      break;
+    case 'P': args->mixedephemeris = optarg; break;
+    case 'r': args->port = optarg; break;
+    case '3': args->rinex3 = 1; break;
+    case 'S': args->proxyhost = optarg; break;
+    case 'n': args->nmea = optarg; break;
+    case 'R': args->proxyport = optarg; break;
+    case 'O': args->changeobs = 1; break;
+    case 'U': args->uring = 1; break;
+    case 'h': help=1; break;
+    case 'M':
+      args->mode = 0;
+      if (!strcmp(optarg,"n") || !strcmp(optarg,"ntrip1"))
+        args->mode = NTRIP1;
+      else if(!strcmp(optarg,"h") || !strcmp(optarg,"http"))
+        args->mode = HTTP;
+      else if(!strcmp(optarg,"r") || !strcmp(optarg,"rtsp"))
+        args->mode = RTSP;
+      else if(!strcmp(optarg,"a") || !strcmp(optarg,"auto"))
+        args->mode = AUTO;
+      else args->mode = atoi(optarg);
+      if((args->mode == 0) || (args->mode >= END))
+      {
+        fprintf(stderr, "Mode %s unknown\n", optarg);
+        res = 0;
+      }
+      break;
+    case 't':
+      args->timeout = strtoul(optarg, &t, 10);
+      if((t && *t) || args->timeout < 0)
+        res = 0;
+      break;
+
+    case 1:
+      {
+        const char *err;
+        if((err = geturl(optarg, args)))
         {
-          RTCM3Text(" %02d %2d %2d %2d %2d %10.7f  %d%3d",
-          cti.year%100, cti.month, cti.day, cti.hour, cti.minute, cti.second
-          + fmod(Parser->Data.timeofweek/1000.0,1.0),  nh ? 4 : 0,
-          Parser->Data.numsats);
-          for(i = 0; i < 12 && i < Parser->Data.numsats; ++i)
-          {
-            if(Parser->Data.satellites[i] <= PRN_GPS_END)
-              RTCM3Text("G%02d", Parser->Data.satellites[i]);
-            else if(Parser->Data.satellites[i] >= PRN_GLONASS_START
-            && Parser->Data.satellites[i] <= PRN_GLONASS_END)
-              RTCM3Text("R%02d", Parser->Data.satellites[i]
-              - (PRN_GLONASS_START-1));
-            else if(Parser->Data.satellites[i] >= PRN_SBAS_START
-            && Parser->Data.satellites[i] <= PRN_SBAS_END)
-              RTCM3Text("S%02d", Parser->Data.satellites[i]
-              - PRN_SBAS_START+20);
-            else if(Parser->Data.satellites[i] >= PRN_GALILEO_START
-            && Parser->Data.satellites[i] <= PRN_GALILEO_END)
-              RTCM3Text("E%02d", Parser->Data.satellites[i]
-              - (PRN_GALILEO_START-1));
-            else if(Parser->Data.satellites[i] >= PRN_GIOVE_START
-            && Parser->Data.satellites[i] <= PRN_GIOVE_END)
-              RTCM3Text("E%02d", Parser->Data.satellites[i]
-              - (PRN_GIOVE_START-PRN_GIOVE_OFFSET));
-            else if(Parser->Data.satellites[i] >= PRN_QZSS_START
-            && Parser->Data.satellites[i] <= PRN_QZSS_END)
-              RTCM3Text("J%02d", Parser->Data.satellites[i]
-              - (PRN_QZSS_START-1));
-            else if(Parser->Data.satellites[i] >= PRN_BDS_START
-            && Parser->Data.satellites[i] <= PRN_BDS_END)
-              RTCM3Text("C%02d", Parser->Data.satellites[i]
-              - (PRN_BDS_START-1));
-            else
-              RTCM3Text("%3d", Parser->Data.satellites[i]);
-          }
-          RTCM3Text("\n");
-          o = 12;
-          j = Parser->Data.numsats - 12;
-          while(j > 0)
-          {
-            RTCM3Text("                                ");
-            for(i = o; i < o+12 && i < Parser->Data.numsats; ++i)
-            {
-              if(Parser->Data.satellites[i] <= PRN_GPS_END)
-                RTCM3Text("G%02d", Parser->Data.satellites[i]);
-              else if(Parser->Data.satellites[i] >= PRN_GLONASS_START
-              && Parser->Data.satellites[i] <= PRN_GLONASS_END)
-                RTCM3Text("R%02d", Parser->Data.satellites[i]
-                - (PRN_GLONASS_START-1));
-              else if(Parser->Data.satellites[i] >= PRN_SBAS_START
-              && Parser->Data.satellites[i] <= PRN_SBAS_END)
-                RTCM3Text("S%02d", Parser->Data.satellites[i]
-                - PRN_SBAS_START+20);
-              else if(Parser->Data.satellites[i] >= PRN_GALILEO_START
-              && Parser->Data.satellites[i] <= PRN_GALILEO_END)
-                RTCM3Text("E%02d", Parser->Data.satellites[i]
-                - (PRN_GALILEO_START-1));
-              else if(Parser->Data.satellites[i] >= PRN_GIOVE_START
-              && Parser->Data.satellites[i] <= PRN_GIOVE_END)
-                RTCM3Text("E%02d", Parser->Data.satellites[i]
-                - (PRN_GIOVE_START-PRN_GIOVE_OFFSET));
-              else if(Parser->Data.satellites[i] >= PRN_QZSS_START
-              && Parser->Data.satellites[i] <= PRN_QZSS_END)
-                RTCM3Text("J%02d", Parser->Data.satellites[i]
-                - (PRN_QZSS_START-1));
-              else if(Parser->Data.satellites[i] >= PRN_BDS_START
-              && Parser->Data.satellites[i] <= PRN_BDS_END)
-                RTCM3Text("C%02d", Parser->Data.satellites[i]
-                - (PRN_BDS_START-1));
-              else
-                RTCM3Text("%3d", Parser->Data.satellites[i]);
-            }
-            RTCM3Text("\n");
-            j -= 12;
-            o += 12;
-          }
-          if(nh)
-          {
-            RTCM3Text("%s\n                             "
-            "                               END OF HEADER\n", newheader);
-          }
-          for(i = 0; i < Parser->Data.numsats; ++i)
-          {
-            for(j = 0; j < Parser->info[RTCM3_MSM_GPS].numtypes; ++j)
-            {
-              int v = 0;
-              long long df = Parser->flags[j];
-              int pos = Parser->pos[j];
-              if((Parser->Data.dataflags[i] & df)
-              && !isnan(Parser->Data.measdata[i][pos])
-              && !isinf(Parser->Data.measdata[i][pos]))
-              {
-                v = 1;
-              }
-              else
-              {
-                df = Parser->info[RTCM3_MSM_GPS].flags[j];
-                pos = Parser->info[RTCM3_MSM_GPS].pos[j];
+          RTCM3Error("%s\n\n", err);
+          res = 0;
+        }
+      }
+      break;
+    case -1: break;
+    }
+  } while(getoptr != -1 || !res);
+
+  datestr[0] = datestr[7];
+  datestr[1] = datestr[8];
+  datestr[2] = datestr[9];
+  datestr[3] = datestr[10];
+  datestr[5] = datestr[12];
+  datestr[6] = datestr[13];
+  datestr[8] = datestr[15];
+  datestr[9] = datestr[16];
+  datestr[4] = datestr[7] = '-';
+  datestr[10] = 0;
+
+  if(args->mixedephemeris && !args->rinex3)
+  {
+    RTCM3Error("RINEX2 cannot created combined ephemeris file.\n");
+    res = 0;
+  }
+  else if(args->mixedephemeris && (args->gpsephemeris || args->glonassephemeris
+  || args->bdsephemeris || args->qzssephemeris || args->sbasephemeris))
+  {
+    RTCM3Error("Combined ephemeris file specified with another one.\n"
+    "Please specify only one navigation file.\n");
+    res = 0;
+  }
+  else if(args->bdsephemeris && !args->rinex3)
+  {
+    RTCM3Error("RINEX2 cannot produce BDS ephemeris.\n");
+    res = 0;
+  }
+  else if(args->uring && !args->streams)
+  {
+    RTCM3Error("Only the files of a stream list are written with io_uring.\n");
+    res = 0;
+  }
+  else if(!res || help)
+  {
+    RTCM3Error("Version %s (%s) GPL" COMPILEDATE
+    "\nUsage: %s -s server -u user ...\n"
+    " -d " LONG_OPT("--data             ") "the requested data set\n"
+    " -f " LONG_OPT("--headerfile       ") "file for RINEX header information\n"
+    " -s " LONG_OPT("--server           ") "the server name or address\n"
+    " -p " LONG_OPT("--password         ") "the login password\n"
+    " -r " LONG_OPT("--port             ") "the server port number (default 2101)\n"
+    " -t " LONG_OPT("--timeout          ") "timeout in seconds (default 60)\n"
+    " -u " LONG_OPT("--user             ") "the user name\n"
+    " -C " LONG_OPT("--bdsephemeris     ") "output file for BDS ephemeris data\n"
+    " -E " LONG_OPT("--gpsephemeris     ") "output file for GPS ephemeris data\n"
+    " -G " LONG_OPT("--glonassephemeris ") "output file for GLONASS ephemeris data\n"
+    " -Q " LONG_OPT("--qzssephemeris    ") "output file for QZSS ephemeris data\n"
+    " -B " LONG_OPT("--sbasephemeris    ") "output file for SBAS ephemeris data\n"
+    " -P " LONG_OPT("--mixedephemeris   ") "output file for all ephemeris data\n"
+    " -3 " LONG_OPT("--rinex3           ") "output RINEX type 3 data\n"
+    " -S " LONG_OPT("--proxyhost        ") "proxy name or address\n"
+    " -R " LONG_OPT("--proxyport        ") "proxy port, optional (default 2101)\n"
+    " -n " LONG_OPT("--nmea             ") "NMEA string for sending to server\n"
+    " -O " LONG_OPT("--changeobs        ") "Add observation type change header lines\n"
+    " -q " LONG_OPT("--qcfile           ") "output file for quality control summary\n"
+    " -i " LONG_OPT("--input            ") "convert RTCM3 file instead of NTRIP stream, - is stdin\n"
+    " -j " LONG_OPT("--threads          ") "number of threads for an input file or a stream list\n"
+    " -k " LONG_OPT("--checkpoint       ") "file to keep the parser state over restarts\n"
+    " -o " LONG_OPT("--output           ") "output file for observation data instead of stdout\n"
+    " -L " LONG_OPT("--streams          ") "file with one stream per line, all converted at once\n"
+    " -w " LONG_OPT("--overflow         ") "write in a separate thread, full queue: block, drop, spill\n"
+    " -U " LONG_OPT("--uring            ") "write the files of a stream list with io_uring\n"
+    " -M " LONG_OPT("--mode             ") "mode for data request\n"
+    "     Valid modes are:\n"
+    "     1, h, http     NTRIP Version 2.0 Caster in TCP/IP mode\n"
+    "     2, r, rtsp     NTRIP Version 2.0 Caster in RTSP/RTP mode\n"
+    "     3, n, ntrip1   NTRIP Version 1.0 Caster\n"
+    "     4, a, auto     automatic detection (default)\n"
+    "or using an URL:\n%s ntrip:data[/user[:password]][@[server][:port][@proxyhost[:proxyport]]][;nmea]\n"
+    , revisionstr, datestr, argv[0], argv[0]);
+    exit(1);
+  }
+  return res;
+}
+
+/* let the output complete a block if necessary */
+static void signalhandler(int sig)
+{
+  if(!stop)
+  {
+    RTCM3Error("Stop signal number %d received. "
+    "Trying to terminate gentle.\n", sig);
+    stop = 1;
+    alarm(1);
+  }
+}
 
-                if((Parser->Data.dataflags[i] & df)
-                && !isnan(Parser->Data.measdata[i][pos])
-                && !isinf(Parser->Data.measdata[i][pos]))
-                {
-                  v = 1;
-                }
-              }
+#ifndef WINDOWSVERSION
+static void WaitMicro(int mic)
+{
+  struct timeval tv;
+  tv.tv_sec = mic/1000000;
+  tv.tv_usec = mic%1000000;
+#ifdef DEBUG
+  fprintf(stderr, "Waiting %d micro seconds\n", mic);
+#endif
+  select(0, 0, 0, 0, &tv);
+}
+#else /* WINDOWSVERSION */
+void WaitMicro(int mic)
+{
+   Sleep(mic/1000);
+}
+#endif /* WINDOWSVERSION */
 
-              if(!v)
-              { /* no or illegal data */
-                RTCM3Text("                ");
-              }
-              else
-              {
-                char lli = ' ';
-                char snr = ' ';
-                if(df & (GNSSDF_L1CDATA|GNSSDF_L1PDATA))
-                {
-                  if(Parser->Data.dataflags2[i] & GNSSDF2_LOCKLOSSL1)
-                    lli = '1';
-                  snr = '0'+Parser->Data.snrL1[i];
-                }
-                if(df & (GNSSDF_L2CDATA|GNSSDF_L2PDATA))
-                {
-                  if(Parser->Data.dataflags2[i]
-                  & (GNSSDF2_LOCKLOSSL2|GNSSDF2_XCORRL2))
-                  {
-                    lli = '0';
-                    if(Parser->Data.dataflags2[i] & GNSSDF2_LOCKLOSSL2)
-                      lli += 1;
-                    if(Parser->Data.dataflags2[i] & GNSSDF2_XCORRL2)
-                      lli += 4;
-                  }
-                  snr = '0'+Parser->Data.snrL2[i];
-                }
-                if((df & GNSSDF_P2DATA) && (Parser->Data.dataflags2[i]
-                & GNSSDF2_XCORRL2))
-                  lli = '4';
-                RTCM3Text("%14.3f%c%c",
-                Parser->Data.measdata[i][pos],lli,snr);
-              }
-              if(j%5 == 4 || j == Parser->info[RTCM3_MSM_GPS].numtypes-1)
-                RTCM3Text("\n");
-            }
-          }
-        }
+#define ALARMTIME   (2*60)
+
+/* for some reason we had to abort hard (maybe waiting for data */
+#ifdef __GNUC__
+static __attribute__ ((noreturn)) void signalhandler_alarm(
+int sig __attribute__((__unused__)))
+#else /* __GNUC__ */
+static void signalhandler_alarm(int sig)
+#endif /* __GNUC__ */
+{
+  RTCM3Error("Programm forcefully terminated.\n");
+  exit(1);
+}
+
+/* takes the station position from APPROX POSITION XYZ of the header file,
+   it is needed before the header is written to restore ambiguities */
+static void HeaderFilePosition(struct RTCM3ParserData *Parser)
+{
+  FILE *fh;
+  char line[256];
+
+  if(!Parser->headerfile || !(fh = fopen(Parser->headerfile, "r")))
+    return;
+  while(fgets(line, sizeof(line), fh))
+  {
+    if(strlen(line) >= 60+19 && !strncmp(line+60, "APPROX POSITION XYZ", 19))
+    {
+      double x, y, z;
+      line[60] = 0;
+      if(sscanf(line, "%lf%lf%lf", &x, &y, &z) == 3)
+      {
+        Parser->refpos[0] = x;
+        Parser->refpos[1] = y;
+        Parser->refpos[2] = z;
       }
     }
   }
+  fclose(fh);
 }
 
-#ifndef NO_RTCM3_MAIN
-static char datestr[]     = "$Date$";
+/* takes the output settings of the arguments */
+static void ParserArgs(struct RTCM3ParserData *Parser, const struct Args *args)
+{
+  Parser->headerfile = args->headerfile;
+  Parser->glonassephemeris = args->glonassephemeris;
+  Parser->gpsephemeris = args->gpsephemeris;
+  Parser->bdsephemeris = args->bdsephemeris;
+  Parser->qzssephemeris = args->qzssephemeris;
+  Parser->sbasephemeris = args->sbasephemeris;
+  Parser->mixedephemeris = args->mixedephemeris;
+  Parser->qcfile = args->qcfile;
+  if(Parser->qcfile && !(Parser->qc = calloc(1, sizeof(*Parser->qc))))
+  {
+    RTCM3Error("Could not allocate quality control.\n");
+    exit(1);
+  }
+  Parser->rinex3 = args->rinex3;
+  Parser->changeobs = args->changeobs;
+  Parser->checkpoint = args->checkpoint;
+  if(Parser->checkpoint)
+    ReadCheckpoint(Parser);
+  HeaderFilePosition(Parser); /* after the checkpoint, the file has priority */
+}
 
-/* The string, which is send as agent in HTTP request */
-#define AGENTSTRING "NTRIP NtripRTCM3ToRINEX"
+#define INPUTCHUNK (16*1024*1024) /* bytes passed to the parser at once */
+#define PARALLELCHUNKS 4 /* chunks per thread */
+#define PARALLELMIN (1024*1024) /* smallest chunk */
+#define NAVFILES 6
 
-#define MAXDATASIZE 1000 /* max number of bytes we can get at once */
+/* A chunk of the input converted by a thread. It starts with a copy of the
+   parser made just before the chunk, so its output is the same as the serial
+   one. */
+struct ConvertChunk
+{
+  const unsigned char *data;
+  size_t size;
+  struct RTCM3ParserData *parser;
+  FILE *text; /* observation output */
+  int done;
+};
 
-static const char encodingTable [64] = {
-  'A','B','C','D','E','F','G','H','I','J','K','L','M','N','O','P',
-  'Q','R','S','T','U','V','W','X','Y','Z','a','b','c','d','e','f',
-  'g','h','i','j','k','l','m','n','o','p','q','r','s','t','u','v',
-  'w','x','y','z','0','1','2','3','4','5','6','7','8','9','+','/'
+struct ConvertJob
+{
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  struct ConvertChunk *chunks;
+  int ready; /* chunks with a parser */
+  int next;  /* next chunk to convert */
+  int end;   /* no more chunks get ready */
 };
 
-/* does not buffer overrun, but breaks directly after an error */
-/* returns the number of required bytes */
-static int encode(char *buf, int size, const char *user, const char *pwd)
+/* the navigation output fields of a parser */
+static void NavFields(struct RTCM3ParserData *Parser, FILE **files[NAVFILES],
+const char **names[NAVFILES])
 {
-  unsigned char inbuf[3];
-  char *out = buf;
-  int i, sep = 0, fill = 0, bytes = 0;
+  files[0] = &Parser->gpsfile; names[0] = &Parser->gpsephemeris;
+  files[1] = &Parser->glonassfile; names[1] = &Parser->glonassephemeris;
+  files[2] = &Parser->sbasfile; names[2] = &Parser->sbasephemeris;
+  files[3] = &Parser->qzssfile; names[3] = &Parser->qzssephemeris;
+  files[4] = &Parser->bdsfile; names[4] = &Parser->bdsephemeris;
+  files[5] = &Parser->mixedfile; names[5] = &Parser->mixedephemeris;
+}
 
-  while(*user || *pwd)
+/* appends the temporary file from to the file to and closes from */
+static void AppendFile(FILE *to, FILE *from)
+{
+  static THREADLOCAL char buf[65536];
+  size_t n;
+
+  rewind(from);
+  while((n = fread(buf, 1, sizeof(buf), from)) > 0)
+    fwrite(buf, 1, n, to);
+  fclose(from);
+}
+
+static void *ConvertThread(void *arg)
+{
+  struct ConvertJob *job = (struct ConvertJob *)arg;
+
+  errorquiet = 1; /* the messages come from the serial state pass */
+  pthread_mutex_lock(&job->mutex);
+  for(;;)
   {
-    i = 0;
-    while(i < 3 && *user) inbuf[i++] = *(user++);
-    if(i < 3 && !sep)    {inbuf[i++] = ':'; ++sep; }
-    while(i < 3 && *pwd)  inbuf[i++] = *(pwd++);
-    while(i < 3)         {inbuf[i++] = 0; ++fill; }
-    if(out-buf < size-1)
-      *(out++) = encodingTable[(inbuf [0] & 0xFC) >> 2];
-    if(out-buf < size-1)
-      *(out++) = encodingTable[((inbuf [0] & 0x03) << 4)
-               | ((inbuf [1] & 0xF0) >> 4)];
-    if(out-buf < size-1)
+    struct ConvertChunk *c;
+
+    while(job->next >= job->ready && !job->end)
+      pthread_cond_wait(&job->cond, &job->mutex);
+    if(job->next >= job->ready)
+      break;
+    c = job->chunks + job->next++;
+    pthread_mutex_unlock(&job->mutex);
+
+    textfile = c->text;
+    HandleBytes(c->parser, c->data, c->size);
+    textfile = 0;
+
+    pthread_mutex_lock(&job->mutex);
+    c->done = 1;
+    pthread_cond_broadcast(&job->cond);
+  }
+  pthread_mutex_unlock(&job->mutex);
+  return 0;
+}
+
+/* Converts size bytes with threads. The calling thread runs the parser over
+   all data as a state pass, which keeps the state (lock times, GLONASS
+   frequencies, ephemerides, header, quality control) but formats no text.
+   Before each chunk the parser is copied for a thread, which converts the
+   chunk to temporary files. These are appended in order, so the output is
+   the serial one. Returns the number of converted bytes. */
+static size_t ConvertParallel(struct RTCM3ParserData *Parser,
+const unsigned char *data, size_t size, int threads)
+{
+  struct ConvertJob job;
+  pthread_t *tids = 0;
+  FILE **files[NAVFILES], *out[NAVFILES];
+  const char **names[NAVFILES], *realnames[NAVFILES];
+  size_t step, pos = 0;
+  int num, i, k, n;
+
+  num = threads*PARALLELCHUNKS;
+  if((size_t)num > size/PARALLELMIN)
+    num = size/PARALLELMIN > 1 ? size/PARALLELMIN : 1;
+  step = (size+num-1)/num;
+  memset(&job, 0, sizeof(job));
+  if(!(job.chunks = calloc(num, sizeof(*job.chunks)))
+  || !(tids = calloc(threads, sizeof(*tids))))
+  {
+    RTCM3Error("Could not prepare threads, converting serially.\n");
+    free(tids);
+    free(job.chunks);
+    return 0;
+  }
+  pthread_mutex_init(&job.mutex, 0);
+  pthread_cond_init(&job.cond, 0);
+  for(n = 0; n < threads && !pthread_create(tids+n, 0, ConvertThread, &job);
+  ++n)
+    ;
+
+  NavFields(Parser, files, names);
+  for(i = 0; i < NAVFILES; ++i)
+  {
+    realnames[i] = *names[i];
+    out[i] = 0;
+  }
+  Parser->statepass = 1;
+  textdiscard = 1;
+  for(k = 0; k < num && pos < size && !stop; ++k)
+  {
+    struct ConvertChunk *c = job.chunks+k;
+    struct RTCM3ParserData *p;
+
+    c->data = data+pos;
+    c->size = size-pos < step ? size-pos : step;
+    if((p = c->parser = malloc(sizeof(*p))))
     {
-      if(fill == 2)
-        *(out++) = '=';
+      memcpy(p, Parser, sizeof(*p));
+      p->ephemerides = 0;
+      p->qc = 0;
+    }
+    if(!p || (Parser->ephemerides
+    && !(p->ephemerides = malloc(sizeof(*p->ephemerides))))
+    || !(c->text = tmpfile()))
+    {
+      RTCM3Error("Could not prepare chunk, converting the rest serially.\n");
+      if(p)
+        RTCM3ParserFree(p);
+      free(c->parser);
+      c->parser = 0;
+      break;
+    }
+    if(p->ephemerides) /* the chunk stores its own ephemerides */
+      memcpy(p->ephemerides, Parser->ephemerides, sizeof(*p->ephemerides));
+    if(Parser->DataNew)
+    {
+      p->DataNew = p->EpochData + (Parser->DataNew-Parser->EpochData);
+      p->Data = p->EpochData + (Parser->Data-Parser->EpochData);
+    }
+    p->statepass = 0;
+    p->navtemp = 1;
+    p->qcfile = 0;
+    p->checkpoint = 0;
+    NavFields(p, files, names);
+    for(i = 0; i < NAVFILES; ++i)
+    {
+      if(*files[i]) /* already opened in the state pass */
+        *files[i] = tmpfile();
+    }
+
+    pthread_mutex_lock(&job.mutex);
+    job.ready = k+1;
+    pthread_cond_signal(&job.cond);
+    pthread_mutex_unlock(&job.mutex);
+    HandleBytes(Parser, c->data, c->size);
+    pos += c->size;
+  }
+  textdiscard = 0;
+  Parser->statepass = 0;
+  pthread_mutex_lock(&job.mutex);
+  job.end = 1;
+  pthread_cond_broadcast(&job.cond);
+  pthread_mutex_unlock(&job.mutex);
+
+  /* the output in the order of the chunks */
+  for(k = 0; k < job.ready; ++k)
+  {
+    struct ConvertChunk *c = job.chunks+k;
+
+    pthread_mutex_lock(&job.mutex);
+    while(!c->done)
+      pthread_cond_wait(&job.cond, &job.mutex);
+    pthread_mutex_unlock(&job.mutex);
+    AppendFile(stdout, c->text);
+    NavFields(c->parser, files, names);
+    for(i = 0; i < NAVFILES; ++i)
+    {
+      if(!*files[i])
+        continue;
+      if(!out[i] && !(out[i] = fopen(realnames[i], "w")))
+      {
+        RTCM3Error("Could not open ephemeris output file '%s'.\n",
+        realnames[i]);
+        realnames[i] = 0;
+      }
+      if(out[i])
+        AppendFile(out[i], *files[i]);
       else
-        *(out++) = encodingTable[((inbuf [1] & 0x0F) << 2)
-                 | ((inbuf [2] & 0xC0) >> 6)];
+        fclose(*files[i]);
     }
-    if(out-buf < size-1)
+    RTCM3ParserFree(c->parser);
+    free(c->parser);
+  }
+  while(n--)
+    pthread_join(tids[n], 0);
+  pthread_cond_destroy(&job.cond);
+  pthread_mutex_destroy(&job.mutex);
+
+  /* the state pass opened /dev/null instead of the files */
+  NavFields(Parser, files, names);
+  for(i = 0; i < NAVFILES; ++i)
+  {
+    if(*files[i])
+      fclose(*files[i]);
+    *files[i] = out[i];
+  }
+  free(tids);
+  free(job.chunks);
+  return pos;
+}
+
+/* Converts a RTCM3 file or stdin ("-"). Regular files are mapped into memory
+   and the messages are decoded in place, others are read in large blocks.
+   Mapped files are converted with the given number of threads. */
+static void ReadInput(struct RTCM3ParserData *Parser, const char *name,
+int threads)
+{
+  struct timeval t0, t1;
+  struct stat st;
+  double total = 0.0, sec;
+  int fd, mapped = 0;
+
+  if(!strcmp(name, "-"))
+    fd = 0;
+  else if((fd = open(name, O_RDONLY)) < 0)
+  {
+    RTCM3Error("Could not open input file '%s': %s\n", name, strerror(errno));
+    exit(1);
+  }
+  gettimeofday(&t0, 0);
+  if(!fstat(fd, &st) && S_ISREG(st.st_mode) && st.st_size > 0)
+  {
+    size_t size = st.st_size, pos, n;
+    unsigned char *map = mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    if(map != MAP_FAILED)
     {
-      if(fill >= 1)
-        *(out++) = '=';
+      mapped = 1;
+      madvise(map, size, MADV_SEQUENTIAL);
+      pos = threads > 1 ? ConvertParallel(Parser, map, size, threads) : 0;
+      total = pos;
+      for(; !stop && pos < size; pos += n)
+      {
+        n = size-pos < INPUTCHUNK ? size-pos : INPUTCHUNK;
+        HandleBytes(Parser, map+pos, n);
+        /* the parser copies an incomplete message, the pages are done */
+        madvise(map+pos, n, MADV_DONTNEED);
+        total += n;
+      }
+      munmap(map, size);
+    }
+  }
+  if(!mapped)
+  {
+    static unsigned char buf[INPUTCHUNK];
+    ssize_t n;
+
+    while(!stop && (n = read(fd, buf, sizeof(buf))) > 0)
+    {
+      HandleBytes(Parser, buf, n);
+      total += n;
+    }
+  }
+  gettimeofday(&t1, 0);
+  if(fd)
+    close(fd);
+  sec = (t1.tv_sec-t0.tv_sec) + (t1.tv_usec-t0.tv_usec)/1000000.0;
+  RTCM3Error("Converted %.1f MB in %.2f seconds (%.1f MB/s).\n",
+  total/1000000.0, sec, sec > 0.0 ? total/1000000.0/sec : 0.0);
+}
+
+static void *PipeConverter(void *arg)
+{
+  struct Pipeline *p = arg;
+  struct PipeBuffer *b;
+
+  textpipe = p;
+  while((b = PipePop(&p->input)))
+  {
+    HandleBytes(p->parser, b->data, b->size);
+    free(b);
+  }
+  textpipe = 0;
+  PipeClose(&p->output);
+  return 0;
+}
+
+static void *PipeWriter(void *arg)
+{
+  struct Pipeline *p = arg;
+  struct PipeBuffer *b;
+
+  while((b = PipePop(&p->output)))
+  {
+    ++p->writes;
+    if(fwrite(b->data, 1, b->size, p->out) == b->size)
+      p->written += b->size;
+    else
+      ++p->writeerrors;
+    free(b);
+  }
+  return 0;
+}
+
+static void PipeInit(struct PipeRing *r, enum PipePolicy policy)
+{
+  r->policy = policy;
+  sem_init(&r->consumerwake, 0, 0);
+  sem_init(&r->producerwake, 0, 0);
+  pthread_mutex_init(&r->spillmutex, 0);
+  if(policy == PIPE_SPILL && !(r->spill = tmpfile()))
+  {
+    RTCM3Error("Could not create spill file: %s\n", strerror(errno));
+    exit(1);
+  }
+}
+
+/* Writing is done by a thread of its own. With receive the received data
+   is converted by another thread, otherwise by the calling one. */
+static void PipelineStart(struct RTCM3ParserData *Parser,
+enum PipePolicy policy, int receive)
+{
+  struct Pipeline *p;
+  sigset_t sigs, oldsigs;
+
+  if(!(p = calloc(1, sizeof(*p))))
+  {
+    RTCM3Error("Could not allocate pipeline.\n");
+    exit(1);
+  }
+  p->parser = Parser;
+  p->out = stdout;
+  PipeInit(&p->input, PIPE_BLOCK);
+  PipeInit(&p->output, policy);
+  /* the signals stay with the receiving thread */
+  sigfillset(&sigs);
+  pthread_sigmask(SIG_BLOCK, &sigs, &oldsigs);
+  if(pthread_create(&p->writer, 0, PipeWriter, p)
+  || (receive && pthread_create(&p->converter, 0, PipeConverter, p)))
+  {
+    RTCM3Error("Could not start pipeline threads.\n");
+    exit(1);
+  }
+  pthread_sigmask(SIG_SETMASK, &oldsigs, 0);
+  p->hasconverter = receive;
+  if(!receive)
+    textpipe = p;
+  pipeline = p;
+}
+
+/* the stages finish in order, then the counters are shown */
+static void PipelineStop(void)
+{
+  struct Pipeline *p = pipeline;
+
+  if(!p)
+    return;
+  if(p->hasconverter)
+  {
+    PipeClose(&p->input);
+    pthread_join(p->converter, 0);
+  }
+  else
+  {
+    textpipe = 0;
+    PipeClose(&p->output);
+  }
+  pthread_join(p->writer, 0);
+  pipeline = 0;
+  if(p->hasconverter)
+  {
+    RTCM3Error("Receive: %ld buffers, %.1f MB, queue max %ld, %ld times "
+    "full.\n", p->input.buffers, p->input.bytes/1000000.0, p->input.maxdepth,
+    p->input.blocked);
+  }
+  RTCM3Error("Convert: %ld results, %ld epochs, %.1f MB text.\n", p->results,
+  p->epochs, p->converted/1000000.0);
+  RTCM3Error("Output queue: %ld buffers, max %ld, %ld times blocked, "
+  "%ld dropped (%.1f MB), %ld spilled (%.1f MB).\n", p->output.buffers,
+  p->output.maxdepth, p->output.blocked, p->output.dropped,
+  p->output.droppedbytes/1000000.0, p->output.spilled,
+  p->output.spilledbytes/1000000.0);
+  RTCM3Error("Write: %ld writes, %.1f MB, %ld errors.\n", p->writes,
+  p->written/1000000.0, p->writeerrors);
+  if(p->output.spill)
+    fclose(p->output.spill);
+  free(p);
+}
+
+/* received data goes to the converting stage */
+static void HandleReceived(struct RTCM3ParserData *Parser, const char *buf,
+int size)
+{
+  if(pipeline)
+    PipePush(&pipeline->input, PipeBuffer(buf, size));
+  else
+    HandleBytes(Parser, (const unsigned char *)buf, size);
+}
+
+/* Address of the caster or of the proxy. For a proxy proxyserver and
+   proxyport are the caster to be given in the request, otherwise
+   proxyserver is 0. */
+static int NtripAddress(const struct Args *args, struct sockaddr_in *addr,
+const char **proxyserver, char proxyport[6])
+{
+  struct hostent *he;
+  struct servent *se;
+  const char *server, *port;
+  char *b;
+  long i;
+
+  *proxyserver = 0;
+  if(args->proxyhost)
+  {
+    int p;
+    if((i = strtol(args->port, &b, 10)) && (!b || !*b))
+      p = i;
+    else if(!(se = getservbyname(args->port, 0)))
+    {
+      RTCM3Error("Can't resolve port %s.", args->port);
+      return 0;
+    }
+    else
+    {
+      p = ntohs(se->s_port);
+    }
+    snprintf(proxyport, 6, "%d", p);
+    port = args->proxyport;
+    *proxyserver = args->server;
+    server = args->proxyhost;
+  }
+  else
+  {
+    server = args->server;
+    port = args->port;
+  }
+
+  memset(addr, 0, sizeof(struct sockaddr_in));
+  if((i = strtol(port, &b, 10)) && (!b || !*b))
+    addr->sin_port = htons(i);
+  else if(!(se = getservbyname(port, 0)))
+  {
+    RTCM3Error("Can't resolve port %s.", port);
+    return 0;
+  }
+  else
+  {
+    addr->sin_port = se->s_port;
+  }
+  if(!(he=gethostbyname(server)))
+  {
+    RTCM3Error("Server name lookup failed for '%s'.\n", server);
+    return 0;
+  }
+  addr->sin_family = AF_INET;
+  addr->sin_addr = *((struct in_addr *)he->h_addr);
+  return 1;
+}
+
+/* the HTTP request for NTRIP version 1 and 2, returns the length or 0 */
+static int NtripRequest(char *buf, const struct Args *args,
+const char *proxyserver, const char *proxyport)
+{
+  int i;
+
+  if(!args->data)
+  {
+    i = snprintf(buf, MAXDATASIZE,
+    "GET %s%s%s%s/ HTTP/1.0\r\n"
+    "Host: %s\r\n%s"
+    "User-Agent: %s/%s\r\n"
+    "Connection: close\r\n"
+    "\r\n"
+    , proxyserver ? "http://" : "", proxyserver ? proxyserver : "",
+    proxyserver ? ":" : "", proxyserver ? proxyport : "",
+    args->server, args->mode == NTRIP1 ? "" : "Ntrip-Version: Ntrip/2.0\r\n",
+    AGENTSTRING, revisionstr);
+    if(i >= MAXDATASIZE || i < 0)
+    {
+      RTCM3Error("Requested data too long\n");
+      return 0;
+    }
+  }
+  else
+  {
+    i=snprintf(buf, MAXDATASIZE-40, /* leave some space for login */
+    "GET %s%s%s%s/%s HTTP/1.0\r\n"
+    "Host: %s\r\n%s"
+    "User-Agent: %s/%s\r\n"
+    "Connection: close\r\n"
+    "Authorization: Basic "
+    , proxyserver ? "http://" : "", proxyserver ? proxyserver : "",
+    proxyserver ? ":" : "", proxyserver ? proxyport : "",
+    args->data, args->server,
+    args->mode == NTRIP1 ? "" : "Ntrip-Version: Ntrip/2.0\r\n",
+    AGENTSTRING, revisionstr);
+    if(i > MAXDATASIZE-40 || i < 0) /* second check for old glibc */
+    {
+      RTCM3Error("Requested data too long\n");
+      return 0;
+    }
+    i += encode(buf+i, MAXDATASIZE-i-4, args->user, args->password);
+    if(i > MAXDATASIZE-4)
+    {
+      RTCM3Error("Username and/or password too long\n");
+      return 0;
+    }
+    buf[i++] = '\r';
+    buf[i++] = '\n';
+    buf[i++] = '\r';
+    buf[i++] = '\n';
+    if(args->nmea)
+    {
+      int j = snprintf(buf+i, MAXDATASIZE-i, "%s\r\n", args->nmea);
+      if(j >= 0 && j < MAXDATASIZE-i)
+        i += j;
       else
-        *(out++) = encodingTable[inbuf [2] & 0x3F];
+      {
+        RTCM3Error("NMEA string too long\n");
+        return 0;
+      }
+    }
+  }
+  return i;
+}
+
+/* state of the chunked transfer encoding of NTRIP version 2 */
+struct ChunkState
+{
+  int mode; /* 1 before the size, 0 for no chunked encoding */
+  int size; /* bytes left in the chunk */
+};
+
+/* removes the chunked transfer encoding in place, returns the number of
+   data bytes now at the start of buf or -1 for an error in the encoding */
+static int Dechunk(struct ChunkState *c, char *buf, int numbytes)
+{
+  int i, pos = 0, total = 0;
+
+  while(pos < numbytes)
+  {
+    switch(c->mode)
+    {
+    case 1: /* reading number starts */
+      c->size = 0;
+      ++c->mode; /* no break */
+    case 2: /* during reading number */
+      i = buf[pos++];
+      if(i >= '0' && i <= '9') c->size = c->size*16+i-'0';
+      else if(i >= 'a' && i <= 'f') c->size = c->size*16+i-'a'+10;
+      else if(i >= 'A' && i <= 'F') c->size = c->size*16+i-'A'+10;
+      else if(i == '\r') ++c->mode;
+      else if(i == ';') c->mode = 5;
+      else return -1;
+      break;
+    case 3: /* scanning for return */
+      if(buf[pos++] == '\n') c->mode = c->size ? 4 : 1;
+      else return -1;
+      break;
+    case 4: /* data */
+      i = numbytes-pos;
+      if(i > c->size) i = c->size;
+      memmove(buf+total, buf+pos, i);
+      total += i;
+      c->size -= i;
+      pos += i;
+      if(!c->size)
+        c->mode = 1;
+      break;
+    case 5: /* chunk extension */
+      if(buf[pos++] == '\r') c->mode = 3;
+      break;
     }
-    bytes += 4;
   }
-  if(out-buf < size)
-    *out = 0;
-  return bytes;
+  return total;
 }
 
-static int stop = 0;
+#ifdef __linux__
+#define STREAMBUFFER 65536 /* bytes read from a stream at once */
+#define STREAMRETRY 10 /* seconds before a failed stream is connected again */
+#define STREAMRESPONSE 1024 /* size of the caster response header */
+#define STREAMARGS 64 /* arguments of a line of the stream list */
+#define STREAMBATCH 16 /* conversions between two looks at the sockets */
+#define STREAMREPORT 60 /* seconds between two reports of the shards */
+#define STREAMWAKE (~(uint64_t)0) /* epoll data of the wakeup eventfd */
+
+enum StreamState { STREAM_RETRY, STREAM_CONNECT, STREAM_RESPONSE,
+STREAM_DATA };
+
+struct StreamShard;
+
+/* A stream of the stream list with its own parser and output files. The
+   socket and the timer are in the epoll set of its shard with data index*2
+   and index*2+1. Received data is appended to pending and the stream is
+   queued at its shard. A queued stream is converted by one worker at a
+   time, but any worker may take it from the queue. */
+struct Stream
+{
+  struct Args args;
+  struct RTCM3ParserData *parser;
+  struct StreamShard *shard;
+  struct sockaddr_in addr;
+  const char *proxyserver;
+  char proxyport[6];
+  FILE *obs;
+  int sock;  /* -1 when not connected */
+  int timer; /* timeout or retry */
+  int index;
+  enum StreamState state;
+  time_t lastdata;
+  struct ChunkState chunk;
+  int responsesize;
+  char response[STREAMRESPONSE+1];
+  pthread_mutex_t mutex; /* for pending, resetpos and queued */
+  unsigned char *pending, *work;
+  size_t pendingsize, pendingalloc, workalloc;
+  long resetpos; /* a new connection starts here, -1 for none */
+  int queued;
+  double queuetime;
+};
 
-struct Args
+/* A worker thread handles the sockets and timers of the streams of its
+   shard and converts queued streams, its own ones first. */
+struct StreamShard
 {
-  const char *server;
-  const char *port;
-  int         mode;
-  int         timeout;
-  int         rinex3;
-  int         changeobs;
-  const char *user;
-  const char *password;
-  const char *proxyhost;
-  const char *proxyport;
-  const char *nmea;
-  const char *data;
-  const char *headerfile;
-  const char *sbasephemeris;
-  const char *gpsephemeris;
-  const char *qzssephemeris;
-  const char *glonassephemeris;
-  const char *bdsephemeris;
-  const char *mixedephemeris;
+  pthread_mutex_t mutex;
+  pthread_t thread;
+  int epfd;
+  int wakefd; /* eventfd to end the wait for events */
+  int idle;   /* waiting for events */
+  struct Stream **queue;
+  int head, depth, streams;
+  /* statistics since the last report */
+  int maxdepth;
+  long tasks, stolen;
+  double latency, maxlatency;
 };
 
-/* option parsing */
-#ifdef NO_LONG_OPTS
-#define LONG_OPT(a)
-#else
-#define LONG_OPT(a) a
-static struct option opts[] = {
-{ "data",             required_argument, 0, 'd'},
-{ "server",           required_argument, 0, 's'},
-{ "password",         required_argument, 0, 'p'},
-{ "port",             required_argument, 0, 'r'},
-{ "timeout",          required_argument, 0, 't'},
-{ "header",           required_argument, 0, 'f'},
-{ "user",             required_argument, 0, 'u'},
-{ "bdsephemeris",     required_argument, 0, 'C'},
-{ "gpsephemeris",     required_argument, 0, 'E'},
-{ "qzssephemeris",    required_argument, 0, 'Q'},
-{ "glonassephemeris", required_argument, 0, 'G'},
-{ "sbasephemeris",    required_argument, 0, 'B'},
-{ "mixedephemeris",   required_argument, 0, 'P'},
-{ "rinex3",           no_argument,       0, '3'},
-{ "changeobs",        no_argument,       0, 'O'},
-{ "proxyport",        required_argument, 0, 'R'},
-{ "proxyhost",        required_argument, 0, 'S'},
-{ "nmea",             required_argument, 0, 'n'},
-{ "mode",             required_argument, 0, 'M'},
-{ "help",             no_argument,       0, 'h'},
-{0,0,0,0}};
-#endif
-#define ARGOPT "-d:s:p:r:t:f:u:E:C:G:B:P:Q:M:S:R:n:h3O"
+static struct Stream *streamlist;
+static struct StreamShard *shards;
+static int numshards;
 
-enum MODE { HTTP = 1, RTSP = 2, NTRIP1 = 3, AUTO = 4, END };
+static double StreamNow(void)
+{
+  struct timespec t;
 
-static const char *geturl(const char *url, struct Args *args)
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec*1e-9;
+}
+
+/* called with the lock of the shard */
+static void StreamWake(struct StreamShard *h)
 {
-  static char buf[1000];
-  static char *Buffer = buf;
-  static char *Bufend = buf+sizeof(buf);
+  uint64_t one = 1;
 
-  if(strncmp("ntrip:", url, 6))
-    return "URL must start with 'ntrip:'.";
-  url += 6; /* skip ntrip: */
+  if(h->idle && write(h->wakefd, &one, sizeof(one)) == sizeof(one))
+    h->idle = 0;
+}
 
-  if(*url != '@' && *url != '/')
+/* Called with the lock of the stream. When the shard falls behind, an idle
+   worker is woken to take streams from its queue. */
+static void StreamQueue(struct Stream *s)
+{
+  struct StreamShard *h = s->shard;
+  int i, depth, woken = 0;
+
+  s->queued = 1;
+  s->queuetime = StreamNow();
+  pthread_mutex_lock(&h->mutex);
+  h->queue[(h->head+h->depth++)%h->streams] = s;
+  if(h->depth > h->maxdepth)
+    h->maxdepth = h->depth;
+  depth = h->depth;
+  StreamWake(h);
+  pthread_mutex_unlock(&h->mutex);
+  for(i = 0; depth > 1 && i < numshards && !woken; ++i)
   {
-    /* scan for mountpoint */
-    args->data = Buffer;
-    while(*url && *url != '@' &&  *url != ';' &&*url != '/' && Buffer != Bufend)
-      *(Buffer++) = *(url++);
-    if(Buffer == args->data)
-      return "Mountpoint required.";
-    else if(Buffer >= Bufend-1)
-      return "Parsing buffer too short.";
-    *(Buffer++) = 0;
+    pthread_mutex_lock(&shards[i].mutex);
+    woken = shards[i].idle;
+    StreamWake(shards+i);
+    pthread_mutex_unlock(&shards[i].mutex);
   }
+}
 
-  if(*url == '/') /* username and password */
+static struct Stream *StreamTake(struct StreamShard *h)
+{
+  struct Stream *s = 0;
+
+  pthread_mutex_lock(&h->mutex);
+  if(h->depth)
   {
-    ++url;
-    args->user = Buffer;
-    while(*url && *url != '@' && *url != ';' && *url != ':' && Buffer != Bufend)
-      *(Buffer++) = *(url++);
-    if(Buffer == args->user)
-      return "Username cannot be empty.";
-    else if(Buffer >= Bufend-1)
-      return "Parsing buffer too short.";
-    *(Buffer++) = 0;
+    s = h->queue[h->head];
+    h->head = (h->head+1)%h->streams;
+    --h->depth;
+  }
+  pthread_mutex_unlock(&h->mutex);
+  return s;
+}
 
-    if(*url == ':') ++url;
+/* the own queue first, then the others */
+static struct Stream *StreamNext(struct StreamShard *w)
+{
+  struct Stream *s;
+  int i;
 
-    args->password = Buffer;
-    while(*url && *url != '@' && *url != ';' && Buffer != Bufend)
-      *(Buffer++) = *(url++);
-    if(Buffer == args->password)
-      return "Password cannot be empty.";
-    else if(Buffer >= Bufend-1)
-      return "Parsing buffer too short.";
-    *(Buffer++) = 0;
+  for(i = 0; i < numshards; ++i)
+  {
+    if((s = StreamTake(shards+(w-shards+i)%numshards)))
+      return s;
   }
+  return 0;
+}
 
-  if(*url == '@') /* server */
+static void StreamConvert(struct StreamShard *w, struct Stream *s)
+{
+  struct RTCM3ParserData *p = s->parser;
+  struct StreamShard *h = s->shard;
+  unsigned char *buf;
+  size_t size, alloc;
+  long reset;
+  double t;
+
+  pthread_mutex_lock(&s->mutex);
+  buf = s->pending;
+  size = s->pendingsize;
+  alloc = s->pendingalloc;
+  s->pending = s->work;
+  s->pendingalloc = s->workalloc;
+  s->pendingsize = 0;
+  s->work = buf;
+  s->workalloc = alloc;
+  reset = s->resetpos;
+  s->resetpos = -1;
+  t = s->queuetime;
+  pthread_mutex_unlock(&s->mutex);
+
+  textfile = s->obs;
+  if(reset >= 0) /* the partial message of the old connection is dropped */
   {
-    ++url;
-    if(*url != '@' && *url != ':')
-    {
-      args->server = Buffer;
-      while(*url && *url != '@' && *url != ':' && *url != ';' && Buffer != Bufend)
-        *(Buffer++) = *(url++);
-      if(Buffer == args->server)
-        return "Servername cannot be empty.";
-      else if(Buffer >= Bufend-1)
-        return "Parsing buffer too short.";
-      *(Buffer++) = 0;
-    }
+    HandleBytes(p, buf, (size_t)reset);
+    if(p->qc) /* the summary up to the end of the connection */
+      QCReport(p);
+    p->MessageStart = p->MessageSize = 0;
+    p->NeedBytes = p->SkipBytes = 0;
+    HandleBytes(p, buf+reset, size-reset);
+  }
+  else
+    HandleBytes(p, buf, size);
+  textfile = 0;
 
-    if(*url == ':')
-    {
-      ++url;
-      args->port = Buffer;
-      while(*url && *url != '@' && *url != ';' && Buffer != Bufend)
-        *(Buffer++) = *(url++);
-      if(Buffer == args->port)
-        return "Port cannot be empty.";
-      else if(Buffer >= Bufend-1)
-        return "Parsing buffer too short.";
-      *(Buffer++) = 0;
-    }
+  pthread_mutex_lock(&s->mutex);
+  if(s->pendingsize || s->resetpos >= 0)
+    StreamQueue(s);
+  else
+    s->queued = 0;
+  pthread_mutex_unlock(&s->mutex);
+
+  t = StreamNow()-t;
+  pthread_mutex_lock(&h->mutex);
+  ++h->tasks;
+  if(w != h)
+    ++h->stolen;
+  h->latency += t;
+  if(t > h->maxlatency)
+    h->maxlatency = t;
+  pthread_mutex_unlock(&h->mutex);
+}
 
-    if(*url == '@') /* proxy */
+static void StreamData(struct Stream *s, const char *buf, int numbytes)
+{
+  pthread_mutex_lock(&s->mutex);
+  if(s->pendingsize+numbytes > s->pendingalloc)
+  {
+    size_t n = s->pendingalloc ? 2*s->pendingalloc : STREAMBUFFER;
+    unsigned char *b;
+    while(n < s->pendingsize+numbytes)
+      n *= 2;
+    if(!(b = realloc(s->pending, n)))
     {
-      ++url;
-      args->proxyhost = Buffer;
-      while(*url && *url != ':' && *url != ';' && Buffer != Bufend)
-        *(Buffer++) = *(url++);
-      if(Buffer == args->proxyhost)
-        return "Proxy servername cannot be empty.";
-      else if(Buffer >= Bufend-1)
-        return "Parsing buffer too short.";
-      *(Buffer++) = 0;
-
-      if(*url == ':')
-      {
-        ++url;
-        args->proxyport = Buffer;
-        while(*url && *url != ';' && Buffer != Bufend)
-          *(Buffer++) = *(url++);
-        if(Buffer == args->proxyport)
-          return "Proxy port cannot be empty.";
-        else if(Buffer >= Bufend-1)
-          return "Parsing buffer too short.";
-        *(Buffer++) = 0;
-      }
+      pthread_mutex_unlock(&s->mutex);
+      RTCM3Error("%s: Could not allocate buffer, data lost.\n", s->args.data);
+      return;
     }
+    s->pending = b;
+    s->pendingalloc = n;
   }
-  if(*url == ';') /* NMEA */
-  {
-    args->nmea = ++url;
-    while(*url)
-      ++url;
-  }
-
-  return *url ? "Garbage at end of server string." : 0;
+  memcpy(s->pending+s->pendingsize, buf, numbytes);
+  s->pendingsize += numbytes;
+  if(!s->queued)
+    StreamQueue(s);
+  pthread_mutex_unlock(&s->mutex);
 }
 
-static int getargs(int argc, char **argv, struct Args *args)
+static void StreamTimer(struct Stream *s, int sec)
 {
-  int res = 1;
-  int getoptr;
-  int help = 0;
-  char *t;
+  struct itimerspec t;
 
-  args->server = "www.euref-ip.net";
-  args->port = "2101";
-  args->timeout = 60;
-  args->user = "";
-  args->password = "";
-  args->data = 0;
-  args->headerfile = 0;
-  args->gpsephemeris = 0;
-  args->qzssephemeris = 0;
-  args->sbasephemeris = 0;
-  args->glonassephemeris = 0;
-  args->bdsephemeris = 0;
-  args->mixedephemeris = 0;
-  args->rinex3 = 0;
-  args->nmea = 0;
-  args->changeobs = 0;
-  args->proxyhost = 0;
-  args->proxyport = "2101";
-  args->mode = AUTO;
-  help = 0;
+  memset(&t, 0, sizeof(t));
+  t.it_value.tv_sec = sec;
+  timerfd_settime(s->timer, 0, &t, 0);
+}
 
-  do
-  {
+/* the stream is connected again later, the parser drops the partial
+   message when it gets there */
+static void StreamFail(struct Stream *s, const char *reason)
+{
+  RTCM3Error("%s: %s, retry in %d seconds.\n", s->args.data, reason,
+  STREAMRETRY);
+  if(s->sock != -1)
+    close(s->sock);
+  s->sock = -1;
+  s->state = STREAM_RETRY;
+  pthread_mutex_lock(&s->mutex);
+  s->resetpos = s->pendingsize;
+  if(!s->queued)
+    StreamQueue(s);
+  pthread_mutex_unlock(&s->mutex);
+  StreamTimer(s, STREAMRETRY);
+}
 
-#ifdef NO_LONG_OPTS
-    switch((getoptr = getopt(argc, argv, ARGOPT)))
-#else
-    switch((getoptr = getopt_long(argc, argv, ARGOPT, opts, 0)))
-#endif
-    {
-    case 's': args->server = optarg; break;
-    case 'u': args->user = optarg; break;
-    case 'p': args->password = optarg; break;
-    case 'd': args->data = optarg; break;
-    case 'f': args->headerfile = optarg; break;
-    case 'C': args->bdsephemeris = optarg; break;
-    case 'E': args->gpsephemeris = optarg; break;
-    case 'B': args->sbasephemeris = optarg; break;
-    case 'G': args->glonassephemeris = optarg; break;
-    case 'Q': args->qzssephemeris = optarg; break;
-    case 'P': args->mixedephemeris = optarg; break;
-    case 'r': args->port = optarg; break;
-    case '3': args->rinex3 = 1; break;
-    case 'S': args->proxyhost = optarg; break;
-    case 'n': args->nmea = optarg; break;
-    case 'R': args->proxyport = optarg; break;
-    case 'O': args->changeobs = 1; break;
-    case 'h': help=1; break;
-    case 'M':
-      args->mode = 0;
-      if (!strcmp(optarg,"n") || !strcmp(optarg,"ntrip1"))
-        args->mode = NTRIP1;
-      else if(!strcmp(optarg,"h") || !strcmp(optarg,"http"))
-        args->mode = HTTP;
-      else if(!strcmp(optarg,"r") || !strcmp(optarg,"rtsp"))
-        args->mode = RTSP;
-      else if(!strcmp(optarg,"a") || !strcmp(optarg,"auto"))
-        args->mode = AUTO;
-      else args->mode = atoi(optarg);
-      if((args->mode == 0) || (args->mode >= END))
-      {
-        fprintf(stderr, "Mode %s unknown\n", optarg);
-        res = 0;
-      }
-      break;
-    case 't':
-      args->timeout = strtoul(optarg, &t, 10);
-      if((t && *t) || args->timeout < 0)
-        res = 0;
-      break;
+static void StreamConnect(struct Stream *s)
+{
+  struct epoll_event ev;
+
+  s->sock = socket(AF_INET, SOCK_STREAM|SOCK_NONBLOCK, 0);
+  if(s->sock == -1)
+  {
+    StreamFail(s, strerror(errno));
+    return;
+  }
+  if(connect(s->sock, (struct sockaddr *)&s->addr, sizeof(s->addr)) == -1
+  && errno != EINPROGRESS)
+  {
+    StreamFail(s, strerror(errno));
+    return;
+  }
+  ev.events = EPOLLOUT;
+  ev.data.u64 = s->index*2;
+  epoll_ctl(s->shard->epfd, EPOLL_CTL_ADD, s->sock, &ev);
+  s->state = STREAM_CONNECT;
+  s->lastdata = time(0);
+  StreamTimer(s, s->args.timeout);
+}
 
-    case 1:
-      {
-        const char *err;
-        if((err = geturl(optarg, args)))
-        {
-          RTCM3Error("%s\n\n", err);
-          res = 0;
-        }
-      }
-      break;
-    case -1: break;
-    }
-  } while(getoptr != -1 || !res);
+/* the connection is established, the request is small enough to be sent
+   at once */
+static void StreamRequest(struct Stream *s)
+{
+  struct epoll_event ev;
+  char buf[MAXDATASIZE];
+  socklen_t len = sizeof(int);
+  int err = 0, i;
 
-  datestr[0] = datestr[7];
-  datestr[1] = datestr[8];
-  datestr[2] = datestr[9];
-  datestr[3] = datestr[10];
-  datestr[5] = datestr[12];
-  datestr[6] = datestr[13];
-  datestr[8] = datestr[15];
-  datestr[9] = datestr[16];
-  datestr[4] = datestr[7] = '-';
-  datestr[10] = 0;
+  if(getsockopt(s->sock, SOL_SOCKET, SO_ERROR, &err, &len) == -1 || err)
+  {
+    StreamFail(s, strerror(err ? err : errno));
+    return;
+  }
+  if(!(i = NtripRequest(buf, &s->args, s->proxyserver, s->proxyport)))
+  {
+    StreamFail(s, "invalid request");
+    return;
+  }
+  if(send(s->sock, buf, (size_t)i, MSG_NOSIGNAL) != i)
+  {
+    StreamFail(s, "could not send request");
+    return;
+  }
+  ev.events = EPOLLIN;
+  ev.data.u64 = s->index*2;
+  epoll_ctl(s->shard->epfd, EPOLL_CTL_MOD, s->sock, &ev);
+  s->state = STREAM_RESPONSE;
+  s->responsesize = 0;
+  s->chunk.mode = 0;
+}
 
-  if(args->mixedephemeris && !args->rinex3)
+/* The response header is collected until its end. The checks are those of
+   the single stream connection. Returns the offset of the data in buf or
+   -1 if more is needed or the stream failed. */
+static int StreamResponse(struct Stream *s, const char *buf, int numbytes)
+{
+  char *r = s->response, *e;
+  int n = numbytes, icy;
+
+  if(n > STREAMRESPONSE-s->responsesize)
+    n = STREAMRESPONSE-s->responsesize;
+  memcpy(r+s->responsesize, buf, n);
+  s->responsesize += n;
+  r[s->responsesize] = 0;
+  icy = !strncmp(r, "ICY 200 OK\r\n", 12);
+  if(!(e = strstr(r, icy ? "\r\n" : "\r\n\r\n")))
   {
-    RTCM3Error("RINEX2 cannot created combined ephemeris file.\n");
-    res = 0;
+    if(s->responsesize == STREAMRESPONSE)
+      StreamFail(s, "response header too long");
+    return -1;
   }
-  else if(args->mixedephemeris && (args->gpsephemeris || args->glonassephemeris
-  || args->bdsephemeris || args->qzssephemeris || args->sbasephemeris))
+  e += icy ? 2 : 4;
+  if(!strncmp(r, "HTTP/1.1 200 OK\r\n", 17)
+  || !strncmp(r, "HTTP/1.0 200 OK\r\n", 17))
   {
-    RTCM3Error("Combined ephemeris file specified with another one.\n"
-    "Please specify only one navigation file.\n");
-    res = 0;
+    if(!strstr(r, "Content-Type: gnss/data\r\n"))
+    {
+      StreamFail(s, "no 'Content-Type: gnss/data' found");
+      return -1;
+    }
+    if(strstr(r, "Transfer-Encoding: chunked\r\n"))
+      s->chunk.mode = 1;
   }
-  else if(args->bdsephemeris && !args->rinex3)
+  else if(!icy)
   {
-    RTCM3Error("RINEX2 cannot produce BDS ephemeris.\n");
-    res = 0;
+    for(e = r; *e && *e != '\r' && *e != '\n'; ++e)
+      ;
+    *e = 0;
+    StreamFail(s, r);
+    return -1;
   }
-  else if(!res || help)
+  else if(s->args.mode == HTTP)
   {
-    RTCM3Error("Version %s (%s) GPL" COMPILEDATE
-    "\nUsage: %s -s server -u user ...\n"
-    " -d " LONG_OPT("--data             ") "the requested data set\n"
-    " -f " LONG_OPT("--headerfile       ") "file for RINEX header information\n"
-    " -s " LONG_OPT("--server           ") "the server name or address\n"
-    " -p " LONG_OPT("--password         ") "the login password\n"
-    " -r " LONG_OPT("--port             ") "the server port number (default 2101)\n"
-    " -t " LONG_OPT("--timeout          ") "timeout in seconds (default 60)\n"
-    " -u " LONG_OPT("--user             ") "the user name\n"
-    " -C " LONG_OPT("--bdsephemeris     ") "output file for BDS ephemeris data\n"
-    " -E " LONG_OPT("--gpsephemeris     ") "output file for GPS ephemeris data\n"
-    " -G " LONG_OPT("--glonassephemeris ") "output file for GLONASS ephemeris data\n"
-    " -Q " LONG_OPT("--qzssephemeris    ") "output file for QZSS ephemeris data\n"
-    " -B " LONG_OPT("--sbasephemeris    ") "output file for SBAS ephemeris data\n"
-    " -P " LONG_OPT("--mixedephemeris   ") "output file for all ephemeris data\n"
-    " -3 " LONG_OPT("--rinex3           ") "output RINEX type 3 data\n"
-    " -S " LONG_OPT("--proxyhost        ") "proxy name or address\n"
-    " -R " LONG_OPT("--proxyport        ") "proxy port, optional (default 2101)\n"
-    " -n " LONG_OPT("--nmea             ") "NMEA string for sending to server\n"
-    " -O " LONG_OPT("--changeobs        ") "Add observation type change header lines\n"
-    " -M " LONG_OPT("--mode             ") "mode for data request\n"
-    "     Valid modes are:\n"
-    "     1, h, http     NTRIP Version 2.0 Caster in TCP/IP mode\n"
-    "     2, r, rtsp     NTRIP Version 2.0 Caster in RTSP/RTP mode\n"
-    "     3, n, ntrip1   NTRIP Version 1.0 Caster\n"
-    "     4, a, auto     automatic detection (default)\n"
-    "or using an URL:\n%s ntrip:data[/user[:password]][@[server][:port][@proxyhost[:proxyport]]][;nmea]\n"
-    , revisionstr, datestr, argv[0], argv[0]);
-    exit(1);
+    StreamFail(s, "NTRIP version 2 HTTP connection failed");
+    return -1;
   }
-  return res;
+  s->state = STREAM_DATA;
+  return (e-r)-(s->responsesize-n);
 }
 
-/* let the output complete a block if necessary */
-static void signalhandler(int sig)
+static void StreamRead(struct Stream *s)
 {
-  if(!stop)
+  char buf[STREAMBUFFER];
+  int numbytes, pos = 0;
+
+  numbytes = recv(s->sock, buf, sizeof(buf), 0);
+  if(numbytes <= 0)
   {
-    RTCM3Error("Stop signal number %d received. "
-    "Trying to terminate gentle.\n", sig);
-    stop = 1;
-    alarm(1);
+    if(numbytes == -1 && (errno == EAGAIN || errno == EINTR))
+      return;
+    StreamFail(s, numbytes ? strerror(errno) : "connection closed");
+    return;
+  }
+  s->lastdata = time(0);
+  if(s->state == STREAM_RESPONSE
+  && (pos = StreamResponse(s, buf, numbytes)) < 0)
+    return;
+  if(pos < numbytes && s->chunk.mode)
+  {
+    int n = Dechunk(&s->chunk, buf+pos, numbytes-pos);
+    if(n < 0)
+    {
+      StreamFail(s, "error in chunky transfer encoding");
+      return;
+    }
+    numbytes = pos+n;
   }
+  if(pos < numbytes)
+    StreamData(s, buf+pos, numbytes-pos);
 }
 
-#ifndef WINDOWSVERSION
-static void WaitMicro(int mic)
+/* The timer is not set again for every read, at expiry it is checked how
+   long the stream had no data. */
+static void StreamTimeout(struct Stream *s)
 {
-  struct timeval tv;
-  tv.tv_sec = mic/1000000;
-  tv.tv_usec = mic%1000000;
-#ifdef DEBUG
-  fprintf(stderr, "Waiting %d micro seconds\n", mic);
-#endif
-  select(0, 0, 0, 0, &tv);
+  uint64_t n;
+  time_t t;
+
+  if(read(s->timer, &n, sizeof(n)) != sizeof(n))
+    return;
+  if(s->state == STREAM_RETRY)
+    StreamConnect(s);
+  else if((t = time(0)-s->lastdata) >= s->args.timeout)
+    StreamFail(s, "timeout");
+  else
+    StreamTimer(s, s->args.timeout-t);
 }
-#else /* WINDOWSVERSION */
-void WaitMicro(int mic)
+
+/* Network events of the own shard are handled before queued streams are
+   converted. Without work the worker waits for events and is idle. */
+static void *StreamWorker(void *arg)
 {
-   Sleep(mic/1000);
+  struct StreamShard *w = arg;
+  struct epoll_event ev[64];
+  struct Stream *s;
+  int i, n, busy;
+
+  while(!stop)
+  {
+    pthread_mutex_lock(&w->mutex);
+    w->idle = 1;
+    busy = w->depth;
+    pthread_mutex_unlock(&w->mutex);
+    for(i = 0; i < numshards && !busy; ++i)
+    {
+      pthread_mutex_lock(&shards[i].mutex);
+      busy = shards[i].depth;
+      pthread_mutex_unlock(&shards[i].mutex);
+    }
+    n = epoll_wait(w->epfd, ev, 64, busy ? 0 : -1);
+    pthread_mutex_lock(&w->mutex);
+    w->idle = 0;
+    pthread_mutex_unlock(&w->mutex);
+    for(i = 0; i < n; ++i)
+    {
+      if(ev[i].data.u64 == STREAMWAKE)
+      {
+        uint64_t k;
+        if(read(w->wakefd, &k, sizeof(k)) != sizeof(k))
+          continue;
+      }
+      else if(ev[i].data.u64 & 1)
+        StreamTimeout(streamlist+(ev[i].data.u64>>1));
+      else
+      {
+        s = streamlist+(ev[i].data.u64>>1);
+        if(s->state == STREAM_CONNECT)
+          StreamRequest(s);
+        else if(s->sock != -1)
+          StreamRead(s);
+      }
+    }
+    for(i = 0; i < STREAMBATCH && (s = StreamNext(w)); ++i)
+      StreamConvert(w, s);
+    UringFlush();
+  }
+  UringFinish();
+  return 0;
 }
-#endif /* WINDOWSVERSION */
 
-#define ALARMTIME   (2*60)
+static void StreamReport(void)
+{
+  int i;
 
-/* for some reason we had to abort hard (maybe waiting for data */
-#ifdef __GNUC__
-static __attribute__ ((noreturn)) void signalhandler_alarm(
-int sig __attribute__((__unused__)))
-#else /* __GNUC__ */
-static void signalhandler_alarm(int sig)
-#endif /* __GNUC__ */
+  for(i = 0; i < numshards; ++i)
+  {
+    struct StreamShard *h = shards+i;
+    pthread_mutex_lock(&h->mutex);
+    RTCM3Error("Shard %d: %d streams, queue %d (max %d), %ld conversions, "
+    "%ld by other workers, latency %.1f ms (max %.1f ms)\n", i, h->streams,
+    h->depth, h->maxdepth, h->tasks, h->stolen,
+    h->tasks ? h->latency/h->tasks*1000.0 : 0.0, h->maxlatency*1000.0);
+    h->maxdepth = h->depth;
+    h->tasks = h->stolen = 0;
+    h->latency = h->maxlatency = 0.0;
+    pthread_mutex_unlock(&h->mutex);
+  }
+}
+
+/* Each line of the list has the arguments of a single stream conversion,
+   an observation file given with --output is required. Empty lines and
+   lines starting with # are skipped. */
+static struct Stream *ReadStreams(const char *name, int *num)
 {
-  RTCM3Error("Programm forcefully terminated.\n");
-  exit(1);
+  struct Stream *streams = 0;
+  char line[4096];
+  int n = 0, l = 0;
+  FILE *f;
+
+  if(!(f = fopen(name, "r")))
+  {
+    RTCM3Error("Could not open stream list %s.\n", name);
+    return 0;
+  }
+  while(fgets(line, sizeof(line), f))
+  {
+    char *argv[STREAMARGS+1], *a = strdup(line);
+    struct Stream *s;
+    int argc = 1;
+
+    ++l;
+    argv[0] = "rtcm3torinex";
+    for(a = strtok(a, " \t\r\n"); a && argc < STREAMARGS;
+    a = strtok(0, " \t\r\n"))
+      argv[argc++] = a;
+    argv[argc] = 0;
+    if(argc == 1 || argv[1][0] == '#')
+      continue;
+    if(!(s = realloc(streams, (n+1)*sizeof(*s))))
+      break;
+    streams = s;
+    s += n;
+    memset(s, 0, sizeof(*s));
+    optind = 0;
+    if(!getargs(argc, argv, &s->args) || !s->args.data || !s->args.output
+    || s->args.mode == RTSP || s->args.input || s->args.streams)
+    {
+      RTCM3Error("Line %d of %s: a stream needs --data and --output, RTSP "
+      "and --input are not possible.\n", l, name);
+      free(streams);
+      streams = 0;
+      break;
+    }
+    s->index = n++;
+  }
+  fclose(f);
+  *num = n;
+  return streams;
+}
+
+/* All streams of the list are converted by the given number of worker
+   threads, each pinned to a core. The streams are distributed over the
+   shards of the workers. Connections are non-blocking and the timeouts use
+   timerfd instead of alarm(). The main thread only waits for the stop
+   signal and reports the shards. */
+static void RunStreams(const char *name, int threads, int useuring)
+{
+  struct epoll_event ev;
+  sigset_t sigs, oldsigs;
+  struct timespec wait;
+  FILE **files[NAVFILES];
+  const char **names[NAVFILES];
+  time_t report;
+  int num, i, k, ncpu;
+
+  if(!(streamlist = ReadStreams(name, &num)))
+    exit(1);
+  numshards = threads < num ? threads : num ? num : 1;
+  if(!(shards = calloc(numshards, sizeof(*shards))))
+    exit(1);
+  for(i = 0; i < numshards; ++i)
+  {
+    struct StreamShard *h = shards+i;
+    pthread_mutex_init(&h->mutex, 0);
+    h->streams = (num-i+numshards-1)/numshards;
+    if((h->epfd = epoll_create1(0)) == -1
+    || (h->wakefd = eventfd(0, EFD_NONBLOCK)) == -1
+    || !(h->queue = malloc((h->streams ? h->streams : 1)*sizeof(*h->queue))))
+    {
+      RTCM3Error("Could not create shard: %s\n", strerror(errno));
+      exit(1);
+    }
+    ev.events = EPOLLIN;
+    ev.data.u64 = STREAMWAKE;
+    epoll_ctl(h->epfd, EPOLL_CTL_ADD, h->wakefd, &ev);
+  }
+  for(i = 0; i < num; ++i)
+  {
+    struct Stream *s = streamlist+i;
+    time_t tim;
+
+    /* untouched pages of the parser are not allocated */
+    if(!(s->parser = calloc(1, sizeof(*s->parser))))
+    {
+      RTCM3Error("Could not allocate parser for %s.\n", s->args.data);
+      exit(1);
+    }
+    tim = time(0) - ((10*365+2+5)*24*60*60+LEAPSECONDS);
+    s->parser->GPSWeek = tim/(7*24*60*60);
+    s->parser->GPSTOW = tim%(7*24*60*60);
+    ParserArgs(s->parser, &s->args);
+    s->parser->uring = useuring;
+    if(!(s->obs = useuring ? UringOpen(s->args.output)
+    : fopen(s->args.output, "w")))
+    {
+      RTCM3Error("Could not open %s.\n", s->args.output);
+      exit(1);
+    }
+    setbuf(s->obs, 0);
+    pthread_mutex_init(&s->mutex, 0);
+    s->resetpos = -1;
+    s->sock = -1;
+    s->shard = shards+i%numshards;
+    if((s->timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK)) == -1)
+    {
+      RTCM3Error("Function timerfd_create: %s\n", strerror(errno));
+      exit(1);
+    }
+    ev.events = EPOLLIN;
+    ev.data.u64 = i*2+1;
+    epoll_ctl(s->shard->epfd, EPOLL_CTL_ADD, s->timer, &ev);
+    if(NtripAddress(&s->args, &s->addr, &s->proxyserver, s->proxyport))
+      StreamConnect(s);
+    else
+      StreamFail(s, "no address");
+  }
+
+  /* the workers leave the signals to the main thread */
+  sigemptyset(&sigs);
+  sigaddset(&sigs, SIGINT);
+  sigaddset(&sigs, SIGQUIT);
+  sigaddset(&sigs, SIGTERM);
+  sigaddset(&sigs, SIGPIPE);
+  sigaddset(&sigs, SIGALRM);
+  pthread_sigmask(SIG_BLOCK, &sigs, &oldsigs);
+  ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+  for(i = 0; i < numshards; ++i)
+  {
+    if(pthread_create(&shards[i].thread, 0, StreamWorker, shards+i))
+    {
+      RTCM3Error("Could not start worker thread.\n");
+      exit(1);
+    }
+    if(numshards > 1 && ncpu > 1)
+    {
+      cpu_set_t cpus;
+      CPU_ZERO(&cpus);
+      CPU_SET(i%ncpu, &cpus);
+      pthread_setaffinity_np(shards[i].thread, sizeof(cpus), &cpus);
+    }
+  }
+  report = time(0)+STREAMREPORT;
+  while(!stop)
+  {
+    wait.tv_sec = report > time(0) ? report-time(0) : 0;
+    wait.tv_nsec = 0;
+    pselect(0, 0, 0, 0, &wait, &oldsigs);
+    if(time(0) >= report)
+    {
+      StreamReport();
+      report = time(0)+STREAMREPORT;
+    }
+  }
+  /* closing the files of all streams may take longer than the second
+     signalhandler leaves before the forced exit */
+  alarm(0);
+  pthread_sigmask(SIG_SETMASK, &oldsigs, 0);
+  for(i = 0; i < numshards; ++i)
+  {
+    pthread_mutex_lock(&shards[i].mutex);
+    shards[i].idle = 1;
+    StreamWake(shards+i);
+    pthread_mutex_unlock(&shards[i].mutex);
+  }
+  for(i = 0; i < numshards; ++i)
+    pthread_join(shards[i].thread, 0);
+  StreamReport();
+
+  for(i = 0; i < num; ++i)
+  {
+    struct Stream *s = streamlist+i;
+    struct RTCM3ParserData *p = s->parser;
+    if(s->queued) /* the data received until the stop */
+      StreamConvert(s->shard, s);
+    if(s->sock != -1)
+      close(s->sock);
+    close(s->timer);
+    fclose(s->obs);
+    NavFields(p, files, names);
+    for(k = 0; k < NAVFILES; ++k)
+    {
+      if(*files[k]) /* queued writes complete */
+        fclose(*files[k]);
+      *files[k] = 0;
+    }
+    if(p->ephemerisSuppressed)
+    {
+      RTCM3Error("%s: Ephemerides: %d written, %d repeated ones suppressed.\n",
+      s->args.data, p->ephemerisWritten, p->ephemerisSuppressed);
+    }
+    if(p->qcfile)
+      QCReport(p);
+    if(p->checkpoint)
+      WriteCheckpoint(p);
+    RTCM3ParserFree(p);
+    free(p);
+  }
+  UringFinish();
+  if(useuring && !uringunavailable)
+  {
+    RTCM3Error("io_uring: %ld writes (%ld from registered buffers), %.1f MB, "
+    "%ld syncs, %ld errors.\n", uringwrites, uringfixed, uringbytes/1000000.0,
+    uringsyncs, uringerrors);
+  }
+  for(i = 0; i < numshards; ++i)
+  {
+    close(shards[i].epfd);
+    close(shards[i].wakefd);
+  }
 }
+#endif /* __linux__ */
 
 int main(int argc, char **argv)
 {
   struct Args args;
   struct RTCM3ParserData Parser;
+  int res;
 
   setbuf(stdout, 0);
   setbuf(stdin, 0);
@@ -3897,73 +7913,49 @@ int main(int argc, char **argv)
     Parser.GPSTOW = tim%(7*24*60*60);
   }
 
-  if(getargs(argc, argv, &args))
+  res = getargs(argc, argv, &args);
+  if(res && args.output && !args.streams)
+  {
+    if(!freopen(args.output, "w", stdout))
+    {
+      RTCM3Error("Could not open %s.\n", args.output);
+      exit(1);
+    }
+    setbuf(stdout, 0);
+  }
+  if(res && args.streams)
+  {
+#ifdef __linux__
+    RunStreams(args.streams, args.threads, args.uring);
+#else
+    RTCM3Error("A stream list is only supported on Linux.\n");
+#endif
+  }
+  else if(res && args.input)
+  {
+    ParserArgs(&Parser, &args);
+    if(args.overflow && args.threads == 1)
+      PipelineStart(&Parser, args.overflow, 0);
+    ReadInput(&Parser, args.input, args.threads);
+  }
+  else if(res)
   {
     int sockfd, numbytes;
     char buf[MAXDATASIZE];
     struct sockaddr_in their_addr; /* connector's address information */
-    struct hostent *he;
-    struct servent *se;
-    const char *server, *port, *proxyserver = 0;
+    const char *proxyserver;
     char proxyport[6];
-    char *b;
     long i;
     struct timeval tv;
 
     alarm(ALARMTIME);
 
-    Parser.headerfile = args.headerfile;
-    Parser.glonassephemeris = args.glonassephemeris;
-    Parser.gpsephemeris = args.gpsephemeris;
-    Parser.bdsephemeris = args.bdsephemeris;
-    Parser.qzssephemeris = args.qzssephemeris;
-    Parser.sbasephemeris = args.sbasephemeris;
-    Parser.mixedephemeris = args.mixedephemeris;
-    Parser.rinex3 = args.rinex3;
-    Parser.changeobs = args.changeobs;
-
-    if(args.proxyhost)
-    {
-      int p;
-      if((i = strtol(args.port, &b, 10)) && (!b || !*b))
-        p = i;
-      else if(!(se = getservbyname(args.port, 0)))
-      {
-        RTCM3Error("Can't resolve port %s.", args.port);
-        exit(1);
-      }
-      else
-      {
-        p = ntohs(se->s_port);
-      }
-      snprintf(proxyport, sizeof(proxyport), "%d", p);
-      port = args.proxyport;
-      proxyserver = args.server;
-      server = args.proxyhost;
-    }
-    else
-    {
-      server = args.server;
-      port = args.port;
-    }
+    ParserArgs(&Parser, &args);
+    if(args.overflow)
+      PipelineStart(&Parser, args.overflow, 1);
 
-    memset(&their_addr, 0, sizeof(struct sockaddr_in));
-    if((i = strtol(port, &b, 10)) && (!b || !*b))
-      their_addr.sin_port = htons(i);
-    else if(!(se = getservbyname(port, 0)))
-    {
-      RTCM3Error("Can't resolve port %s.", port);
-      exit(1);
-    }
-    else
-    {
-      their_addr.sin_port = se->s_port;
-    }
-    if(!(he=gethostbyname(server)))
-    {
-      RTCM3Error("Server name lookup failed for '%s'.\n", server);
+    if(!NtripAddress(&args, &their_addr, &proxyserver, proxyport))
       exit(1);
-    }
     if((sockfd = socket(AF_INET, SOCK_STREAM, 0)) == -1)
     {
       perror("socket");
@@ -3978,9 +7970,6 @@ int main(int argc, char **argv)
       exit(1);
     }
 
-    their_addr.sin_family = AF_INET;
-    their_addr.sin_addr = *((struct in_addr *)he->h_addr);
-
     if(args.data && args.mode == RTSP)
     {
       struct sockaddr_in local;
@@ -4142,7 +8131,6 @@ int main(int argc, char **argv)
               memset(&addrRTP, 0, sizeof(addrRTP));
               addrRTP.sin_family = AF_INET;
               addrRTP.sin_port   = htons(serverport);
-              their_addr.sin_addr = *((struct in_addr *)he->h_addr);
               len = sizeof(addrRTP);
               int ts = 0;
               int sn = 0;
@@ -4163,7 +8151,6 @@ int main(int argc, char **argv)
 
                   if(init)
                   {
-                    int z;
                     if(u < -30000 && sn > 30000) sn -= 0xFFFF;
                     if(ssrc != w || ts > v)
                     {
@@ -4171,8 +8158,7 @@ int main(int argc, char **argv)
                       exit(1);
                     }
                     if(u > sn) /* don't show out-of-order packets */
-                    for(z = 12; z < i && !stop; ++z)
-                      HandleByte(&Parser, (unsigned int) buf[z]);
+                      HandleReceived(&Parser, buf+12, i-12);
                   }
                   sn = u; ts = v; ssrc = w; init = 1;
                 }
@@ -4228,59 +8214,8 @@ int main(int argc, char **argv)
         perror("connect");
         exit(1);
       }
-      if(!args.data)
-      {
-        i = snprintf(buf, MAXDATASIZE,
-        "GET %s%s%s%s/ HTTP/1.0\r\n"
-        "Host: %s\r\n%s"
-        "User-Agent: %s/%s\r\n"
-        "Connection: close\r\n"
-        "\r\n"
-        , proxyserver ? "http://" : "", proxyserver ? proxyserver : "",
-        proxyserver ? ":" : "", proxyserver ? proxyport : "",
-        args.server, args.mode == NTRIP1 ? "" : "Ntrip-Version: Ntrip/2.0\r\n",
-        AGENTSTRING, revisionstr);
-      }
-      else
-      {
-        i=snprintf(buf, MAXDATASIZE-40, /* leave some space for login */
-        "GET %s%s%s%s/%s HTTP/1.0\r\n"
-        "Host: %s\r\n%s"
-        "User-Agent: %s/%s\r\n"
-        "Connection: close\r\n"
-        "Authorization: Basic "
-        , proxyserver ? "http://" : "", proxyserver ? proxyserver : "",
-        proxyserver ? ":" : "", proxyserver ? proxyport : "",
-        args.data, args.server,
-        args.mode == NTRIP1 ? "" : "Ntrip-Version: Ntrip/2.0\r\n",
-        AGENTSTRING, revisionstr);
-        if(i > MAXDATASIZE-40 || i < 0) /* second check for old glibc */
-        {
-          RTCM3Error("Requested data too long\n");
-          exit(1);
-        }
-        i += encode(buf+i, MAXDATASIZE-i-4, args.user, args.password);
-        if(i > MAXDATASIZE-4)
-        {
-          RTCM3Error("Username and/or password too long\n");
-          exit(1);
-        }
-        buf[i++] = '\r';
-        buf[i++] = '\n';
-        buf[i++] = '\r';
-        buf[i++] = '\n';
-        if(args.nmea)
-        {
-          int j = snprintf(buf+i, MAXDATASIZE-i, "%s\r\n", args.nmea);
-          if(j >= 0 && j < MAXDATASIZE-i)
-            i += j;
-          else
-          {
-            RTCM3Error("NMEA string too long\n");
-            exit(1);
-          }
-        }
-      }
+      if(!(i = NtripRequest(buf, &args, proxyserver, proxyport)))
+        exit(1);
       if(send(sockfd, buf, (size_t)i, 0) != i)
       {
         perror("send");
@@ -4291,7 +8226,7 @@ int main(int argc, char **argv)
         int k = 0;
         int chunkymode = 0;
         int totalbytes = 0;
-        int chunksize = 0;
+        struct ChunkState chunk;
 
         while(!stop && (numbytes=recv(sockfd, buf, MAXDATASIZE-1, 0)) != -1)
         {
@@ -4329,7 +8264,7 @@ int main(int argc, char **argv)
                   ;
               }
               if(i < numbytes-l)
-                chunkymode = 1;
+                chunkymode = chunk.mode = 1;
             }
             else if(numbytes < 12 || strncmp("ICY 200 OK\r\n", buf, 12))
             {
@@ -4357,61 +8292,18 @@ int main(int argc, char **argv)
           {
             if(chunkymode)
             {
-              int stop = 0;
-              int pos = 0;
-              while(!stop && pos < numbytes)
-              {
-                switch(chunkymode)
-                {
-                case 1: /* reading number starts */
-                  chunksize = 0;
-                  ++chunkymode; /* no break */
-                case 2: /* during reading number */
-                  i = buf[pos++];
-                  if(i >= '0' && i <= '9') chunksize = chunksize*16+i-'0';
-                  else if(i >= 'a' && i <= 'f') chunksize = chunksize*16+i-'a'+10;
-                  else if(i >= 'A' && i <= 'F') chunksize = chunksize*16+i-'A'+10;
-                  else if(i == '\r') ++chunkymode;
-                  else if(i == ';') chunkymode = 5;
-                  else stop = 1;
-                  break;
-                case 3: /* scanning for return */
-                  if(buf[pos++] == '\n') chunkymode = chunksize ? 4 : 1;
-                  else stop = 1;
-                  break;
-                case 4: /* output data */
-                  i = numbytes-pos;
-                  if(i > chunksize) i = chunksize;
-                  {
-                    int z;
-                    for(z = 0; z < i && !stop; ++z)
-                      HandleByte(&Parser, (unsigned int) buf[pos+z]);
-                  }
-                  totalbytes += i;
-                  chunksize -= i;
-                  pos += i;
-                  if(!chunksize)
-                    chunkymode = 1;
-                  break;
-                case 5:
-                  if(i == '\r') chunkymode = 3;
-                  break;
-                }
-              }
-              if(stop)
+              if((i = Dechunk(&chunk, buf, numbytes)) < 0)
               {
                 RTCM3Error("Error in chunky transfer encoding\n");
                 break;
               }
+              HandleReceived(&Parser, buf, i);
+              totalbytes += i;
             }
             else
             {
               totalbytes += numbytes;
-              {
-                int z;
-                for(z = 0; z < numbytes && !stop; ++z)
-                  HandleByte(&Parser, (unsigned int) buf[z]);
-              }
+              HandleReceived(&Parser, buf, numbytes);
             }
             if(totalbytes < 0) /* overflow */
             {
@@ -4431,6 +8323,17 @@ int main(int argc, char **argv)
       close(sockfd);
     }
   }
+  PipelineStop();
+  if(Parser.ephemerisSuppressed)
+  {
+    RTCM3Error("Ephemerides: %d written, %d repeated ones suppressed.\n",
+    Parser.ephemerisWritten, Parser.ephemerisSuppressed);
+  }
+  if(Parser.qcfile)
+    QCReport(&Parser);
+  if(Parser.checkpoint)
+    WriteCheckpoint(&Parser);
+  RTCM3ParserFree(&Parser);
   return 0;
 }
 #endif /* NO_RTCM3_MAIN */
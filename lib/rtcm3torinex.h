@@ -48,6 +48,7 @@
 #define PRN_GALGIO_END            PRN_GIOVE_END
 
 #define PRN_GLONASS_NUM           (PRN_GLONASS_END-PRN_GLONASS_START+1)
+#define PRN_MAX                   (PRN_QZSS_START+63) /* highest MSM PRN */
 
 #define RTCM3_MSM_NUMSIG      32
 #define RTCM3_MSM_NUMSAT      64
@@ -315,13 +316,27 @@ struct gnssdata {
   int    week;               /* week number of GPS date */
   int    numsats;
   double timeofweek;         /* milliseconds in GPS week */
+#ifdef NO_RTCM3_MAIN
   double measdata[GNSS_MAXSATS][GNSSENTRY_NUMBER];  /* data fields */ 
+#endif /* NO_RTCM3_MAIN */
   unsigned long long dataflags[GNSS_MAXSATS];      /* GNSSDF_xxx */
   unsigned int dataflags2[GNSS_MAXSATS];     /* GNSSDF2_xxx */
   int    satellites[GNSS_MAXSATS];     /* SV - IDs */
   int    snrL1[GNSS_MAXSATS];          /* Important: all the 6 SV-specific fields must */
   int    snrL2[GNSS_MAXSATS];          /* have the same SV-order */
+#ifdef NO_RTCM3_MAIN
   const char * codetype[GNSS_MAXSATS][GNSSENTRY_NUMBER];
+#endif /* NO_RTCM3_MAIN */
+  unsigned char satslot[PRN_MAX+1]; /* SV - ID -> index + 1, 0 if unused */
+#ifndef NO_RTCM3_MAIN
+  /* Compact layout of the program, instead of measdata and codetype: the
+     cells of a row are the entries flagged in dataflags, in the order they
+     were decoded, with value and code type in separate arrays. */
+  double cellvalue[GNSS_MAXSATS][GNSSENTRY_NUMBER];
+  unsigned char cellcode[GNSS_MAXSATS][GNSSENTRY_NUMBER]; /* 0 if none */
+  unsigned char cellindex[GNSS_MAXSATS][GNSSENTRY_NUMBER]; /* entry -> cell */
+  unsigned char numcells[GNSS_MAXSATS]; /* used cells of each row */
+#endif /* NO_RTCM3_MAIN */
 };
 
 #define GPSEPHF_L2PCODEDATA    (1<<0) /* set, if NAV data OFF on L2 P-code, s1w4b01 */
@@ -489,6 +504,29 @@ struct bdsephemeris {
   double TGD_B2_B3;        /*  [s]     */
 };
 
+union ephemerisrecord {
+  struct gpsephemeris     gps;  /* GPS and QZSS */
+  struct glonassephemeris glonass;
+  struct galileoephemeris galileo;
+  struct sbasephemeris    sbas;
+  struct bdsephemeris     bds;
+};
+
+/* a broadcast ephemeris kept in the ephemeris store */
+struct ephemerisentry {
+  int    type;          /* message type, 0 for an unused entry */
+  int    iod;           /* issue of data, tb for GLONASS */
+  int    week;          /* GPS week of toe */
+  int    toe;           /* [s] toe as GPS time of week */
+  union ephemerisrecord data; /* GLONASS GPSWeek/GPSTOW is the time of tb */
+};
+
+/* current ([0]) and previous ([1]) ephemeris of each satellite, indexed
+   by system (RTCM3_MSM_xxx) and satellite number */
+struct ephemerisstore {
+  struct ephemerisentry entry[RTCM3_MSM_NUMSYS][RTCM3_MSM_NUMSAT][2];
+};
+
 struct DataInfo {
   long long flags[RINEXENTRY_NUMBER];
   int       pos[RINEXENTRY_NUMBER];
@@ -496,20 +534,69 @@ struct DataInfo {
   char      type[GNSSENTRY_NUMBER];
 };
 
+#ifndef NO_RTCM3_MAIN
+#define QC_NUMBANDS   7 /* L1, L2, L5, E6, E5B, E5AB, SAIF (GNSSDF2_LOCKLOSSxxx) */
+#define QC_NUMSNRBINS 9 /* below 20 dB-Hz, steps of 5 dB-Hz, 55 dB-Hz and above */
+
+/* quality control accumulators of one band of a satellite */
+struct qcband {
+  int    obs;             /* epochs with code or phase */
+  int    lli;             /* phase values with loss of lock */
+  int    snrnum;          /* number of SNR values */
+  double snrsum;          /* sum of SNR values [dB-Hz] */
+  int    arcnum;          /* multipath values in the current arc */
+  double arcfirst;        /* first multipath value of the arc [m] */
+  double arcsum;          /* sums of the arc relative to arcfirst */
+  double arcsum2;
+  int    mpnum;           /* degrees of freedom of the finished arcs */
+  double mpsum2;          /* squared deviations of the finished arcs [m^2] */
+};
+
+/* quality control accumulators of a satellite */
+struct qcsat {
+  int    epochs;          /* epochs with the satellite */
+  int    last;            /* last epoch with the dual frequency pair */
+  int    gfslips;         /* slips detected in the geometry-free phase */
+  int    mwslips;         /* slips detected by Melbourne-Wuebbena */
+  double gf;              /* last geometry-free phase [m] */
+  int    mwnum;           /* Melbourne-Wuebbena values of the arc */
+  double mwsum;           /* their sum [cycles] */
+  struct qcband band[QC_NUMBANDS];
+};
+
+struct qcdata {
+  int    epochs;
+  int    firstweek;
+  int    lastweek;
+  double firsttow;        /* [ms] */
+  double lasttow;         /* [ms] */
+  int    snr[RTCM3_MSM_NUMSYS][QC_NUMBANDS][QC_NUMSNRBINS];
+  struct qcsat sat[PRN_MAX+1];
+};
+#endif /* NO_RTCM3_MAIN */
+
+/* defined since Data and DataNew of RTCM3ParserData are pointers */
+#define RTCM3PARSER_DATAPOINTER
+
 struct RTCM3ParserData {
   unsigned char Message[2048]; /* input-buffer */
-  int    MessageSize;   /* current buffer size */
+  int    MessageStart;  /* start of unprocessed data */
+  int    MessageSize;   /* end of data in buffer */
   int    NeedBytes;     /* bytes wanted for next run */
   int    SkipBytes;     /* bytes to skip in next round */
   int    GPSWeek;
   int    GPSTOW;        /* in seconds */
-  struct gnssdata Data;
+  /* Data and DataNew point into EpochData and are swapped at each epoch,
+     they were structures before (Parser->Data.x is now Parser->Data->x).
+     Data stays valid until the next epoch is complete. */
+  struct gnssdata *Data;    /* last complete epoch */
   struct gpsephemeris ephemerisGPS;
   struct galileoephemeris ephemerisGALILEO;
   struct glonassephemeris ephemerisGLONASS;
   struct sbasephemeris ephemerisSBAS;
   struct bdsephemeris ephemerisBDS;
-  struct gnssdata DataNew;
+  struct gnssdata *DataNew; /* epoch being assembled */
+  struct gnssdata EpochData[2]; /* storage for Data and DataNew */
   int    GLOFreq[PRN_GLONASS_NUM]; /* frequency numbers of GLONASS + 100 */
   int    size;
   int    lastlockGPSl1[64];
@@ -560,6 +647,23 @@ struct RTCM3ParserData {
   FILE *       sbasfile;
   FILE *       bdsfile;
   FILE *       mixedfile;
+  struct ephemerisstore *ephemerides; /* allocated with the first ephemeris */
+  int          ephemerisrepeat; /* last ephemeris was already stored */
+  double       refpos[3];       /* station XYZ [m] from 1005/1006 or the
+                                   header file, 0 if unknown */
+  double       ambclock;        /* receiver clock of restored ranges [m] */
+#ifndef NO_RTCM3_MAIN
+  int          ephemerisWritten;    /* records written to nav files */
+  int          ephemerisSuppressed; /* repeated records not written */
+  const char * qcfile;              /* quality control summary */
+  struct qcdata *qc;                /* allocated when qcfile is set */
+  long         qctime;              /* time of the next report */
+  int          statepass; /* only the state is kept, no epochs are written */
+  int          navtemp;   /* navigation output goes to temporary files */
+  int          uring;     /* output files are written with io_uring */
+  const char * checkpoint;     /* file for the parser state */
+  long         checkpointtime; /* time of the next checkpoint */
+#endif /* NO_RTCM3_MAIN */
 };
 
 #ifndef PRINTFARG
@@ -577,6 +681,28 @@ void converttime(struct converttimeinfo *c, int week, int tow);
 void HandleHeader(struct RTCM3ParserData *Parser);
 int RTCM3Parser(struct RTCM3ParserData *handle);
 void HandleByte(struct RTCM3ParserData *Parser, unsigned int byte);
+void HandleBytes(struct RTCM3ParserData *Parser, const unsigned char *buf,
+size_t len);
+/* releases the memory allocated by the parser, e.g. the ephemeris store,
+   the parser can be used again afterwards */
+void RTCM3ParserFree(struct RTCM3ParserData *Parser);
+/* The ephemeris store uses the satellite numbers of RINEX 3 (e.g. 20 for
+   SBAS PRN 120). GetEphemeris returns the current ephemeris of a satellite,
+   GetEphemerisAt the stored one valid at GPS time week/tow and nearest to
+   it. Both return 0 if there is none. */
+const struct ephemerisentry *GetEphemeris(
+const struct RTCM3ParserData *Parser, int sys, int prn);
+const struct ephemerisentry *GetEphemerisAt(
+const struct RTCM3ParserData *Parser, int sys, int prn, int week, int tow);
+/* SatellitePositions computes position [m] (ECEF of the system) and clock
+   [s] at GPS time week/tow for num ephemerides, e.g. from GetEphemerisAt.
+   The results for eph[i] are pos[3*i..3*i+2] and clock[i], zero if eph[i]
+   is 0. Returns the number of computed satellites. SatelliteAzEl gives
+   azimuth and elevation [rad] of num positions seen from station. */
+int SatellitePositions(const struct ephemerisentry * const *eph, int num,
+int week, double tow, double *pos, double *clock);
+void SatelliteAzEl(const double *station, int num, const double *pos,
+double *azimuth, double *elevation);
 void PRINTFARG(1,2) RTCM3Error(const char *fmt, ...);
 void PRINTFARG(1,2) RTCM3Text(const char *fmt, ...);
 
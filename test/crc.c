@@ -0,0 +1,93 @@
+/*
+  Compares the CRC24Q variants of the converter with the bitwise CRC.
+
+  Every length from 0 to 2000 bytes is tested at the alignments 0 to 7 with
+  the byte table, slice-by-8 and, where the CPU has it, the carry-less
+  multiplication kernel. The CRC of overlapping frames derived by
+  CRC24Check() during resynchronisation is compared too.
+*/
+
+#define NO_RTCM3_MAIN
+#include "rtcm3torinex.c"
+
+void RTCM3Error(const char *fmt, ...)
+{
+  va_list v;
+  va_start(v, fmt);
+  vfprintf(stderr, fmt, v);
+  va_end(v);
+}
+
+/* the CRC24 of the original converter, one bit at a time */
+static uint32_t CRC24Bitwise(long size, const unsigned char *buf)
+{
+  uint32_t crc = 0;
+  int i;
+
+  while(size--)
+  {
+    crc ^= (*buf++) << 16;
+    for(i = 0; i < 8; i++)
+    {
+      crc <<= 1;
+      if(crc & 0x1000000)
+        crc ^= 0x01864cfb;
+    }
+  }
+  return crc & 0xFFFFFF;
+}
+
+int main(void)
+{
+  static unsigned char buf[4096];
+  long errors = 0, spans = 0;
+  int i, n;
+
+  srand(1);
+  for(i = 0; i < (int)sizeof(buf); ++i)
+    buf[i] = rand();
+  CRC24Init();
+  for(n = 0; n <= 2000; ++n)
+  {
+    for(i = 0; i < 8; ++i)
+    {
+      uint32_t c = CRC24Bitwise(n, buf+i);
+      if(CRC24Table(0, n, buf+i) >> 8 != c
+      || CRC24Slice8(0, n, buf+i) >> 8 != c
+#ifdef RTCM3_PCLMUL
+      || (crc24func == CRC24Clmul && CRC24Clmul(0, n, buf+i) >> 8 != c)
+#endif
+      )
+      {
+        if(++errors <= 10)
+          fprintf(stderr, "length %d alignment %d: CRC differs\n", n, i);
+      }
+    }
+  }
+
+  /* a candidate frame following a previous one at random offsets, the
+     CRC is derived whenever this saves bytes */
+  crc24reuse = 0;
+  for(i = 0; i < 200000; ++i)
+  {
+    struct CRC24Span span;
+    int a = rand() % 1024, la = rand() % 1027, b = a+rand() % 1100;
+    int lb = rand() % 1027;
+
+    span.start = buf;
+    span.len = 0;
+    span.crc = 0;
+    CRC24Check(&span, buf+a, la);
+    CRC24Check(&span, buf+b, lb);
+    ++spans;
+    if(span.crc >> 8 != CRC24Bitwise(lb, buf+b))
+    {
+      if(++errors <= 10)
+        fprintf(stderr, "span %d+%d after %d+%d: CRC differs\n", b, lb, a, la);
+    }
+  }
+  printf("CRC24 (%s): lengths 0-2000 at 8 alignments and %ld overlapping "
+  "frames, %ld errors\n", crc24func == CRC24Slice8 ? "slice-by-8"
+  : "carry-less multiplication", spans, errors);
+  return errors != 0;
+}
@@ -0,0 +1,99 @@
+/*
+  Checks that a rebroadcast ephemeris is written only once.
+
+  usage: ephrepeat
+
+  GLONASS ephemerides (1020) are decoded which differ only in the frame
+  time tk, as a caster sends them every 30 seconds. Only the first may be
+  new, one with changed orbit data is new again.
+*/
+
+#define NO_RTCM3_MAIN
+#include "rtcm3torinex.c"
+
+void RTCM3Error(const char *fmt, ...)
+{
+  va_list v;
+  va_start(v, fmt);
+  vfprintf(stderr, fmt, v);
+  va_end(v);
+}
+
+#define GLONASSSIZE 45 /* message 1020 without the frame */
+
+static void Put(unsigned char *d, int pos, unsigned long v, int n)
+{
+  while(n--)
+  {
+    if((v >> n) & 1)
+      d[pos/8] |= 0x80 >> (pos%8);
+    else
+      d[pos/8] &= ~(0x80 >> (pos%8));
+    ++pos;
+  }
+}
+
+/* the 1020 payload of satellite 5 with tb 12:00, the frame time tk is
+   given in seconds, x is the x position word */
+static void GLONASS(unsigned char *d, long tk, unsigned long x)
+{
+  int i;
+
+  srand(1);
+  for(i = 0; i < GLONASSSIZE; ++i)
+    d[i] = rand();
+  Put(d, 0, 1020, 12);
+  Put(d, 12, 5, 6);
+  Put(d, 18, 8, 5);              /* frequency number 1 */
+  Put(d, 27, tk/3600, 5);
+  Put(d, 32, (tk%3600)/60, 6);
+  Put(d, 38, (tk%60)/30, 1);
+  Put(d, 41, 12*4, 7);           /* tb in 15 minutes */
+  Put(d, 72, x, 27);
+}
+
+/* decodes a payload, returns 1 if it is a new ephemeris */
+static int Decode(struct RTCM3ParserData *p, const unsigned char *d)
+{
+  p->size = GLONASSSIZE;
+  if(RTCM3Decode(p, d) != 1020)
+  {
+    fprintf(stderr, "message 1020 is not decoded\n");
+    exit(1);
+  }
+  return !p->ephemerisrepeat;
+}
+
+int main(void)
+{
+  static const struct { long tk; unsigned long x; int isnew; } msgs[] = {
+    {11*3600+50*60, 1000, 1},
+    {11*3600+50*60+30, 1000, 0}, /* rebroadcast */
+    {11*3600+55*60, 1000, 0},
+    {11*3600+55*60+30, 2000, 1}, /* changed orbit */
+    {11*3600+56*60, 2000, 0}
+  };
+  struct RTCM3ParserData *p;
+  unsigned char d[GLONASSSIZE];
+  int i, errors = 0;
+
+  if(!(p = calloc(1, sizeof(*p))))
+    return 1;
+  p->GPSWeek = 2000;
+  p->GPSTOW = 3*86400+9*3600;
+  for(i = 0; i < (int)(sizeof(msgs)/sizeof(*msgs)); ++i)
+  {
+    GLONASS(d, msgs[i].tk, msgs[i].x);
+    if(Decode(p, d) != msgs[i].isnew)
+    {
+      printf("message %d with tk %ld is %s\n", i, msgs[i].tk,
+      msgs[i].isnew ? "a repeat" : "new");
+      errors = 1;
+    }
+  }
+  if(!errors)
+    printf("rebroadcast GLONASS ephemerides are written once\n");
+  RTCM3ParserFree(p);
+  free(p);
+  return errors;
+}
@@ -0,0 +1,119 @@
+/*
+  Compares the fast number formatting of the converter with printf.
+
+  usage: format [count [seed]]
+
+  FormatFixed must give the "%*.*f" text of printf for every width and
+  precision used by the observation output and FormatExp the "%19.12e"
+  text with 'D' exponent of the navigation output. Random doubles of all
+  magnitudes are tested together with exact rounding ties, numbers near
+  powers of ten and values which round up to the next decade.
+*/
+
+#define NO_RTCM3_MAIN
+#include "rtcm3torinex.c"
+
+void RTCM3Error(const char *fmt, ...)
+{
+  va_list v;
+  va_start(v, fmt);
+  vfprintf(stderr, fmt, v);
+  va_end(v);
+}
+
+static uint64_t seed = 1;
+
+static uint64_t Rand64(void)
+{
+  seed ^= seed << 13;
+  seed ^= seed >> 7;
+  seed ^= seed << 17;
+  return seed;
+}
+
+/* a double with random mantissa and a decimal exponent in [-maxexp, maxexp],
+   sometimes one with few mantissa bits, which gives exact ties */
+static double RandDouble(int maxexp)
+{
+  double x;
+  uint64_t r = Rand64();
+
+  switch(r % 4)
+  {
+  case 0: /* k/2^n */
+    x = ldexp((double)(Rand64() % 100000000), -(int)(Rand64() % 30));
+    break;
+  case 1: /* close to a power of ten */
+    x = pow(10.0, (double)((int)(Rand64() % (2*maxexp+1))-maxexp));
+    x = nextafter(x, Rand64() & 1 ? HUGE_VAL : 0.0);
+    break;
+  default:
+    x = (Rand64() >> 11)*(1.0/9007199254740992.0)
+    * pow(10.0, (double)((int)(Rand64() % (2*maxexp+1))-maxexp));
+    break;
+  }
+  return (r >> 63) ? -x : x;
+}
+
+static int TestFixed(long count)
+{
+  char fast[40], ref[40];
+  long i, errors = 0;
+
+  for(i = 0; i < count; ++i)
+  {
+    double x = RandDouble(9);
+    int width = (int)(Rand64() % 17), prec = (int)(Rand64() % 8), n, r;
+
+    if(!(n = FormatFixed(fast, x, width, prec))) /* printf is used */
+      continue;
+    r = snprintf(ref, sizeof(ref), "%*.*f", width, prec, x);
+    if(n != r || memcmp(fast, ref, n))
+    {
+      if(++errors <= 10)
+        fprintf(stderr, "FormatFixed(%.17g, %d, %d): '%.*s' printf '%s'\n",
+        x, width, prec, n, fast, ref);
+    }
+  }
+  printf("FormatFixed: %ld values, %ld differ from printf\n", count, errors);
+  return errors != 0;
+}
+
+static int TestExp(long count)
+{
+  char fast[40], ref[40];
+  long i, errors = 0;
+  int k;
+
+  for(i = 0; i < count; ++i)
+  {
+    double x = i ? RandDouble(25) : 0.0;
+    int n = FormatExp(fast, x), r;
+
+    r = snprintf(ref, sizeof(ref), "%19.12e", x);
+    for(k = 0; k < r; ++k)
+    {
+      if(ref[k] == 'e') ref[k] = 'D';
+    }
+    if(n != r || memcmp(fast, ref, n))
+    {
+      if(++errors <= 10)
+        fprintf(stderr, "FormatExp(%.17g): '%.*s' printf '%s'\n", x, n, fast,
+        ref);
+    }
+  }
+  printf("FormatExp: %ld values, %ld differ from printf\n", count, errors);
+  return errors != 0;
+}
+
+int main(int argc, char **argv)
+{
+  long count = argc > 1 ? atol(argv[1]) : 2000000;
+  int res;
+
+  if(argc > 2)
+    seed = strtoull(argv[2], 0, 10) | 1;
+  res = TestFixed(count);
+  res |= TestExp(count);
+  return res;
+}
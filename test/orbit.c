@@ -0,0 +1,303 @@
+/*
+  Compares the satellite orbits of the converter with a plain reference.
+
+  usage: orbit [count [seed]]
+
+  Random ephemerides of GPS, Galileo, BeiDou (MEO, IGSO and GEO), GLONASS
+  and SBAS with realistic orbits are given to SatellitePositions() in
+  blocks of varying size with unused entries in between. The reference
+  computes every satellite alone with the libm functions, Kepler's
+  equation solved to convergence, and the GLONASS equations integrated
+  with Runge-Kutta steps of one second.
+*/
+
+#define NO_RTCM3_MAIN
+#include "rtcm3torinex.c"
+
+void RTCM3Error(const char *fmt, ...)
+{
+  va_list v;
+  va_start(v, fmt);
+  vfprintf(stderr, fmt, v);
+  va_end(v);
+}
+
+#define MAXPOS  1e-3  /* [m] */
+#define MAXCLK  1e-12 /* [s] */
+
+static uint64_t seed = 1;
+
+static uint64_t Rand64(void)
+{
+  seed ^= seed << 13;
+  seed ^= seed >> 7;
+  seed ^= seed << 17;
+  return seed;
+}
+
+/* uniform in [a, b) */
+static double Uniform(double a, double b)
+{
+  return a + (b-a)*((Rand64() >> 11)*(1.0/9007199254740992.0));
+}
+
+#define RANDKEPLER(g, sqrta, incl) \
+{ \
+  (g)->sqrt_A = sqrta*Uniform(0.9999, 1.0001); \
+  (g)->e = Uniform(0.0, 0.03); \
+  (g)->i0 = incl + Uniform(-0.02, 0.02); \
+  (g)->M0 = Uniform(-M_PI, M_PI); \
+  (g)->omega = Uniform(-M_PI, M_PI); \
+  (g)->OMEGA0 = Uniform(-M_PI, M_PI); \
+  (g)->Delta_n = Uniform(3e-9, 6e-9); \
+  (g)->OMEGADOT = Uniform(-9e-9, -7e-9); \
+  (g)->IDOT = Uniform(-5e-10, 5e-10); \
+  (g)->Cuc = Uniform(-1e-5, 1e-5); (g)->Cus = Uniform(-1e-5, 1e-5); \
+  (g)->Cic = Uniform(-2e-7, 2e-7); (g)->Cis = Uniform(-2e-7, 2e-7); \
+  (g)->Crc = Uniform(-400.0, 400.0); (g)->Crs = Uniform(-200.0, 200.0); \
+  (g)->TOE = ((int)tow/1800 + (int)(Rand64() % 9)-4)*1800; \
+  (g)->TOC = (g)->TOE - (Rand64() & 1 ? 0 : 16); \
+  (g)->clock_bias = Uniform(-1e-3, 1e-3); \
+  (g)->clock_drift = Uniform(-1e-11, 1e-11); \
+  (g)->clock_driftrate = Uniform(-1e-18, 1e-18); \
+  e->toe = (g)->TOE; \
+}
+
+/* a random ephemeris of week 2300 valid at tow */
+static void RandEphemeris(struct ephemerisentry *e, double tow)
+{
+  memset(e, 0, sizeof(*e));
+  e->week = 2300;
+  switch(Rand64() % 6)
+  {
+  case 0:
+    e->type = 1019;
+    RANDKEPLER(&e->data.gps, 5153.6, 0.96)
+    break;
+  case 1:
+    e->type = 1046;
+    RANDKEPLER(&e->data.galileo, 5440.6, 0.98)
+    break;
+  case 2:
+    {
+      int prn = 1 + (int)(Rand64() % 46), geo = prn <= 5;
+      e->type = RTCM3ID_BDS;
+      e->data.bds.satellite = PRN_BDS_START-1+prn;
+      if(geo || prn <= 18)
+        RANDKEPLER(&e->data.bds, 6493.4, geo ? 0.001 : 0.96)
+      else
+        RANDKEPLER(&e->data.bds, 5282.6, 0.96)
+    }
+    break;
+  case 3:
+    e->type = 1044;
+    RANDKEPLER(&e->data.gps, 6493.4, 0.7)
+    break;
+  case 4: /* a circular orbit of 25510 km in the earth fixed frame */
+    {
+      struct glonassephemeris *o = &e->data.glonass;
+      double r = 25510.0, v = sqrt(GLO_GM*1e-9/r), l = Uniform(-M_PI, M_PI);
+      double i = Uniform(1.1, 1.15), a = Uniform(-M_PI, M_PI);
+      double u[3], w[3];
+
+      e->type = 1020;
+      e->toe = (int)tow + (int)(Rand64() % 1801)-900;
+      u[0] = cos(l)*cos(a) - sin(l)*sin(a)*cos(i);
+      u[1] = cos(l)*sin(a) + sin(l)*cos(a)*cos(i);
+      u[2] = sin(l)*sin(i);
+      w[0] = -sin(l)*cos(a) - cos(l)*sin(a)*cos(i);
+      w[1] = -sin(l)*sin(a) + cos(l)*cos(a)*cos(i);
+      w[2] = cos(l)*sin(i);
+      o->x_pos = r*u[0]; o->y_pos = r*u[1]; o->z_pos = r*u[2];
+      o->x_velocity = v*w[0] + GLO_OMEGAE*o->y_pos;
+      o->y_velocity = v*w[1] - GLO_OMEGAE*o->x_pos;
+      o->z_velocity = v*w[2];
+      o->x_acceleration = Uniform(-3e-9, 3e-9);
+      o->y_acceleration = Uniform(-3e-9, 3e-9);
+      o->z_acceleration = Uniform(-3e-9, 3e-9);
+      o->tau = Uniform(-1e-4, 1e-4);
+      o->gamma = Uniform(-1e-11, 1e-11);
+    }
+    break;
+  default:
+    {
+      struct sbasephemeris *s = &e->data.sbas;
+      e->type = 1043;
+      e->toe = 302400;
+      s->x_pos = Uniform(-4.2e7, 4.2e7); s->y_pos = Uniform(-4.2e7, 4.2e7);
+      s->z_pos = Uniform(-1e5, 1e5);
+      s->x_velocity = Uniform(-1.0, 1.0); s->y_velocity = Uniform(-1.0, 1.0);
+      s->z_velocity = Uniform(-1.0, 1.0);
+      s->x_acceleration = Uniform(-1e-4, 1e-4);
+      s->y_acceleration = Uniform(-1e-4, 1e-4);
+      s->z_acceleration = Uniform(-1e-4, 1e-4);
+      s->agf0 = Uniform(-1e-6, 1e-6); s->agf1 = Uniform(-1e-11, 1e-11);
+    }
+    break;
+  }
+}
+
+#define REFKEPLER(g, gm, omegae, geo) \
+{ \
+  double a = (g)->sqrt_A*(g)->sqrt_A, M, E, v, u, r, i, O, du, x, y, tc; \
+  int n, d = (g)->TOE - (g)->TOC; \
+  if(d > 7*24*60*60/2) d -= 7*24*60*60; \
+  else if(d < -7*24*60*60/2) d += 7*24*60*60; \
+  tc = dt + d; \
+  M = (g)->M0 + (sqrt(gm/(a*a*a)) + (g)->Delta_n)*dt; \
+  for(E = M, n = 0; n < 30; ++n) \
+    E = M + (g)->e*sin(E); \
+  v = atan2(sqrt(1.0-(g)->e*(g)->e)*sin(E), cos(E)-(g)->e); \
+  u = v + (g)->omega; \
+  du = (g)->Cus*sin(2*u) + (g)->Cuc*cos(2*u); \
+  r = a*(1.0-(g)->e*cos(E)) + (g)->Crs*sin(2*u) + (g)->Crc*cos(2*u); \
+  i = (g)->i0 + (g)->IDOT*dt + (g)->Cis*sin(2*u) + (g)->Cic*cos(2*u); \
+  u += du; \
+  x = r*cos(u); \
+  y = r*sin(u); \
+  O = (g)->OMEGA0 + ((g)->OMEGADOT - (geo ? 0.0 : omegae))*dt \
+  - omegae*(g)->TOE; \
+  pos[0] = x*cos(O) - y*cos(i)*sin(O); \
+  pos[1] = x*sin(O) + y*cos(i)*cos(O); \
+  pos[2] = y*sin(i); \
+  *clock = (g)->clock_bias + (g)->clock_drift*tc \
+  + (g)->clock_driftrate*tc*tc \
+  - 2.0*sqrt(gm)/(LIGHTSPEED*LIGHTSPEED)*(g)->e*(g)->sqrt_A*sin(E); \
+  if(geo) \
+  { \
+    double s5 = sin(-5.0*M_PI/180.0), c5 = cos(-5.0*M_PI/180.0); \
+    double s = sin(omegae*dt), c = cos(omegae*dt), y = pos[1]*c5+pos[2]*s5; \
+    double z = -pos[1]*s5 + pos[2]*c5; \
+    pos[1] = -pos[0]*s + y*c; \
+    pos[0] = pos[0]*c + y*s; \
+    pos[2] = z; \
+  } \
+}
+
+static void RefDerivative(const double *s, const double *acc, double *d)
+{
+  double r = sqrt(s[0]*s[0] + s[1]*s[1] + s[2]*s[2]);
+  double gm = GLO_GM/(r*r*r), w2 = GLO_OMEGAE*GLO_OMEGAE;
+  double j2 = 1.5*GLO_J2*GLO_GM*GLO_AE*GLO_AE/(r*r*r*r*r);
+  double z5 = 5.0*s[2]*s[2]/(r*r);
+
+  d[0] = s[3];
+  d[1] = s[4];
+  d[2] = s[5];
+  d[3] = (w2 - gm - j2*(1.0-z5))*s[0] + 2.0*GLO_OMEGAE*s[4] + acc[0];
+  d[4] = (w2 - gm - j2*(1.0-z5))*s[1] - 2.0*GLO_OMEGAE*s[3] + acc[1];
+  d[5] = (-gm - j2*(3.0-z5))*s[2] + acc[2];
+}
+
+static void RefPosition(const struct ephemerisentry *e, double dt,
+double *pos, double *clock)
+{
+  if(e->type == 1020)
+  {
+    const struct glonassephemeris *o = &e->data.glonass;
+    double p[6], t[6], k1[6], k2[6], k3[6], k4[6], acc[3], h;
+    int steps = (int)ceil(fabs(dt)), n, i; /* 1 s steps */
+
+    if(steps < 1)
+      steps = 1;
+    h = dt/steps;
+    p[0] = o->x_pos*1000.0; p[1] = o->y_pos*1000.0; p[2] = o->z_pos*1000.0;
+    p[3] = o->x_velocity*1000.0; p[4] = o->y_velocity*1000.0;
+    p[5] = o->z_velocity*1000.0;
+    acc[0] = o->x_acceleration*1000.0; acc[1] = o->y_acceleration*1000.0;
+    acc[2] = o->z_acceleration*1000.0;
+    for(n = 0; n < steps; ++n)
+    {
+      RefDerivative(p, acc, k1);
+      for(i = 0; i < 6; ++i) t[i] = p[i] + 0.5*h*k1[i];
+      RefDerivative(t, acc, k2);
+      for(i = 0; i < 6; ++i) t[i] = p[i] + 0.5*h*k2[i];
+      RefDerivative(t, acc, k3);
+      for(i = 0; i < 6; ++i) t[i] = p[i] + h*k3[i];
+      RefDerivative(t, acc, k4);
+      for(i = 0; i < 6; ++i)
+        p[i] += h/6.0*(k1[i] + 2.0*k2[i] + 2.0*k3[i] + k4[i]);
+    }
+    pos[0] = p[0]; pos[1] = p[1]; pos[2] = p[2];
+    *clock = -o->tau + o->gamma*dt;
+  }
+  else if(e->type == 1043)
+  {
+    const struct sbasephemeris *s = &e->data.sbas;
+    pos[0] = s->x_pos + s->x_velocity*dt + 0.5*s->x_acceleration*dt*dt;
+    pos[1] = s->y_pos + s->y_velocity*dt + 0.5*s->y_acceleration*dt*dt;
+    pos[2] = s->z_pos + s->z_velocity*dt + 0.5*s->z_acceleration*dt*dt;
+    *clock = s->agf0 + s->agf1*dt;
+  }
+  else if(e->type == RTCM3ID_BDS)
+  {
+    int prn = e->data.bds.satellite-PRN_BDS_START+1;
+    REFKEPLER(&e->data.bds, BDS_GM, BDS_OMEGAE, prn <= 5 || prn >= 59)
+  }
+  else if(e->type == 1046)
+    REFKEPLER(&e->data.galileo, GAL_GM, GPS_OMEGAE, 0)
+  else
+    REFKEPLER(&e->data.gps, GPS_GM, GPS_OMEGAE, 0)
+}
+
+int main(int argc, char **argv)
+{
+  static struct ephemerisentry store[64];
+  const struct ephemerisentry *eph[64];
+  double pos[3*64], clock[64], maxpos = 0.0, maxclk = 0.0;
+  long count = argc > 1 ? atol(argv[1]) : 5000, i, sats = 0, errors = 0;
+  const char *names[] = {"GPS", "Galileo", "BDS", "QZSS", "GLONASS", "SBAS"};
+
+  if(argc > 2)
+    seed = strtoull(argv[2], 0, 10) | 1;
+  for(i = 0; i < count; ++i)
+  {
+    int num = 1 + (int)(Rand64() % 64), j, n = 0;
+    double tow = 302400 + Uniform(-7200.0, 7200.0);
+
+    for(j = 0; j < num; ++j)
+    {
+      eph[j] = 0;
+      if(Rand64() % 8)
+      {
+        RandEphemeris(&store[j], tow);
+        eph[j] = &store[j];
+        ++n;
+      }
+    }
+    if(SatellitePositions(eph, num, 2300, tow, pos, clock) != n)
+    {
+      fprintf(stderr, "SatellitePositions: wrong number of satellites\n");
+      return 1;
+    }
+    for(j = 0; j < num; ++j)
+    {
+      double ref[3] = {0.0, 0.0, 0.0}, refclk = 0.0, d;
+
+      if(eph[j])
+        RefPosition(eph[j], tow - eph[j]->toe, ref, &refclk);
+      d = sqrt((pos[3*j]-ref[0])*(pos[3*j]-ref[0])
+      + (pos[3*j+1]-ref[1])*(pos[3*j+1]-ref[1])
+      + (pos[3*j+2]-ref[2])*(pos[3*j+2]-ref[2]));
+      if(d > maxpos)
+        maxpos = d;
+      if(fabs(clock[j]-refclk) > maxclk)
+        maxclk = fabs(clock[j]-refclk);
+      if(d > MAXPOS || fabs(clock[j]-refclk) > MAXCLK)
+      {
+        if(++errors <= 10)
+        {
+          int t = eph[j]->type;
+          fprintf(stderr, "%s dt %.0f: position differs by %.3g m,"
+          " clock by %.3g s\n", names[t == 1019 ? 0 : t == 1046 ? 1
+          : t == RTCM3ID_BDS ? 2 : t == 1044 ? 3 : t == 1020 ? 4 : 5],
+          tow - eph[j]->toe, d, fabs(clock[j]-refclk));
+        }
+      }
+      sats += !!eph[j];
+    }
+  }
+  printf("SatellitePositions: %ld satellites, largest difference %.2g m"
+  " and %.2g s, %ld too large\n", sats, maxpos, maxclk, errors);
+  return errors != 0;
+}
@@ -0,0 +1,150 @@
+/*
+  Checks the resynchronisation on corrupted RTCM3 streams.
+
+  usage: resync file
+
+  Bit errors, noise and dense false preambles are put into the recording.
+  The frames RTCM3Sync() finds must be the ones of a plain search, which
+  tests every position with the bitwise CRC.
+*/
+
+#define NO_RTCM3_MAIN
+#include "rtcm3torinex.c"
+
+void RTCM3Error(const char *fmt, ...)
+{
+  va_list v;
+  va_start(v, fmt);
+  vfprintf(stderr, fmt, v);
+  va_end(v);
+}
+
+static uint32_t CRC24Bitwise(long size, const unsigned char *buf)
+{
+  uint32_t crc = 0;
+  int i;
+
+  while(size--)
+  {
+    crc ^= (*buf++) << 16;
+    for(i = 0; i < 8; i++)
+    {
+      crc <<= 1;
+      if(crc & 0x1000000)
+        crc ^= 0x01864cfb;
+    }
+  }
+  return crc & 0xFFFFFF;
+}
+
+/* the frames of d in order: a preamble, no reserved bits, a valid CRC */
+static long PlainSearch(const unsigned char *d, long n, long *frames)
+{
+  long p = 0, num = 0;
+
+  while(p+6 <= n)
+  {
+    int size = ((d[p+1]&3)<<8)|d[p+2];
+    if(d[p] == 0xD3 && !(d[p+1] & 0xFC) && p+size+6 <= n
+    && CRC24Bitwise(size+3, d+p)
+    == (uint32_t)((d[p+size+3]<<16)|(d[p+size+4]<<8)|d[p+size+5]))
+    {
+      frames[num++] = p;
+      p += size+6;
+    }
+    else
+      ++p;
+  }
+  return num;
+}
+
+/* the same with RTCM3Sync(), a candidate reaching beyond the end of the
+   data is skipped as at the end of a stream */
+static long SyncSearch(const unsigned char *d, long n, long *frames)
+{
+  const unsigned char *m = d, *e = d+n;
+  long num = 0;
+  int need;
+
+  while(m < e)
+  {
+    m = RTCM3Sync(m, e, &need);
+    if(!need)
+    {
+      frames[num++] = m-d;
+      m += (((m[1]&3)<<8)|m[2])+6;
+    }
+    else if(m < e)
+      ++m;
+  }
+  return num;
+}
+
+/* corruption: 0 none, 1 and 2 bit errors, 3 noise blocks, 4 preambles */
+static void Corrupt(unsigned char *d, long n, int mode)
+{
+  long i;
+
+  srand(mode);
+  for(i = 0; i < n; ++i)
+  {
+    if((mode == 1 && rand() % 80000 == 0) || (mode == 2 && rand() % 8000 == 0))
+      d[i] ^= 1 << (rand() % 8);
+    else if(mode == 3 && rand() % 20000 == 0)
+    {
+      long k;
+      for(k = 0; k < 500 && i < n; ++k, ++i)
+        d[i] = rand();
+    }
+    else if(mode == 4 && rand() % 2000 == 0)
+    {
+      long k;
+      for(k = 0; k < 300 && i+3 <= n; k += 3, i += 3)
+      {
+        d[i] = 0xD3;
+        d[i+1] = rand() & 3;
+        d[i+2] = rand();
+      }
+    }
+  }
+}
+
+int main(int argc, char **argv)
+{
+  static const char *modes[] = {"clean", "BER 1e-4", "BER 1e-3", "noise",
+  "dense preambles"};
+  unsigned char *data, *d;
+  long n, *fa, *fb, na, nb, k;
+  int mode, errors = 0;
+  FILE *f;
+
+  if(argc != 2 || !(f = fopen(argv[1], "rb")) || fseek(f, 0, SEEK_END)
+  || (n = ftell(f)) <= 0 || fseek(f, 0, SEEK_SET) || !(data = malloc(n))
+  || !(d = malloc(n)) || !(fa = malloc(n*sizeof(*fa)))
+  || !(fb = malloc(n*sizeof(*fb))) || fread(data, 1, n, f) != (size_t)n)
+  {
+    fprintf(stderr, "usage: %s file\n", argv[0]);
+    return 1;
+  }
+  fclose(f);
+  CRC24Init();
+  crc24reuse = 0; /* overlapping CRCs are derived whenever possible */
+  for(mode = 0; mode < 5; ++mode)
+  {
+    memcpy(d, data, n);
+    Corrupt(d, n, mode);
+    na = PlainSearch(d, n, fa);
+    nb = SyncSearch(d, n, fb);
+    for(k = 0; k < na && k < nb && fa[k] == fb[k]; ++k)
+      ;
+    printf("%-15s %6ld frames, ", modes[mode], na);
+    if(na != nb || k != na)
+    {
+      printf("RTCM3Sync finds %ld, first difference at frame %ld\n", nb, k);
+      errors = 1;
+    }
+    else
+      printf("same frames found by RTCM3Sync\n");
+  }
+  return errors;
+}
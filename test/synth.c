@@ -0,0 +1,495 @@
+/*
+  Synthetic RTCM3 streams for the tests and benchmarks.
+
+  usage: synth mode [epochs [seed]] > file
+
+  mode is msm1 ... msm7 (all systems with this MSM type), mixed (changing
+  MSM types), legacy (1001-1004 and 1009-1012) or eph (an MSM4 epoch and a
+  re-broadcast of all ephemerides every 4 seconds). Ephemerides are added
+  every 5 epochs, random bytes between the messages and a corrupted frame at
+  the end test the resynchronisation. The values are random, but the output
+  only depends on the seed.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define WEEK 2440
+#define LEAP 17
+
+static unsigned long long seed = 1;
+
+/* random number in [0, n) */
+static long Rand(long n)
+{
+  seed = seed*6364136223846793005ULL+1442695040888963407ULL;
+  return (long)((seed >> 33) % (unsigned long long)n);
+}
+
+/* random number in [a, b) */
+static long RandRange(long a, long b)
+{
+  return a+Rand(b-a);
+}
+
+static double RandDouble(void)
+{
+  return Rand(1L<<30)/(double)(1L<<30);
+}
+
+struct Bits
+{
+  unsigned char buf[1030];
+  int pos; /* written bits */
+};
+
+static void BitsInit(struct Bits *w)
+{
+  memset(w, 0, sizeof(*w));
+}
+
+static void Put(struct Bits *w, unsigned long long v, int n)
+{
+  while(n--)
+  {
+    if((v >> n) & 1)
+      w->buf[3+w->pos/8] |= 0x80 >> (w->pos%8);
+    ++w->pos;
+  }
+}
+
+/* n random bits */
+static void PutRand(struct Bits *w, int n)
+{
+  while(n > 0)
+  {
+    int k = n > 30 ? 30 : n;
+    Put(w, Rand(1L<<k), k);
+    n -= k;
+  }
+}
+
+static unsigned int CRC24(const unsigned char *buf, int size)
+{
+  unsigned int crc = 0;
+  int i;
+
+  while(size--)
+  {
+    crc ^= (unsigned int)*(buf++) << 16;
+    for(i = 0; i < 8; ++i)
+    {
+      crc <<= 1;
+      if(crc & 0x1000000)
+        crc ^= 0x01864cfb;
+    }
+  }
+  return crc;
+}
+
+/* writes the frame, size is the payload length or 0 for the written bits */
+static void Frame(struct Bits *w, int size)
+{
+  unsigned int crc;
+
+  if(!size)
+    size = (w->pos+7)/8;
+  w->buf[0] = 0xD3;
+  w->buf[1] = (size >> 8) & 3;
+  w->buf[2] = size & 0xFF;
+  crc = CRC24(w->buf, size+3);
+  w->buf[size+3] = crc >> 16;
+  w->buf[size+4] = crc >> 8;
+  w->buf[size+5] = crc;
+  fwrite(w->buf, 1, size+6, stdout);
+}
+
+static const int sigs[6][4] = {{1,9,15,22}, {1,2,7,8}, {1,14,18,22},
+{1,22}, {1,15,22}, {1,7,13}};
+static const int numsigs[6] = {4,4,4,2,3,3};
+static const int sats[6][8] = {{2,5,7,9,13,20,28,30}, {1,3,8,10,17,23},
+{1,4,11,19,26,30,51}, {0,3,7}, {0,1,2}, {0,5,10,14}};
+static const int numsats[6] = {8,6,7,3,3,4};
+
+/* a value of n bits, sometimes the invalid marker */
+static void PutValue(struct Bits *w, long range, int n)
+{
+  if(RandDouble() < 0.03)
+    Put(w, 1ULL << (n-1), n);
+  else
+    Put(w, (unsigned long long)RandRange(-range, range), n);
+}
+
+/* system 0 GPS, 1 GLONASS, 2 Galileo, 3 SBAS, 4 QZSS, 5 BeiDou */
+static void MSM(int sys, int msm, long long tow, int sync)
+{
+  struct Bits w;
+  unsigned long long mask;
+  int i, ns = numsats[sys], ng = numsigs[sys], nc = 0;
+
+  BitsInit(&w);
+  Put(&w, 1071+sys*10+msm-1, 12);
+  Put(&w, 0, 12);
+  if(sys == 1)
+  {
+    Put(&w, (tow/86400000)%7, 3);
+    Put(&w, (tow-LEAP*1000+3*3600000)%86400000, 27);
+  }
+  else if(sys == 5)
+    Put(&w, (tow-14000)%(7*86400000LL), 30);
+  else
+    Put(&w, tow, 30);
+  Put(&w, sync, 1);
+  Put(&w, 0, 18);
+  for(mask = 0, i = 0; i < ns; ++i)
+    mask |= 1ULL << (63-sats[sys][i]);
+  Put(&w, mask, 64);
+  for(mask = 0, i = 0; i < ng; ++i)
+    mask |= 1ULL << (31-sigs[sys][i]);
+  Put(&w, mask, 32);
+  for(i = 0; i < ns*ng; ++i)
+  {
+    int c = RandDouble() < 0.85;
+    nc += c;
+    Put(&w, c, 1);
+  }
+
+  /* satellite data */
+  if(msm >= 4)
+  {
+    for(i = 0; i < ns; ++i)
+      Put(&w, RandRange(64, 90), 8);
+  }
+  if(msm == 5 || msm == 7)
+  {
+    for(i = 0; i < ns; ++i)
+      Put(&w, sys == 1 ? Rand(14) : 0, 4);
+  }
+  for(i = 0; i < ns; ++i)
+    Put(&w, Rand(1024), 10);
+  if(msm == 5 || msm == 7)
+  {
+    for(i = 0; i < ns; ++i)
+      Put(&w, RandRange(-8000, 8000), 14);
+  }
+
+  /* signal data */
+  if(msm <= 5)
+  {
+    if(msm != 2)
+    {
+      for(i = 0; i < nc; ++i)
+        PutValue(&w, 9000, 15);
+    }
+    if(msm >= 2)
+    {
+      for(i = 0; i < nc; ++i)
+        PutValue(&w, 1L<<20, 22);
+      for(i = 0; i < nc; ++i)
+        Put(&w, Rand(16), 4);
+      for(i = 0; i < nc; ++i)
+        Put(&w, 0, 1);
+    }
+    if(msm >= 4)
+    {
+      for(i = 0; i < nc; ++i)
+        Put(&w, RandRange(20, 60), 6);
+    }
+  }
+  else
+  {
+    for(i = 0; i < nc; ++i)
+      PutValue(&w, 1L<<18, 20);
+    for(i = 0; i < nc; ++i)
+      PutValue(&w, 1L<<22, 24);
+    for(i = 0; i < nc; ++i)
+      Put(&w, Rand(1024), 10);
+    for(i = 0; i < nc; ++i)
+      Put(&w, 0, 1);
+    for(i = 0; i < nc; ++i)
+      Put(&w, RandRange(300, 900), 10);
+  }
+  if(msm == 5 || msm == 7)
+  {
+    for(i = 0; i < nc; ++i)
+      PutValue(&w, 9000, 15);
+  }
+  Frame(&w, 0);
+}
+
+static void LegacyGPS(int type, long long tow, int sync)
+{
+  struct Bits w;
+  int i;
+
+  BitsInit(&w);
+  Put(&w, type, 12);
+  Put(&w, 0, 12);
+  Put(&w, tow, 30);
+  Put(&w, sync, 1);
+  Put(&w, numsats[0], 5);
+  Put(&w, 0, 4);
+  for(i = 0; i < numsats[0]; ++i)
+  {
+    Put(&w, sats[0][i], 6);
+    Put(&w, Rand(2), 1);
+    Put(&w, Rand(1L<<24), 24);
+    PutValue(&w, 1L<<18, 20);
+    Put(&w, Rand(128), 7);
+    if(type == 1002 || type == 1004)
+    {
+      Put(&w, type == 1004 ? RandRange(60, 80) : Rand(3), 8);
+      Put(&w, Rand(256), 8);
+    }
+    if(type == 1003 || type == 1004)
+    {
+      Put(&w, Rand(4), 2);
+      Put(&w, RandRange(-4000, 4000), 14);
+      Put(&w, RandRange(-(1L<<18), 1L<<18), 20);
+      Put(&w, Rand(128), 7);
+      if(type == 1004)
+        Put(&w, Rand(256), 8);
+    }
+  }
+  Frame(&w, 0);
+}
+
+static void LegacyGLONASS(int type, long long tow, int sync)
+{
+  struct Bits w;
+  int i;
+
+  BitsInit(&w);
+  Put(&w, type, 12);
+  Put(&w, 0, 12);
+  Put(&w, (tow-LEAP*1000+3*3600000)%86400000, 27);
+  Put(&w, sync, 1);
+  Put(&w, numsats[1]+1, 5);
+  Put(&w, 0, 4);
+  for(i = 0; i <= numsats[1]; ++i)
+  {
+    Put(&w, i < numsats[1] ? sats[1][i]+1 : 0, 6);
+    Put(&w, Rand(2), 1);
+    Put(&w, Rand(14), 5);
+    Put(&w, Rand(1L<<25), 25);
+    Put(&w, RandRange(-(1L<<18), 1L<<18), 20);
+    Put(&w, Rand(128), 7);
+    if(type == 1010 || type == 1012)
+    {
+      Put(&w, RandRange(30, 40), 7);
+      Put(&w, Rand(256), 8);
+    }
+    if(type == 1011 || type == 1012)
+    {
+      Put(&w, Rand(2), 2);
+      Put(&w, RandRange(-4000, 4000), 14);
+      Put(&w, RandRange(-(1L<<18), 1L<<18), 20);
+      Put(&w, Rand(128), 7);
+      if(type == 1012)
+        Put(&w, Rand(256), 8);
+    }
+  }
+  Frame(&w, 0);
+}
+
+static void EphemerisGPS(int sv, long tow)
+{
+  struct Bits w;
+
+  BitsInit(&w);
+  Put(&w, 1019, 12);
+  Put(&w, sv, 6);
+  Put(&w, WEEK%1024, 10);
+  Put(&w, Rand(16), 4);
+  Put(&w, Rand(4), 2);
+  Put(&w, RandRange(-8000, 8000), 14);
+  Put(&w, Rand(256), 8);
+  Put(&w, (tow/16)%65536, 16);
+  PutRand(&w, 8+16+22+10+16+16+32+16+32+16+32);
+  Put(&w, (tow/16)%65536, 16);
+  PutRand(&w, 16+32+16+32+16+32+24+8+6+1+1);
+  Frame(&w, 61);
+}
+
+static void EphemerisQZSS(int sv, long tow)
+{
+  struct Bits w;
+
+  BitsInit(&w);
+  Put(&w, 1044, 12);
+  Put(&w, sv, 4);
+  Put(&w, (tow/16)%65536, 16);
+  PutRand(&w, 8+16+22+8+16+16+32+16+32+16+32);
+  Put(&w, (tow/16)%65536, 16);
+  PutRand(&w, 16+32+16+32+16+32+24+14+2);
+  Put(&w, WEEK%1024, 10);
+  PutRand(&w, 4+6+8+10+1);
+  Frame(&w, 61);
+}
+
+static void EphemerisGalileo(int type, int sv, long tow)
+{
+  struct Bits w;
+
+  BitsInit(&w);
+  Put(&w, type, 12);
+  Put(&w, sv, 6);
+  Put(&w, WEEK-1024, 12);
+  Put(&w, Rand(1024), 10);
+  Put(&w, Rand(256), 8);
+  Put(&w, RandRange(-8000, 8000), 14);
+  Put(&w, (tow/60)%10080, 14);
+  PutRand(&w, 6+21+31+16+16+32+16+32+16+32);
+  Put(&w, (tow/60)%10080, 14);
+  PutRand(&w, 16+32+16+32+16+32+24+10);
+  PutRand(&w, type == 1046 ? 10+2+1+2+1 : 2+1);
+  Frame(&w, 0);
+}
+
+static void EphemerisBDS(int sv, long tow)
+{
+  struct Bits w;
+
+  BitsInit(&w);
+  Put(&w, 63, 12);
+  Put(&w, sv, 6);
+  Put(&w, WEEK-1356, 13);
+  Put(&w, Rand(16), 4);
+  Put(&w, RandRange(-8000, 8000), 14);
+  Put(&w, Rand(32), 5);
+  Put(&w, ((tow-14)/8)%(1L<<17), 17);
+  PutRand(&w, 11+22+24+5+18+16+32+18+32+18+32);
+  Put(&w, ((tow-14)/8)%(1L<<17), 17);
+  PutRand(&w, 18+32+18+32+18+32+24+10+10+1);
+  Frame(&w, 64);
+}
+
+static void EphemerisSBAS(int sv, long tow)
+{
+  struct Bits w;
+
+  BitsInit(&w);
+  Put(&w, 1043, 12);
+  Put(&w, sv, 6);
+  Put(&w, Rand(256), 8);
+  Put(&w, (tow%86400)/16, 13);
+  PutRand(&w, 4+30+30+25+17+17+18+10+10+10+12+8);
+  Frame(&w, 29);
+}
+
+static void EphemerisGLONASS(int sv, long tow)
+{
+  struct Bits w;
+  long tk = (tow-LEAP+3*3600)%86400;
+
+  BitsInit(&w);
+  Put(&w, 1020, 12);
+  Put(&w, sv, 6);
+  Put(&w, Rand(14), 5);
+  PutRand(&w, 1+1+2);
+  Put(&w, tk/3600, 5);
+  Put(&w, (tk%3600)/60, 6);
+  Put(&w, 0, 1);
+  PutRand(&w, 1+1);
+  Put(&w, (tk/900)%96, 7);
+  PutRand(&w, 24+27+5+24+27+5+24+27+5+1+11+3+22+5+5);
+  Frame(&w, 45);
+}
+
+/* a set of ephemerides, all is the full re-broadcast of a caster */
+static void Ephemerides(long tow, int all)
+{
+  int i;
+
+  for(i = 0; i < (all ? numsats[0] : 3); ++i)
+    EphemerisGPS(sats[0][i], tow);
+  for(i = 0; i < (all ? numsats[1] : 2); ++i)
+    EphemerisGLONASS(sats[1][i]+1, tow);
+  for(i = 1; i <= (all ? 8 : 1); ++i)
+  {
+    EphemerisGalileo(1045, all ? i : 4, tow);
+    EphemerisGalileo(1046, all ? i : 11, tow);
+  }
+  for(i = 1; i <= (all ? 8 : 1); ++i)
+    EphemerisBDS(all ? i : 5, tow);
+  EphemerisSBAS(3, tow);
+  EphemerisQZSS(1, tow);
+}
+
+static void Garbage(void)
+{
+  int n = Rand(40);
+
+  if(RandDouble() < 0.3)
+  {
+    while(n--)
+      putchar(RandDouble() < 0.2 ? 0xD3 : (int)Rand(256));
+  }
+}
+
+int main(int argc, char **argv)
+{
+  static const int mixed[9] = {7,4,5,6,7,7,1,2,3};
+  const char *mode = argc > 1 ? argv[1] : "";
+  int epochs = argc > 2 ? atoi(argv[2]) : 30, ep, s;
+  long long tow;
+
+  if(argc > 3)
+    seed = strtoull(argv[3], 0, 10);
+  if(strcmp(mode, "mixed") && strcmp(mode, "legacy") && strcmp(mode, "eph")
+  && (strncmp(mode, "msm", 3) || mode[3] < '1' || mode[3] > '7' || mode[4]))
+  {
+    fprintf(stderr, "usage: %s msm1...msm7|mixed|legacy|eph [epochs [seed]]\n",
+    argv[0]);
+    return 1;
+  }
+  tow = Rand(6*86400)*1000LL;
+  for(ep = 0; ep < epochs; ++ep)
+  {
+    long long t = tow+ep*1000LL;
+
+    if(!strcmp(mode, "eph"))
+    {
+      MSM(0, 4, t, 0);
+      if(ep%4 == 0)
+        Ephemerides(t/1000, 1);
+      continue;
+    }
+    if(!strcmp(mode, "legacy"))
+    {
+      Garbage();
+      LegacyGPS(ep > 10 ? 1001+ep%4 : 1004, t, 1);
+      Garbage();
+      LegacyGLONASS(ep > 10 ? 1009+ep%4 : 1012, t, 0);
+    }
+    else
+    {
+      for(s = 0; s < 6; ++s)
+      {
+        Garbage();
+        MSM(s, mode[0] == 'm' && mode[1] == 's' ? mode[3]-'0' : mixed[ep%9],
+        t, s != 5);
+      }
+    }
+    if(ep%5 == 0)
+    {
+      Garbage();
+      Ephemerides(t/1000, 0);
+      if(ep%10 == 0) /* a repeated ephemeris */
+        EphemerisGPS(sats[0][0], t/1000);
+    }
+  }
+  /* a corrupted frame */
+  putchar(0xD3);
+  putchar(0x00);
+  putchar(0x10);
+  for(s = 0; s < 30; ++s)
+    putchar((int)Rand(256));
+  return 0;
+}